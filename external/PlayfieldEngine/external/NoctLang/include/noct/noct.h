@@ -24,6 +24,13 @@
 /* Bytecode file header. */
 #define NOCT_BYTECODE_HEADER	"Noct Bytecode"
 
+/*
+ * Bytecode format version.
+ *  - Bump it when the opcodes or their operands change, so that the
+ *    stored bytecode of an older build is not loaded.
+ */
+#define NOCT_BYTECODE_VERSION	1
+
 /* Zero value. */
 #define NOCT_ZERO	{0, 0}
 
@@ -177,6 +184,20 @@ noct_register_source(
 	const char *file_name,
 	const char *source_text);
 
+/*
+ * Registers functions from a source code text, and returns the
+ * equivalent bytecode data that noct_register_bytecode() accepts.
+ * This is for a bytecode cache. Free the data by noct_free().
+ */
+NOCT_DLL
+bool
+noct_register_source_with_bytecode(
+	NoctEnv *env,
+	const char *file_name,
+	const char *source_text,
+	uint8_t **bytecode,
+	uint32_t *bytecode_size);
+
 /*
  * Registers functions from compiled bytecode data.
  */
@@ -313,6 +334,17 @@ noct_make_empty_dict(
 	NoctEnv *env,
 	NoctValue *val);
 
+/*
+ * Makes an empty dictionary value that has room for the given
+ * number of keys without a reallocation.
+ */
+NOCT_DLL
+bool
+noct_make_dict_with_capacity(
+	NoctEnv *env,
+	NoctValue *val,
+	uint32_t size);
+
 /*
  * Retrieves the type tag of a value.
  *
@@ -489,6 +521,23 @@ noct_get_dict_value_by_index(
 	uint32_t index,
 	NoctValue *val);
 
+/*
+ * Retrieves a dictionary key-value pair by a cursor.
+ *
+ * The cursor must be initialized to 0, and is advanced past the
+ * returned pair. Calling this function as many times as the dictionary
+ * size traverses the entries in the same order as the index functions,
+ * but each call takes constant time.
+ */
+NOCT_DLL
+bool
+noct_get_dict_elem_by_cursor(
+	NoctEnv *env,
+	NoctValue *dict,
+	uint32_t *cursor,
+	NoctValue *key,
+	NoctValue *val);
+
 /*
  * Checks whether a key exists in a dictionary.
  */
@@ -697,6 +746,20 @@ void
 noct_compact_gc(
 	NoctEnv *env);
 
+/*
+ * Runs a slice of the incremental old generation garbage collection.
+ *
+ * A cycle starts when the old generation grows, and proceeds by at
+ * most the specified number of steps per call. This lets an
+ * application spread the collection over frames.
+ * Returns true if a cycle is in progress.
+ */
+NOCT_DLL
+bool
+noct_incremental_gc(
+	NoctEnv *env,
+	int steps);
+
 /*
  * Retrieves the current heap usage, in bytes.
  */
@@ -706,6 +769,21 @@ noct_get_heap_usage(
 	NoctEnv *env,
 	size_t *ret);
 
+/*
+ * Retrieves the free space statistics of the old generation.
+ *
+ * free_size is the total size of the free blocks, and
+ * largest_free_size is the size of the largest one. A large gap
+ * between them means fragmentation, that noct_compact_gc() fixes.
+ */
+NOCT_DLL
+bool
+noct_get_heap_stats(
+	NoctEnv *env,
+	size_t *free_size,
+	size_t *largest_free_size,
+	size_t *free_count);
+
 /*
  * Writes an error message to the internal buffer.
  *
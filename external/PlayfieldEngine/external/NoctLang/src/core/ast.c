@@ -1476,8 +1476,8 @@ ast_accept_kv_list(
 		memset(kv_list, 0, sizeof(struct ast_kv_list));
 	}
 
-	kv->next = kv_list->list;
-	kv_list->list = kv;
+	/* Add a pair to the tail. (in the written order) */
+	AST_ADD_TO_LAST(struct ast_kv, kv_list->list, kv);
 
 	return kv_list;
 }
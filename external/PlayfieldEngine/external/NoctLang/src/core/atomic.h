@@ -14,6 +14,12 @@
 
 #if defined(__GNUC__)
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
 static INLINE void *atomic_load_relaxed_ptr(void **p)
 {
 	return __atomic_load_n(p, __ATOMIC_RELAXED);
@@ -46,6 +52,21 @@ static INLINE int atomic_fetch_sub_release(int *v, int sub)
 	return old;
 }
 
+static INLINE int atomic_exchange_acquire(int *v, int x)
+{
+	return __atomic_exchange_n(v, x, __ATOMIC_ACQUIRE);
+}
+
+static INLINE void atomic_store_release(int *v, int x)
+{
+	__atomic_store_n(v, x, __ATOMIC_RELEASE);
+}
+
+static INLINE bool atomic_test_and_set_bool(bool *p)
+{
+	return __atomic_exchange_n(p, true, __ATOMIC_ACQ_REL);
+}
+
 static INLINE void cpu_relax(void)
 {
 #if defined(__i386__) || defined(__x86_64__)
@@ -60,8 +81,18 @@ static INLINE void cpu_relax(void)
 #endif
 }
 
+static INLINE void cpu_yield(void)
+{
+#if defined(_WIN32)
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
 #elif defined(_MSC_VER)
 
+#include <windows.h>
 #include <intrin.h>
 
 static INLINE void *atomic_load_relaxed_ptr(void **p)
@@ -95,6 +126,21 @@ static INLINE int atomic_fetch_sub_release(int *v, int sub)
 	return _InterlockedExchangeAdd((volatile long *)v, -1);
 }
 
+static INLINE int atomic_exchange_acquire(int *v, int x)
+{
+	return _InterlockedExchange((volatile long *)v, x);
+}
+
+static INLINE void atomic_store_release(int *v, int x)
+{
+	_InterlockedExchange((volatile long *)v, x);
+}
+
+static INLINE bool atomic_test_and_set_bool(bool *p)
+{
+	return _InterlockedExchange8((volatile char *)p, 1) != 0;
+}
+
 #if defined(_M_IX86) || defined(_M_X64)
 #include <immintrin.h>
 static INLINE void cpu_relax(void)
@@ -109,6 +155,11 @@ static INLINE void cpu_relax(void)
 }
 #endif
 
+static INLINE void cpu_yield(void)
+{
+	SwitchToThread();
+}
+
 #endif
 
 #endif
@@ -101,7 +101,7 @@ noct_ex_add_helper(
 			dst_val->val.f = (float)src1_val->val.i + src2_val->val.f;
 			break;
 		case NOCT_VALUE_STRING:
-			if (!noct_make_string_format(env, dst_val, "%d%s", src1_val->val.i, src2_val->val.str->data))
+			if (!rt_make_string_concat(env, dst_val, src1_val, src2_val))
 				return false;
 			break;
 		default:
@@ -120,7 +120,7 @@ noct_ex_add_helper(
 			dst_val->val.f = src1_val->val.f + src2_val->val.f;
 			break;
 		case NOCT_VALUE_STRING:
-			if (!noct_make_string_format(env, dst_val, "%f%s", src1_val->val.f, src2_val->val.str->data))
+			if (!rt_make_string_concat(env, dst_val, src1_val, src2_val))
 				return false;
 			break;
 		default:
@@ -131,15 +131,15 @@ noct_ex_add_helper(
 	case NOCT_VALUE_STRING:
 		switch (src2_val->type) {
 		case NOCT_VALUE_INT:
-			if (!noct_make_string_format(env, dst_val, "%s%d", src1_val->val.str->data, src2_val->val.i))
+			if (!rt_make_string_concat(env, dst_val, src1_val, src2_val))
 				return false;
 			break;
 		case NOCT_VALUE_FLOAT:
-			if (!noct_make_string_format(env, dst_val, "%s%f", src1_val->val.str->data, src2_val->val.f))
+			if (!rt_make_string_concat(env, dst_val, src1_val, src2_val))
 				return false;
 			break;
 		case NOCT_VALUE_STRING:
-			if (!noct_make_string_format(env, dst_val, "%s%s", src1_val->val.str->data, src2_val->val.str->data))
+			if (!rt_make_string_concat(env, dst_val, src1_val, src2_val))
 				return false;
 			break;
 		default:
@@ -1315,6 +1315,30 @@ noct_ex_getdictvalbyindex_helper(
 	return true;
 }
 
+/*
+ * Get the inline cache for a string operand.
+ *  - The interpreter and the JIT code pass a pointer into the bytecode.
+ *  - Other callers (e.g. AOT code) pass a literal, which has no cache.
+ */
+static struct rt_inline_cache *
+ex_get_inline_cache(
+	NoctEnv *env,
+	const char *s)
+{
+	struct rt_func *func;
+	uintptr_t offset;
+
+	func = env->frame->func;
+	if (func == NULL || func->ic == NULL)
+		return NULL;
+
+	offset = (uintptr_t)s - (uintptr_t)func->bytecode;
+	if ((uintptr_t)s < (uintptr_t)func->bytecode || offset >= func->bytecode_size)
+		return NULL;
+
+	return &func->ic[offset >> RT_INLINE_CACHE_SHIFT];
+}
+
 /*
  * LOADSYMBOL helper.
  */
@@ -1328,10 +1352,17 @@ noct_ex_loadsymbol_helper(
 	uint32_t symbol_len,
 	uint32_t symbol_hash)
 {
+	struct rt_inline_cache *ic;
 	struct rt_value val;
 
-	if (!rt_get_global_with_hash(env, symbol, symbol_len, symbol_hash, &val))
-		return false;
+	ic = ex_get_inline_cache(env, symbol);
+	if (ic != NULL) {
+		if (!rt_get_global_with_cache(env, symbol, symbol_len, symbol_hash, ic, &val))
+			return false;
+	} else {
+		if (!rt_get_global_with_hash(env, symbol, symbol_len, symbol_hash, &val))
+			return false;
+	}
 
 	env->frame->tmpvar[dst] = val;
 
@@ -1351,6 +1382,12 @@ noct_ex_storesymbol_helper(
 	uint32_t symbol_hash,
 	int src)
 {
+	struct rt_inline_cache *ic;
+
+	ic = ex_get_inline_cache(env, symbol);
+	if (ic != NULL)
+		return rt_set_global_with_cache(env, symbol, symbol_len, symbol_hash, ic, &env->frame->tmpvar[src]);
+
 	if (!rt_set_global_with_hash(env, symbol, symbol_len, symbol_hash, &env->frame->tmpvar[src]))
 		return false;
 
@@ -1371,6 +1408,8 @@ noct_ex_loaddot_helper(
 	uint32_t field_len,
 	uint32_t field_hash)
 {
+	struct rt_inline_cache *ic;
+
 	/* Special field "length". */
 	if (field_len == 7 &&
 	    field_hash == 0x83d03615 &&
@@ -1401,6 +1440,10 @@ noct_ex_loaddot_helper(
 		return false;
 	}
 
+	ic = ex_get_inline_cache(env, field);
+	if (ic != NULL)
+		return rt_get_dict_elem_with_cache(env, env->frame->tmpvar[dict].val.dict, field, field_len, field_hash, ic, &env->frame->tmpvar[dst]);
+
 	if (!rt_get_dict_elem_with_hash(env, env->frame->tmpvar[dict].val.dict, field, field_len, field_hash, &env->frame->tmpvar[dst]))
 		return false;
 
@@ -1421,6 +1464,7 @@ noct_ex_storedot_helper(
 	uint32_t field_hash,
 	int src)
 {
+	struct rt_inline_cache *ic;
 	struct rt_value *dict_val, *val;
 
 	/* Get the dictionary. */
@@ -1434,6 +1478,9 @@ noct_ex_storedot_helper(
 	val = &env->frame->tmpvar[src];
 
 	/* Store the source value to the dictionary with the key. */
+	ic = ex_get_inline_cache(env, field);
+	if (ic != NULL)
+		return rt_set_dict_elem_with_cache(env, &dict_val->val.dict, field, field_len, field_hash, ic, val);
 	if (!rt_set_dict_elem_with_hash(env, &dict_val->val.dict, field, field_len, field_hash, val))
 		return false;
 
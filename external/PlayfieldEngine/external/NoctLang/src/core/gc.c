@@ -11,12 +11,16 @@
 
 #include "runtime.h"
 #include "gc.h"
+#if defined(NOCT_USE_MULTITHREAD)
+#include "atomic.h"
+#endif
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <limits.h>
 
 /*
  * False Assertion
@@ -24,6 +28,38 @@
 #define NEVER_COME_HERE		0
 #define PINNED_VAR_NOT_FOUND	0
 
+/*
+ * Spins of a busy wait before yielding the CPU.
+ *  - The thread that we wait for may be preempted, especially when
+ *    the threads outnumber the cores.
+ */
+#define SPIN_MAX	100
+
+/*
+ * Mark stack lock. (for the parallel marking)
+ */
+#if defined(NOCT_USE_MULTITHREAD)
+#define MARK_LOCK(env)								\
+	do {									\
+		int spin_ = 0;							\
+		while (atomic_exchange_acquire(&(env)->vm->gc.mark_lock, 1) != 0) \
+			rt_gc_backoff(&spin_);					\
+	} while (0)
+#define MARK_UNLOCK(env)							\
+	atomic_store_release(&(env)->vm->gc.mark_lock, 0)
+#else
+#define MARK_LOCK(env)
+#define MARK_UNLOCK(env)
+#endif
+
+/*
+ * Marker state of a GC thread.
+ */
+struct rt_gc_marker {
+	/* Packet that this thread pushes to and pops from. */
+	struct rt_gc_mark_packet *cur;
+};
+
 /*
  * Link an element to a list.
  */
@@ -73,11 +109,12 @@ static struct rt_string *rt_gc_alloc_string_graduate(struct rt_env *env, const c
 static struct rt_string *rt_gc_alloc_string_tenure(struct rt_env *env, const char *data, size_t len, uint32_t hash);
 static struct rt_array *rt_gc_alloc_array_graduate(struct rt_env *env, size_t size);
 static struct rt_array *rt_gc_alloc_array_tenure(struct rt_env *env, size_t size);
-static struct rt_dict *rt_gc_alloc_dict_graduate(struct rt_env *env, size_t size);
-static struct rt_dict *rt_gc_alloc_dict_tenure(struct rt_env *env, size_t size);
+static struct rt_dict *rt_gc_alloc_dict_graduate(struct rt_env *env, size_t size, struct rt_shape *shape);
+static struct rt_dict *rt_gc_alloc_dict_tenure(struct rt_env *env, size_t size, struct rt_shape *shape);
 static void rt_gc_young_gc(struct rt_env *env);
 static void rt_gc_young_gc_body(struct rt_env *env);
 static bool rt_gc_copy_young_object_recursively(struct rt_env *env, struct rt_gc_object **obj);
+static INLINE bool rt_gc_is_resized(struct rt_gc_object *obj);
 static void rt_gc_array_dict_follow_newer(struct rt_env *env, struct rt_gc_object **obj);
 static struct rt_gc_object *rt_gc_promote_object(struct rt_env *env, struct rt_gc_object *obj);
 static struct rt_gc_object *rt_gc_promote_string(struct rt_env *env, struct rt_gc_object *obj);
@@ -88,17 +125,40 @@ struct rt_gc_object *rt_gc_copy_array_to_graduate(struct rt_env *env, struct rt_
 struct rt_gc_object *rt_gc_copy_dict_to_graduate(struct rt_env *env, struct rt_dict *old_obj);
 static void rt_gc_old_gc(struct rt_env *env);
 static void rt_gc_old_gc_body(struct rt_env *env);
-static void rt_gc_mark_old_object_recursively(struct rt_env *env, struct rt_gc_object **obj);
+static void rt_gc_mark_begin(struct rt_env *env, struct rt_gc_marker *m);
+static void rt_gc_mark_end(struct rt_env *env);
+static void rt_gc_mark_roots(struct rt_env *env, struct rt_gc_marker *m);
+static void rt_gc_mark_old_object(struct rt_env *env, struct rt_gc_marker *m, struct rt_gc_object **obj);
+static void rt_gc_mark_children(struct rt_env *env, struct rt_gc_marker *m, struct rt_gc_object *obj);
+static bool rt_gc_mark_new_packet(struct rt_env *env, struct rt_gc_marker *m);
+static bool rt_gc_mark_get_work(struct rt_env *env, struct rt_gc_marker *m);
+static void rt_gc_mark_drain(struct rt_env *env, struct rt_gc_marker *m);
+static void rt_gc_mark_rescan(struct rt_env *env, struct rt_gc_marker *m);
 static void rt_gc_free_old_object(struct rt_env *env, struct rt_gc_object *obj);
 static bool rt_gc_compact_gc(struct rt_env *env);
 static void rt_gc_update_tenure_ref(struct rt_env *env, struct rt_gc_object **obj);
 static void rt_gc_update_tenure_ref_recursively(struct rt_env *env, struct rt_gc_object **obj);
+static void rt_gc_incremental_gc_body(struct rt_env *env);
+static void rt_gc_incremental_abort(struct rt_env *env);
+static void rt_gc_incremental_on_alloc(struct rt_env *env, struct rt_gc_object *obj);
+static void rt_gc_shade(struct rt_env *env, struct rt_gc_object *obj);
+static uint32_t rt_gc_shade_children(struct rt_env *env, struct rt_gc_object *obj);
+static int rt_gc_scan_gray(struct rt_env *env);
+static void rt_gc_shade_roots(struct rt_env *env);
+static void rt_gc_shade_young(struct rt_env *env);
+static size_t rt_gc_young_used_size(struct rt_env *env);
+static size_t rt_gc_tenure_used_size(struct rt_env *env);
 static void *nursery_alloc(struct rt_env *env, size_t size);
 static void *graduate_alloc(struct rt_env *env, size_t size);
 static void *rt_gc_tenure_alloc(struct rt_env *env, size_t size);
 static void rt_gc_tenure_free(struct rt_env *env, void *p);
+static void rt_gc_freelist_reset(struct freelist *fl_info, char *free_top);
+static INLINE int rt_gc_fls(size_t x);
 #if defined(NOCT_USE_MULTITHREAD)
 static void rt_gc_multithread_gc_wrapper(struct rt_env *env, void (*gc)(struct rt_env *));
+static void rt_gc_wait_for_gc(struct rt_env *env);
+static INLINE void rt_gc_backoff(int *spin);
+static void rt_gc_help_mark(struct rt_env *env);
 #endif
 
 /*
@@ -126,7 +186,15 @@ rt_gc_init(
 	vm->gc.tenure_freelist.top = noct_calloc(1, vm->config.gc_tenure_size);
 	if (vm->gc.tenure_freelist.top == NULL)
 		return false;
-	vm->gc.tenure_freelist.end = vm->gc.tenure_freelist.top + vm->config.gc_tenure_size;
+	vm->gc.tenure_freelist.end = vm->gc.tenure_freelist.top +
+		(vm->config.gc_tenure_size & ~(RT_GC_FREELIST_ALIGN - 1));
+	rt_gc_freelist_reset(&vm->gc.tenure_freelist, vm->gc.tenure_freelist.top);
+
+	/* Initialize the incremental GC. */
+	vm->gc.inc_phase = RT_GC_PHASE_IDLE;
+	vm->gc.inc_trigger = RT_GC_DEFAULT_INCREMENTAL_TRIGGER;
+	if (vm->gc.inc_trigger > vm->config.gc_tenure_size / 4 * 3)
+		vm->gc.inc_trigger = vm->config.gc_tenure_size / 4 * 3;
 
 	return true;
 }
@@ -152,6 +220,10 @@ void env_gc_cleanup(struct rt_vm *vm)
 
 	/* Cleanup the tenure allocator. */
 	noct_free(vm->gc.tenure_freelist.top);
+
+	/* Cleanup the gray stack. */
+	if (vm->gc.gray_stack != NULL)
+		noct_free(vm->gc.gray_stack);
 }
 
 /*
@@ -193,8 +265,11 @@ rt_gc_alloc_string(
 		/* Get the string top address. */
 		s = (char *)rts + sizeof(struct rt_string);
 
-		/* Copy the string. */
-		memcpy(s, data, len);
+		/* Copy the string. (NULL data leaves it for the caller.) */
+		if (data != NULL)
+			memcpy(s, data, len);
+		else
+			s[len - 1] = '\0';
 
 		/* Setup the struct. */
 		memset(&rts->head, 0, sizeof(struct rt_gc_object));
@@ -304,8 +379,11 @@ rt_gc_alloc_string_tenure(
 		/* Get the string top address. */
 		s = (char *)rts + sizeof(struct rt_string);
 
-		/* Copy the string. */
-		memcpy(s, data, len);
+		/* Copy the string. (NULL data leaves it for the caller.) */
+		if (data != NULL)
+			memcpy(s, data, len);
+		else
+			s[len - 1] = '\0';
 
 		/* Setup the struct. */
 		memset(&rts->head, 0, sizeof(struct rt_gc_object));
@@ -313,6 +391,8 @@ rt_gc_alloc_string_tenure(
 		rts->head.region = RT_GC_REGION_TENURE;
 		rts->head.size = sizeof(struct rt_string) + len;
 		INSERT_TO_LIST(&rts->head, env->vm->gc.tenure_list, prev, next);
+		env->vm->gc.tenure_count++;
+		rt_gc_incremental_on_alloc(env, &rts->head);
 		rts->data = s;
 		rts->len = len;
 		rts->hash = hash;
@@ -488,6 +568,8 @@ rt_gc_alloc_array_tenure(
 		arr->head.region = RT_GC_REGION_TENURE;
 		arr->head.size = sizeof(struct rt_array) + size * sizeof(struct rt_value);
 		INSERT_TO_LIST(&arr->head, env->vm->gc.tenure_list, prev, next);
+		env->vm->gc.tenure_count++;
+		rt_gc_incremental_on_alloc(env, &arr->head);
 		arr->alloc_size = size;
 		arr->size = 0;
 		arr->table = table;
@@ -511,29 +593,34 @@ rt_gc_alloc_array_tenure(
 struct rt_dict *
 rt_gc_alloc_dict(
 	struct rt_env *env,
-	size_t size)
+	size_t size,
+	struct rt_shape *shape)
 {
 	struct rt_dict *dict;
 	struct rt_value *key_table;
 	struct rt_value *value_table;
+	size_t key_size;
 	int retry;
 
 	assert(env != NULL);
 	assert(size > 0);
 
+	/* A shaped dictionary has no key table. */
+	key_size = shape != NULL ? 0 : size;
+
 	/*
 	 * [Large Object Promotion]
 	 *  - If the array is large, allocate in the tenure region.
 	 */
-	if (size * sizeof(char *) + size * sizeof(struct rt_value *) >= env->vm->config.gc_lop_threshold)
-		return rt_gc_alloc_dict_tenure(env, size);
+	if (key_size * sizeof(char *) + size * sizeof(struct rt_value *) >= env->vm->config.gc_lop_threshold)
+		return rt_gc_alloc_dict_tenure(env, size, shape);
 
 	/* Allocate in the nursery region. */
 	for (retry = 0; retry <= 1; retry++) {
 		/* Allocate a rt_dict buffer. */
 		dict = nursery_alloc(env,
 				     sizeof(struct rt_dict) +
-				     size * sizeof(struct rt_value) +
+				     key_size * sizeof(struct rt_value) +
 				     size * sizeof(struct rt_value));
 		if (dict == NULL) {
 			/* Retry. */
@@ -547,21 +634,22 @@ rt_gc_alloc_dict(
 		}
 
 		/* Get the address of the key array block. */
-		key_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
+		key_table = shape != NULL ? NULL : (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
 
 		/* Get the address of the value array block. */
-		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + size * sizeof(struct rt_value));
+		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + key_size * sizeof(struct rt_value));
 
 		/* Setup the struct. */
 		memset(&dict->head, 0, sizeof(struct rt_gc_object));
 		dict->head.type = RT_GC_TYPE_DICT;
 		dict->head.region = RT_GC_REGION_NURSERY;
-		dict->head.size = sizeof(struct rt_dict) + 2 * size * sizeof(struct rt_value);
+		dict->head.size = sizeof(struct rt_dict) + (key_size + size) * sizeof(struct rt_value);
 		INSERT_TO_LIST(&dict->head, env->vm->gc.nursery_list, prev, next);
 		dict->alloc_size = size;
 		dict->size = 0;
 		dict->key = key_table;
 		dict->value = value_table;
+		dict->shape = shape;
 		dict->newer = NULL;
 #if defined(NOCT_USE_MULTITHREAD)
 		dict->counter = 0;
@@ -580,15 +668,20 @@ rt_gc_alloc_dict(
 static struct rt_dict *
 rt_gc_alloc_dict_graduate(
 	struct rt_env *env,
-	size_t size)
+	size_t size,
+	struct rt_shape *shape)
 {
 	struct rt_dict *dict;
 	struct rt_value *key_table;
 	struct rt_value *value_table;
+	size_t key_size;
 
 	assert(env != NULL);
 	assert(size > 0);
 
+	/* A shaped dictionary has no key table. */
+	key_size = shape != NULL ? 0 : size;
+
 	/*
 	 * This function is only called from the young GC,
 	 * and thus, we don't use young GC for a retry here.
@@ -599,27 +692,28 @@ rt_gc_alloc_dict_graduate(
 		/* Allocate a rt_dict buffer. */
 		dict = graduate_alloc(env,
 				      sizeof(struct rt_dict) +
-				      size * sizeof(struct rt_value) +
+				      key_size * sizeof(struct rt_value) +
 				      size * sizeof(struct rt_value));
 		if (dict == NULL)
 			break;
 
 		/* Get the address of the key array block. */
-		key_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
+		key_table = shape != NULL ? NULL : (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
 
 		/* Get the address of the value array block. */
-		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + size * sizeof(struct rt_value));
+		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + key_size * sizeof(struct rt_value));
 
 		/* Setup a struct. */
 		memset(&dict->head, 0, sizeof(struct rt_gc_object));
 		dict->head.type = RT_GC_TYPE_DICT;
 		dict->head.region = RT_GC_REGION_GRADUATE;
-		dict->head.size = sizeof(struct rt_dict) + 2 * size * sizeof(struct rt_value);
+		dict->head.size = sizeof(struct rt_dict) + (key_size + size) * sizeof(struct rt_value);
 		INSERT_TO_LIST(&dict->head, env->vm->gc.graduate_new_list, prev, next);
 		dict->alloc_size = size;
 		dict->size = 0;
 		dict->key = key_table;
 		dict->value = value_table;
+		dict->shape = shape;
 		dict->newer = NULL;
 #if defined(NOCT_USE_MULTITHREAD)
 		dict->counter = 0;
@@ -633,7 +727,7 @@ rt_gc_alloc_dict_graduate(
 	 * Failed to allocate in the graduate region.
 	 * Try allocating in the tenure region.
 	 */
-	dict = rt_gc_alloc_dict_tenure(env, size);
+	dict = rt_gc_alloc_dict_tenure(env, size, shape);
 	if (dict == NULL)
 		return NULL;
 
@@ -645,22 +739,27 @@ rt_gc_alloc_dict_graduate(
 static struct rt_dict *
 rt_gc_alloc_dict_tenure(
 	struct rt_env *env,
-	size_t size)
+	size_t size,
+	struct rt_shape *shape)
 {
 	struct rt_dict *dict;
 	struct rt_value *key_table;
 	struct rt_value *value_table;
+	size_t key_size;
 	int retry;
 
 	assert(env != NULL);
 	assert(size > 0);
 
+	/* A shaped dictionary has no key table. */
+	key_size = shape != NULL ? 0 : size;
+
 	/* Allocate in the tenure region. */
 	for (retry = 0; retry <= 2; retry++) {
 		/* Allocate the rt_dict buffer. */
 		dict = rt_gc_tenure_alloc(env,
 					  sizeof(struct rt_dict) +
-					  size * sizeof(struct rt_value) +
+					  key_size * sizeof(struct rt_value) +
 					  size * sizeof(struct rt_value));
 		if (dict == NULL) {
 			/* Retry. */
@@ -677,21 +776,24 @@ rt_gc_alloc_dict_tenure(
 		}
 
 		/* Get the address of the key array block. */
-		key_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
+		key_table = shape != NULL ? NULL : (struct rt_value *)((char *)dict + sizeof(struct rt_dict));
 
 		/* Get the address of the value array block. */
-		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + size * sizeof(struct rt_value));
+		value_table = (struct rt_value *)((char *)dict + sizeof(struct rt_dict) + key_size * sizeof(struct rt_value));
 
 		/* Setup a value. */
 		memset(&dict->head, 0, sizeof(struct rt_gc_object));
 		dict->head.type = RT_GC_TYPE_DICT;
 		dict->head.region = RT_GC_REGION_TENURE;
-		dict->head.size = sizeof(struct rt_dict) + 2 * size * sizeof(struct rt_value);
+		dict->head.size = sizeof(struct rt_dict) + (key_size + size) * sizeof(struct rt_value);
 		INSERT_TO_LIST(&dict->head, env->vm->gc.tenure_list, prev, next);
+		env->vm->gc.tenure_count++;
+		rt_gc_incremental_on_alloc(env, &dict->head);
 		dict->alloc_size = size;
 		dict->size = 0;
 		dict->key = key_table;
 		dict->value = value_table;
+		dict->shape = shape;
 		dict->newer = NULL;
 #if defined(NOCT_USE_MULTITHREAD)
 		dict->counter = 0;
@@ -734,6 +836,18 @@ rt_gc_array_write_barrier(
 		arr->head.rem_flg = true;
 		INSERT_TO_LIST(&arr->head, env->vm->gc.remember_set, rem_prev, rem_next);
 	}
+	/*
+	 * While an incremental marking is in progress, a scanned (black)
+	 * array may get a reference to an unvisited (white) object. Make
+	 * the array gray again to rescan it.
+	 */
+	if (env->vm->gc.inc_phase == RT_GC_PHASE_MARK &&
+	    arr->head.color == RT_GC_COLOR_BLACK &&
+	    IS_REF_VAL(val)) {
+		arr->head.color = RT_GC_COLOR_WHITE;
+		rt_gc_shade(env, &arr->head);
+		env->vm->gc.inc_debt++;
+	}
 }
 
 /*
@@ -761,6 +875,14 @@ rt_gc_dict_write_barrier(
 		dict->head.rem_flg = true;
 		INSERT_TO_LIST(&dict->head, env->vm->gc.remember_set, rem_prev, rem_next);
 	}
+	/* Make the dictionary gray again if scanned. (see above) */
+	if (env->vm->gc.inc_phase == RT_GC_PHASE_MARK &&
+	    dict->head.color == RT_GC_COLOR_BLACK &&
+	    IS_REF_VAL(val)) {
+		dict->head.color = RT_GC_COLOR_WHITE;
+		rt_gc_shade(env, &dict->head);
+		env->vm->gc.inc_debt++;
+	}
 }
 
 /* Executes a young GC in the multithreaded manner. */
@@ -768,6 +890,40 @@ static void
 rt_gc_young_gc(
 	struct rt_env *env)
 {
+	size_t free_size, young_size, steps;
+
+	/*
+	 * A promotion must not fail in the middle of a young GC, because
+	 * the old GC can't run on the half-copied young objects.
+	 *  - If the tenure region is getting short, advance the
+	 *    incremental cycle. (start one if idle)
+	 *  - Only if it can't take the whole young generation yet, collect
+	 *    it at once as the last resort.
+	 */
+	free_size = env->vm->gc.tenure_freelist.free_size;
+	young_size = rt_gc_young_used_size(env);
+	if (free_size < young_size) {
+		rt_gc_old_gc(env);
+	} else if (free_size / RT_GC_PRESSURE_RATIO < young_size) {
+		/*
+		 * A cycle takes about two steps per tenure object, and
+		 * the free space lasts at least (free_size / young_size)
+		 * young GCs. Like the young GC itself, this is bounded by
+		 * the number of the tenure objects.
+		 */
+		steps = env->vm->gc.tenure_count * 2 / (free_size / young_size);
+		if (steps < RT_GC_PRESSURE_MIN_STEPS)
+			steps = RT_GC_PRESSURE_MIN_STEPS;
+		if (steps > (size_t)INT_MAX)
+			steps = INT_MAX;
+		env->vm->gc.inc_steps = (int)steps;
+#if defined(NOCT_USE_MULTITHREAD)
+		rt_gc_multithread_gc_wrapper(env, rt_gc_incremental_gc_body);
+#else
+		rt_gc_incremental_gc_body(env);
+#endif
+	}
+
 #if defined(NOCT_USE_MULTITHREAD)
 	rt_gc_multithread_gc_wrapper(env, rt_gc_young_gc_body);
 #else
@@ -780,8 +936,10 @@ static void
 rt_gc_young_gc_body(
 	struct rt_env *env)
 {
-	struct rt_gc_object *obj;
+	struct rt_gc_object *obj, *next_obj, *ref;
 	struct rt_frame *frame;
+	struct rt_stack_chunk *chunk;
+	struct rt_shape *shape;
 	uint32_t i;
 	int sp;
 
@@ -832,19 +990,21 @@ rt_gc_young_gc_body(
 		}
 	}
 
-	/* For all call frames. */
-	for (sp = (int)env->cur_frame_index; sp >= 0; sp--) {
-		frame = &env->frame_alloc[sp];
-
-		/* For all temporary variables in the frame. */
-		for (i = 0; i < frame->tmpvar_size; i++) {
-			if (IS_REF_VAL(&frame->tmpvar[i])) {
-				if (!rt_gc_copy_young_object_recursively(env, &frame->tmpvar[i].val.obj))
+	/* For all temporary variables on the stack. (contiguous in chunks) */
+	for (chunk = env->stack_bottom; chunk != NULL; chunk = chunk->next) {
+		for (i = 0; i < chunk->top; i++) {
+			if (IS_REF_VAL(&chunk->value[i])) {
+				if (!rt_gc_copy_young_object_recursively(env, &chunk->value[i].val.obj))
 					return;
 			}
 		}
+		if (chunk == env->stack_top)
+			break;
+	}
 
-		/* For all pinned C local variables in the frame. */
+	/* For all pinned C local variables in the call frames. */
+	for (sp = (int)env->cur_frame_index; sp >= 0; sp--) {
+		frame = env->frame_tbl[sp];
 		for (i = 0; i < frame->pinned_count; i++) {
 			if (IS_REF_VAL(frame->pinned[i])) {
 				if (!rt_gc_copy_young_object_recursively(env, &frame->pinned[i]->val.obj))
@@ -861,10 +1021,22 @@ rt_gc_young_gc_body(
 		}
 	}
 
+	/* For all dictionary shape keys. */
+	for (shape = env->vm->shape_list; shape != NULL; shape = shape->next) {
+		if (!rt_gc_copy_young_object_recursively(env, &shape->key.val.obj))
+			return;
+	}
+
 	/* For all remember set objects. */
 	obj = env->vm->gc.remember_set;
 	while (obj != NULL) {
-		if (!rt_gc_copy_young_object_recursively(env, &obj))
+		/*
+		 * Pass a copy of the reference because it may be rewritten
+		 * to the newer array or dictionary, which is at another
+		 * position in the remember set.
+		 */
+		ref = obj;
+		if (!rt_gc_copy_young_object_recursively(env, &ref))
 			return;
 		obj = obj->rem_next;
 	}
@@ -876,7 +1048,9 @@ rt_gc_young_gc_body(
 	/* For each remember set object, update the addresses of the inner elements using the forwarding pointer technique. */
 	obj = env->vm->gc.remember_set;
 	while (obj != NULL) {
-		if (obj->type == RT_GC_TYPE_ARRAY) {
+		if (rt_gc_is_resized(obj)) {
+			/* Not referenced anymore. Removed below. */
+		} else if (obj->type == RT_GC_TYPE_ARRAY) {
 			struct rt_array *arr = (struct rt_array *)obj;
 			for (i = 0; i < arr->size; i++) {
 				if (IS_REF_VAL(&arr->table[i]) &&
@@ -888,9 +1062,10 @@ rt_gc_young_gc_body(
 		} else {
 			struct rt_dict *dict = (struct rt_dict *)obj;
 			for (i = 0; i < dict->alloc_size; i++) {
-				if (dict->key[i].type != NOCT_VALUE_STRING)
+				if (!RT_DICT_SLOT_USED(dict, i))
 					continue; /* Removed or empty. */
-				if (IS_YOUNG_OBJ(dict->key[i].val.obj) &&
+				if (dict->key != NULL &&
+				    IS_YOUNG_OBJ(dict->key[i].val.obj) &&
 				    dict->key[i].val.obj->forward != NULL) {
 					dict->key[i].val.obj = dict->key[i].val.obj->forward;
 				}
@@ -908,7 +1083,10 @@ rt_gc_young_gc_body(
 	obj = env->vm->gc.remember_set;
 	while (obj != NULL) {
 		bool has_cross_gen_ref = false;
-		if (obj->type == RT_GC_TYPE_ARRAY) {
+		next_obj = obj->rem_next;
+		if (rt_gc_is_resized(obj)) {
+			/* Not referenced anymore. */
+		} else if (obj->type == RT_GC_TYPE_ARRAY) {
 			struct rt_array *arr = (struct rt_array *)obj;
 			for (i = 0; i < arr->size; i++) {
 				if (IS_REF_VAL(&arr->table[i]) &&
@@ -920,9 +1098,10 @@ rt_gc_young_gc_body(
 		} else {
 			struct rt_dict *dict = (struct rt_dict *)obj;
 			for (i = 0; i < dict->alloc_size; i++) {
-				if (dict->key[i].type != NOCT_VALUE_STRING)
+				if (!RT_DICT_SLOT_USED(dict, i))
 					continue; /* Removed or empty. */
-				if (IS_YOUNG_OBJ(dict->key[i].val.obj)) {
+				if (dict->key != NULL &&
+				    IS_YOUNG_OBJ(dict->key[i].val.obj)) {
 					has_cross_gen_ref = true;
 					break;
 				}
@@ -938,7 +1117,7 @@ rt_gc_young_gc_body(
 			obj->rem_flg = false;
 			UNLINK_FROM_LIST(obj, env->vm->gc.remember_set, rem_prev, rem_next);
 		}
-		obj = obj->rem_next;
+		obj = next_obj;
 	}
 
 	/*
@@ -1055,9 +1234,10 @@ rt_gc_copy_young_object_recursively(
 	case RT_GC_TYPE_DICT:
 		dict = (struct rt_dict *)*obj;
 		for (i = 0; i < dict->alloc_size; i++) {
-			if (dict->key[i].type != NOCT_VALUE_STRING)
+			if (!RT_DICT_SLOT_USED(dict, i))
 				continue; /* Removed or empty. */
-			if (!rt_gc_copy_young_object_recursively(env, &dict->key[i].val.obj))
+			if (dict->key != NULL &&
+			    !rt_gc_copy_young_object_recursively(env, &dict->key[i].val.obj))
 				return false;
 			if (IS_REF_VAL(&dict->value[i])) {
 				if (!rt_gc_copy_young_object_recursively(env, &dict->value[i].val.obj))
@@ -1098,16 +1278,14 @@ rt_gc_copy_young_object_recursively(
 			if (dict->head.rem_flg)
 				return true;
 			for (i = 0; i < dict->alloc_size; i++) {
-				if (dict->key[i].type != NOCT_VALUE_STRING)
+				if (!RT_DICT_SLOT_USED(dict, i))
 					continue; /* Removed or empty. */
 
-				/* If the key is young generation. */
-				if (IS_YOUNG_OBJ(dict->key[i].val.obj)) {
-					/* And if the element is not promoted to the tenure region. */
-					if (dict->key[i].val.obj->forward != NULL &&
-					    dict->key[i].val.obj->forward->region == RT_GC_REGION_TENURE)
-						continue;
-
+				/* If the key is young generation, and is not promoted to the tenure region. */
+				if (dict->key != NULL &&
+				    IS_YOUNG_OBJ(dict->key[i].val.obj) &&
+				    (dict->key[i].val.obj->forward == NULL ||
+				     dict->key[i].val.obj->forward->region != RT_GC_REGION_TENURE)) {
 					/* Add to remember set. */
 					dict->head.rem_flg = true;
 					INSERT_TO_LIST(&dict->head, env->vm->gc.remember_set, rem_prev, rem_next);
@@ -1134,6 +1312,21 @@ rt_gc_copy_young_object_recursively(
 	return true;
 }
 
+/*
+ * Check if this is an array or dictionary that is resized. All references
+ * to it are rewritten to the newer one at a GC.
+ */
+static INLINE bool
+rt_gc_is_resized(
+	struct rt_gc_object *obj)
+{
+	if (obj->type == RT_GC_TYPE_ARRAY)
+		return ((struct rt_array *)obj)->newer != NULL;
+	if (obj->type == RT_GC_TYPE_DICT)
+		return ((struct rt_dict *)obj)->newer != NULL;
+	return false;
+}
+
 /* If this is an array or dictionary, get the forwarder. */
 static void
 rt_gc_array_dict_follow_newer(
@@ -1235,6 +1428,9 @@ rt_gc_promote_array(
 	new_arr->size = old_arr->size;
 	if (new_arr->size > 0)
 		memcpy(new_arr->table, old_arr->table, new_arr->size * sizeof(struct rt_value));
+#if defined(NOCT_USE_MULTITHREAD)
+	new_arr->counter = old_arr->counter;
+#endif
 
 	/* Set the forwarding pointer. */
 	obj->forward = &new_arr->head;
@@ -1257,32 +1453,43 @@ rt_gc_promote_dict(
 	alloc_size = old_dict->alloc_size;
 
 	/* Allocate a dictionary object. */
-	new_dict = rt_gc_alloc_dict_tenure(env, alloc_size);
+	new_dict = rt_gc_alloc_dict_tenure(env, alloc_size, old_dict->shape);
 	if (new_dict == NULL)
 		return false;
 
-	/* Rehash. (Copy the keys and values.) */
-	for (i = 0; i < old_dict->alloc_size; i++) {
-		if (old_dict->key[i].type != NOCT_VALUE_STRING)
-			continue; /* Removed or empty. */
-
-		index = rt_string_hash(old_dict->key[i].val.str->data) & ((uint32_t)new_dict->alloc_size - 1);
-		for (j = index;
-		     j != ((index - 1 + (uint32_t)new_dict->alloc_size) & (new_dict->alloc_size - 1));
-		     j = (j + 1) & ((uint32_t)new_dict->alloc_size - 1)) {
-			if (new_dict->key[j].type != NOCT_VALUE_STRING) {
-				/* Copy the item. */
-				new_dict->key[j] = old_dict->key[i];
-				new_dict->value[j] = old_dict->value[i];
-
-				/* Write barrier. */
-				rt_gc_dict_write_barrier(env, new_dict, &new_dict->key[j]);
-				rt_gc_dict_write_barrier(env, new_dict, &new_dict->value[j]);
-				break;
+	if (old_dict->shape != NULL) {
+		/* Copy the values. (The keys are in the shape.) */
+		for (i = 0; i < old_dict->size; i++) {
+			new_dict->value[i] = old_dict->value[i];
+			rt_gc_dict_write_barrier(env, new_dict, &new_dict->value[i]);
+		}
+	} else {
+		/* Rehash. (Copy the keys and values.) */
+		for (i = 0; i < old_dict->alloc_size; i++) {
+			if (!RT_DICT_SLOT_USED(old_dict, i))
+				continue; /* Removed or empty. */
+
+			index = rt_string_hash(old_dict->key[i].val.str->data) & ((uint32_t)new_dict->alloc_size - 1);
+			for (j = index;
+			     j != ((index - 1 + (uint32_t)new_dict->alloc_size) & (new_dict->alloc_size - 1));
+			     j = (j + 1) & ((uint32_t)new_dict->alloc_size - 1)) {
+				if (new_dict->key[j].type != NOCT_VALUE_STRING) {
+					/* Copy the item. */
+					new_dict->key[j] = old_dict->key[i];
+					new_dict->value[j] = old_dict->value[i];
+
+					/* Write barrier. */
+					rt_gc_dict_write_barrier(env, new_dict, &new_dict->key[j]);
+					rt_gc_dict_write_barrier(env, new_dict, &new_dict->value[j]);
+					break;
+				}
 			}
 		}
 	}
 	new_dict->size = old_dict->size;
+#if defined(NOCT_USE_MULTITHREAD)
+	new_dict->counter = old_dict->counter;
+#endif
 
 	/* Set the forwarding pointer. */
 	obj->forward = &new_dict->head;
@@ -1345,6 +1552,9 @@ rt_gc_copy_array_to_graduate(
 	/* Copy the table. */
 	new_obj->size = old_obj->size;
 	memcpy(new_obj->table, old_obj->table, old_obj->size * sizeof(struct rt_value));
+#if defined(NOCT_USE_MULTITHREAD)
+	new_obj->counter = old_obj->counter;
+#endif
 
 	/* Check for cross-generation references. */
 	if (new_obj->head.region == RT_GC_REGION_TENURE) {
@@ -1384,19 +1594,26 @@ rt_gc_copy_dict_to_graduate(
 	assert(size < env->vm->config.gc_lop_threshold / sizeof(struct rt_value *) / 2);
 
 	/* Allocate in the graduate region. (If failed, in the tenure region.) */
-	new_obj = rt_gc_alloc_dict_graduate(env, size);
+	new_obj = rt_gc_alloc_dict_graduate(env, size, old_obj->shape);
 	if (new_obj == NULL)
 		return NULL;
 
 	/* Copy the keys and values. */
 	new_obj->size = old_obj->size;
-	memcpy(new_obj->key, old_obj->key, old_obj->alloc_size * sizeof(struct rt_value));
+	if (old_obj->key != NULL)
+		memcpy(new_obj->key, old_obj->key, old_obj->alloc_size * sizeof(struct rt_value));
 	memcpy(new_obj->value, old_obj->value, old_obj->alloc_size * sizeof(struct rt_value));
+#if defined(NOCT_USE_MULTITHREAD)
+	new_obj->counter = old_obj->counter;
+#endif
 
 	/* Check for cross-generation references. */
 	if (new_obj->head.region == RT_GC_REGION_TENURE) {
-		for (i = 0; i < (uint32_t)new_obj->size; i++) {
-			if (IS_YOUNG_OBJ(new_obj->key[i].val.obj)) {
+		for (i = 0; i < (uint32_t)new_obj->alloc_size; i++) {
+			if (!RT_DICT_SLOT_USED(new_obj, i))
+				continue; /* Removed or empty. */
+			if (new_obj->key != NULL &&
+			    IS_YOUNG_OBJ(new_obj->key[i].val.obj)) {
 				new_obj->head.rem_flg = true;
 				INSERT_TO_LIST(&new_obj->head, env->vm->gc.remember_set,rem_prev, rem_next);
 				break;
@@ -1436,9 +1653,10 @@ rt_gc_old_gc_body(
 	struct rt_env *env)
 {
 	struct rt_gc_object *obj, *next_obj;
-	struct rt_frame *frame;
-	uint32_t i;
-	int sp;
+	struct rt_gc_marker m;
+
+	/* This supersedes an incremental cycle. */
+	rt_gc_incremental_abort(env);
 
 	/*
 	 * Clear marks.
@@ -1469,36 +1687,19 @@ rt_gc_old_gc_body(
 	 * Mark.
 	 */
 
-	/* For all global variables. */
-	for (i = 0; i < (uint32_t)env->vm->global_alloc_size; i++) {
-		if (env->vm->global[i].name == NULL || env->vm->global[i].is_removed)
-			continue;
-		if (IS_REF_VAL(&env->vm->global[i].val))
-			rt_gc_mark_old_object_recursively(env, &env->vm->global[i].val.val.obj);
-	}
-
-	/* For all call frames. */
-	for (sp = env->cur_frame_index; sp >= 0; sp--) {
-		frame = &env->frame_alloc[sp];
+	/* Mark from the roots, with the help of the other threads. */
+	rt_gc_mark_begin(env, &m);
+	rt_gc_mark_roots(env, &m);
+	rt_gc_mark_drain(env, &m);
 
-		/* For all temporary variables in the frame. */
-		for (i = 0; i < frame->tmpvar_size; i++) {
-			if (IS_REF_VAL(&frame->tmpvar[i]))
-				rt_gc_mark_old_object_recursively(env, &frame->tmpvar[i].val.obj);
-		}
-
-		/* For all pinned C local variables in the frame. */
-		for (i = 0; i < frame->pinned_count; i++) {
-			if (IS_REF_VAL(frame->pinned[i]))
-				rt_gc_mark_old_object_recursively(env, &frame->pinned[i]->val.obj);
-		}
+	/* If the mark stack overflowed, scan the marked objects again. */
+	while (env->vm->gc.mark_overflow) {
+		rt_gc_mark_begin(env, &m);
+		rt_gc_mark_rescan(env, &m);
+		rt_gc_mark_drain(env, &m);
 	}
 
-	/* For all pinned C global variables. */
-	for (i = 0; i < env->vm->pinned_count; i++) {
-		if (IS_REF_VAL(env->vm->pinned[i]))
-			rt_gc_mark_old_object_recursively(env, &env->vm->pinned[i]->val.obj);
-	}
+	rt_gc_mark_end(env);
 
 	/*
 	 * Sweep.
@@ -1517,40 +1718,327 @@ rt_gc_old_gc_body(
 	}
 }
 
-/* Mark object recursively for the old GC. */
+/*
+ * Old GC Marking
+ *
+ * The marking uses an explicit mark stack instead of the C recursion.
+ * The stack is a list of packets. Each GC thread pushes and pops on
+ * its own packet, and passes a full packet to the shared list.
+ *
+ * In multithread builds, the threads that are waiting at GC safe
+ * points take packets from the shared list and help the marking.
+ * A thread that runs out of work waits for a packet until no thread
+ * is busy. (the termination)
+ *
+ * There are no dedicated GC threads. An app that runs scripts on a
+ * single thread marks on that thread only.
+ *
+ * If a packet can't be allocated, the object stays marked but not
+ * scanned. The marked objects are scanned again after the marking.
+ */
+
+/* Start the marking. */
 static void
-rt_gc_mark_old_object_recursively(
+rt_gc_mark_begin(
 	struct rt_env *env,
-	struct rt_gc_object **obj)
+	struct rt_gc_marker *m)
+{
+	m->cur = NULL;
+	env->vm->gc.mark_overflow = false;
+
+#if defined(NOCT_USE_MULTITHREAD)
+	/* Open the marking to the other threads. This thread is busy. */
+	MARK_LOCK(env);
+	env->vm->gc.mark_busy = 1;
+	env->vm->gc.mark_open = 1;
+	MARK_UNLOCK(env);
+#endif
+}
+
+/* Finish the marking. */
+static void
+rt_gc_mark_end(
+	struct rt_env *env)
+{
+	struct rt_gc_mark_packet *p, *next;
+#if defined(NOCT_USE_MULTITHREAD)
+	int spin;
+#endif
+
+#if defined(NOCT_USE_MULTITHREAD)
+	/* Wait for the helper threads leaving. */
+	spin = 0;
+	while (atomic_load_acquire(&env->vm->gc.mark_helpers) > 0)
+		rt_gc_backoff(&spin);
+#endif
+
+	assert(env->vm->gc.mark_full == NULL);
+
+	/* Free the packets. */
+	p = env->vm->gc.mark_free;
+	while (p != NULL) {
+		next = p->next;
+		noct_free(p);
+		p = next;
+	}
+	env->vm->gc.mark_free = NULL;
+}
+
+/* Mark the objects referenced from the roots. */
+static void
+rt_gc_mark_roots(
+	struct rt_env *env,
+	struct rt_gc_marker *m)
 {
+	struct rt_env *e;
+	struct rt_frame *frame;
+	struct rt_stack_chunk *chunk;
+	struct rt_shape *shape;
 	uint32_t i;
+	int sp;
+
+	/* For all global variables. */
+	for (i = 0; i < (uint32_t)env->vm->global_alloc_size; i++) {
+		if (env->vm->global[i].name == NULL || env->vm->global[i].is_removed)
+			continue;
+		if (IS_REF_VAL(&env->vm->global[i].val))
+			rt_gc_mark_old_object(env, m, &env->vm->global[i].val.val.obj);
+	}
+
+	/* For all envs. (the other threads are stopped) */
+	for (e = env->vm->env_list; e != NULL; e = e->next) {
+		/* For all temporary variables on the stack. (contiguous in chunks) */
+		for (chunk = e->stack_bottom; chunk != NULL; chunk = chunk->next) {
+			for (i = 0; i < chunk->top; i++) {
+				if (IS_REF_VAL(&chunk->value[i]))
+					rt_gc_mark_old_object(env, m, &chunk->value[i].val.obj);
+			}
+			if (chunk == e->stack_top)
+				break;
+		}
+
+		/* For all pinned C local variables in the call frames. */
+		for (sp = e->cur_frame_index; sp >= 0; sp--) {
+			frame = e->frame_tbl[sp];
+			for (i = 0; i < frame->pinned_count; i++) {
+				if (IS_REF_VAL(frame->pinned[i]))
+					rt_gc_mark_old_object(env, m, &frame->pinned[i]->val.obj);
+			}
+		}
+	}
+
+	/* For all pinned C global variables. */
+	for (i = 0; i < env->vm->pinned_count; i++) {
+		if (IS_REF_VAL(env->vm->pinned[i]))
+			rt_gc_mark_old_object(env, m, &env->vm->pinned[i]->val.obj);
+	}
 
+	/* For all dictionary shape keys. */
+	for (shape = env->vm->shape_list; shape != NULL; shape = shape->next)
+		rt_gc_mark_old_object(env, m, &shape->key.val.obj);
+}
+
+/* Mark an object, and push it to the mark stack. */
+static void
+rt_gc_mark_old_object(
+	struct rt_env *env,
+	struct rt_gc_marker *m,
+	struct rt_gc_object **obj)
+{
 	/* Follow the newer array/dict. */
 	rt_gc_array_dict_follow_newer(env, obj);
 
-	/* If already marked, just return. */
+	/* Mark. If already marked, just return. */
+#if defined(NOCT_USE_MULTITHREAD)
+	if (atomic_test_and_set_bool(&(*obj)->is_marked))
+		return;
+#else
 	if ((*obj)->is_marked)
 		return;
-
-	/* Mark. */
 	(*obj)->is_marked = true;
+#endif
 
-	/* Mark recursively. */
-	if ((*obj)->type == RT_GC_TYPE_ARRAY) {
-		struct rt_array *arr = (struct rt_array *)*obj;
+	/* A string has no children. */
+	if ((*obj)->type == RT_GC_TYPE_STRING)
+		return;
+
+	/* Push. */
+	if (m->cur == NULL || m->cur->count == RT_GC_MARK_PACKET_SIZE) {
+		if (!rt_gc_mark_new_packet(env, m))
+			return;
+	}
+	m->cur->obj[m->cur->count++] = *obj;
+}
+
+/* Mark the children of an object. */
+static void
+rt_gc_mark_children(
+	struct rt_env *env,
+	struct rt_gc_marker *m,
+	struct rt_gc_object *obj)
+{
+	uint32_t i;
+
+	if (obj->type == RT_GC_TYPE_ARRAY) {
+		struct rt_array *arr = (struct rt_array *)obj;
 		for (i = 0; i < arr->size; i++) {
 			if (IS_REF_VAL(&arr->table[i]))
-				rt_gc_mark_old_object_recursively(env, &arr->table[i].val.obj);
+				rt_gc_mark_old_object(env, m, &arr->table[i].val.obj);
 		}
-	} else if ((*obj)->type == RT_GC_TYPE_DICT) {
-		struct rt_dict *dict = (struct rt_dict *)*obj;
+	} else if (obj->type == RT_GC_TYPE_DICT) {
+		struct rt_dict *dict = (struct rt_dict *)obj;
 		for (i = 0; i < dict->alloc_size; i++) {
-			if (dict->key[i].type != NOCT_VALUE_STRING)
+			if (!RT_DICT_SLOT_USED(dict, i))
 				continue; /* Removed or empty. */
 
-			rt_gc_mark_old_object_recursively(env, &dict->key[i].val.obj);
+			if (dict->key != NULL)
+				rt_gc_mark_old_object(env, m, &dict->key[i].val.obj);
 			if (IS_REF_VAL(&dict->value[i]))
-				rt_gc_mark_old_object_recursively(env, &dict->value[i].val.obj);
+				rt_gc_mark_old_object(env, m, &dict->value[i].val.obj);
+		}
+	}
+}
+
+/* Pass the current full packet to the shared list, and get an empty one. */
+static bool
+rt_gc_mark_new_packet(
+	struct rt_env *env,
+	struct rt_gc_marker *m)
+{
+	struct rt_gc_mark_packet *p;
+
+	MARK_LOCK(env);
+
+	/* Share the full packet. */
+	if (m->cur != NULL) {
+		m->cur->next = env->vm->gc.mark_full;
+		env->vm->gc.mark_full = m->cur;
+		m->cur = NULL;
+	}
+
+	/* Reuse a free packet. */
+	p = env->vm->gc.mark_free;
+	if (p != NULL)
+		env->vm->gc.mark_free = p->next;
+
+	MARK_UNLOCK(env);
+
+	/* Allocate a packet. */
+	if (p == NULL) {
+		p = noct_malloc(sizeof(struct rt_gc_mark_packet));
+		if (p == NULL) {
+			/* The object will be scanned by rt_gc_mark_rescan(). */
+			MARK_LOCK(env);
+			env->vm->gc.mark_overflow = true;
+			MARK_UNLOCK(env);
+			return false;
+		}
+	}
+
+	p->count = 0;
+	m->cur = p;
+
+	return true;
+}
+
+/* Get a packet to scan. Returns false when the marking is finished. */
+static bool
+rt_gc_mark_get_work(
+	struct rt_env *env,
+	struct rt_gc_marker *m)
+{
+#if defined(NOCT_USE_MULTITHREAD)
+	int spin;
+#endif
+
+	MARK_LOCK(env);
+
+	/* Release the current empty packet. */
+	if (m->cur != NULL) {
+		m->cur->next = env->vm->gc.mark_free;
+		env->vm->gc.mark_free = m->cur;
+		m->cur = NULL;
+	}
+
+	/* Take a shared packet. */
+	if (env->vm->gc.mark_full != NULL) {
+		m->cur = env->vm->gc.mark_full;
+		env->vm->gc.mark_full = m->cur->next;
+		MARK_UNLOCK(env);
+		return true;
+	}
+
+#if defined(NOCT_USE_MULTITHREAD)
+	/* This thread is idle. */
+	env->vm->gc.mark_busy--;
+	MARK_UNLOCK(env);
+
+	/* Wait for a packet shared by a busy thread. */
+	spin = 0;
+	while (1) {
+		MARK_LOCK(env);
+		if (env->vm->gc.mark_full != NULL) {
+			m->cur = env->vm->gc.mark_full;
+			env->vm->gc.mark_full = m->cur->next;
+			env->vm->gc.mark_busy++;
+			MARK_UNLOCK(env);
+			return true;
+		}
+		if (env->vm->gc.mark_busy == 0 || !env->vm->gc.mark_open) {
+			/* No thread will share a packet. Finished. */
+			env->vm->gc.mark_open = 0;
+			MARK_UNLOCK(env);
+			return false;
+		}
+		MARK_UNLOCK(env);
+
+		rt_gc_backoff(&spin);
+	}
+#else
+	MARK_UNLOCK(env);
+	return false;
+#endif
+}
+
+/* Scan objects until the marking is finished. */
+static void
+rt_gc_mark_drain(
+	struct rt_env *env,
+	struct rt_gc_marker *m)
+{
+	struct rt_gc_object *obj;
+
+	while (1) {
+		/* Pop and scan. (This may replace the current packet.) */
+		while (m->cur != NULL && m->cur->count > 0) {
+			obj = m->cur->obj[--m->cur->count];
+			rt_gc_mark_children(env, m, obj);
+		}
+
+		/* Get more work. */
+		if (!rt_gc_mark_get_work(env, m))
+			break;
+	}
+}
+
+/* Scan the children of all marked objects. (after an overflow) */
+static void
+rt_gc_mark_rescan(
+	struct rt_env *env,
+	struct rt_gc_marker *m)
+{
+	struct rt_gc_object *list[3];
+	struct rt_gc_object *obj;
+	int i;
+
+	list[0] = env->vm->gc.nursery_list;
+	list[1] = env->vm->gc.graduate_list;
+	list[2] = env->vm->gc.tenure_list;
+
+	for (i = 0; i < 3; i++) {
+		for (obj = list[i]; obj != NULL; obj = obj->next) {
+			if (obj->is_marked)
+				rt_gc_mark_children(env, m, obj);
 		}
 	}
 }
@@ -1572,6 +2060,7 @@ rt_gc_free_old_object(
 
 	/* Unlink from the tenure list. */
 	UNLINK_FROM_LIST(obj, env->vm->gc.tenure_list, prev, next);
+	env->vm->gc.tenure_count--;
 
 	/* Unlink from the remember set. */
 	if (obj->rem_flg)
@@ -1603,6 +2092,11 @@ rt_gc_compact_gc(
 	uint32_t index, i;
 	int sp;
 	struct rt_frame *frame;
+	struct rt_stack_chunk *chunk;
+	struct rt_shape *shape;
+
+	/* Objects will move. */
+	rt_gc_incremental_abort(env);
 
 	/*
 	 * Count all tenure objects.
@@ -1645,9 +2139,10 @@ rt_gc_compact_gc(
 
 		blk_size = *(size_t *)cur_blk;
 		blk_used = blk_size & RT_GC_FREELIST_USED_BIT ? true : false;
+		blk_size &= RT_GC_FREELIST_SIZE_MASK;
 		obj = (struct rt_gc_object *)(cur_blk + sizeof(size_t));
 
-		/* Check for the end of the list. */
+		/* Check for the sentinel. */
 		if (blk_size == 0)
 			break;
 
@@ -1660,7 +2155,7 @@ rt_gc_compact_gc(
 		/* Record. */
 		env->vm->gc.compact_before[index] = obj;
 		env->vm->gc.compact_after[index] = remap_top + sizeof(size_t);
-		remap_top += sizeof(size_t) + obj->size;
+		remap_top += sizeof(size_t) + blk_size;
 		index++;
 
 		cur_blk += sizeof(size_t) + blk_size;
@@ -1673,24 +2168,30 @@ rt_gc_compact_gc(
 	 */
 
 	for (i = 0; i < env->vm->gc.compact_count; i++) {
-		/* Get the real object size. */
-		size_t obj_size = ((struct rt_gc_object *)env->vm->gc.compact_before[i])->size;
+		/* Get the block size. */
+		size_t blk_size = *(size_t *)((char *)env->vm->gc.compact_before[i] - sizeof(size_t)) & RT_GC_FREELIST_SIZE_MASK;
 
-		/* Move. */
+		/* Move. (The object size doesn't exceed the block size.) */
 		memmove(env->vm->gc.compact_after[i],
 			env->vm->gc.compact_before[i],
-			obj_size);
+			((struct rt_gc_object *)env->vm->gc.compact_before[i])->size);
 
-		/* Store the size header. */
-		*(size_t *)((char *)env->vm->gc.compact_after[i] - sizeof(size_t)) = obj_size;
+		/* Store the size header. (No free block precedes.) */
+		*(size_t *)((char *)env->vm->gc.compact_after[i] - sizeof(size_t)) = blk_size | RT_GC_FREELIST_USED_BIT;
+	}
 
-		/* Fill the reminder. */
-		if (i == env->vm->gc.compact_count - 1) {
-			memset((char *)env->vm->gc.compact_after[i] + obj_size,
-			       0,
-			       (size_t)(env->vm->gc.tenure_freelist.end - ((char *)env->vm->gc.compact_after[i] + obj_size)));
-		}
+	/*
+	 * Make the remainder a single free block.
+	 */
+
+	if ((size_t)(env->vm->gc.tenure_freelist.end - sizeof(size_t) - remap_top) < sizeof(size_t) + RT_GC_FREELIST_MIN_SIZE &&
+	    remap_top != env->vm->gc.tenure_freelist.end - sizeof(size_t)) {
+		/* Too small for a block: extend the last block. */
+		char *last_blk = (char *)env->vm->gc.compact_after[env->vm->gc.compact_count - 1] - sizeof(size_t);
+		*(size_t *)last_blk += (size_t)(env->vm->gc.tenure_freelist.end - sizeof(size_t) - remap_top);
+		remap_top = env->vm->gc.tenure_freelist.end - sizeof(size_t);
 	}
+	rt_gc_freelist_reset(&env->vm->gc.tenure_freelist, remap_top);
 
 	/*
 	 * Rewrite all references.
@@ -1728,17 +2229,19 @@ rt_gc_compact_gc(
 			rt_gc_update_tenure_ref_recursively(env, &env->vm->global[i].val.val.obj);
 	}
 
-	/* For all call frames. */
-	for (sp = env->cur_frame_index; sp >= 0; sp--) {
-		frame = &env->frame_alloc[sp];
-
-		/* For all temporary variables in the frame. */
-		for (i = 0; i < frame->tmpvar_size; i++) {
-			if (IS_REF_VAL(&frame->tmpvar[i]))
-				rt_gc_update_tenure_ref_recursively(env, &frame->tmpvar[i].val.obj);
+	/* For all temporary variables on the stack. (contiguous in chunks) */
+	for (chunk = env->stack_bottom; chunk != NULL; chunk = chunk->next) {
+		for (i = 0; i < chunk->top; i++) {
+			if (IS_REF_VAL(&chunk->value[i]))
+				rt_gc_update_tenure_ref_recursively(env, &chunk->value[i].val.obj);
 		}
+		if (chunk == env->stack_top)
+			break;
+	}
 
-		/* For all pinned C local variables in the frame. */
+	/* For all pinned C local variables in the call frames. */
+	for (sp = (int)env->cur_frame_index; sp >= 0; sp--) {
+		frame = env->frame_tbl[sp];
 		for (i = 0; i < frame->pinned_count; i++) {
 			if (IS_REF_VAL(frame->pinned[i]))
 				rt_gc_update_tenure_ref_recursively(env, &frame->pinned[i]->val.obj);
@@ -1751,6 +2254,10 @@ rt_gc_compact_gc(
 			rt_gc_update_tenure_ref_recursively(env, &env->vm->pinned[i]->val.obj);
 	}
 
+	/* For all dictionary shape keys. */
+	for (shape = env->vm->shape_list; shape != NULL; shape = shape->next)
+		rt_gc_update_tenure_ref_recursively(env, &shape->key.val.obj);
+
 	/*
 	 * Cleanup the compaction table.
 	 */
@@ -1816,10 +2323,11 @@ rt_gc_update_tenure_ref_recursively(
 	} else if ((*obj)->type == RT_GC_TYPE_DICT) {
 		struct rt_dict *dict = (struct rt_dict *)*obj;
 		for (i = 0; i < dict->alloc_size; i++) {
-			if (dict->key[i].type != NOCT_VALUE_STRING)
+			if (!RT_DICT_SLOT_USED(dict, i))
 				continue; /* Removed or empty. */
 
-			rt_gc_update_tenure_ref_recursively(env, &dict->key[i].val.obj);
+			if (dict->key != NULL)
+				rt_gc_update_tenure_ref_recursively(env, &dict->key[i].val.obj);
 			if (IS_REF_VAL(&dict->value[i]))
 				rt_gc_update_tenure_ref_recursively(env, &dict->value[i].val.obj);
 		}
@@ -1932,19 +2440,63 @@ rt_gc_get_heap_usage(
 	struct rt_env *env,
 	size_t *ret)
 {
-	UNUSED_PARAMETER(env);
+	struct rt_gc_info *gc;
 
 	assert(env != NULL);
 	assert(ret != NULL);
 
-	/* TODO */
-	*ret = 0;
+	gc = &env->vm->gc;
+
+	/* Young generation. */
+	*ret = (size_t)(gc->nursery_arena.cur - gc->nursery_arena.top);
+	*ret += (size_t)(gc->graduate_arena[gc->cur_grad_from].cur - gc->graduate_arena[gc->cur_grad_from].top);
+
+	/* Tenure generation. (including block headers) */
+	*ret += rt_gc_tenure_used_size(env);
 
 	return true;
 }
 
 /*
- * Manually trigger the young GC.
+ * Retrieves the free space statistics of the tenure region.
+ */
+bool
+rt_gc_get_heap_stats(
+	struct rt_env *env,
+	size_t *free_size,
+	size_t *largest_free_size,
+	size_t *free_count)
+{
+	struct freelist *fl_info;
+	struct rt_gc_free_block *blk;
+	int fl, sl;
+
+	assert(env != NULL);
+	assert(free_size != NULL);
+	assert(largest_free_size != NULL);
+	assert(free_count != NULL);
+
+	fl_info = &env->vm->gc.tenure_freelist;
+
+	*free_size = fl_info->free_size;
+	*free_count = fl_info->free_count;
+
+	/* The largest block is in the highest non-empty class. */
+	*largest_free_size = 0;
+	if (fl_info->fl_bitmap == 0)
+		return true;
+	fl = rt_gc_fls(fl_info->fl_bitmap);
+	sl = rt_gc_fls(fl_info->sl_bitmap[fl]);
+	for (blk = fl_info->head[fl][sl]; blk != NULL; blk = blk->next) {
+		if ((blk->header & RT_GC_FREELIST_SIZE_MASK) > *largest_free_size)
+			*largest_free_size = blk->header & RT_GC_FREELIST_SIZE_MASK;
+	}
+
+	return true;
+}
+
+/*
+ * Manually trigger the young GC.
  */
 void
 rt_gc_level1_gc(struct rt_env *env)
@@ -1971,6 +2523,388 @@ void rt_gc_level3_gc(struct rt_env *env)
 	rt_gc_compact_gc(env);
 }
 
+/*
+ * Incremental Old GC
+ *
+ * A cycle marks the tenure objects with the tri-color marking, and
+ * then sweeps the tenure list, both in slices of limited steps.
+ *
+ * Young objects are not colored because they move at every young GC.
+ * Instead, the last slice of the marking rescans the roots and all
+ * young objects at once. It costs the size of the young generation,
+ * not the size of the tenure region.
+ *
+ * Between slices, the write barriers make a scanned (black) container
+ * gray again when a reference is stored, and objects that are
+ * allocated in the tenure region while marking start gray.
+ */
+
+/* Number of scanned references that are counted as a step. */
+#define RT_GC_INCREMENTAL_REFS_PER_STEP		64
+
+/* Initial size of the gray stack. */
+#define RT_GC_GRAY_STACK_INIT			1024
+
+/*
+ * Runs a slice of the incremental old GC.
+ */
+bool
+rt_gc_incremental_gc(
+	struct rt_env *env,
+	int steps)
+{
+	assert(env != NULL);
+
+	if (steps <= 0)
+		return env->vm->gc.inc_phase != RT_GC_PHASE_IDLE;
+
+	/* Check if a cycle should start. */
+	if (env->vm->gc.inc_phase == RT_GC_PHASE_IDLE &&
+	    rt_gc_tenure_used_size(env) < env->vm->gc.inc_trigger)
+		return false;
+
+	env->vm->gc.inc_steps = steps;
+#if defined(NOCT_USE_MULTITHREAD)
+	rt_gc_multithread_gc_wrapper(env, rt_gc_incremental_gc_body);
+#else
+	rt_gc_incremental_gc_body(env);
+#endif
+
+	return env->vm->gc.inc_phase != RT_GC_PHASE_IDLE;
+}
+
+/* Executes a slice of the incremental old GC. */
+static void
+rt_gc_incremental_gc_body(
+	struct rt_env *env)
+{
+	struct rt_gc_info *gc;
+	struct rt_gc_object *obj;
+	size_t used, trigger;
+	int steps;
+
+	gc = &env->vm->gc;
+	steps = gc->inc_steps;
+
+	/* Start a cycle. */
+	if (gc->inc_phase == RT_GC_PHASE_IDLE) {
+		gc->inc_phase = RT_GC_PHASE_MARK;
+		rt_gc_shade_roots(env);
+	}
+
+	/*
+	 * Mark.
+	 */
+
+	if (gc->inc_phase == RT_GC_PHASE_MARK) {
+		/*
+		 * Also pay for the gray objects that the mutator made since
+		 * the last slice, so that the marking always catches up.
+		 */
+		if (gc->inc_debt > INT_MAX - steps)
+			steps = INT_MAX;
+		else
+			steps += gc->inc_debt;
+		gc->inc_debt = 0;
+
+		/* Scan gray objects within the steps. */
+		while (steps > 0 && gc->gray_count > 0)
+			steps -= rt_gc_scan_gray(env);
+		if (gc->inc_phase != RT_GC_PHASE_MARK || gc->gray_count > 0)
+			return;
+
+		/*
+		 * Finish the marking at once. Collect the young
+		 * generation first so that dead young objects don't
+		 * retain tenure objects.
+		 */
+		rt_gc_young_gc_body(env);
+		rt_gc_shade_roots(env);
+		rt_gc_shade_young(env);
+		while (gc->gray_count > 0)
+			rt_gc_scan_gray(env);
+		if (gc->inc_phase != RT_GC_PHASE_MARK)
+			return;
+
+		/* The remaining white objects are unreachable. */
+		gc->inc_phase = RT_GC_PHASE_SWEEP;
+		gc->sweep_cursor = gc->tenure_list;
+		return;
+	}
+
+	/*
+	 * Sweep.
+	 *  - Objects allocated from now are inserted before the cursor.
+	 */
+
+	while (steps > 0 && gc->sweep_cursor != NULL) {
+		obj = gc->sweep_cursor;
+		gc->sweep_cursor = obj->next;
+
+		/* Free if white, and make white for the next cycle. */
+		if (obj->color == RT_GC_COLOR_WHITE)
+			rt_gc_free_old_object(env, obj);
+		else
+			obj->color = RT_GC_COLOR_WHITE;
+
+		steps--;
+	}
+	if (gc->sweep_cursor != NULL)
+		return;
+
+	/* Finish the cycle, and start the next when the live size doubles. */
+	used = rt_gc_tenure_used_size(env);
+	trigger = used * 2;
+	if (trigger < RT_GC_DEFAULT_INCREMENTAL_TRIGGER)
+		trigger = RT_GC_DEFAULT_INCREMENTAL_TRIGGER;
+	if (trigger > (size_t)(gc->tenure_freelist.end - gc->tenure_freelist.top) / 4 * 3)
+		trigger = (size_t)(gc->tenure_freelist.end - gc->tenure_freelist.top) / 4 * 3;
+	gc->inc_trigger = trigger;
+	gc->inc_phase = RT_GC_PHASE_IDLE;
+}
+
+/* Abort the incremental cycle in progress. */
+static void
+rt_gc_incremental_abort(
+	struct rt_env *env)
+{
+	struct rt_gc_object *obj;
+
+	if (env->vm->gc.inc_phase == RT_GC_PHASE_IDLE)
+		return;
+
+	/* Make all tenure objects white. */
+	obj = env->vm->gc.tenure_list;
+	while (obj != NULL) {
+		obj->color = RT_GC_COLOR_WHITE;
+		obj = obj->next;
+	}
+
+	env->vm->gc.gray_count = 0;
+	env->vm->gc.inc_debt = 0;
+	env->vm->gc.sweep_cursor = NULL;
+	env->vm->gc.inc_phase = RT_GC_PHASE_IDLE;
+}
+
+/* Called when a tenure object is allocated. */
+static void
+rt_gc_incremental_on_alloc(
+	struct rt_env *env,
+	struct rt_gc_object *obj)
+{
+	/*
+	 * While marking, a new object is gray so that its references
+	 * copied from elsewhere are scanned. Otherwise, white.
+	 */
+	obj->color = RT_GC_COLOR_WHITE;
+	if (env->vm->gc.inc_phase == RT_GC_PHASE_MARK) {
+		rt_gc_shade(env, obj);
+		env->vm->gc.inc_debt++;
+	}
+}
+
+/* Make a white tenure object gray, and its newer array/dict too. */
+static void
+rt_gc_shade(
+	struct rt_env *env,
+	struct rt_gc_object *obj)
+{
+	struct rt_gc_object **new_stack;
+	size_t new_alloc;
+
+	while (obj != NULL) {
+		if (obj->region == RT_GC_REGION_TENURE &&
+		    obj->color == RT_GC_COLOR_WHITE) {
+			/* Expand the gray stack. */
+			if (env->vm->gc.gray_count == env->vm->gc.gray_alloc) {
+				new_alloc = env->vm->gc.gray_alloc == 0 ?
+					RT_GC_GRAY_STACK_INIT :
+					env->vm->gc.gray_alloc * 2;
+				new_stack = noct_malloc(new_alloc * sizeof(struct rt_gc_object *));
+				if (new_stack == NULL) {
+					/* Leave it to the stop-the-world GC. */
+					rt_gc_incremental_abort(env);
+					return;
+				}
+				if (env->vm->gc.gray_stack != NULL) {
+					memcpy(new_stack,
+					       env->vm->gc.gray_stack,
+					       env->vm->gc.gray_count * sizeof(struct rt_gc_object *));
+					noct_free(env->vm->gc.gray_stack);
+				}
+				env->vm->gc.gray_stack = new_stack;
+				env->vm->gc.gray_alloc = new_alloc;
+			}
+
+			/* Push. */
+			obj->color = RT_GC_COLOR_GRAY;
+			env->vm->gc.gray_stack[env->vm->gc.gray_count++] = obj;
+		}
+
+		/* Follow the newer array/dict. */
+		if (obj->type == RT_GC_TYPE_ARRAY && ((struct rt_array *)obj)->newer != NULL)
+			obj = &((struct rt_array *)obj)->newer->head;
+		else if (obj->type == RT_GC_TYPE_DICT && ((struct rt_dict *)obj)->newer != NULL)
+			obj = &((struct rt_dict *)obj)->newer->head;
+		else
+			obj = NULL;
+	}
+}
+
+/* Shade the children of an object. Returns the number of the references. */
+static uint32_t
+rt_gc_shade_children(
+	struct rt_env *env,
+	struct rt_gc_object *obj)
+{
+	uint32_t i, count;
+
+	count = 0;
+	if (obj->type == RT_GC_TYPE_ARRAY) {
+		struct rt_array *arr = (struct rt_array *)obj;
+		for (i = 0; i < arr->size; i++) {
+			if (IS_REF_VAL(&arr->table[i])) {
+				rt_gc_shade(env, arr->table[i].val.obj);
+				count++;
+			}
+		}
+	} else if (obj->type == RT_GC_TYPE_DICT) {
+		struct rt_dict *dict = (struct rt_dict *)obj;
+		for (i = 0; i < dict->alloc_size; i++) {
+			if (!RT_DICT_SLOT_USED(dict, i))
+				continue; /* Removed or empty. */
+
+			if (dict->key != NULL)
+				rt_gc_shade(env, dict->key[i].val.obj);
+			if (IS_REF_VAL(&dict->value[i]))
+				rt_gc_shade(env, dict->value[i].val.obj);
+			count += 2;
+		}
+	}
+
+	return count;
+}
+
+/* Scan a gray object and make it black. Returns the steps spent. */
+static int
+rt_gc_scan_gray(
+	struct rt_env *env)
+{
+	struct rt_gc_object *obj;
+	uint32_t count;
+
+	assert(env->vm->gc.gray_count > 0);
+
+	/* Pop. */
+	obj = env->vm->gc.gray_stack[--env->vm->gc.gray_count];
+	obj->color = RT_GC_COLOR_BLACK;
+
+	/* Scan. */
+	count = rt_gc_shade_children(env, obj);
+
+	return 1 + (int)(count / RT_GC_INCREMENTAL_REFS_PER_STEP);
+}
+
+/* Shade the objects referenced from the roots. */
+static void
+rt_gc_shade_roots(
+	struct rt_env *env)
+{
+	struct rt_env *e;
+	struct rt_frame *frame;
+	struct rt_stack_chunk *chunk;
+	struct rt_shape *shape;
+	uint32_t i;
+	int sp;
+
+	/* For all global variables. */
+	for (i = 0; i < (uint32_t)env->vm->global_alloc_size; i++) {
+		if (env->vm->global[i].name == NULL || env->vm->global[i].is_removed)
+			continue;
+		if (IS_REF_VAL(&env->vm->global[i].val))
+			rt_gc_shade(env, env->vm->global[i].val.val.obj);
+	}
+
+	/* For all envs. (the other threads are stopped) */
+	for (e = env->vm->env_list; e != NULL; e = e->next) {
+		/* For all temporary variables on the stack. (contiguous in chunks) */
+		for (chunk = e->stack_bottom; chunk != NULL; chunk = chunk->next) {
+			for (i = 0; i < chunk->top; i++) {
+				if (IS_REF_VAL(&chunk->value[i]))
+					rt_gc_shade(env, chunk->value[i].val.obj);
+			}
+			if (chunk == e->stack_top)
+				break;
+		}
+
+		/* For all pinned C local variables in the call frames. */
+		for (sp = (int)e->cur_frame_index; sp >= 0; sp--) {
+			frame = e->frame_tbl[sp];
+			for (i = 0; i < frame->pinned_count; i++) {
+				if (IS_REF_VAL(frame->pinned[i]))
+					rt_gc_shade(env, frame->pinned[i]->val.obj);
+			}
+		}
+	}
+
+	/* For all pinned C global variables. */
+	for (i = 0; i < env->vm->pinned_count; i++) {
+		if (IS_REF_VAL(env->vm->pinned[i]))
+			rt_gc_shade(env, env->vm->pinned[i]->val.obj);
+	}
+
+	/* For all dictionary shape keys. */
+	for (shape = env->vm->shape_list; shape != NULL; shape = shape->next)
+		rt_gc_shade(env, shape->key.val.obj);
+}
+
+/* Shade the tenure objects referenced from the young objects. */
+static void
+rt_gc_shade_young(
+	struct rt_env *env)
+{
+	struct rt_gc_object *obj;
+
+	/* Nursery objects. */
+	obj = env->vm->gc.nursery_list;
+	while (obj != NULL) {
+		rt_gc_shade(env, obj);
+		rt_gc_shade_children(env, obj);
+		obj = obj->next;
+	}
+
+	/* Graduate objects. */
+	obj = env->vm->gc.graduate_list;
+	while (obj != NULL) {
+		rt_gc_shade(env, obj);
+		rt_gc_shade_children(env, obj);
+		obj = obj->next;
+	}
+}
+
+/* Get the used size of the nursery and graduate regions. */
+static size_t
+rt_gc_young_used_size(
+	struct rt_env *env)
+{
+	struct arena_info *nursery, *graduate;
+
+	nursery = &env->vm->gc.nursery_arena;
+	graduate = &env->vm->gc.graduate_arena[env->vm->gc.cur_grad_from];
+
+	return (size_t)(nursery->cur - nursery->top) +
+		(size_t)(graduate->cur - graduate->top);
+}
+
+/* Get the used size of the tenure region. */
+static size_t
+rt_gc_tenure_used_size(
+	struct rt_env *env)
+{
+	return (size_t)(env->vm->gc.tenure_freelist.end - env->vm->gc.tenure_freelist.top) -
+		env->vm->gc.tenure_freelist.free_size;
+}
+
 static void *
 nursery_alloc(
 	struct rt_env *env,
@@ -1990,18 +2924,188 @@ graduate_alloc(
 }
 
 /*
- * Allocate a tenure block.
+ * Tenure Allocator
+ *
+ * A two-level segregated fit allocator. A block has its payload size
+ * at the block top, and the LSB of the header indicates the block is
+ * used (set) or freed (clear). The second bit tells the previous
+ * block is free, in which case the size of the previous block can be
+ * read from its boundary tag just before the header.
  *
- * The allocator for the tenure region.
- * Each block has its size at the block top.
- * The LSB of the block size indicates the block is used (set) or freed (clear).
+ * The region ends with a zero-sized used block, the sentinel.
+ */
+
+/* Get the index of the MSB. */
+static INLINE int
+rt_gc_fls(
+	size_t x)
+{
+#if defined(__GNUC__)
+	if (sizeof(size_t) > sizeof(unsigned int))
+		return (int)(sizeof(unsigned long long) * 8) - 1 - __builtin_clzll((unsigned long long)x);
+	return (int)(sizeof(unsigned int) * 8) - 1 - __builtin_clz((unsigned int)x);
+#else
+	int n = -1;
+	while (x != 0) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Get the index of the LSB. */
+static INLINE int
+rt_gc_ffs(
+	uint32_t x)
+{
+#if defined(__GNUC__)
+	return __builtin_ctz(x);
+#else
+	int n = 0;
+	while ((x & 1) == 0) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* Get the size class of a block size. */
+static INLINE void
+rt_gc_size_class(
+	size_t size,
+	int *fl,
+	int *sl)
+{
+	int msb;
+
+	if (size < RT_GC_FREELIST_SL_COUNT) {
+		*fl = 0;
+		*sl = (int)size;
+		return;
+	}
+
+	msb = rt_gc_fls(size);
+	*fl = msb - RT_GC_FREELIST_SL_LOG2 + 1;
+	*sl = (int)(size >> (msb - RT_GC_FREELIST_SL_LOG2)) - RT_GC_FREELIST_SL_COUNT;
+	if (*fl >= RT_GC_FREELIST_FL_COUNT) {
+		*fl = RT_GC_FREELIST_FL_COUNT - 1;
+		*sl = RT_GC_FREELIST_SL_COUNT - 1;
+	}
+}
+
+/* Insert a free block to its size class list. */
+static INLINE void
+rt_gc_freelist_insert(
+	struct freelist *fl_info,
+	struct rt_gc_free_block *blk)
+{
+	int fl, sl;
+
+	rt_gc_size_class(blk->header & RT_GC_FREELIST_SIZE_MASK, &fl, &sl);
+
+	blk->prev = NULL;
+	blk->next = fl_info->head[fl][sl];
+	if (blk->next != NULL)
+		blk->next->prev = blk;
+	fl_info->head[fl][sl] = blk;
+
+	fl_info->fl_bitmap |= 1U << fl;
+	fl_info->sl_bitmap[fl] |= 1U << sl;
+
+	fl_info->free_size += blk->header & RT_GC_FREELIST_SIZE_MASK;
+	fl_info->free_count++;
+}
+
+/* Remove a free block from its size class list. */
+static INLINE void
+rt_gc_freelist_remove(
+	struct freelist *fl_info,
+	struct rt_gc_free_block *blk)
+{
+	int fl, sl;
+
+	rt_gc_size_class(blk->header & RT_GC_FREELIST_SIZE_MASK, &fl, &sl);
+
+	if (blk->next != NULL)
+		blk->next->prev = blk->prev;
+	if (blk->prev != NULL) {
+		blk->prev->next = blk->next;
+	} else {
+		fl_info->head[fl][sl] = blk->next;
+		if (blk->next == NULL) {
+			fl_info->sl_bitmap[fl] &= ~(1U << sl);
+			if (fl_info->sl_bitmap[fl] == 0)
+				fl_info->fl_bitmap &= ~(1U << fl);
+		}
+	}
+
+	fl_info->free_size -= blk->header & RT_GC_FREELIST_SIZE_MASK;
+	fl_info->free_count--;
+}
+
+/* Make a free block and insert it to the free list. */
+static INLINE void
+rt_gc_freelist_make_free(
+	struct freelist *fl_info,
+	char *blk,
+	size_t size)
+{
+	size_t *next_header;
+
+	/* Store the header and the boundary tag. */
+	*(size_t *)blk = size;
+	*(size_t *)(blk + size) = size;
+
+	/* Tell the next block that this block is free. */
+	next_header = (size_t *)(blk + sizeof(size_t) + size);
+	*next_header |= RT_GC_FREELIST_PREV_FREE_BIT;
+
+	rt_gc_freelist_insert(fl_info, (struct rt_gc_free_block *)blk);
+}
+
+/* Reset the tenure region so that a free block starts at the specified address. */
+static void
+rt_gc_freelist_reset(
+	struct freelist *fl_info,
+	char *free_top)
+{
+	char *sentinel;
+	size_t size;
+
+	fl_info->fl_bitmap = 0;
+	memset(fl_info->sl_bitmap, 0, sizeof(fl_info->sl_bitmap));
+	memset(fl_info->head, 0, sizeof(fl_info->head));
+	fl_info->free_size = 0;
+	fl_info->free_count = 0;
+
+	/* Put the sentinel. */
+	sentinel = fl_info->end - sizeof(size_t);
+	*(size_t *)sentinel = RT_GC_FREELIST_USED_BIT;
+
+	/* If there is no room, leave no free block. */
+	if (free_top == sentinel)
+		return;
+	size = (size_t)(sentinel - free_top) - sizeof(size_t);
+	assert(size >= RT_GC_FREELIST_MIN_SIZE);
+
+	rt_gc_freelist_make_free(fl_info, free_top, size);
+}
+
+/*
+ * Allocate a tenure block.
  */
 static void *
 rt_gc_tenure_alloc(
 	struct rt_env *env,
 	size_t size)
 {
-	char *cur;
+	struct freelist *fl_info = &env->vm->gc.tenure_freelist;
+	struct rt_gc_free_block *blk;
+	size_t blk_size, search_size;
+	uint32_t map;
+	int fl, sl;
 
 	assert(size > 0);
 	if (size == 0)
@@ -2009,44 +3113,55 @@ rt_gc_tenure_alloc(
 
 	/* Align. */
 	size = (size + RT_GC_FREELIST_ALIGN - 1) & ~(RT_GC_FREELIST_ALIGN - 1);
+	if (size < RT_GC_FREELIST_MIN_SIZE)
+		size = RT_GC_FREELIST_MIN_SIZE;
+
+	/* Round up to the next class boundary so that any block in the class fits. */
+	search_size = size;
+	if (search_size >= RT_GC_FREELIST_SL_COUNT)
+		search_size += ((size_t)1 << (rt_gc_fls(search_size) - RT_GC_FREELIST_SL_LOG2)) - 1;
+	rt_gc_size_class(search_size, &fl, &sl);
+
+	/* Find a non-empty class. */
+	map = fl_info->sl_bitmap[fl] & (~0U << sl);
+	if (map == 0) {
+		if (fl + 1 >= RT_GC_FREELIST_FL_COUNT)
+			return NULL;
+		map = fl_info->fl_bitmap & (~0U << (fl + 1));
+		if (map == 0)
+			return NULL;
+		fl = rt_gc_ffs(map);
+		map = fl_info->sl_bitmap[fl];
+	}
+	sl = rt_gc_ffs(map);
 
-	/* The second blk */
-	cur = env->vm->gc.tenure_freelist.top;
-
-	/* Search for the first match. */
-	while (*(size_t *)cur) {
-		size_t blk_size = *(size_t *)cur;
-		bool is_used;
-
-		/* Check for the end of the list. */
-		if (blk_size == 0)
-			break;
-
-		is_used = blk_size & RT_GC_FREELIST_USED_BIT;
-		blk_size &= blk_size & RT_GC_FREELIST_SIZE_MASK;
-
-		/* Check if the block is used or the size is small. */
-		if (is_used || size > blk_size) {
-			cur = cur + sizeof(size_t) + blk_size;
-			assert(cur < env->vm->gc.tenure_freelist.end);
-			continue;
-		}
-
-		/* Reuse this block. */
-		blk_size |= RT_GC_FREELIST_USED_BIT;
-		*(size_t *)cur = blk_size;
+	/* Take the head. (Only the last class may have a smaller block.) */
+	blk = fl_info->head[fl][sl];
+	assert(blk != NULL);
+	blk_size = blk->header & RT_GC_FREELIST_SIZE_MASK;
+	if (blk_size < size)
+		return NULL;
+	rt_gc_freelist_remove(fl_info, blk);
 
-		/* Return the address of the block top + the size of the size header. */
-		return cur + sizeof(size_t);
+	if (blk_size - size >= sizeof(size_t) + RT_GC_FREELIST_MIN_SIZE) {
+		/* Split, and return the remainder to the free list. */
+		rt_gc_freelist_make_free(fl_info,
+					 (char *)blk + sizeof(size_t) + size,
+					 blk_size - size - sizeof(size_t));
+	} else {
+		/* Use the whole block, and tell the next block. */
+		size = blk_size;
+		*(size_t *)((char *)blk + sizeof(size_t) + size) &= ~(size_t)RT_GC_FREELIST_PREV_FREE_BIT;
 	}
 
-	/* Check if the remaining size fits. */
-	if (size > (size_t)(env->vm->gc.tenure_freelist.end - (uintptr_t)cur - sizeof(size_t)))
-		return NULL;
+	/* The previous block of a free block is never free. */
+	blk->header = size | RT_GC_FREELIST_USED_BIT;
+
+	/* Clear the payload, as the arenas do. (Free blocks hold links.) */
+	memset((char *)blk + sizeof(size_t), 0, size);
 
-	/* Allocate at the end of the free list. */
-	*(size_t *)cur = size | RT_GC_FREELIST_USED_BIT;
-	return cur + sizeof(size_t);
+	/* Return the address of the block top + the size of the size header. */
+	return (char *)blk + sizeof(size_t);
 }
 
 /* Free a tenure block. */
@@ -2055,22 +3170,35 @@ rt_gc_tenure_free(
 	struct rt_env *env,
 	void *p)
 {
-	size_t *header;
-	size_t size;
-
-	UNUSED_PARAMETER(env);
+	struct freelist *fl_info = &env->vm->gc.tenure_freelist;
+	char *blk, *next;
+	size_t header, size, next_header;
 
 	/* Get the header address. */
-	header = (size_t *)((char *)p - sizeof(size_t));
-
-	/* Get the block size. */
-	size = *header;
+	blk = (char *)p - sizeof(size_t);
+	header = *(size_t *)blk;
 
 	/* Block must be used. (check the used bit.) */
-	assert(size & RT_GC_FREELIST_USED_BIT);
+	assert(header & RT_GC_FREELIST_USED_BIT);
+	size = header & RT_GC_FREELIST_SIZE_MASK;
+
+	/* Coalesce with the next block. (The sentinel is always used.) */
+	next = blk + sizeof(size_t) + size;
+	next_header = *(size_t *)next;
+	if ((next_header & RT_GC_FREELIST_USED_BIT) == 0) {
+		rt_gc_freelist_remove(fl_info, (struct rt_gc_free_block *)next);
+		size += sizeof(size_t) + (next_header & RT_GC_FREELIST_SIZE_MASK);
+	}
 
-	/* Erase the used bit. */
-	*header = size & RT_GC_FREELIST_SIZE_MASK;
+	/* Coalesce with the previous block. */
+	if (header & RT_GC_FREELIST_PREV_FREE_BIT) {
+		size_t prev_size = *(size_t *)(blk - sizeof(size_t));
+		blk -= sizeof(size_t) + prev_size;
+		rt_gc_freelist_remove(fl_info, (struct rt_gc_free_block *)blk);
+		size += sizeof(size_t) + prev_size;
+	}
+
+	rt_gc_freelist_make_free(fl_info, blk, size);
 }
 
 /*
@@ -2079,8 +3207,6 @@ rt_gc_tenure_free(
 
 #if defined(NOCT_USE_MULTITHREAD)
 
-#include "atomic.h"
-
 /*
  * Initialize an environment.
  */
@@ -2101,8 +3227,7 @@ rt_gc_init_env(
 		atomic_fetch_sub_release(&env->vm->in_flight_counter, 1);
 
 		/* Wait for GC. */
-		while (atomic_load_acquire(&env->vm->gc_stw_counter) > 0)
-			cpu_relax();
+		rt_gc_wait_for_gc(env);
 	}
 }
 
@@ -2129,8 +3254,7 @@ rt_gc_safepoint(
 		atomic_fetch_sub_release(&env->vm->in_flight_counter, 1);
 
 		/* Wait for GC. */
-		while (env->vm->gc_stw_counter > 0)
-			cpu_relax();
+		rt_gc_wait_for_gc(env);
 	}
 }
 
@@ -2143,6 +3267,7 @@ rt_gc_multithread_gc_wrapper(
 	void (*gc)(struct rt_env *))
 {
 	bool is_executor = false;
+	int spin;
 
 	/* This thread is inflight at this moment. */
 
@@ -2151,33 +3276,30 @@ rt_gc_multithread_gc_wrapper(
 		// Make this thread non-inflight, and enter a GC safe point.
 		atomic_fetch_sub_release(&env->vm->in_flight_counter, 1);
 
-		/* Wait for all other threads entering GC safe points. */
-		while (1) {
-			/* Try acquire the right to execute GC. */
-			int old = atomic_fetch_add_acquire(&env->vm->gc_stw_counter, 1);
-			if (env->vm->in_flight_counter == 0 && old == 0) {
-				/* Succeeded, entering the GC section. */
-				is_executor = true;
-				break;
-			}
-
-			/* Failed, release.*/
+		/* Try acquire the right to execute GC. */
+		if (atomic_fetch_add_acquire(&env->vm->gc_stw_counter, 1) > 0) {
+			/* Failed, release. */
 			atomic_fetch_sub_release(&env->vm->gc_stw_counter, 1);
 
-			/* If another thread got the right to execute GC. */
-			if (old > 0) {
-				/* Wait for the GC finishes. */
-				while (env->vm->gc_stw_counter > 0)
-					cpu_relax();
-
-				/* Don't execute a GC in this thread this time. */
-				goto back_to_inflight;
-			}
+			/* Another thread got the right. Wait for the GC finishes. */
+			rt_gc_wait_for_gc(env);
 
-			/* Wait for all other threads get non-inflight. */
-			while (env->vm->in_flight_counter > 0)
-				cpu_relax();
+			/* Don't execute a GC in this thread this time. */
+			goto back_to_inflight;
 		}
+
+		/*
+		 * Wait for all other threads entering GC safe points.
+		 *  - Keep the right while waiting. Otherwise, the threads
+		 *    pass their safe points without stopping, and all of
+		 *    them are rarely non-inflight at once.
+		 */
+		spin = 0;
+		while (atomic_load_acquire(&env->vm->in_flight_counter) > 0)
+			rt_gc_backoff(&spin);
+
+		/* Succeeded, entering the GC section. */
+		is_executor = true;
 	} else {
 		/*
 		 * Recursive call, this thread is non-inflight, and in
@@ -2217,8 +3339,7 @@ back_to_inflight:
 			atomic_fetch_sub_release(&env->vm->in_flight_counter, 1);
 
 			/* Wait for GC. */
-			while (atomic_load_acquire(&env->vm->gc_stw_counter) > 0)
-				cpu_relax();
+			rt_gc_wait_for_gc(env);
 		}
 
 		/* Now this thread is infligh. */
@@ -2230,4 +3351,70 @@ back_to_inflight:
 	}
 }
 
+/*
+ * Wait for the GC in another thread finishes. (non-inflight)
+ */
+static void
+rt_gc_wait_for_gc(
+	struct rt_env *env)
+{
+	int spin;
+
+	spin = 0;
+	while (atomic_load_acquire(&env->vm->gc_stw_counter) > 0) {
+		/* Help the old GC marking if it is in progress. */
+		rt_gc_help_mark(env);
+
+		rt_gc_backoff(&spin);
+	}
+}
+
+/*
+ * Wait a moment in a busy wait loop. Spin first, then yield the CPU.
+ */
+static INLINE void
+rt_gc_backoff(
+	int *spin)
+{
+	if (*spin < SPIN_MAX) {
+		(*spin)++;
+		cpu_relax();
+		return;
+	}
+
+	cpu_yield();
+}
+
+/*
+ * Help the old GC marking in another thread.
+ */
+static void
+rt_gc_help_mark(
+	struct rt_env *env)
+{
+	struct rt_gc_marker m;
+
+	if (!atomic_load_acquire(&env->vm->gc.mark_open))
+		return;
+
+	/* Join as a busy thread. */
+	MARK_LOCK(env);
+	if (!env->vm->gc.mark_open) {
+		MARK_UNLOCK(env);
+		return;
+	}
+	env->vm->gc.mark_busy++;
+	env->vm->gc.mark_helpers++;
+	MARK_UNLOCK(env);
+
+	/* Scan the shared packets until the marking is finished. */
+	m.cur = NULL;
+	rt_gc_mark_drain(env, &m);
+
+	/* Leave. */
+	MARK_LOCK(env);
+	env->vm->gc.mark_helpers--;
+	MARK_UNLOCK(env);
+}
+
 #endif /* defined(NOCT_USE_MULTITHREAD) */
@@ -21,7 +21,12 @@
  *
  * - Tenure Region:
  *   For long-lived, or large objects. Collected using Mark-Sweep GC,
- *   and compacted using Slide Compaction.
+ *   and compacted using Slide Compaction. The Mark-Sweep GC also runs
+ *   incrementally, in small slices, using tri-color marking.
+ *   The stop-the-world marking uses an explicit mark stack, and the
+ *   threads waiting at GC safe points help it in multithread builds.
+ *   Blocks are managed by a two-level segregated fit allocator that
+ *   allocates and frees in O(1), and coalesces free neighbors.
  *
  * - Remember Set:
  *   Tracks tenure-region arrays or dictionaries that reference
@@ -65,6 +70,23 @@
  */
 #define RT_GC_DEFAULT_PROMOTION_THRESHOLD	(2)
 
+/*
+ * Incremental GC Trigger - An incremental old GC cycle starts when the
+ * tenure usage reaches this value, or twice the live size after the
+ * last cycle.
+ */
+#define RT_GC_DEFAULT_INCREMENTAL_TRIGGER	(4 * 1024 * 1024)
+
+/*
+ * Tenure Pressure - When the tenure free space is less than this
+ * multiple of the young generation usage, each young GC advances the
+ * incremental old GC cycle, at a pace that finishes the cycle before
+ * a promotion runs out of the tenure space, and by the minimum steps
+ * below at least.
+ */
+#define RT_GC_PRESSURE_RATIO			(4)
+#define RT_GC_PRESSURE_MIN_STEPS		(4096)
+
 /*
  * Regions.
  */
@@ -84,12 +106,80 @@ enum rt_gc_object_type {
 	RT_GC_TYPE_FUNC,
 };
 
+/*
+ * Incremental GC Phases.
+ */
+enum rt_gc_incremental_phase {
+	RT_GC_PHASE_IDLE,
+	RT_GC_PHASE_MARK,
+	RT_GC_PHASE_SWEEP,
+};
+
+/*
+ * Tri-Color Marking Colors. (for the tenure objects)
+ *  - White: not visited yet, freed at the sweep phase
+ *  - Gray: visited, in the gray stack, and its children are not scanned yet
+ *  - Black: visited, and its children are scanned
+ */
+enum rt_gc_color {
+	RT_GC_COLOR_WHITE,
+	RT_GC_COLOR_GRAY,
+	RT_GC_COLOR_BLACK,
+};
+
 /*
  * Free List Constants.
+ *
+ * Each tenure block has a size_t header that holds the payload size
+ * and two flag bits. A free block additionally stores the links of
+ * its size class list at the payload top, and its size at the
+ * payload end (a boundary tag) so that the next block can find it.
  */
 #define RT_GC_FREELIST_ALIGN		(sizeof(void *))
 #define RT_GC_FREELIST_USED_BIT		0x1
-#define RT_GC_FREELIST_SIZE_MASK	(~(size_t)1)
+#define RT_GC_FREELIST_PREV_FREE_BIT	0x2
+#define RT_GC_FREELIST_SIZE_MASK	(~(size_t)3)
+#define RT_GC_FREELIST_MIN_SIZE		(2 * sizeof(void *) + sizeof(size_t))
+
+/*
+ * Size Classes.
+ *
+ * A free block size is first classified by its MSB position (the
+ * first level), and then split linearly into 2^SL_LOG2 classes (the
+ * second level).
+ */
+#define RT_GC_FREELIST_SL_LOG2		4
+#define RT_GC_FREELIST_SL_COUNT		(1 << RT_GC_FREELIST_SL_LOG2)
+#define RT_GC_FREELIST_FL_COUNT		32
+
+/*
+ * Free block in the tenure region.
+ */
+struct rt_gc_free_block {
+	/* Block header. (size and flags) */
+	size_t header;
+
+	/* Links of the size class list. */
+	struct rt_gc_free_block *next;
+	struct rt_gc_free_block *prev;
+};
+
+/*
+ * Mark Packet - A fixed-size part of the old GC mark stack.
+ *  - The mark stack is a list of packets, so that the GC threads can
+ *    share the work by passing packets.
+ */
+#define RT_GC_MARK_PACKET_SIZE	256
+
+struct rt_gc_mark_packet {
+	struct rt_gc_mark_packet *next;
+
+	/* Number of the objects to scan. */
+	uint32_t count;
+
+	/* Marked objects whose children are not scanned yet. */
+	struct rt_gc_object *obj[RT_GC_MARK_PACKET_SIZE];
+};
 
 /*
  * Garbage Collector state structure that is embedded to struct rt_vm.
@@ -110,6 +200,17 @@ struct rt_gc_info {
 	struct freelist {
 		char *top;
 		char *end;
+
+		/* Bitmaps of non-empty size classes. */
+		uint32_t fl_bitmap;
+		uint32_t sl_bitmap[RT_GC_FREELIST_FL_COUNT];
+
+		/* Heads of the size class lists. */
+		struct rt_gc_free_block *head[RT_GC_FREELIST_FL_COUNT][RT_GC_FREELIST_SL_COUNT];
+
+		/* Statistics. */
+		size_t free_size;
+		size_t free_count;
 	} tenure_freelist;
 
 	/* Linked list of objects in the nursery generation. */
@@ -121,6 +222,7 @@ struct rt_gc_info {
 
 	/* Linked list of objects in the tenure generation. */
 	struct rt_gc_object *tenure_list;
+	size_t tenure_count;
 
 	/* Linked list of the remember set. */
 	struct rt_gc_object *remember_set;
@@ -129,6 +231,29 @@ struct rt_gc_info {
 	uint32_t compact_count;
 	void **compact_before;
 	void **compact_after;
+
+	/* Incremental old GC state. */
+	int inc_phase;
+	int inc_steps;
+	int inc_debt;
+	size_t inc_trigger;
+	struct rt_gc_object **gray_stack;
+	size_t gray_count;
+	size_t gray_alloc;
+	struct rt_gc_object *sweep_cursor;
+
+	/* Old GC mark stack. (packets to scan, and free packets) */
+	struct rt_gc_mark_packet *mark_full;
+	struct rt_gc_mark_packet *mark_free;
+	bool mark_overflow;
+
+#if defined(NOCT_USE_MULTITHREAD)
+	/* Parallel marking state. (protected by mark_lock) */
+	int mark_lock;
+	int mark_open;
+	int mark_busy;
+	int mark_helpers;
+#endif
 };
 
 /*
@@ -168,6 +293,9 @@ struct rt_gc_object {
 	/* Mark bit used in mark-and-sweep GC for the tenure generation. */
 	bool is_marked;
 
+	/* Color used in the incremental old GC. (tenure objects only) */
+	int color;
+
 	/* Promotion count. */
 	uint32_t promotion_count;
 
@@ -179,20 +307,22 @@ struct rt_gc_object {
  * The following functions are part of the GC interface used by runtime.c.
  */
 
+struct rt_shape;
+
 /* Initializes the garbage collector and allocate memory regions. */
 bool rt_gc_init(struct rt_vm *vm);
 
 /* Cleanups the garbage collector and deallocate memory regions. */
 void rt_gc_cleanup(struct rt_vm *vm);
 
-/* Allocates a string object in the appropriate region. */
+/* Allocates a string object in the appropriate region. (If data is NULL, only the NUL is written.) */
 struct rt_string *rt_gc_alloc_string(struct rt_env *env, const char *data, size_t len, uint32_t hash);
 
 /* Allocates an array object in the appropriate region. */
 struct rt_array *rt_gc_alloc_array(struct rt_env *env, size_t size);
 
-/* Allocates a dictionary object in the appropriate region. */
-struct rt_dict *rt_gc_alloc_dict(struct rt_env *env, size_t size);
+/* Allocates a dictionary object in the appropriate region. (If shape is not NULL, a shaped one without keys.) */
+struct rt_dict *rt_gc_alloc_dict(struct rt_env *env, size_t size, struct rt_shape *shape);
 
 /* Write barrier: registers a container in the remember set if it references a young object. */
 void rt_gc_array_write_barrier(struct rt_env *env, struct rt_array *arr, uint32_t index, struct rt_value *val);
@@ -215,6 +345,9 @@ bool rt_gc_unpin_local(struct rt_env *env, struct rt_value *val);
 /* Retrieves the approximate memory usage, in bytes. */
 bool rt_gc_get_heap_usage(struct rt_env *env, size_t *ret);
 
+/* Retrieves the free space statistics of the tenure region. */
+bool rt_gc_get_heap_stats(struct rt_env *env, size_t *free_size, size_t *largest_free_size, size_t *free_count);
+
 /* Manually triggers a young GC. (nursery + graduate, copying GC) */
 void rt_gc_level1_gc(struct rt_env *env);
 
@@ -224,6 +357,9 @@ void rt_gc_level2_gc(struct rt_env *env);
 /* Manually triggers a full GC. (tenure, nursery + graduate) */
 void rt_gc_level3_gc(struct rt_env *env);
 
+/* Runs a slice of the incremental old GC. Returns true if a cycle is in progress. */
+bool rt_gc_incremental_gc(struct rt_env *env, int steps);
+
 /*
  * Multithread Support
  */
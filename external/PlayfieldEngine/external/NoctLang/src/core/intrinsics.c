@@ -33,9 +33,11 @@ static bool rt_intrin_charCount(NoctEnv *env);
 static bool rt_intrin_charAt(NoctEnv *env);
 static bool rt_intrin_substring(NoctEnv *env);
 static bool rt_intrin_indexOf(NoctEnv *env);
+static bool rt_intrin_join(NoctEnv *env);
 static bool rt_intrin_fast_gc(NoctEnv *env);
 static bool rt_intrin_full_gc(NoctEnv *env);
 static bool rt_intrin_compact_gc(NoctEnv *env);
+static bool rt_intrin_incremental_gc(NoctEnv *env);
 
 struct intrin_item {
 	const char *field_name;
@@ -57,11 +59,13 @@ struct intrin_item {
 	{"charAt",     "__charAt",    2, {"this", "index"       }, rt_intrin_charAt,     true,  NULL},
 	{"substring",  "__substring", 3, {"this", "start", "len"}, rt_intrin_substring,  true,  NULL},
 	{"indexOf",    "__indexOf",   2, {"this", "str"         }, rt_intrin_indexOf,    true,  NULL},
+	{"join",       "__join",      2, {"this", "sep"         }, rt_intrin_join,       true,  NULL},
 	{"isset",      "__isset",     2, {"this", "key"         }, rt_intrin_isset,      true,  NULL},
 	{"unset",      "__unset",     2, {"this", "key"         }, rt_intrin_unset,      true,  NULL},
 	{"fast_gc",    "fast_gc",     0, {NULL},                   rt_intrin_fast_gc,    false, NULL},
 	{"full_gc",    "full_gc",     0, {NULL},                   rt_intrin_full_gc,    false, NULL},
 	{"compact_gc", "compact_gc",  0, {NULL},                   rt_intrin_compact_gc, true,  NULL},
+	{"incremental_gc", "incremental_gc", 1, {"steps"},         rt_intrin_incremental_gc, false, NULL},
 };
 
 size_t get_string_length(const char *text);
@@ -571,6 +575,81 @@ rt_intrin_indexOf(
 	return true;
 }
 
+/* join() */
+static bool
+rt_intrin_join(
+	NoctEnv *env)
+{
+	NoctValue arr, sep, elem, ret;
+	const char *sep_s;
+	char num[RT_NUMBER_BUF_SIZE];
+	char *tmp;
+	uint32_t size, i;
+	size_t sep_len, total, ofs, len;
+	int pass;
+
+	if (!noct_get_arg_check_array(env, 0, &arr))
+		return false;
+	if (!noct_get_arg_check_string(env, 1, &sep, &sep_s))
+		return false;
+	if (!noct_get_array_size(env, &arr, &size))
+		return false;
+
+	/* Pass 0 measures the total length, pass 1 copies. */
+	sep_len = strlen(sep_s);
+	total = 0;
+	tmp = NULL;
+	for (pass = 0; pass < 2; pass++) {
+		ofs = 0;
+		for (i = 0; i < size; i++) {
+			if (!noct_get_array_elem(env, &arr, i, &elem)) {
+				noct_free(tmp);
+				return false;
+			}
+
+			if (i > 0) {
+				if (tmp != NULL)
+					memcpy(tmp + ofs, sep_s, sep_len);
+				ofs += sep_len;
+			}
+
+			if (elem.type == NOCT_VALUE_STRING) {
+				len = elem.val.str->len - 1;
+				if (tmp != NULL)
+					memcpy(tmp + ofs, elem.val.str->data, len);
+			} else if (elem.type == NOCT_VALUE_INT || elem.type == NOCT_VALUE_FLOAT) {
+				len = rt_format_number(&elem, num);
+				if (tmp != NULL)
+					memcpy(tmp + ofs, num, len);
+			} else {
+				noct_free(tmp);
+				noct_error(env, N_TR("Value is not a number or a string."));
+				return false;
+			}
+			ofs += len;
+		}
+
+		if (pass == 0) {
+			total = ofs;
+			tmp = noct_malloc(total + 1);
+			if (tmp == NULL) {
+				rt_out_of_memory(env);
+				return false;
+			}
+		}
+	}
+	tmp[total] = '\0';
+
+	if (!noct_set_return_make_string(env, &ret, tmp)) {
+		noct_free(tmp);
+		return false;
+	}
+
+	noct_free(tmp);
+
+	return true;
+}
+
 /* Get a top character of a utf-8 string as a utf-32. */
 static int utf8_to_utf32(const char *mbs, uint32_t *wc)
 {
@@ -717,3 +796,23 @@ rt_intrin_compact_gc(
 	noct_compact_gc(env);
 	return true;
 }
+
+/* incremental_gc() */
+static bool
+rt_intrin_incremental_gc(
+	NoctEnv *env)
+{
+	struct rt_value steps, ret;
+	int steps_i;
+
+	noct_pin_local(env, 2, &steps, &ret);
+
+	if (!noct_get_arg_check_int(env, 0, &steps, &steps_i))
+		return false;
+
+	/* Returns 1 if a cycle is in progress. */
+	if (!noct_set_return_make_int(env, &ret, noct_incremental_gc(env, steps_i) ? 1 : 0))
+		return false;
+
+	return true;
+}
@@ -29,6 +29,7 @@
 #define PATCH_BAL                       0
 #define PATCH_BEQ                       1
 #define PATCH_BNE                       2
+#define PATCH_BCOND                     3
 
 /* Generated code. */
 static uint32_t *jit_code_region;
@@ -446,6 +447,149 @@ jit_put_bne(
         return true;
 }
 
+/* ldr wN / str wN / ldr sN / str sN with an unsigned offset */
+#define LDR_W_IMM(rt, rn, imm)          if (!jit_put_ldst32(ctx, 0xb9400000, rt, rn, imm)) return false
+#define STR_W_IMM(rt, rn, imm)          if (!jit_put_ldst32(ctx, 0xb9000000, rt, rn, imm)) return false
+#define LDR_S_IMM(rt, rn, imm)          if (!jit_put_ldst32(ctx, 0xbd400000, rt, rn, imm)) return false
+#define STR_S_IMM(rt, rn, imm)          if (!jit_put_ldst32(ctx, 0xbd000000, rt, rn, imm)) return false
+static bool
+jit_put_ldst32(
+        struct jit_context *ctx,
+        uint32_t op,
+        uint32_t rt,
+        uint32_t rn,
+        uint32_t imm)
+{
+        if (!jit_put_word(ctx,
+                          op |                          /* ldr/str */
+                          rt |                          /* rt */
+                          (rn << 5) |                   /* rn */
+                          (((imm / 4) & 0xfff) << 10))) /* imm */
+                return false;
+        return true;
+}
+
+/* Three-register operations (32-bit) */
+#define ORR_W(rd, rn, rm)               if (!jit_put_rrr(ctx, 0x2a000000, rd, rn, rm)) return false
+#define ADD_W(rd, rn, rm)               if (!jit_put_rrr(ctx, 0x0b000000, rd, rn, rm)) return false
+#define SUB_W(rd, rn, rm)               if (!jit_put_rrr(ctx, 0x4b000000, rd, rn, rm)) return false
+#define MUL_W(rd, rn, rm)               if (!jit_put_rrr(ctx, 0x1b007c00, rd, rn, rm)) return false
+#define CMP_W(rn, rm)                   if (!jit_put_rrr(ctx, 0x6b00001f, 0, rn, rm)) return false
+#define FADD_S(rd, rn, rm)              if (!jit_put_rrr(ctx, 0x1e202800, rd, rn, rm)) return false
+#define FSUB_S(rd, rn, rm)              if (!jit_put_rrr(ctx, 0x1e203800, rd, rn, rm)) return false
+#define FMUL_S(rd, rn, rm)              if (!jit_put_rrr(ctx, 0x1e200800, rd, rn, rm)) return false
+#define FCMP_S(rn, rm)                  if (!jit_put_rrr(ctx, 0x1e202000, 0, rn, rm)) return false
+static bool
+jit_put_rrr(
+        struct jit_context *ctx,
+        uint32_t op,
+        uint32_t rd,
+        uint32_t rn,
+        uint32_t rm)
+{
+        if (!jit_put_word(ctx,
+                          op |          /* op */
+                          rd |          /* rd */
+                          (rn << 5) |   /* rn */
+                          (rm << 16)))  /* rm */
+                return false;
+        return true;
+}
+
+/* cmp wN, #imm */
+#define CMP_W_IMM(rn, imm)              if (!jit_put_cmp_w_imm(ctx, rn, imm)) return false
+static bool
+jit_put_cmp_w_imm(
+        struct jit_context *ctx,
+        uint32_t rn,
+        uint32_t imm)
+{
+        if (!jit_put_word(ctx,
+                          0x7100001f |                  /* cmp */
+                          (rn << 5) |                   /* rn */
+                          ((imm & 0xfff) << 10)))       /* imm */
+                return false;
+        return true;
+}
+
+/* cset wN, cond */
+#define CSET_W(rd, cond)                if (!jit_put_cset_w(ctx, rd, cond)) return false
+static bool
+jit_put_cset_w(
+        struct jit_context *ctx,
+        uint32_t rd,
+        uint32_t cond)
+{
+        if (!jit_put_word(ctx,
+                          0x1a9f07e0 |                  /* csinc wzr, wzr */
+                          rd |                          /* rd */
+                          ((cond ^ 1) << 12)))          /* inverted cond */
+                return false;
+        return true;
+}
+
+/* movz wN, #imm */
+#define MOVZ_W(rd, imm)                 if (!jit_put_movz_w(ctx, rd, imm)) return false
+static bool
+jit_put_movz_w(
+        struct jit_context *ctx,
+        uint32_t rd,
+        uint32_t imm)
+{
+        if (!jit_put_word(ctx,
+                          0x52800000 |                  /* movz */
+                          rd |                          /* rd */
+                          ((imm & 0xffff) << 5)))       /* imm */
+                return false;
+        return true;
+}
+
+/* cbnz wN, rel */
+#define CBNZ_W(rt, rel)                 if (!jit_put_cbnz_w(ctx, rt, rel)) return false
+static INLINE bool
+jit_put_cbnz_w(
+        struct jit_context *ctx,
+        uint32_t rt,
+        uint32_t rel)
+{
+        if (!jit_put_word(ctx,
+                          0x35000000 |                                  /* cbnz */
+                          rt |                                          /* rt */
+                          ((((uint32_t)(rel / 4)) & 0x7ffff) << 5)))    /* rel */
+                return false;
+        return true;
+}
+
+/* b.cond */
+#define BCOND(cond, rel)                if (!jit_put_bcond(ctx, cond, rel)) return false
+static INLINE bool
+jit_put_bcond(
+        struct jit_context *ctx,
+        uint32_t cond,
+        uint32_t rel)
+{
+        if (!jit_put_word(ctx,
+                          0x54000000 |                                  /* b.cond */
+                          (cond & 0xf) |                                /* cond */
+                          ((((uint32_t)(rel / 4)) & 0x7ffff) << 5)))    /* rel */
+                return false;
+        return true;
+}
+
+/* b */
+#define B(rel)                          if (!jit_put_b(ctx, rel)) return false
+static INLINE bool
+jit_put_b(
+        struct jit_context *ctx,
+        uint32_t rel)
+{
+        if (!jit_put_word(ctx,
+                          0x14000000 |                                  /* b */
+                          (((uint32_t)(rel / 4)) & 0x3ffffff)))         /* rel */
+                return false;
+        return true;
+}
+
 /* BLR */
 #define BLR(rd)                         if (!jit_put_blr(ctx, rd)) return false
 static INLINE bool
@@ -539,6 +683,298 @@ jit_put_ret(
                 BEQ             (IMM19((uint64_t)ctx->exception_code - (uint64_t)ctx->code));           \
         }
 
+/*
+ * Fast paths
+ */
+
+/* Condition codes. */
+#define COND_NONE               (-1)
+#define COND_EQ                 0x0
+#define COND_NE                 0x1
+#define COND_MI                 0x4
+#define COND_LS                 0x9
+#define COND_GE                 0xa
+#define COND_LT                 0xb
+#define COND_GT                 0xc
+#define COND_LE                 0xd
+
+/* Negate a condition code. */
+#define COND_NOT(cond)          ((cond) ^ 1)
+
+/* Resolve a forward cbnz/b.cond at p to the current code position. */
+static INLINE void
+jit_resolve_imm19(
+        struct jit_context *ctx,
+        uint32_t *p)
+{
+        uint32_t rel;
+
+        rel = (uint32_t)((uint8_t *)ctx->code - (uint8_t *)p);
+        *p |= ((rel / 4) & 0x7ffff) << 5;
+}
+
+/* Resolve a forward b at p to the current code position. */
+static INLINE void
+jit_resolve_imm26(
+        struct jit_context *ctx,
+        uint32_t *p)
+{
+        uint32_t rel;
+
+        rel = (uint32_t)((uint8_t *)ctx->code - (uint8_t *)p);
+        *p |= (rel / 4) & 0x3ffffff;
+}
+
+/*
+ * Put the operand addresses for a fast path.
+ *  - x2 = &tmpvar[dst], x3 = &tmpvar[src1], x4 = &tmpvar[src2]
+ *  - w5 = type of src1, w6 = type of src2, w7 = w5 | w6
+ */
+static bool
+jit_put_fast_path_operands(
+        struct jit_context *ctx,
+        int dst,
+        int src1,
+        int src2)
+{
+        ASM {
+                /* x0 = env */
+                /* x1 = &env->frame->tmpvar[0] */
+
+                MOVZ            (REG_X2, IMM16(dst * (int)sizeof(struct rt_value)), LSL_0);
+                ADD             (REG_X2, REG_X2, REG_X1);
+                MOVZ            (REG_X3, IMM16(src1 * (int)sizeof(struct rt_value)), LSL_0);
+                ADD             (REG_X3, REG_X3, REG_X1);
+                MOVZ            (REG_X4, IMM16(src2 * (int)sizeof(struct rt_value)), LSL_0);
+                ADD             (REG_X4, REG_X4, REG_X1);
+
+                /* Both ints? (NOCT_VALUE_INT is zero.) */
+                LDR_W_IMM       (REG_X5, REG_X3, 0);
+                LDR_W_IMM       (REG_X6, REG_X4, 0);
+                ORR_W           (REG_X7, REG_X5, REG_X6);
+        }
+
+        return true;
+}
+
+/*
+ * Put an arithmetic operation with inline int+int and float+float paths.
+ *  - Other type combinations fall back to the C helper f.
+ */
+static bool
+jit_put_arith_fast_path(
+        struct jit_context *ctx,
+        int dst,
+        int src1,
+        int src2,
+        uint32_t int_op,
+        uint32_t float_op,
+        uint64_t f)
+{
+        uint32_t *not_int, *slow1, *slow2, *done1, *done2;
+
+        if (!jit_put_fast_path_operands(ctx, dst, src1, src2))
+                return false;
+
+        not_int = ctx->code;
+        ASM {
+                CBNZ_W          (REG_X7, 0);
+
+                /* int op int */
+                LDR_W_IMM       (REG_X5, REG_X3, 8);
+                LDR_W_IMM       (REG_X6, REG_X4, 8);
+        }
+        if (!jit_put_rrr(ctx, int_op, REG_X5, REG_X5, REG_X6))
+                return false;
+        ASM {
+                STR_W_IMM       (REG_XZR, REG_X2, 0);
+                STR_W_IMM       (REG_X5, REG_X2, 8);
+        }
+        done1 = ctx->code;
+        ASM {
+                B               (0);
+        }
+
+        /* not_int: Both floats? */
+        jit_resolve_imm19(ctx, not_int);
+        ASM {
+                CMP_W_IMM       (REG_X5, NOCT_VALUE_FLOAT);
+        }
+        slow1 = ctx->code;
+        ASM {
+                BNE             (0);
+                CMP_W_IMM       (REG_X6, NOCT_VALUE_FLOAT);
+        }
+        slow2 = ctx->code;
+        ASM {
+                BNE             (0);
+
+                /* float op float */
+                LDR_S_IMM       (0, REG_X3, 8);
+                LDR_S_IMM       (1, REG_X4, 8);
+        }
+        if (!jit_put_rrr(ctx, float_op, 0, 0, 1))
+                return false;
+        ASM {
+                MOVZ_W          (REG_X5, NOCT_VALUE_FLOAT);
+                STR_W_IMM       (REG_X5, REG_X2, 0);
+                STR_S_IMM       (0, REG_X2, 8);
+        }
+        done2 = ctx->code;
+        ASM {
+                B               (0);
+        }
+
+        /* slow: */
+        jit_resolve_imm19(ctx, slow1);
+        jit_resolve_imm19(ctx, slow2);
+        ASM_BINARY_OP(f);
+
+        /* done: */
+        jit_resolve_imm26(ctx, done1);
+        jit_resolve_imm26(ctx, done2);
+
+        return true;
+}
+
+/*
+ * Put the tail of a comparison fast path.
+ *  - If fused, branch on the flags and skip the following jump.
+ *  - Otherwise, jump to done, which is returned in *done for resolving.
+ */
+static bool
+jit_put_fused_branch(
+        struct jit_context *ctx,
+        bool is_fused,
+        bool is_true,
+        int cond,
+        uint32_t target_lpc,
+        uint32_t next_lpc,
+        uint32_t **done)
+{
+        if (!is_fused) {
+                *done = ctx->code;
+                ASM {
+                        B               (0);
+                }
+                return true;
+        }
+
+        /* Branch to the target by the flags. (Patch later.) */
+        ctx->branch_patch[ctx->branch_patch_count].code = ctx->code;
+        ctx->branch_patch[ctx->branch_patch_count].lpc = target_lpc;
+        ctx->branch_patch[ctx->branch_patch_count].type = PATCH_BCOND;
+        ctx->branch_patch_count++;
+        ASM {
+                BCOND           ((uint32_t)(is_true ? cond : COND_NOT(cond)), 0);
+        }
+
+        /* Skip the JMPIFTRUE/JMPIFFALSE. (Patch later.) */
+        ctx->branch_patch[ctx->branch_patch_count].code = ctx->code;
+        ctx->branch_patch[ctx->branch_patch_count].lpc = next_lpc;
+        ctx->branch_patch[ctx->branch_patch_count].type = PATCH_BAL;
+        ctx->branch_patch_count++;
+        ASM {
+                BAL             (0);
+        }
+
+        *done = NULL;
+        return true;
+}
+
+/*
+ * Put a comparison with inline int-int and float-float paths.
+ *  - int_cond is the condition after cmp, float_cond after fcmp.
+ *    (COND_NONE for no float path)
+ *  - If a JMPIFTRUE/JMPIFFALSE on dst follows, branch on the flags.
+ */
+static bool
+jit_put_cmp_fast_path(
+        struct jit_context *ctx,
+        int dst,
+        int src1,
+        int src2,
+        int int_cond,
+        int float_cond,
+        uint64_t f)
+{
+        uint32_t *not_int, *slow1, *slow2, *done1, *done2;
+        uint32_t target_lpc, next_lpc;
+        bool is_fused, is_true;
+
+        /* Check for a following conditional branch. */
+        is_fused = false;
+        is_true = false;
+        target_lpc = 0;
+        next_lpc = 0;
+        if (ctx->branch_patch_count + 5 <= BRANCH_PATCH_MAX)
+                is_fused = jit_peek_cond_branch(ctx, dst, &is_true, &target_lpc, &next_lpc);
+
+        if (!jit_put_fast_path_operands(ctx, dst, src1, src2))
+                return false;
+
+        not_int = ctx->code;
+        ASM {
+                CBNZ_W          (REG_X7, 0);
+
+                /* int cmp int */
+                LDR_W_IMM       (REG_X5, REG_X3, 8);
+                LDR_W_IMM       (REG_X6, REG_X4, 8);
+                CMP_W           (REG_X5, REG_X6);
+                CSET_W          (REG_X5, (uint32_t)int_cond);
+                STR_W_IMM       (REG_XZR, REG_X2, 0);
+                STR_W_IMM       (REG_X5, REG_X2, 8);
+        }
+        if (!jit_put_fused_branch(ctx, is_fused, is_true, int_cond, target_lpc, next_lpc, &done1))
+                return false;
+
+        /* not_int: */
+        jit_resolve_imm19(ctx, not_int);
+        slow1 = NULL;
+        slow2 = NULL;
+        done2 = NULL;
+        if (float_cond != COND_NONE) {
+                /* Both floats? */
+                ASM {
+                        CMP_W_IMM       (REG_X5, NOCT_VALUE_FLOAT);
+                }
+                slow1 = ctx->code;
+                ASM {
+                        BNE             (0);
+                        CMP_W_IMM       (REG_X6, NOCT_VALUE_FLOAT);
+                }
+                slow2 = ctx->code;
+                ASM {
+                        BNE             (0);
+
+                        /* float cmp float (unordered is false for MI/LS/GT/GE) */
+                        LDR_S_IMM       (0, REG_X3, 8);
+                        LDR_S_IMM       (1, REG_X4, 8);
+                        FCMP_S          (0, 1);
+                        CSET_W          (REG_X5, (uint32_t)float_cond);
+                        STR_W_IMM       (REG_XZR, REG_X2, 0);
+                        STR_W_IMM       (REG_X5, REG_X2, 8);
+                }
+                if (!jit_put_fused_branch(ctx, is_fused, is_true, float_cond, target_lpc, next_lpc, &done2))
+                        return false;
+        }
+
+        /* slow: */
+        if (slow1 != NULL) {
+                jit_resolve_imm19(ctx, slow1);
+                jit_resolve_imm19(ctx, slow2);
+        }
+        ASM_BINARY_OP(f);
+
+        /* done: (If fused, the following JMPIFTRUE/JMPIFFALSE tests dst.) */
+        if (done1 != NULL)
+                jit_resolve_imm26(ctx, done1);
+        if (done2 != NULL)
+                jit_resolve_imm26(ctx, done2);
+
+        return true;
+}
+
 /*
  * Bytecode visitors
  */
@@ -857,7 +1293,8 @@ jit_visit_add_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_add_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_add_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0x0b000000, 0x1e202800, (uint64_t)ex_add_helper))
+                return false;
 
         return true;
 }
@@ -876,7 +1313,8 @@ jit_visit_sub_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_sub_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_sub_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0x4b000000, 0x1e203800, (uint64_t)ex_sub_helper))
+                return false;
 
         return true;
 }
@@ -895,7 +1333,8 @@ jit_visit_mul_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_mul_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_mul_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0x1b007c00, 0x1e200800, (uint64_t)ex_mul_helper))
+                return false;
 
         return true;
 }
@@ -1081,7 +1520,8 @@ jit_visit_lt_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_lt_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_lt_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_LT, COND_MI, (uint64_t)ex_lt_helper))
+                return false;
 
         return true;
 }
@@ -1100,7 +1540,8 @@ jit_visit_lte_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_lte_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_lte_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_LE, COND_LS, (uint64_t)ex_lte_helper))
+                return false;
 
         return true;
 }
@@ -1119,7 +1560,8 @@ jit_visit_eq_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_eq_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_eq_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_EQ, COND_NONE, (uint64_t)ex_eq_helper))
+                return false;
 
         return true;
 }
@@ -1138,7 +1580,8 @@ jit_visit_neq_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_neq_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_neq_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_NE, COND_NONE, (uint64_t)ex_neq_helper))
+                return false;
 
         return true;
 }
@@ -1157,7 +1600,8 @@ jit_visit_gte_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_gte_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_gte_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_GE, COND_GE, (uint64_t)ex_gte_helper))
+                return false;
 
         return true;
 }
@@ -1176,7 +1620,8 @@ jit_visit_gt_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_gt_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_gt_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, COND_GT, COND_GT, (uint64_t)ex_gt_helper))
+                return false;
 
         return true;
 }
@@ -2198,6 +2643,15 @@ jit_patch_branch(
                 ASM {
                         BNE     (IMM19(offset));
                 }
+        } else if (ctx->branch_patch[patch_index].type == PATCH_BCOND) {
+                uint32_t cond;
+
+                /* Keep the condition. */
+                cond = *(uint32_t *)ctx->code & 0xf;
+
+                ASM {
+                        BCOND   (cond, IMM19(offset));
+                }
         }
 
         return true;
@@ -41,6 +41,7 @@
 #define PATCH_JMP               0
 #define PATCH_JE                1
 #define PATCH_JNE               2
+#define PATCH_JCC               3
 
 /* Generated code. */
 static uint8_t *jit_code_region;
@@ -308,6 +309,287 @@ jit_put_qword(
         }                                                                                                           \
     }
 
+/*
+ * Fast paths
+ */
+
+/* Condition codes. (low nibble of jcc/setcc) */
+#define CC_NONE                 (-1)
+#define CC_B                    0x2
+#define CC_AE                   0x3
+#define CC_E                    0x4
+#define CC_NE                   0x5
+#define CC_BE                   0x6
+#define CC_A                    0x7
+#define CC_L                    0xc
+#define CC_GE                   0xd
+#define CC_LE                   0xe
+#define CC_G                    0xf
+
+/* Negate a condition code. */
+#define CC_NOT(cc)              ((cc) ^ 1)
+
+/* Resolve a forward rel32 that ends at rel_end to the current code position. */
+static INLINE void
+jit_resolve_rel32(
+        struct jit_context *ctx,
+        uint8_t *rel_end)
+{
+        uint32_t rel;
+
+        rel = (uint32_t)((uint8_t *)ctx->code - rel_end);
+        rel_end[-4] = (uint8_t)(rel & 0xff);
+        rel_end[-3] = (uint8_t)((rel >> 8) & 0xff);
+        rel_end[-2] = (uint8_t)((rel >> 16) & 0xff);
+        rel_end[-1] = (uint8_t)((rel >> 24) & 0xff);
+}
+
+/*
+ * Put an arithmetic operation with inline int+int and float+float paths.
+ *  - Other type combinations fall back to the C helper f.
+ */
+static bool
+jit_put_arith_fast_path(
+        struct jit_context *ctx,
+        int dst,
+        int src1,
+        int src2,
+        uint8_t int_op,
+        uint8_t float_op,
+        uint64_t f)
+{
+        uint8_t *not_int, *slow1, *slow2, *done1, *done2;
+        uint32_t d, s1, s2;
+
+        d = (uint32_t)dst * (uint32_t)sizeof(struct rt_value);
+        s1 = (uint32_t)src1 * (uint32_t)sizeof(struct rt_value);
+        s2 = (uint32_t)src2 * (uint32_t)sizeof(struct rt_value);
+
+        ASM {
+                /* r13: exception_handler */
+                /* r14: env */
+                /* r15: &env->frame->tmpvar[0] */
+
+                /* Both ints? (NOCT_VALUE_INT is zero.) */
+                /* movl s1(%r15), %eax */        IB(0x41); IB(0x8b); IB(0x87); ID(s1);
+                /* orl s2(%r15), %eax */         IB(0x41); IB(0x0b); IB(0x87); ID(s2);
+                /* jne not_int */                IB(0x0f); IB(0x85); ID(0);
+        }
+        not_int = ctx->code;
+
+        ASM {
+                /* movl s1+8(%r15), %eax */      IB(0x41); IB(0x8b); IB(0x87); ID(s1 + 8);
+        }
+        if (int_op == 0xaf) {
+                ASM {
+                /* imull s2+8(%r15), %eax */     IB(0x41); IB(0x0f); IB(0xaf); IB(0x87); ID(s2 + 8);
+                }
+        } else {
+                ASM {
+                /* addl/subl s2+8(%r15), %eax */ IB(0x41); IB(int_op); IB(0x87); ID(s2 + 8);
+                }
+        }
+        ASM {
+                /* movl $0, d(%r15) */           IB(0x41); IB(0xc7); IB(0x87); ID(d); ID(NOCT_VALUE_INT);
+                /* movl %eax, d+8(%r15) */       IB(0x41); IB(0x89); IB(0x87); ID(d + 8);
+                /* jmp done */                   IB(0xe9); ID(0);
+        }
+        done1 = ctx->code;
+
+        /* not_int: */
+        jit_resolve_rel32(ctx, not_int);
+        ASM {
+                /* Both floats? */
+                /* cmpl $1, s1(%r15) */          IB(0x41); IB(0x83); IB(0xbf); ID(s1); IB(NOCT_VALUE_FLOAT);
+                /* jne slow */                   IB(0x0f); IB(0x85); ID(0);
+        }
+        slow1 = ctx->code;
+        ASM {
+                /* cmpl $1, s2(%r15) */          IB(0x41); IB(0x83); IB(0xbf); ID(s2); IB(NOCT_VALUE_FLOAT);
+                /* jne slow */                   IB(0x0f); IB(0x85); ID(0);
+        }
+        slow2 = ctx->code;
+        ASM {
+                /* movss s1+8(%r15), %xmm0 */    IB(0xf3); IB(0x41); IB(0x0f); IB(0x10); IB(0x87); ID(s1 + 8);
+                /* op s2+8(%r15), %xmm0 */       IB(0xf3); IB(0x41); IB(0x0f); IB(float_op); IB(0x87); ID(s2 + 8);
+                /* movl $1, d(%r15) */           IB(0x41); IB(0xc7); IB(0x87); ID(d); ID(NOCT_VALUE_FLOAT);
+                /* movss %xmm0, d+8(%r15) */     IB(0xf3); IB(0x41); IB(0x0f); IB(0x11); IB(0x87); ID(d + 8);
+                /* jmp done */                   IB(0xe9); ID(0);
+        }
+        done2 = ctx->code;
+
+        /* slow: */
+        jit_resolve_rel32(ctx, slow1);
+        jit_resolve_rel32(ctx, slow2);
+        ASM_BINARY_OP(f);
+
+        /* done: */
+        jit_resolve_rel32(ctx, done1);
+        jit_resolve_rel32(ctx, done2);
+
+        return true;
+}
+
+/*
+ * Put the tail of a comparison fast path.
+ *  - If fused, branch on the flags and skip the following jump.
+ *  - Otherwise, jump to done, which is returned in *done for resolving.
+ */
+static bool
+jit_put_fused_branch(
+        struct jit_context *ctx,
+        bool is_fused,
+        bool is_true,
+        int cc,
+        uint32_t target_lpc,
+        uint32_t next_lpc,
+        uint8_t **done)
+{
+        if (!is_fused) {
+                ASM {
+                        /* jmp done */           IB(0xe9); ID(0);
+                }
+                *done = ctx->code;
+                return true;
+        }
+
+        /* Branch to the target by the flags. (Patch later.) */
+        ctx->branch_patch[ctx->branch_patch_count].code = ctx->code;
+        ctx->branch_patch[ctx->branch_patch_count].lpc = target_lpc;
+        ctx->branch_patch[ctx->branch_patch_count].type = PATCH_JCC;
+        ctx->branch_patch_count++;
+        ASM {
+                /* jcc target */                 IB(0x0f); IB((uint8_t)(0x80 | (is_true ? cc : CC_NOT(cc)))); ID(0);
+        }
+
+        /* Skip the JMPIFTRUE/JMPIFFALSE. (Patch later.) */
+        ctx->branch_patch[ctx->branch_patch_count].code = ctx->code;
+        ctx->branch_patch[ctx->branch_patch_count].lpc = next_lpc;
+        ctx->branch_patch[ctx->branch_patch_count].type = PATCH_JMP;
+        ctx->branch_patch_count++;
+        ASM {
+                /* jmp next */                   IB(0xe9); ID(0);
+        }
+
+        *done = NULL;
+        return true;
+}
+
+/*
+ * Put a comparison with inline int-int and float-float paths.
+ *  - int_cc is the condition for signed ints.
+ *  - float_cc is the condition after ucomiss, or CC_NONE for no float path.
+ *    is_float_swap compares src2 with src1 so that "below" is never used,
+ *    which would be true for NaN.
+ *  - If a JMPIFTRUE/JMPIFFALSE on dst follows, branch on the flags.
+ */
+static bool
+jit_put_cmp_fast_path(
+        struct jit_context *ctx,
+        int dst,
+        int src1,
+        int src2,
+        int int_cc,
+        int float_cc,
+        bool is_float_swap,
+        uint64_t f)
+{
+        uint8_t *not_int, *slow1, *slow2, *done1, *done2;
+        uint32_t d, s1, s2;
+        uint32_t target_lpc, next_lpc;
+        bool is_fused, is_true;
+
+        d = (uint32_t)dst * (uint32_t)sizeof(struct rt_value);
+        s1 = (uint32_t)src1 * (uint32_t)sizeof(struct rt_value);
+        s2 = (uint32_t)src2 * (uint32_t)sizeof(struct rt_value);
+
+        /* Check for a following conditional branch. */
+        is_fused = false;
+        is_true = false;
+        target_lpc = 0;
+        next_lpc = 0;
+        if (ctx->branch_patch_count + 5 <= BRANCH_PATCH_MAX)
+                is_fused = jit_peek_cond_branch(ctx, dst, &is_true, &target_lpc, &next_lpc);
+
+        ASM {
+                /* r13: exception_handler */
+                /* r14: env */
+                /* r15: &env->frame->tmpvar[0] */
+
+                /* Both ints? (NOCT_VALUE_INT is zero.) */
+                /* movl s1(%r15), %eax */        IB(0x41); IB(0x8b); IB(0x87); ID(s1);
+                /* orl s2(%r15), %eax */         IB(0x41); IB(0x0b); IB(0x87); ID(s2);
+                /* jne not_int */                IB(0x0f); IB(0x85); ID(0);
+        }
+        not_int = ctx->code;
+
+        ASM {
+                /* movl s1+8(%r15), %eax */      IB(0x41); IB(0x8b); IB(0x87); ID(s1 + 8);
+                /* cmpl s2+8(%r15), %eax */      IB(0x41); IB(0x3b); IB(0x87); ID(s2 + 8);
+                /* setcc %al */                  IB(0x0f); IB((uint8_t)(0x90 | int_cc)); IB(0xc0);
+                /* movzbl %al, %eax */           IB(0x0f); IB(0xb6); IB(0xc0);
+                /* movl $0, d(%r15) */           IB(0x41); IB(0xc7); IB(0x87); ID(d); ID(NOCT_VALUE_INT);
+                /* movl %eax, d+8(%r15) */       IB(0x41); IB(0x89); IB(0x87); ID(d + 8);
+        }
+        if (!jit_put_fused_branch(ctx, is_fused, is_true, int_cc, target_lpc, next_lpc, &done1))
+                return false;
+
+        /* not_int: */
+        jit_resolve_rel32(ctx, not_int);
+        slow1 = NULL;
+        slow2 = NULL;
+        done2 = NULL;
+        if (float_cc != CC_NONE) {
+                ASM {
+                        /* Both floats? */
+                        /* cmpl $1, s1(%r15) */          IB(0x41); IB(0x83); IB(0xbf); ID(s1); IB(NOCT_VALUE_FLOAT);
+                        /* jne slow */                   IB(0x0f); IB(0x85); ID(0);
+                }
+                slow1 = ctx->code;
+                ASM {
+                        /* cmpl $1, s2(%r15) */          IB(0x41); IB(0x83); IB(0xbf); ID(s2); IB(NOCT_VALUE_FLOAT);
+                        /* jne slow */                   IB(0x0f); IB(0x85); ID(0);
+                }
+                slow2 = ctx->code;
+                ASM {
+                        /* movss s1+8(%r15), %xmm0 */    IB(0xf3); IB(0x41); IB(0x0f); IB(0x10); IB(0x87); ID(s1 + 8);
+                        /* movss s2+8(%r15), %xmm1 */    IB(0xf3); IB(0x41); IB(0x0f); IB(0x10); IB(0x8f); ID(s2 + 8);
+                }
+                if (is_float_swap) {
+                        ASM {
+                        /* ucomiss %xmm0, %xmm1 */       IB(0x0f); IB(0x2e); IB(0xc8);
+                        }
+                } else {
+                        ASM {
+                        /* ucomiss %xmm1, %xmm0 */       IB(0x0f); IB(0x2e); IB(0xc1);
+                        }
+                }
+                ASM {
+                        /* setcc %al */                  IB(0x0f); IB((uint8_t)(0x90 | float_cc)); IB(0xc0);
+                        /* movzbl %al, %eax */           IB(0x0f); IB(0xb6); IB(0xc0);
+                        /* movl $0, d(%r15) */           IB(0x41); IB(0xc7); IB(0x87); ID(d); ID(NOCT_VALUE_INT);
+                        /* movl %eax, d+8(%r15) */       IB(0x41); IB(0x89); IB(0x87); ID(d + 8);
+                }
+                if (!jit_put_fused_branch(ctx, is_fused, is_true, float_cc, target_lpc, next_lpc, &done2))
+                        return false;
+        }
+
+        /* slow: */
+        if (slow1 != NULL) {
+                jit_resolve_rel32(ctx, slow1);
+                jit_resolve_rel32(ctx, slow2);
+        }
+        ASM_BINARY_OP(f);
+
+        /* done: (If fused, the following JMPIFTRUE/JMPIFFALSE tests dst.) */
+        if (done1 != NULL)
+                jit_resolve_rel32(ctx, done1);
+        if (done2 != NULL)
+                jit_resolve_rel32(ctx, done2);
+
+        return true;
+}
+
 /*
  * Bytecode visitors
  */
@@ -635,7 +917,8 @@ jit_visit_add_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_add_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_add_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0x03, 0x58, (uint64_t)ex_add_helper))
+                return false;
 
         return true;
 }
@@ -654,7 +937,8 @@ jit_visit_sub_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_sub_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_sub_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0x2b, 0x5c, (uint64_t)ex_sub_helper))
+                return false;
 
         return true;
 }
@@ -673,7 +957,8 @@ jit_visit_mul_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_mul_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_mul_helper);
+        if (!jit_put_arith_fast_path(ctx, dst, src1, src2, 0xaf, 0x59, (uint64_t)ex_mul_helper))
+                return false;
 
         return true;
 }
@@ -859,7 +1144,8 @@ jit_visit_lt_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_lt_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_lt_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_L, CC_A, true, (uint64_t)ex_lt_helper))
+                return false;
 
         return true;
 }
@@ -878,7 +1164,8 @@ jit_visit_lte_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_lte_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_lte_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_LE, CC_AE, true, (uint64_t)ex_lte_helper))
+                return false;
 
         return true;
 }
@@ -897,7 +1184,8 @@ jit_visit_eq_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_eq_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_eq_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_E, CC_NONE, false, (uint64_t)ex_eq_helper))
+                return false;
 
         return true;
 }
@@ -916,7 +1204,8 @@ jit_visit_neq_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_neq_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_neq_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_NE, CC_NONE, false, (uint64_t)ex_neq_helper))
+                return false;
 
         return true;
 }
@@ -935,7 +1224,8 @@ jit_visit_gte_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_gte_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_gte_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_GE, CC_AE, false, (uint64_t)ex_gte_helper))
+                return false;
 
         return true;
 }
@@ -994,7 +1284,8 @@ jit_visit_gt_op(
         CONSUME_TMPVAR(src2);
 
         /* if (!rt_gt_helper(env, dst, src1, src2)) return false; */
-        ASM_BINARY_OP(ex_gt_helper);
+        if (!jit_put_cmp_fast_path(ctx, dst, src1, src2, CC_G, CC_A, false, (uint64_t)ex_gt_helper))
+                return false;
 
         return true;
 }
@@ -2059,6 +2350,19 @@ jit_patch_branch(
                         IB(0x85);
                         ID((uint32_t)offset);
                 }
+        } else if (ctx->branch_patch[patch_index].type == PATCH_JCC) {
+                uint8_t cc;
+
+                /* Keep the condition. */
+                cc = ((uint8_t *)ctx->code)[1];
+
+                offset -= 6;
+                ASM {
+                        /* jcc offset */
+                        IB(0x0f);
+                        IB(cc);
+                        ID((uint32_t)offset);
+                }
         }
 
         return true;
@@ -284,6 +284,55 @@ jit_get_opr_string(
 	return true;
 }
 
+/*
+ * Check if the next instruction is a JMPIFTRUE/JMPIFFALSE that tests
+ * the result of the current comparison. If so, the comparison can
+ * branch on its own flags. (fused compare-and-branch)
+ *  - The jump is still emitted as usual because it may be a branch
+ *    target. The fused path skips it by jumping to *next_lpc.
+ *  - The outputs are always set, and are zero if not fused.
+ */
+static INLINE bool
+jit_peek_cond_branch(
+	struct jit_context *ctx,
+	int dst,
+	bool *is_true,
+	uint32_t *target_lpc,
+	uint32_t *next_lpc)
+{
+	const uint8_t *p;
+	int src;
+
+	*is_true = false;
+	*target_lpc = 0;
+	*next_lpc = 0;
+
+	if (ctx->lpc + 7 > ctx->func->bytecode_size)
+		return false;
+
+	p = &ctx->func->bytecode[ctx->lpc];
+	if (p[0] != OP_JMPIFTRUE && p[0] != OP_JMPIFFALSE)
+		return false;
+
+	src = (p[1] << 8) | p[2];
+	if (src != dst)
+		return false;
+
+	*target_lpc = ((uint32_t)p[3] << 24) |
+		      ((uint32_t)p[4] << 16) |
+		      ((uint32_t)p[5] << 8) |
+		      (uint32_t)p[6];
+	if (*target_lpc >= (uint32_t)(ctx->func->bytecode_size + 1)) {
+		*target_lpc = 0;
+		return false;
+	}
+
+	*is_true = p[0] == OP_JMPIFTRUE;
+	*next_lpc = ctx->lpc + 7;
+
+	return true;
+}
+
 #endif /* defined(NOCT_USE_JIT) */
 
 #endif
@@ -80,6 +80,31 @@ noct_register_source(
 	return true;
 }
 
+NOCT_DLL
+bool
+noct_register_source_with_bytecode(
+	NoctEnv *env,
+	const char *file_name,
+	const char *source_text,
+	uint8_t **bytecode,
+	uint32_t *bytecode_size)
+{
+	size_t size;
+
+	assert(env != NULL);
+	assert(file_name != NULL);
+	assert(source_text != NULL);
+	assert(bytecode != NULL);
+	assert(bytecode_size != NULL);
+
+	if (!rt_register_source_with_bytecode(env, file_name, source_text, bytecode, &size))
+		return false;
+
+	*bytecode_size = (uint32_t)size;
+
+	return true;
+}
+
 NOCT_DLL
 bool
 noct_register_bytecode(
@@ -303,6 +328,22 @@ noct_make_empty_dict(
 	return true;
 }
 
+NOCT_DLL
+bool
+noct_make_dict_with_capacity(
+	NoctEnv *env,
+	NoctValue *val,
+	uint32_t size)
+{
+	assert(env != NULL);
+	assert(val != NULL);
+
+	if (!rt_make_dict_with_capacity(env, val, size))
+		return false;
+
+	return true;
+}
+
 NOCT_DLL
 bool
 noct_get_value_type(
@@ -635,6 +676,34 @@ noct_get_dict_value_by_index(
 	return true;
 }
 
+NOCT_DLL
+bool
+noct_get_dict_elem_by_cursor(
+	NoctEnv *env,
+	NoctValue *dict,
+	uint32_t *cursor,
+	NoctValue *key,
+	NoctValue *val)
+{
+	assert(env != NULL);
+	assert(dict != NULL);
+	assert(cursor != NULL);
+	assert(key != NULL);
+	assert(val != NULL);
+
+	/* Check the type. */
+	if (dict->type != NOCT_VALUE_DICT) {
+		rt_error(env, N_TR("Not a dictionary."));
+		return false;
+	}
+
+	/* Load the key and the value. */
+	if (!rt_get_dict_elem_by_cursor(env, dict->val.dict, cursor, key, val))
+		return false;
+
+	return true;
+}
+
 NOCT_DLL
 bool
 noct_check_dict_key(
@@ -713,10 +782,6 @@ noct_set_dict_elem(
 	return true;
 }
 
-/*
- * The following is not thread-safe.
- */
-#if !defined(NOCT_USE_MULTITHREAD)
 NOCT_DLL
 bool
 noct_remove_dict_elem(
@@ -735,12 +800,11 @@ noct_remove_dict_elem(
 	}
 
 	/* Remove the element. */
-	if (!rt_remove_dict_elem(env, dict->val.dict, key))
+	if (!rt_remove_dict_elem(env, &dict->val.dict, key))
 		return false;
 
 	return true;
 }
-#endif
 
 NOCT_DLL
 bool
@@ -993,18 +1057,33 @@ noct_compact_gc(
 	rt_gc_level3_gc(env);
 }
 
+NOCT_DLL
+bool
+noct_incremental_gc(
+	NoctEnv *env,
+	int steps)
+{
+	return rt_gc_incremental_gc(env, steps);
+}
+
 NOCT_DLL
 bool
 noct_get_heap_usage(
 	NoctEnv *env,
 	size_t *ret)
 {
-	UNUSED_PARAMETER(env);
-
-	/* TODO: */
-	*ret = 0;
+	return rt_gc_get_heap_usage(env, ret);
+}
 
-	return true;
+NOCT_DLL
+bool
+noct_get_heap_stats(
+	NoctEnv *env,
+	size_t *free_size,
+	size_t *largest_free_size,
+	size_t *free_count)
+{
+	return rt_gc_get_heap_stats(env, free_size, largest_free_size, free_count);
 }
 
 NOCT_DLL
@@ -30,6 +30,10 @@
 #include <time.h>
 #include <assert.h>
 
+#if defined(NOCT_TARGET_WASM)
+#include <emscripten/stack.h>
+#endif
+
 /* False assertion */
 #define NOT_IMPLEMENTED		0
 #define NEVER_COME_HERE		0
@@ -40,18 +44,46 @@
 #define IS_DICT_KEY_REMOVED(k)	(k.type == NOCT_VALUE_FLOAT)
 #define REMOVE_DICT_KEY(k)	do { k.type = NOCT_VALUE_FLOAT; } while (0)
 
+/* Bytecode image that rt_register_source_with_bytecode() writes. */
+struct rt_bytecode_image {
+	uint8_t *data;
+	size_t size;
+	size_t alloc_size;
+};
+
 /* Forward declarations. */
 static void rt_free_func(struct rt_env *rt, struct rt_func *func);
 static bool rt_register_lir(struct rt_env *rt, struct lir_func *lir);
+static bool rt_put_bytecode_func(struct rt_env *env, struct rt_bytecode_image *img, struct lir_func *lir);
+static bool rt_put_bytecode_line(struct rt_env *env, struct rt_bytecode_image *img, const char *format, ...);
+static bool rt_put_bytecode_data(struct rt_env *env, struct rt_bytecode_image *img, const void *data, size_t size);
 static bool rt_register_bytecode_function(struct rt_env *rt, uint8_t *data, size_t size, uint32_t *pos, char *file_name);
 static const char *rt_read_bytecode_line(uint8_t *data, size_t size, uint32_t *pos);
-static bool rt_enter_frame(struct rt_env *env, struct rt_func *func);
+static bool rt_init_stack(struct rt_env *env);
+static void rt_cleanup_stack(struct rt_env *env);
+static struct rt_stack_chunk *rt_alloc_stack_chunk(uint32_t size);
+static bool rt_enter_frame(struct rt_env *env, struct rt_func *func, uint32_t arg_count);
+static bool rt_is_c_stack_exhausted(struct rt_env *env, char *mark);
+static void rt_set_compile_file_name(struct rt_env *env, const char *file_name);
 static void rt_leave_frame(struct rt_env *env);
-static bool rt_expand_array(struct rt_env *env, struct rt_array *old_arr, struct rt_array **new_arr_pp, size_t size);
-static bool rt_expand_dict(struct rt_env *env, struct rt_dict *old_dict, struct rt_dict **new_dict_pp);
+static bool rt_expand_frame_tbl(struct rt_env *env);
+static bool rt_expand_array(struct rt_env *env, struct rt_array **old_arr_pp, struct rt_array **new_arr_pp, size_t size);
+static bool rt_expand_dict(struct rt_env *env, struct rt_dict **old_dict_pp, struct rt_dict **new_dict_pp);
+static bool rt_unshape_dict(struct rt_env *env, struct rt_dict **old_dict_pp, struct rt_dict **new_dict_pp);
+static bool rt_append_shaped_dict_elem(struct rt_env *env, struct rt_dict **real_dict_pp, struct rt_dict **dict, const char *key, size_t len, uint32_t hash, struct rt_value *val);
+static bool rt_append_hash_dict_elem(struct rt_env *env, struct rt_dict **real_dict_pp, struct rt_dict **dict, const char *key, size_t len, uint32_t hash, struct rt_value *val);
+static bool rt_make_dict_key(struct rt_env *env, struct rt_value *val, const char *key, size_t len, uint32_t hash);
+static bool rt_find_dict_slot(struct rt_dict *dict, const char *key, size_t len, uint32_t hash, uint32_t *slot);
+static bool rt_check_dict_slot(struct rt_dict *dict, const char *key, size_t len, uint32_t hash, struct rt_inline_cache *ic);
+static bool rt_find_shape_index(struct rt_shape *shape, const char *key, size_t len, uint32_t hash, uint32_t *index);
+static struct rt_shape *rt_get_shape_by_index(struct rt_shape *shape, uint32_t index);
+static struct rt_shape *rt_find_shape_transition(struct rt_shape *shape, const char *key, size_t len, uint32_t hash);
+static bool rt_get_shape_transition(struct rt_env *env, struct rt_shape *shape, const char *key, size_t len, uint32_t hash, struct rt_shape **next);
+static void rt_cleanup_shapes(struct rt_vm *vm);
 static bool rt_init_global(struct rt_env *env);
 static void rt_cleanup_global(struct rt_env *env);
 static bool rt_expand_global(struct rt_env *env);
+static bool rt_find_global_slot(struct rt_env *env, const char *name, size_t len, uint32_t hash, uint32_t *slot);
 
 /*
  * Initialization
@@ -73,6 +105,7 @@ rt_create_vm(
 		return false;
 	}
 	memset(*vm, 0, sizeof(struct rt_vm));
+	(*vm)->shape_empty.id = RT_SHAPE_ID_EMPTY;
 
 	/* Copy the config if specified. */
 	if (config != NULL)
@@ -89,14 +122,15 @@ rt_create_vm(
 	}
 	memset(*default_env, 0, sizeof(struct rt_env));
 	(*default_env)->vm = *vm;
+	(*default_env)->file_name = (*default_env)->compile_file_name;
 	(*vm)->env_list = *default_env;
 
 	/* Enter the initial stack frame. */
-	(*default_env)->cur_frame_index = 0;
-	(*default_env)->frame = &(*default_env)->frame_alloc[0];
-	(*default_env)->frame->tmpvar = &(*default_env)->frame->tmpvar_alloc[0];
-	(*default_env)->frame->tmpvar_size = RT_TMPVAR_MAX;
-	memset((*default_env)->frame->tmpvar, 0, sizeof(struct rt_value) * RT_TMPVAR_MAX);
+	if (!rt_init_stack(*default_env)) {
+		noct_free(*default_env);
+		noct_free(*vm);
+		return false;
+	}
 
 #if defined(NOCT_USE_MULTITHREAD)
 	/* Initialize for GC. */
@@ -105,6 +139,7 @@ rt_create_vm(
 
 	/* Initialize the global variables. */
 	if (!rt_init_global(*default_env)) {
+		rt_cleanup_stack(*default_env);
 		noct_free(*default_env);
 		noct_free(*vm);
 		return false;
@@ -113,6 +148,7 @@ rt_create_vm(
 	/* Initialize the garbage collector. */
 	if (!rt_gc_init(*vm)) {
 		rt_cleanup_global(*default_env);
+		rt_cleanup_stack(*default_env);
 		noct_free(*default_env);
 		noct_free(*vm);
 		return false;
@@ -122,6 +158,7 @@ rt_create_vm(
 	if (!rt_register_intrinsics(*default_env)) {
 		rt_cleanup_global(*default_env);
 		rt_gc_cleanup(*vm);
+		rt_cleanup_stack(*default_env);
 		noct_free(*default_env);
 		noct_free(*vm);
 		return false;
@@ -151,6 +188,7 @@ rt_destroy_vm(
 	env = vm->env_list;
 	while (env != NULL) {
 		next_env = env->next;
+		rt_cleanup_stack(env);
 		noct_free(env);
 		env = next_env;
 	}
@@ -158,6 +196,9 @@ rt_destroy_vm(
 	/* Cleanup the garbage collector. */
 	rt_gc_cleanup(vm);
 
+	/* Free the dictionary shapes. */
+	rt_cleanup_shapes(vm);
+
 	/* Free functions. */
 	func = vm->func_list;
 	while (func != NULL) {
@@ -192,11 +233,96 @@ rt_free_func(
 	}
 	noct_free(func->file_name);
 	noct_free(func->bytecode);
+	noct_free(func->ic);
 
 	if (func->jit_code != NULL)
 		func->jit_code = NULL;
 }
 
+/* Allocate the stack and enter the bottom frame. */
+static bool
+rt_init_stack(
+	struct rt_env *env)
+{
+	/* Allocate the frame table. */
+	env->frame_tbl = noct_calloc(RT_FRAME_INIT, sizeof(struct rt_frame *));
+	if (env->frame_tbl == NULL)
+		return false;
+	env->frame_tbl_size = RT_FRAME_INIT;
+
+	/* Allocate the bottom frame. */
+	env->frame_tbl[0] = noct_calloc(1, sizeof(struct rt_frame));
+	if (env->frame_tbl[0] == NULL) {
+		rt_cleanup_stack(env);
+		return false;
+	}
+
+	/* Allocate the first stack chunk. */
+	env->stack_bottom = rt_alloc_stack_chunk(RT_STACK_CHUNK_SIZE);
+	if (env->stack_bottom == NULL) {
+		rt_cleanup_stack(env);
+		return false;
+	}
+	env->stack_top = env->stack_bottom;
+
+	/* Enter the bottom frame. */
+	env->cur_frame_index = 0;
+	env->frame = env->frame_tbl[0];
+	env->frame->tmpvar = &env->stack_bottom->value[0];
+	env->frame->tmpvar_size = RT_TMPVAR_MAX;
+	env->frame->chunk = env->stack_bottom;
+	env->stack_bottom->top = RT_TMPVAR_MAX;
+	memset(env->frame->tmpvar, 0, sizeof(struct rt_value) * RT_TMPVAR_MAX);
+
+	return true;
+}
+
+/* Free the stack. */
+static void
+rt_cleanup_stack(
+	struct rt_env *env)
+{
+	struct rt_stack_chunk *chunk, *next;
+	int i;
+
+	if (env->frame_tbl != NULL) {
+		for (i = 0; i < env->frame_tbl_size; i++) {
+			if (env->frame_tbl[i] != NULL)
+				noct_free(env->frame_tbl[i]);
+		}
+		noct_free(env->frame_tbl);
+		env->frame_tbl = NULL;
+	}
+
+	chunk = env->stack_bottom;
+	while (chunk != NULL) {
+		next = chunk->next;
+		noct_free(chunk);
+		chunk = next;
+	}
+	env->stack_bottom = NULL;
+	env->stack_top = NULL;
+}
+
+/* Allocate a stack chunk. */
+static struct rt_stack_chunk *
+rt_alloc_stack_chunk(
+	uint32_t size)
+{
+	struct rt_stack_chunk *chunk;
+
+	chunk = noct_malloc(sizeof(struct rt_stack_chunk) +
+			    sizeof(struct rt_value) * (size_t)(size - 1));
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->next = NULL;
+	chunk->size = size;
+	chunk->top = 0;
+
+	return chunk;
+}
+
 #if defined(NOCT_USE_MULTITHREAD)
 /*
  * Create an environment for the current thread.
@@ -216,17 +342,19 @@ rt_create_thread_env(
 	}
 	memset(env, 0, sizeof(struct rt_env));
 	env->vm = prev_env->vm;
+	env->file_name = env->compile_file_name;
+
+	/* Enter the initial stack frame. */
+	if (!rt_init_stack(env)) {
+		noct_free(env);
+		rt_out_of_memory(prev_env);
+		return false;
+	}
 
 	/* Link. */
 	env->next = prev_env->vm->env_list;
 	prev_env->vm->env_list = env;
 
-	/* Enter the initial stack frame. */
-	env->cur_frame_index = 0;
-	env->frame = &env->frame_alloc[0];
-	env->frame->tmpvar = &env->frame->tmpvar_alloc[0];
-	env->frame->tmpvar_size = RT_TMPVAR_MAX;
-
 	/* Initialize for GC. */
 	rt_gc_init_env(env);
 
@@ -249,16 +377,34 @@ rt_register_source(
 	const char *file_name,
 	const char *source_text)
 {
+	return rt_register_source_with_bytecode(env, file_name, source_text, NULL, NULL);
+}
+
+/*
+ * Register functions from a souce text, and return the equivalent
+ * bytecode image if image is not NULL.
+ */
+bool
+rt_register_source_with_bytecode(
+	struct rt_env *env,
+	const char *file_name,
+	const char *source_text,
+	uint8_t **image,
+	size_t *image_size)
+{
+	struct rt_bytecode_image img;
 	struct hir_block *hfunc;
 	struct lir_func *lfunc;
 	uint32_t i, func_count;
 	bool is_succeeded;
 
+	memset(&img, 0, sizeof(img));
+
 	is_succeeded = false;
 	do {
 		/* Do parse and build AST. */
 		if (!ast_build(file_name, source_text)) {
-			strncpy(env->file_name, ast_get_file_name(), sizeof(env->file_name) - 1);
+			rt_set_compile_file_name(env, ast_get_file_name());
 			env->line = ast_get_error_line();
 			rt_error(env, "%s", ast_get_error_message());
 			break;
@@ -266,24 +412,46 @@ rt_register_source(
 
 		/* Transform AST to HIR. */
 		if (!hir_build()) {
-			strncpy(env->file_name, hir_get_file_name(), sizeof(env->file_name) - 1);
+			rt_set_compile_file_name(env, hir_get_file_name());
 			env->line = hir_get_error_line();
 			rt_error(env, "%s", hir_get_error_message());
 			break;
 		}
 
-		/* For each function. */
+		/* Put a bytecode header. */
 		func_count = hir_get_function_count();
+		if (image != NULL) {
+			if (!rt_put_bytecode_line(env, &img, "Noct Bytecode 1.0"))
+				break;
+			if (!rt_put_bytecode_line(env, &img, "Source"))
+				break;
+			if (!rt_put_bytecode_line(env, &img, "%s", file_name))
+				break;
+			if (!rt_put_bytecode_line(env, &img, "Number Of Functions"))
+				break;
+			if (!rt_put_bytecode_line(env, &img, "%u", func_count))
+				break;
+		}
+
+		/* For each function. */
 		for (i = 0; i < func_count; i++) {
 			/* Transform HIR to LIR (bytecode). */
 			hfunc = hir_get_function(i);
 			if (!lir_build(hfunc, &lfunc)) {
-				strncpy(env->file_name, lir_get_file_name(), sizeof(env->file_name) - 1);
+				rt_set_compile_file_name(env, lir_get_file_name());
 				env->line = lir_get_error_line();
 				rt_error(env, "%s", lir_get_error_message());
 				break;
 			}
 
+			/* Put a bytecode function. */
+			if (image != NULL) {
+				if (!rt_put_bytecode_func(env, &img, lfunc)) {
+					lir_cleanup(lfunc);
+					break;
+				}
+			}
+
 			/* Make a function object. */
 			if (!rt_register_lir(env, lfunc))
 				break;
@@ -302,13 +470,130 @@ rt_register_source(
 	ast_cleanup();
 
 	/* If failed. */
-	if (!is_succeeded)
+	if (!is_succeeded) {
+		if (img.data != NULL)
+			noct_free(img.data);
 		return false;
+	}
+
+	/* Return the image. */
+	if (image != NULL) {
+		*image = img.data;
+		*image_size = img.size;
+	}
 
 	/* Succeeded. */
 	return true;
 }
 
+/* Set the file name of a compile error. */
+static void
+rt_set_compile_file_name(
+	struct rt_env *env,
+	const char *file_name)
+{
+	strncpy(env->compile_file_name, file_name, sizeof(env->compile_file_name) - 1);
+	env->file_name = env->compile_file_name;
+}
+
+/* Put a function to a bytecode image. (Same format as bcback) */
+static bool
+rt_put_bytecode_func(
+	struct rt_env *env,
+	struct rt_bytecode_image *img,
+	struct lir_func *lir)
+{
+	uint32_t i;
+
+	if (!rt_put_bytecode_line(env, img, "Begin Function"))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "Name"))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "%s", lir->func_name))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "Parameters"))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "%u", lir->param_count))
+		return false;
+	for (i = 0; i < lir->param_count; i++) {
+		if (!rt_put_bytecode_line(env, img, "%s", lir->param_name[i]))
+			return false;
+	}
+	if (!rt_put_bytecode_line(env, img, "Temporary Size"))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "%u", lir->tmpvar_size))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "Bytecode Size"))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "%u", lir->bytecode_size))
+		return false;
+	if (!rt_put_bytecode_data(env, img, lir->bytecode, lir->bytecode_size))
+		return false;
+	if (!rt_put_bytecode_line(env, img, "\nEnd Function"))
+		return false;
+
+	return true;
+}
+
+/* Put a line to a bytecode image. */
+static bool
+rt_put_bytecode_line(
+	struct rt_env *env,
+	struct rt_bytecode_image *img,
+	const char *format,
+	...)
+{
+	char line[1024];
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = vsnprintf(line, sizeof(line) - 1, format, ap);
+	va_end(ap);
+	if (len < 0 || len >= (int)sizeof(line) - 1) {
+		rt_error(env, N_TR("Failed to write bytecode."));
+		return false;
+	}
+	line[len++] = '\n';
+
+	return rt_put_bytecode_data(env, img, line, (size_t)len);
+}
+
+/* Put data to a bytecode image. */
+static bool
+rt_put_bytecode_data(
+	struct rt_env *env,
+	struct rt_bytecode_image *img,
+	const void *data,
+	size_t size)
+{
+	uint8_t *new_data;
+	size_t new_alloc_size;
+
+	/* Grow the buffer. */
+	if (img->size + size > img->alloc_size) {
+		new_alloc_size = img->alloc_size == 0 ? 4096 : img->alloc_size * 2;
+		while (new_alloc_size < img->size + size)
+			new_alloc_size *= 2;
+		new_data = noct_malloc(new_alloc_size);
+		if (new_data == NULL) {
+			rt_out_of_memory(env);
+			return false;
+		}
+		if (img->data != NULL) {
+			memcpy(new_data, img->data, img->size);
+			noct_free(img->data);
+		}
+		img->data = new_data;
+		img->alloc_size = new_alloc_size;
+	}
+
+	memcpy(img->data + img->size, data, size);
+	img->size += size;
+
+	return true;
+}
+
 /* Register a function from LIR. */
 static bool
 rt_register_lir(
@@ -347,6 +632,14 @@ rt_register_lir(
 			return false;
 		}
 		memcpy(func->bytecode, lir->bytecode, (size_t)lir->bytecode_size);
+
+		/* Allocate the inline caches. */
+		func->ic = noct_calloc(((size_t)lir->bytecode_size >> RT_INLINE_CACHE_SHIFT) + 1,
+				       sizeof(struct rt_inline_cache));
+		if (func->ic == NULL) {
+			rt_out_of_memory(env);
+			return false;
+		}
 	}
 	func->tmpvar_size = lir->tmpvar_size;
 	func->file_name = strdup(lir->file_name);
@@ -434,6 +727,8 @@ rt_register_bytecode(
 			if (!rt_register_bytecode_function(env, data, size, &pos, file_name))
 				break;
 		}
+		if (i != func_count)
+			break;
 
 		succeeded = true;
 	} while (0);
@@ -689,7 +984,7 @@ rt_call(
 	struct rt_value *arg,
 	struct rt_value *ret)
 {
-	char old_file_name[256];
+	const char *old_file_name;
 	uint32_t i;
 
 #if defined(NOCT_USE_MULTITHREAD)
@@ -719,15 +1014,17 @@ rt_call(
 		env->vm->is_jit_dirty = false;
 	}
 
-	/* Allocate a frame for this call. */
-	if (!rt_enter_frame(env, func))
-		return false;
-
-	/* Pass args. */
+	/* Check args. */
 	if (arg_count != func->param_count) {
 		noct_error(env, N_TR("%s(): Function arguments not match."), func->name);
 		return false;
 	}
+
+	/* Allocate a frame for this call. */
+	if (!rt_enter_frame(env, func, arg_count))
+		return false;
+
+	/* Pass args. */
 	for (i = 0; i < arg_count; i++)
 		env->frame->tmpvar[i] = arg[i];
 
@@ -737,11 +1034,9 @@ rt_call(
 		if (!func->cfunc(env))
 			return false;
 	} else {
-		/* Backup the old file name. */
-		strncpy(old_file_name, env->file_name, sizeof(old_file_name) - 1);
-
 		/* Set the new file name. */
-		strncpy(env->file_name, env->frame->func->file_name, sizeof(env->file_name) - 1);
+		old_file_name = env->file_name;
+		env->file_name = func->file_name;
 
 		if (func->jit_code != NULL) {
 			/* Call a JIT-generated code. */
@@ -758,7 +1053,7 @@ rt_call(
 		}
 
 		/* Restore the old file name. */
-		strncpy(env->file_name, old_file_name, sizeof(env->file_name) - 1);
+		env->file_name = old_file_name;
 	}
 
 	/* Get a return value. */
@@ -777,43 +1072,159 @@ rt_call(
 	return true;
 }
 
-/* Enter a new calling frame. */
+/*
+ * Enter a new calling frame.
+ *  - The first arg_count slots are left for the caller to fill.
+ */
 static bool
 rt_enter_frame(
 	struct rt_env *env,
-	struct rt_func *func)
+	struct rt_func *func,
+	uint32_t arg_count)
 {
 	struct rt_frame *frame;
+	struct rt_stack_chunk *chunk;
+	uint32_t size;
+	int index;
+	char c_stack_mark;
+
+	/* Check the stack depth. */
+	index = env->cur_frame_index + 1;
+	if (index >= RT_FRAME_MAX) {
+		rt_error(env, N_TR("Stack overflow."));
+		return false;
+	}
 
-	if (++env->cur_frame_index >= RT_FRAME_MAX) {
+	/* Check the C stack depth. */
+	if (index == 1)
+		env->c_stack_base = &c_stack_mark;
+	if (rt_is_c_stack_exhausted(env, &c_stack_mark)) {
 		rt_error(env, N_TR("Stack overflow."));
 		return false;
 	}
 
-	frame = &env->frame_alloc[env->cur_frame_index];
-	env->frame = frame;
+	/* Grow the frame table. */
+	if (index >= env->frame_tbl_size) {
+		if (!rt_expand_frame_tbl(env))
+			return false;
+	}
+
+	/* Allocate a frame when we reach this depth for the first time. */
+	if (env->frame_tbl[index] == NULL) {
+		env->frame_tbl[index] = noct_calloc(1, sizeof(struct rt_frame));
+		if (env->frame_tbl[index] == NULL) {
+			rt_out_of_memory(env);
+			return false;
+		}
+	}
+
+	/* Allocate the tmpvar on the stack. */
+	size = func->tmpvar_size;
+	chunk = env->stack_top;
+	if (chunk->top + size > chunk->size) {
+		/* Link a new chunk if the next one is absent or too small. */
+		if (chunk->next == NULL || chunk->next->size < size) {
+			struct rt_stack_chunk *new_chunk;
+			new_chunk = rt_alloc_stack_chunk(size > RT_STACK_CHUNK_SIZE ? size : RT_STACK_CHUNK_SIZE);
+			if (new_chunk == NULL) {
+				rt_out_of_memory(env);
+				return false;
+			}
+			new_chunk->next = chunk->next;
+			chunk->next = new_chunk;
+		}
+		chunk = chunk->next;
+		env->stack_top = chunk;
+	}
+
+	frame = env->frame_tbl[index];
 	frame->func = func;
-	frame->tmpvar = &frame->tmpvar_alloc[0];
-	frame->tmpvar_size = func->tmpvar_size;
+	frame->tmpvar = &chunk->value[chunk->top];
+	frame->tmpvar_size = size;
+	frame->chunk = chunk;
 	frame->pinned_count = 0;
+	chunk->top += size;
+
+	env->cur_frame_index = index;
+	env->frame = frame;
 
 	/* We can't remove this due to GC. */
-	memset(frame->tmpvar, 0, sizeof(struct rt_value) * (size_t)frame->tmpvar_size);
+	if (size > arg_count) {
+		memset(&frame->tmpvar[arg_count], 0,
+		       sizeof(struct rt_value) * (size_t)(size - arg_count));
+	}
 
 	return true;
 }
 
+/* Check if the C stack can't take another call. */
+static bool
+rt_is_c_stack_exhausted(
+	struct rt_env *env,
+	char *mark)
+{
+#if defined(NOCT_TARGET_WASM)
+	UNUSED_PARAMETER(env);
+	UNUSED_PARAMETER(mark);
+
+	return emscripten_stack_get_free() < RT_C_STACK_MARGIN;
+#else
+	uintptr_t base, cur;
+
+	/* The stack grows downward on most targets, but don't assume it. */
+	base = (uintptr_t)env->c_stack_base;
+	cur = (uintptr_t)mark;
+	if (base > cur)
+		return base - cur > RT_C_STACK_MAX;
+	return cur - base > RT_C_STACK_MAX;
+#endif
+}
+
 /* Leave the current calling frame. */
 static void
 rt_leave_frame(
 	struct rt_env *env)
 {
-	if (--env->cur_frame_index < 0) {
+	struct rt_frame *frame;
+
+	if (env->cur_frame_index <= 0) {
 		rt_error(env, N_TR("Stack underflow."));
 		abort();
 	}
 
-	env->frame = &env->frame_alloc[env->cur_frame_index];
+	/* Free the tmpvar. */
+	frame = env->frame;
+	frame->chunk->top -= frame->tmpvar_size;
+
+	env->cur_frame_index--;
+	env->frame = env->frame_tbl[env->cur_frame_index];
+	env->stack_top = env->frame->chunk;
+}
+
+/* Grow the frame table. */
+static bool
+rt_expand_frame_tbl(
+	struct rt_env *env)
+{
+	struct rt_frame **new_tbl;
+	int new_size;
+
+	new_size = env->frame_tbl_size * 2;
+	if (new_size > RT_FRAME_MAX)
+		new_size = RT_FRAME_MAX;
+
+	new_tbl = noct_calloc((size_t)new_size, sizeof(struct rt_frame *));
+	if (new_tbl == NULL) {
+		rt_out_of_memory(env);
+		return false;
+	}
+	memcpy(new_tbl, env->frame_tbl, sizeof(struct rt_frame *) * (size_t)env->frame_tbl_size);
+	noct_free(env->frame_tbl);
+
+	env->frame_tbl = new_tbl;
+	env->frame_tbl_size = new_size;
+
+	return true;
 }
 
 /*
@@ -868,6 +1279,85 @@ rt_make_string_with_hash(
 	return true;
 }
 
+/*
+ * Make a string value by concatenating two strings or numbers.
+ *  - The result is written directly into a right-sized string.
+ *  - dst may be the same as src1 or src2.
+ */
+bool
+rt_make_string_concat(
+	struct rt_env *env,
+	struct rt_value *dst,
+	struct rt_value *src1,
+	struct rt_value *src2)
+{
+	char num1[RT_NUMBER_BUF_SIZE], num2[RT_NUMBER_BUF_SIZE];
+	const char *s1, *s2;
+	size_t len1, len2;
+	struct rt_string *rts;
+
+	assert(src1->type == NOCT_VALUE_STRING || src2->type == NOCT_VALUE_STRING);
+
+	/* Get the lengths. (Excluding NUL) */
+	len1 = src1->type == NOCT_VALUE_STRING ? src1->val.str->len - 1 : rt_format_number(src1, num1);
+	len2 = src2->type == NOCT_VALUE_STRING ? src2->val.str->len - 1 : rt_format_number(src2, num2);
+
+	/* Allocate. (This may run a young GC that moves the source strings.) */
+	rts = rt_gc_alloc_string(env, NULL, len1 + len2 + 1, 0);
+	if (rts == NULL) {
+		rt_out_of_memory(env);
+		return false;
+	}
+
+	/* Copy. */
+	s1 = src1->type == NOCT_VALUE_STRING ? src1->val.str->data : num1;
+	s2 = src2->type == NOCT_VALUE_STRING ? src2->val.str->data : num2;
+	memcpy(rts->data, s1, len1);
+	memcpy(rts->data + len1, s2, len2);
+
+	/* Setup a value. */
+	dst->type = NOCT_VALUE_STRING;
+	dst->val.str = rts;
+
+	return true;
+}
+
+/*
+ * Format an integer or a float as "+" does. Returns the length.
+ *  - buf must have RT_NUMBER_BUF_SIZE bytes.
+ */
+size_t
+rt_format_number(
+	struct rt_value *val,
+	char *buf)
+{
+	char tmp[16];
+	unsigned int u;
+	size_t len, i;
+
+	if (val->type == NOCT_VALUE_FLOAT)
+		return (size_t)snprintf(buf, RT_NUMBER_BUF_SIZE, "%f", val->val.f);
+
+	assert(val->type == NOCT_VALUE_INT);
+
+	/* Convert digits in the reverse order. */
+	u = val->val.i < 0 ? 0u - (unsigned int)val->val.i : (unsigned int)val->val.i;
+	i = 0;
+	do {
+		tmp[i++] = (char)('0' + u % 10);
+		u /= 10;
+	} while (u != 0);
+
+	len = 0;
+	if (val->val.i < 0)
+		buf[len++] = '-';
+	while (i > 0)
+		buf[len++] = tmp[--i];
+	buf[len] = '\0';
+
+	return len;
+}
+
 /*
  * Cache the hash of a string.
  */
@@ -963,6 +1453,36 @@ rt_string_hash_and_len(
 
 #endif
 
+/*
+ * Get the acquired object again after an allocation, which may run a GC
+ * that moves it. (The reference is a GC root.)
+ */
+#define RELOAD_OBJ(obj, real_obj)							\
+	do {										\
+		(real_obj) = (obj);							\
+		while ((real_obj)->newer != NULL)					\
+			(real_obj) = (real_obj)->newer;					\
+	} while (0)
+
+/*
+ * Shape transitions.
+ */
+#if !defined(NOCT_USE_MULTITHREAD)
+
+#define ACQUIRE_SHAPE()
+#define RELEASE_SHAPE()
+
+#else
+
+#define ACQUIRE_SHAPE()									\
+	while (atomic_exchange_acquire(&env->vm->shape_lock, 1) != 0)			\
+		cpu_relax()
+
+#define RELEASE_SHAPE()									\
+	atomic_store_release(&env->vm->shape_lock, 0)
+
+#endif
+
 /*
  * Make an empty array.
  */
@@ -1073,7 +1593,7 @@ rt_set_array_elem(
 		struct rt_array *new_arr;
 
 		/* Reallocate an array. */
-		if (!rt_expand_array(env, real_arr, arr, index + 1)) {
+		if (!rt_expand_array(env, &real_arr, arr, index + 1)) {
 			RELEASE_OBJ(real_arr);
 			return false;
 		}
@@ -1133,7 +1653,7 @@ rt_resize_array(
 		struct rt_array *new_arr;
 
 		/* Reallocate an array. */
-		if (!rt_expand_array(env, real_arr, arr, size)) {
+		if (!rt_expand_array(env, &real_arr, arr, size)) {
 			RELEASE_OBJ(real_arr);
 			return false;
 		}
@@ -1163,15 +1683,17 @@ rt_resize_array(
 static bool
 rt_expand_array(
 	struct rt_env *env,
-	struct rt_array *old_arr,
+	struct rt_array **old_arr_pp,
 	struct rt_array **new_arr_pp,
 	size_t size)
 {
-	struct rt_array *new_arr;
+	struct rt_array *old_arr, *new_arr;
 	size_t old_size;
 	uint32_t i;
 
 	assert(env != NULL);
+
+	old_arr = *old_arr_pp;
 	assert(old_arr->newer == NULL);
 	assert(old_arr->alloc_size < size);
 
@@ -1190,6 +1712,16 @@ rt_expand_array(
 		return false;
 	}
 
+	/*
+	 * The allocation may run a GC that moves the old array. Reload it
+	 * from the reference, which is a GC root and is rewritten by the
+	 * GC. The caller releases the moved one.
+	 */
+	old_arr = *new_arr_pp;
+	while (old_arr->newer != NULL)
+		old_arr = old_arr->newer;
+	*old_arr_pp = old_arr;
+
 	/* Copy the values with write barrier. */
 	new_arr->size = old_arr->size;
 	for (i = 0; i < old_arr->size; i++) {
@@ -1260,8 +1792,8 @@ rt_make_empty_dict(
 
 	const uint32_t START_SIZE = 2;
 
-	/* Allocate a dictionary. */
-	dict = rt_gc_alloc_dict(env, START_SIZE);
+	/* Allocate a dictionary with the empty shape. */
+	dict = rt_gc_alloc_dict(env, START_SIZE, &env->vm->shape_empty);
 	if (dict == NULL) {
 		rt_out_of_memory(env);
 		return false;
@@ -1275,20 +1807,59 @@ rt_make_empty_dict(
 }
 
 /*
- * Get the size of a dictionary.
+ * Make an empty dictionary that has room for the given number of keys.
+ *  - A dictionary that the shape can hold gets a presized value vector.
+ *  - A larger one starts as a hash table that needs no rehash.
  */
 bool
-rt_get_dict_size(
+rt_make_dict_with_capacity(
 	struct rt_env *env,
-	struct rt_dict *dict,
-	uint32_t *size)
+	struct rt_value *val,
+	uint32_t size)
 {
-	struct rt_dict *real_dict;
+	struct rt_dict *dict;
+	size_t alloc_size;
 
-	UNUSED_PARAMETER(env);
+	if (size <= RT_SHAPE_KEY_MAX) {
+		/* Allocate a shaped dictionary. */
+		alloc_size = size < 2 ? 2 : size;
+		dict = rt_gc_alloc_dict(env, alloc_size, &env->vm->shape_empty);
+	} else {
+		/* Keep the load factor under 75% after the last append. */
+		alloc_size = 4;
+		while (size > alloc_size / 4 * 3)
+			alloc_size *= 2;
 
-	assert(env != NULL);
-	assert(dict != NULL);
+		/* Allocate a hash table. */
+		dict = rt_gc_alloc_dict(env, alloc_size, NULL);
+	}
+	if (dict == NULL) {
+		rt_out_of_memory(env);
+		return false;
+	}
+
+	/* Setup a value. */
+	val->type = NOCT_VALUE_DICT;
+	val->val.dict = dict;
+
+	return true;
+}
+
+/*
+ * Get the size of a dictionary.
+ */
+bool
+rt_get_dict_size(
+	struct rt_env *env,
+	struct rt_dict *dict,
+	uint32_t *size)
+{
+	struct rt_dict *real_dict;
+
+	UNUSED_PARAMETER(env);
+
+	assert(env != NULL);
+	assert(dict != NULL);
 	assert(size != NULL);
 
 	ACQUIRE_OBJ(dict, real_dict);
@@ -1312,7 +1883,7 @@ rt_check_dict_key(
 {
 	struct rt_dict *real_dict;
 	size_t len;
-	uint32_t hash, i, index;
+	uint32_t hash, i;
 
 	UNUSED_PARAMETER(env);
 
@@ -1320,33 +1891,11 @@ rt_check_dict_key(
 
 	len = strlen(key) + 1; /* +1 for NUL */
 	hash = rt_string_hash(key);
-	index = hash & ((uint32_t)real_dict->alloc_size - 1);
 
 	/* Search the key. */
-	for (i = index;
-	     i != ((index - 1 + (uint32_t)real_dict->alloc_size) & ((uint32_t)real_dict->alloc_size - 1));
-	     i = (i + 1) & ((uint32_t)real_dict->alloc_size - 1)) {
-		if (IS_DICT_KEY_REMOVED(real_dict->key[i]) ||
-		    IS_DICT_KEY_EMPTY(real_dict->key[i]))
-			continue;
-
-		/* Make a hash cache. */
-		if (real_dict->key[i].val.str->hash == 0)
-			real_dict->key[i].val.str->hash = rt_string_hash(real_dict->key[i].val.str->data);
-
-		if (real_dict->key[i].val.str->len == len &&
-		    real_dict->key[i].val.str->hash == hash &&
-		    strcmp(real_dict->key[i].val.str->data, key) == 0) {
-			/* Found. */
-			RELEASE_OBJ(real_dict);
-			*ret = true;
-			return true;
-		}
-	}
+	*ret = rt_find_dict_slot(real_dict, key, len, hash, &i);
 
-	/* Not found. */
 	RELEASE_OBJ(real_dict);
-	*ret = false;
 
 	/* Note: this is not an error, so just return true. */
 	return true;
@@ -1379,6 +1928,13 @@ rt_get_dict_key_by_index(
 		return false;
 	}
 
+	/* For a shaped dictionary, the key is in the shape. */
+	if (real_dict->shape != NULL) {
+		*key = rt_get_shape_by_index(real_dict->shape, index)->key;
+		RELEASE_OBJ(real_dict);
+		return true;
+	}
+
 	count = 0;
 	for (i = 0; i < real_dict->alloc_size; i++) {
 		if (IS_DICT_KEY_REMOVED(real_dict->key[i]) ||
@@ -1425,6 +1981,13 @@ rt_get_dict_value_by_index(
 		return false;
 	}
 
+	/* For a shaped dictionary, the index is the key index. */
+	if (real_dict->shape != NULL) {
+		*val = real_dict->value[index];
+		RELEASE_OBJ(real_dict);
+		return true;
+	}
+
 	count = 0;
 	for (i = 0; i < real_dict->alloc_size; i++) {
 		if (IS_DICT_KEY_REMOVED(real_dict->key[i]) ||
@@ -1444,6 +2007,61 @@ rt_get_dict_value_by_index(
 	return true;
 }
 
+/*
+ * Get a dictionary key-value pair by a cursor.
+ *  - The cursor starts from 0, and is advanced past the pair.
+ *  - This visits the pairs in the index order in constant time per pair.
+ */
+bool
+rt_get_dict_elem_by_cursor(
+	struct rt_env *env,
+	struct rt_dict *dict,
+	uint32_t *cursor,
+	struct rt_value *key,
+	struct rt_value *val)
+{
+	struct rt_dict *real_dict;
+	uint32_t i;
+
+	assert(env != NULL);
+	assert(dict != NULL);
+	assert(cursor != NULL);
+	assert(key != NULL);
+	assert(val != NULL);
+
+	ACQUIRE_OBJ(dict, real_dict);
+
+	/* For a shaped dictionary, the cursor is the key index. */
+	if (real_dict->shape != NULL) {
+		if (*cursor < real_dict->size) {
+			*key = rt_get_shape_by_index(real_dict->shape, *cursor)->key;
+			*val = real_dict->value[*cursor];
+			(*cursor)++;
+			RELEASE_OBJ(real_dict);
+			return true;
+		}
+	} else {
+		/* Otherwise, the cursor is the next slot to search. */
+		for (i = *cursor; i < real_dict->alloc_size; i++) {
+			if (IS_DICT_KEY_REMOVED(real_dict->key[i]) ||
+			    IS_DICT_KEY_EMPTY(real_dict->key[i]))
+				continue;
+
+			/* Load the key and the value. */
+			*key = real_dict->key[i];
+			*val = real_dict->value[i];
+			*cursor = i + 1;
+			RELEASE_OBJ(real_dict);
+			return true;
+		}
+	}
+
+	RELEASE_OBJ(real_dict);
+
+	rt_error(env, N_TR("Dictionary index %d is out-of-range."), *cursor);
+	return false;
+}
+
 /*
  * Retrieves the value by a key in a dictionary.
  */
@@ -1478,7 +2096,7 @@ rt_get_dict_elem_with_hash(
 	struct rt_value *val)
 {
 	struct rt_dict *real_dict;
-	uint32_t index, i;
+	uint32_t i;
 
 	assert(env != NULL);
 	assert(dict != NULL);
@@ -1488,35 +2106,133 @@ rt_get_dict_elem_with_hash(
 
 	ACQUIRE_OBJ(dict, real_dict);
 
-	index = hash & (uint32_t)(real_dict->alloc_size - 1);
+	if (!rt_find_dict_slot(real_dict, key, len, hash, &i)) {
+		/* Not found. */
+		RELEASE_OBJ(real_dict);
+		rt_error(env, N_TR("Dictionary key \"%s\" not found."), key);
+		return false;
+	}
+
+	/* Succeeded. */
+	*val = real_dict->value[i];
+	RELEASE_OBJ(real_dict);
+	return true;
+}
+
+/*
+ * Retrieves the value by a key in a dictionary. (inline cache version)
+ */
+bool
+rt_get_dict_elem_with_cache(
+	struct rt_env *env,
+	struct rt_dict *dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val)
+{
+	struct rt_dict *real_dict;
+	uint32_t i;
+
+	assert(ic != NULL);
+
+	ACQUIRE_OBJ(dict, real_dict);
+
+	/* Hit: the key is still at the cached slot. */
+	if (rt_check_dict_slot(real_dict, key, len, hash, ic)) {
+		*val = real_dict->value[ic->slot];
+		RELEASE_OBJ(real_dict);
+		return true;
+	}
+
+	/* Miss: probe and remember the slot. */
+	if (!rt_find_dict_slot(real_dict, key, len, hash, &i)) {
+		RELEASE_OBJ(real_dict);
+		rt_error(env, N_TR("Dictionary key \"%s\" not found."), key);
+		return false;
+	}
+	ic->stamp = real_dict->shape != NULL ? real_dict->shape->id : 1;
+	ic->slot = i;
+
+	*val = real_dict->value[i];
+	RELEASE_OBJ(real_dict);
+	return true;
+}
+
+/*
+ * Find the slot of a key in a dictionary.
+ *  - For a shaped dictionary, the slot is the key index.
+ */
+static bool
+rt_find_dict_slot(
+	struct rt_dict *dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	uint32_t *slot)
+{
+	uint32_t index, i;
+
+	if (dict->shape != NULL)
+		return rt_find_shape_index(dict->shape, key, len, hash, slot);
+
+	index = hash & (uint32_t)(dict->alloc_size - 1);
 	for (i = index;
-	     i != ((index - 1 + real_dict->alloc_size) & (real_dict->alloc_size - 1));
-	     i = (i + 1) & ((uint32_t)real_dict->alloc_size - 1)) {
-		if (IS_DICT_KEY_REMOVED(real_dict->key[i]))
+	     i != ((index - 1 + dict->alloc_size) & (dict->alloc_size - 1));
+	     i = (i + 1) & ((uint32_t)dict->alloc_size - 1)) {
+		if (IS_DICT_KEY_REMOVED(dict->key[i]))
 			continue;
-		if (IS_DICT_KEY_EMPTY(real_dict->key[i]))
+		if (IS_DICT_KEY_EMPTY(dict->key[i]))
 			break;
 
 		/* Make a hash cache. */
-		if (real_dict->key[i].val.str->hash == 0)
-			real_dict->key[i].val.str->hash = rt_string_hash(real_dict->key[i].val.str->data);
-		
-		if (real_dict->key[i].val.str->len == len &&
-		    real_dict->key[i].val.str->hash == hash &&
-		    strcmp(real_dict->key[i].val.str->data, key) == 0) {
-			/* Succeeded. */
-			*val = real_dict->value[i];
-			RELEASE_OBJ(real_dict);
+		if (dict->key[i].val.str->hash == 0)
+			dict->key[i].val.str->hash = rt_string_hash(dict->key[i].val.str->data);
+
+		if (dict->key[i].val.str->len == len &&
+		    dict->key[i].val.str->hash == hash &&
+		    strcmp(dict->key[i].val.str->data, key) == 0) {
+			*slot = i;
 			return true;
 		}
 	}
 
-	/* Not found. */
-	RELEASE_OBJ(real_dict);
-	rt_error(env, N_TR("Dictionary key \"%s\" not found."), key);
 	return false;
 }
 
+/* Check if an inline cache still points to a key in a dictionary. */
+static bool
+rt_check_dict_slot(
+	struct rt_dict *dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic)
+{
+	struct rt_value *k;
+
+	if (ic->stamp == 0)
+		return false;
+
+	/* A shaped dictionary has the same key index as the cached shape. */
+	if (dict->shape != NULL)
+		return ic->stamp == dict->shape->id;
+
+	if (ic->slot >= dict->alloc_size)
+		return false;
+
+	k = &dict->key[ic->slot];
+	if (k->type != NOCT_VALUE_STRING)
+		return false;
+	if (k->val.str->hash != hash || k->val.str->len != len)
+		return false;
+	if (strcmp(k->val.str->data, key) != 0)
+		return false;
+
+	return true;
+}
+
 /*
  * Stores a key-value-pair to a dictionary.
  */
@@ -1550,8 +2266,9 @@ rt_set_dict_elem_with_hash(
 	uint32_t hash,
 	struct rt_value *val)
 {
-	struct rt_dict *real_dict, *append_dict;
-	uint32_t index, i;
+	struct rt_dict *real_dict;
+	uint32_t i;
+	bool ret;
 
 	assert(env != NULL);
 	assert(dict != NULL);
@@ -1562,115 +2279,358 @@ rt_set_dict_elem_with_hash(
 
 	ACQUIRE_OBJ(*dict, real_dict);
 
-	/* Search for the key to replace the value. */
-	index = hash & ((uint32_t)real_dict->alloc_size - 1);
-	for (i = index;
-	     i != ((index - 1 + real_dict->alloc_size) & (real_dict->alloc_size - 1));
-	     i = (i + 1) & ((uint32_t)real_dict->alloc_size - 1)) {
-		if (IS_DICT_KEY_REMOVED(real_dict->key[i]) ||
-		    IS_DICT_KEY_EMPTY(real_dict->key[i]))
-			break;
+	/* Search for the key to replace the value. */
+	if (rt_find_dict_slot(real_dict, key, len, hash, &i)) {
+		/* Found, replace the value. */
+		real_dict->value[i] = *val;
+
+		/* GC: Write barrier for the remember set. */
+		if (val->type == NOCT_VALUE_STRING ||
+		    val->type == NOCT_VALUE_ARRAY ||
+		    val->type == NOCT_VALUE_DICT)
+			rt_gc_dict_write_barrier(env, real_dict, val);
+
+		RELEASE_OBJ(real_dict);
+		return true;
+	}
+
+	/* Key doesn't exist. Add new one. */
+	if (real_dict->shape != NULL)
+		ret = rt_append_shaped_dict_elem(env, &real_dict, dict, key, len, hash, val);
+	else
+		ret = rt_append_hash_dict_elem(env, &real_dict, dict, key, len, hash, val);
+
+	/* Publication. (In case of expand, the new dictionaty will appear to other threads.) */
+	RELEASE_OBJ(real_dict);
+	return ret;
+}
+
+/*
+ * Append a key to a shaped dictionary.
+ *  - *real_dict_pp is the acquired one, and is updated if it moves.
+ */
+static bool
+rt_append_shaped_dict_elem(
+	struct rt_env *env,
+	struct rt_dict **real_dict_pp,
+	struct rt_dict **dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_value *val)
+{
+	struct rt_dict *d;
+	struct rt_shape *next;
+
+	/* Get the next shape. (This may run a GC.) */
+	next = NULL;
+	if ((*real_dict_pp)->size < RT_SHAPE_KEY_MAX) {
+		if (!rt_get_shape_transition(env, (*real_dict_pp)->shape, key, len, hash, &next))
+			return false;
+
+		/* Reload the dictionary that a GC may have moved. */
+		RELOAD_OBJ(*dict, *real_dict_pp);
+	}
+
+	/* If the shape can't grow, fall back to a hash table. */
+	if (next == NULL)
+		return rt_append_hash_dict_elem(env, real_dict_pp, dict, key, len, hash, val);
+
+	/* Expand the value vector if full. */
+	d = *real_dict_pp;
+	if (d->size == d->alloc_size) {
+		if (!rt_expand_dict(env, real_dict_pp, dict))
+			return false;
+
+		/* Get the new dictionary which is only visible to this thread until a publication. */
+		d = *dict;
+	}
+	assert(d->size < d->alloc_size);
+
+	/* Append. (The key is in the shape.) */
+	d->value[d->size] = *val;
+	d->size++;
+	d->shape = next;
+
+	/* GC: Write barrier for the remember set. */
+	if (val->type == NOCT_VALUE_STRING ||
+	    val->type == NOCT_VALUE_ARRAY ||
+	    val->type == NOCT_VALUE_DICT)
+		rt_gc_dict_write_barrier(env, d, val);
+
+	return true;
+}
+
+/*
+ * Append a key to a hash table dictionary.
+ *  - A shaped dictionary is made a hash table.
+ *  - *real_dict_pp is the acquired one, and is updated if it moves.
+ */
+static bool
+rt_append_hash_dict_elem(
+	struct rt_env *env,
+	struct rt_dict **real_dict_pp,
+	struct rt_dict **dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_value *val)
+{
+	struct rt_dict *d;
+	struct rt_value key_val;
+	uint32_t index, i;
+
+	/* Make a key value. (Pinned because the expand below may run a GC.) */
+	key_val.type = NOCT_VALUE_INT;
+	if (!rt_gc_pin_local(env, &key_val))
+		return false;
+	if (!rt_make_dict_key(env, &key_val, key, len, hash)) {
+		rt_gc_unpin_local(env, &key_val);
+		return false;
+	}
+	RELOAD_OBJ(*dict, *real_dict_pp);
+
+	/* Make a hash table, or expand the size if 75% is used. */
+	d = *real_dict_pp;
+	if (d->shape != NULL || d->size >= d->alloc_size / 4 * 3) {
+		/* Reallocate a dictionary. */
+		if (d->shape != NULL ?
+		    !rt_unshape_dict(env, real_dict_pp, dict) :
+		    !rt_expand_dict(env, real_dict_pp, dict)) {
+			rt_gc_unpin_local(env, &key_val);
+			return false;
+		}
+
+		/* Get the new dictionary which is only visible to this thread until a publication. */
+		d = *dict;
+	}
+	assert(d->size < d->alloc_size);
+	rt_gc_unpin_local(env, &key_val);
+
+	/* Append. */
+	index = hash & ((uint32_t)d->alloc_size - 1);
+	for (i = index;
+	     i != ((index - 1 + d->alloc_size) & (d->alloc_size - 1));
+	     i = (i + 1) & ((uint32_t)d->alloc_size - 1)) {
+		if (IS_DICT_KEY_REMOVED(d->key[i]) ||
+		    IS_DICT_KEY_EMPTY(d->key[i])) {
+			d->key[i] = key_val;
+			d->value[i] = *val;
+			break;
+		}
+	}
+	d->size++;
+
+	/* GC: Write barrier for the remember set. (The key is always a string.) */
+	rt_gc_dict_write_barrier(env, d, &d->key[i]);
+	if (val->type == NOCT_VALUE_STRING ||
+	    val->type == NOCT_VALUE_ARRAY ||
+	    val->type == NOCT_VALUE_DICT)
+		rt_gc_dict_write_barrier(env, d, val);
+
+	return true;
+}
+
+/*
+ * Make a key string.
+ *  - The key may be the data of a young string that the allocation
+ *    moves by a young GC, so copy it out first.
+ */
+static bool
+rt_make_dict_key(
+	struct rt_env *env,
+	struct rt_value *val,
+	const char *key,
+	size_t len,
+	uint32_t hash)
+{
+	char buf[RT_NUMBER_BUF_SIZE];
+	char *tmp;
+	bool ret;
+
+	if (len <= sizeof(buf)) {
+		tmp = buf;
+	} else {
+		tmp = noct_malloc(len);
+		if (tmp == NULL) {
+			rt_out_of_memory(env);
+			return false;
+		}
+	}
+	memcpy(tmp, key, len);
+
+	ret = rt_make_string_with_hash(env, val, tmp, len, hash);
+
+	if (tmp != buf)
+		noct_free(tmp);
+
+	return ret;
+}
+
+/*
+ * Stores a key-value-pair to a dictionary. (inline cache version)
+ */
+bool
+rt_set_dict_elem_with_cache(
+	struct rt_env *env,
+	struct rt_dict **dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val)
+{
+	struct rt_dict *real_dict;
+	uint32_t i;
+
+	assert(ic != NULL);
+
+	ACQUIRE_OBJ(*dict, real_dict);
+
+	/* Hit: replace the value at the cached slot. */
+	if (rt_check_dict_slot(real_dict, key, len, hash, ic)) {
+		real_dict->value[ic->slot] = *val;
+
+		/* GC: Write barrier for the remember set. */
+		if (val->type == NOCT_VALUE_STRING ||
+		    val->type == NOCT_VALUE_ARRAY ||
+		    val->type == NOCT_VALUE_DICT)
+			rt_gc_dict_write_barrier(env, real_dict, val);
+
+		RELEASE_OBJ(real_dict);
+		return true;
+	}
+	RELEASE_OBJ(real_dict);
+
+	/* Miss: store and remember the slot. */
+	if (!rt_set_dict_elem_with_hash(env, dict, key, len, hash, val))
+		return false;
+
+	ACQUIRE_OBJ(*dict, real_dict);
+	if (rt_find_dict_slot(real_dict, key, len, hash, &i)) {
+		ic->stamp = real_dict->shape != NULL ? real_dict->shape->id : 1;
+		ic->slot = i;
+	}
+	RELEASE_OBJ(real_dict);
+
+	return true;
+}
+
+/*
+ * Expand a dictionary.
+ *  - The allocation may run a GC that moves the old dictionary.
+ *    *old_dict_pp is updated to the moved one, which the caller releases.
+ */
+static bool
+rt_expand_dict(
+	struct rt_env *env,
+	struct rt_dict **old_dict_pp,
+	struct rt_dict **new_dict_pp)
+{
+	struct rt_dict *old_dict, *new_dict;
+	size_t old_size, new_size;
+	uint32_t index, i, j;
+
+	assert(env != NULL);
+	assert(old_dict_pp != NULL);
+	assert(*old_dict_pp != NULL);
+	assert((*old_dict_pp)->newer == NULL);
+	assert(new_dict_pp != NULL);
+
+	old_size = (*old_dict_pp)->alloc_size;
+	new_size = old_size * 2;
 
-		/* Make a hash cache. */
-		if (real_dict->key[i].val.str->hash == 0)
-			real_dict->key[i].val.str->hash = rt_string_hash(real_dict->key[i].val.str->data);
-
-		if (real_dict->key[i].val.str->len == len &&
-		    real_dict->key[i].val.str->hash == hash &&
-		    strcmp(real_dict->key[i].val.str->data, key) == 0) {
-			/* Found, replace the value. */
-			real_dict->value[i] = *val;
-			RELEASE_OBJ(real_dict);
-			return true;
-		}
+	/* Allocate the new dictionary. */
+	new_dict = rt_gc_alloc_dict(env, new_size, (*old_dict_pp)->shape);
+	if (new_dict == NULL) {
+		rt_out_of_memory(env);
+		return false;
 	}
+	RELOAD_OBJ(*new_dict_pp, *old_dict_pp);
+	old_dict = *old_dict_pp;
 
-	/* Key doesn't exist. Add new one. */
-
-	/* Expand the size if 75% is used. */
-	if (real_dict->size >= real_dict->alloc_size / 4 * 3) {
-		/* Reallocate a dictionary. */
-		if (!rt_expand_dict(env, real_dict, dict)) {
-			RELEASE_OBJ(real_dict);
-			return false;
+	if (old_dict->shape != NULL) {
+		/* Copy the values with write barrier. */
+		for (i = 0; i < old_dict->size; i++) {
+			new_dict->value[i] = old_dict->value[i];
+			rt_gc_dict_write_barrier(env, new_dict, &new_dict->value[i]);
 		}
-
-		/* Get the new dictionary which is only visible to this thread until a publication. */
-		append_dict = *dict;
 	} else {
-		append_dict = real_dict;
-	}
-	assert(append_dict->size < append_dict->alloc_size);
-
-	/* Append. */
-	index = hash & ((uint32_t)append_dict->alloc_size - 1);
-	for (i = index;
-	     i != ((index - 1 + append_dict->alloc_size) & (append_dict->alloc_size - 1));
-	     i = (i + 1) & ((uint32_t)append_dict->alloc_size - 1)) {
-		if (IS_DICT_KEY_REMOVED(append_dict->key[i]) ||
-		    IS_DICT_KEY_EMPTY(append_dict->key[i])) {
-			/* Make a key value. */
-			if (!rt_make_string_with_hash(env, &append_dict->key[i], key, len, hash)) {
-				RELEASE_OBJ(real_dict);
-				return false;
+		/* Rehash. (Copy the values with write barrier.) */
+		for (i = 0; i < old_size; i++) {
+			if (IS_DICT_KEY_REMOVED(old_dict->key[i]) || IS_DICT_KEY_EMPTY(old_dict->key[i]))
+				continue;
+
+			index = rt_string_hash(old_dict->key[i].val.str->data) & ((uint32_t)new_dict->alloc_size - 1);
+			for (j = index;
+			     j != ((index - 1 + new_dict->alloc_size) & (new_dict->alloc_size - 1));
+			     j = (j + 1) & ((uint32_t)new_dict->alloc_size - 1)) {
+				if (IS_DICT_KEY_EMPTY(new_dict->key[j])) {
+					/* Copy the key and values. */
+					new_dict->key[j] = old_dict->key[i];
+					new_dict->value[j] = old_dict->value[i];
+
+					/* Write barrier. */
+					rt_gc_dict_write_barrier(env, new_dict, &new_dict->key[j]);
+					rt_gc_dict_write_barrier(env, new_dict, &new_dict->value[j]);
+					break;
+				}
 			}
-			append_dict->value[i] = *val;
-			break;
 		}
 	}
-	append_dict->size++;
+	new_dict->size = old_dict->size;
 
-	/* GC: Write barrier for the remember set. */
-	if (val->type == NOCT_VALUE_STRING ||
-	    val->type == NOCT_VALUE_ARRAY ||
-	    val->type == NOCT_VALUE_DICT) {
-		rt_gc_dict_write_barrier(env, append_dict, &real_dict->key[real_dict->size]);
-		rt_gc_dict_write_barrier(env, append_dict, val);
-	}
+	/* Set the forwarding pointer. */
+	old_dict->newer = new_dict;
+
+	/* Set the result */
+	*new_dict_pp = new_dict;
 
-	/* Publication. (In case of expand, the new dictionaty will appear to other threads.) */
-	RELEASE_OBJ(real_dict);
 	return true;
 }
 
-/* Expand an array. */
+/*
+ * Make a shaped dictionary a hash table that has room for a new key.
+ *  - *old_dict_pp is updated as rt_expand_dict() does.
+ */
 static bool
-rt_expand_dict(
+rt_unshape_dict(
 	struct rt_env *env,
-	struct rt_dict *old_dict,
+	struct rt_dict **old_dict_pp,
 	struct rt_dict **new_dict_pp)
 {
-	struct rt_dict *new_dict;
-	size_t old_size, new_size;
+	struct rt_dict *old_dict, *new_dict;
+	struct rt_shape *shape;
+	size_t new_size;
 	uint32_t index, i, j;
 
-	assert(env != NULL);
-	assert(old_dict != NULL);
-	assert(old_dict->newer == NULL);
-	assert(new_dict_pp != NULL);
+	assert((*old_dict_pp)->shape != NULL);
+	assert((*old_dict_pp)->newer == NULL);
 
-	old_size = old_dict->alloc_size;
-	new_size = old_size * 2;
+	/* Keep the load factor under 75% after an append. */
+	new_size = 4;
+	while ((*old_dict_pp)->size + 1 > new_size / 4 * 3)
+		new_size *= 2;
 
-	/* Allocate the new array. */
-	new_dict = rt_gc_alloc_dict(env, new_size);
+	/* Allocate a hash table. */
+	new_dict = rt_gc_alloc_dict(env, new_size, NULL);
 	if (new_dict == NULL) {
 		rt_out_of_memory(env);
 		return false;
 	}
+	RELOAD_OBJ(*new_dict_pp, *old_dict_pp);
+	old_dict = *old_dict_pp;
 
-	/* Rehash. (Copy the values with write barrier.) */
-	for (i = 0; i < old_size; i++) {
-		if (IS_DICT_KEY_REMOVED(old_dict->key[i]) || IS_DICT_KEY_EMPTY(old_dict->key[i]))
-			continue;
-
-		index = rt_string_hash(old_dict->key[i].val.str->data) & ((uint32_t)new_dict->alloc_size - 1);
+	/* Insert the keys in the shape. (Copy the values with write barrier.) */
+	for (shape = old_dict->shape; shape->parent != NULL; shape = shape->parent) {
+		i = shape->count - 1;
+		index = shape->key.val.str->hash & ((uint32_t)new_dict->alloc_size - 1);
 		for (j = index;
 		     j != ((index - 1 + new_dict->alloc_size) & (new_dict->alloc_size - 1));
 		     j = (j + 1) & ((uint32_t)new_dict->alloc_size - 1)) {
 			if (IS_DICT_KEY_EMPTY(new_dict->key[j])) {
 				/* Copy the key and values. */
-				new_dict->key[j] = old_dict->key[i];
+				new_dict->key[j] = shape->key;
 				new_dict->value[j] = old_dict->value[i];
 
 				/* Write barrier. */
@@ -1697,7 +2657,7 @@ rt_expand_dict(
 bool
 rt_remove_dict_elem(
 	struct rt_env *env,
-	struct rt_dict *dict,
+	struct rt_dict **dict,
 	const char *key)
 {
 	size_t len;
@@ -1717,56 +2677,58 @@ rt_remove_dict_elem(
 bool
 rt_remove_dict_elem_with_hash(
 	struct rt_env *env,
-	struct rt_dict *dict,
+	struct rt_dict **dict,
 	const char *key,
 	size_t len,
 	uint32_t hash)
 {
-	struct rt_dict *real_dict;
-	uint32_t index, i;
+	struct rt_dict *real_dict, *d;
+	uint32_t i;
 
 	assert(env != NULL);
 	assert(dict != NULL);
+	assert(*dict != NULL);
 	assert(key != NULL);
 	assert(hash != 0);
 
-	ACQUIRE_OBJ(dict, real_dict);
+	ACQUIRE_OBJ(*dict, real_dict);
 
 	/* Search for the key. */
-	index = hash & ((uint32_t)real_dict->alloc_size - 1);
-	for (i = index;
-	     i != ((index - 1 + real_dict->alloc_size) & (real_dict->alloc_size - 1));
-	     i = (i + 1) & ((uint32_t)real_dict->alloc_size - 1)) {
-		if (IS_DICT_KEY_REMOVED(real_dict->key[i]))
-			continue;
-		if (IS_DICT_KEY_EMPTY(real_dict->key[i]))
-			break;
+	if (!rt_find_dict_slot(real_dict, key, len, hash, &i)) {
+		/* Not found. */
+		RELEASE_OBJ(real_dict);
+		rt_error(env, N_TR("Dictionary key \"%s\" not found."), key);
+		return false;
+	}
 
-		/* Make a hash cache. */
-		if (real_dict->key[i].val.str->hash == 0)
-			real_dict->key[i].val.str->hash = rt_string_hash(real_dict->key[i].val.str->data);
-		
-		if (real_dict->key[i].val.str->len == len &&
-		    real_dict->key[i].val.str->hash == hash &&
-		    strcmp(real_dict->key[i].val.str->data, key) == 0) {
-			REMOVE_DICT_KEY(real_dict->key[i]);
-			real_dict->value[i].type = NOCT_VALUE_INT;
-			real_dict->value[i].val.i = 0;
-
-			/* Succeeded. */
+	/* A shaped dictionary becomes a hash table. */
+	d = real_dict;
+	if (real_dict->shape != NULL) {
+		if (!rt_unshape_dict(env, &real_dict, dict)) {
 			RELEASE_OBJ(real_dict);
-			return true;
+			return false;
+		}
+		d = *dict;
+		if (!rt_find_dict_slot(d, key, len, hash, &i)) {
+			assert(NEVER_COME_HERE);
+			RELEASE_OBJ(real_dict);
+			return false;
 		}
 	}
 
-	/* Not found. */
-	RELEASE_OBJ(d);
-	rt_error(env, N_TR("Dictionary key \"%s\" not found."), key);
-	return false;
+	REMOVE_DICT_KEY(d->key[i]);
+	d->value[i].type = NOCT_VALUE_INT;
+	d->value[i].val.i = 0;
+	d->size--;
+
+	/* Succeeded. */
+	RELEASE_OBJ(real_dict);
+	return true;
 }
 
 /*
  * Make a shallow copy of a dictionary.
+ *  - A shaped dictionary shares the shape with the copy.
  */
 bool
 rt_make_dict_copy(
@@ -1784,7 +2746,7 @@ rt_make_dict_copy(
 	ACQUIRE_OBJ(src, src_real);
 
 	/* Make a dictionary */
-	d = rt_gc_alloc_dict(env, src_real->alloc_size);
+	d = rt_gc_alloc_dict(env, src_real->alloc_size, src_real->shape);
 	if (d == NULL) {
 		RELEASE_OBJ(src_real);
 		return false;
@@ -1793,16 +2755,18 @@ rt_make_dict_copy(
 	/* Copy the array with write-barrier. */
 	d->size = src_real->size;
 	for (i = 0; i < (int)src_real->alloc_size; i++) {
-		if (!IS_DICT_KEY_REMOVED(src_real->key[i]) &&
-		    !IS_DICT_KEY_EMPTY(src_real->key[i])) {
-			/* Copy the key and value. */
-			d->key[i] = src_real->key[i];
-			d->value[i] = src_real->value[i];
+		if (!RT_DICT_SLOT_USED(src_real, (size_t)i))
+			continue;
 
-			/* Write barrier. */
+		/* Copy the key and value. */
+		if (src_real->shape == NULL) {
+			d->key[i] = src_real->key[i];
 			rt_gc_dict_write_barrier(env, d, &d->key[i]);
-			rt_gc_dict_write_barrier(env, d, &d->value[i]);
 		}
+		d->value[i] = src_real->value[i];
+
+		/* Write barrier. */
+		rt_gc_dict_write_barrier(env, d, &d->value[i]);
 	}
 
 	RELEASE_OBJ(src_real);
@@ -1812,6 +2776,156 @@ rt_make_dict_copy(
 	return true;
 }
 
+/*
+ * Dictionary Shapes
+ */
+
+/* Find the index of a key in a shape. */
+static bool
+rt_find_shape_index(
+	struct rt_shape *shape,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	uint32_t *index)
+{
+	struct rt_string *s;
+
+	/* Walk the keys from the last one. */
+	for (; shape->parent != NULL; shape = shape->parent) {
+		s = shape->key.val.str;
+		if (s->hash == hash &&
+		    s->len == len &&
+		    strcmp(s->data, key) == 0) {
+			*index = shape->count - 1;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Get the shape that added the key of an index. */
+static struct rt_shape *
+rt_get_shape_by_index(
+	struct rt_shape *shape,
+	uint32_t index)
+{
+	assert(index < shape->count);
+
+	while (shape->count > index + 1)
+		shape = shape->parent;
+
+	return shape;
+}
+
+/* Find a transition of a shape by a key. */
+static struct rt_shape *
+rt_find_shape_transition(
+	struct rt_shape *shape,
+	const char *key,
+	size_t len,
+	uint32_t hash)
+{
+	struct rt_shape *child;
+	struct rt_string *s;
+
+	for (child = shape->child; child != NULL; child = child->sibling) {
+		s = child->key.val.str;
+		if (s->hash == hash &&
+		    s->len == len &&
+		    strcmp(s->data, key) == 0)
+			return child;
+	}
+
+	return NULL;
+}
+
+/*
+ * Get a transition of a shape by a key, and add it if not exists.
+ *  - *next is NULL if there are too many shapes.
+ *  - This may run a GC to make the key string.
+ */
+static bool
+rt_get_shape_transition(
+	struct rt_env *env,
+	struct rt_shape *shape,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_shape **next)
+{
+	struct rt_shape *new_shape;
+
+	/* Search. */
+	ACQUIRE_SHAPE();
+	*next = rt_find_shape_transition(shape, key, len, hash);
+	RELEASE_SHAPE();
+	if (*next != NULL)
+		return true;
+
+	/* Limit the number of the shapes. */
+	if (env->vm->shape_count >= RT_SHAPE_MAX)
+		return true;
+
+	/* Allocate a shape. */
+	new_shape = noct_malloc(sizeof(struct rt_shape));
+	if (new_shape == NULL) {
+		rt_out_of_memory(env);
+		return false;
+	}
+	memset(new_shape, 0, sizeof(struct rt_shape));
+
+	/* Make the key string. (Not a GC root until linked below.) */
+	if (!rt_make_dict_key(env, &new_shape->key, key, len, hash)) {
+		noct_free(new_shape);
+		return false;
+	}
+
+	ACQUIRE_SHAPE();
+
+	/* Another thread may have added the same transition. */
+	*next = rt_find_shape_transition(shape,
+					 new_shape->key.val.str->data,
+					 len,
+					 hash);
+	if (*next != NULL) {
+		RELEASE_SHAPE();
+		noct_free(new_shape);
+		return true;
+	}
+
+	/* Link. */
+	new_shape->parent = shape;
+	new_shape->count = shape->count + 1;
+	new_shape->id = RT_SHAPE_ID_EMPTY + ++env->vm->shape_count;
+	new_shape->sibling = shape->child;
+	shape->child = new_shape;
+	new_shape->next = env->vm->shape_list;
+	env->vm->shape_list = new_shape;
+
+	RELEASE_SHAPE();
+
+	*next = new_shape;
+	return true;
+}
+
+/* Free the shapes. */
+static void
+rt_cleanup_shapes(
+	struct rt_vm *vm)
+{
+	struct rt_shape *shape, *next;
+
+	shape = vm->shape_list;
+	while (shape != NULL) {
+		next = shape->next;
+		noct_free(shape);
+		shape = next;
+	}
+	vm->shape_list = NULL;
+}
+
 /*
  * Global Variable
  */
@@ -1854,6 +2968,7 @@ rt_init_global(
 
 	env->vm->global_alloc_size = START_SIZE;
 	env->vm->global_size = 0;
+	env->vm->global_version = 1;
 
 	return true;
 }
@@ -1952,35 +3067,60 @@ rt_get_global_with_hash(
 	uint32_t hash,
 	struct rt_value *val)
 {
-	uint32_t index, i;
+	uint32_t i;
 
 	ACQUIRE_GLOBAL();
 
-	index = hash & ((uint32_t)env->vm->global_alloc_size - 1) ;
-	for (i = index;
-	     i != ((index - 1 + env->vm->global_alloc_size) & (env->vm->global_alloc_size - 1));
-	     i = (i + 1) & (env->vm->global_alloc_size - 1)) {
-		if (env->vm->global[i].is_removed)
-			continue;
-		if (env->vm->global[i].name == NULL)
-			break;
-		if (env->vm->global[i].name_len != len)
-			continue;
-		if (env->vm->global[i].name_hash != hash)
-			continue;
-		if (strcmp(env->vm->global[i].name, name) != 0)
-			continue;
+	if (!rt_find_global_slot(env, name, len, hash, &i)) {
+		/* Not found. */
+		RELEASE_GLOBAL();
+		rt_error(env, N_TR("Symbol \"%s\" not found."), name);
+		return false;
+	}
 
-		/* Found. */
-		*val = env->vm->global[i].val;
+	/* Found. */
+	*val = env->vm->global[i].val;
+	RELEASE_GLOBAL();
+	return true;
+}
+
+/*
+ * Get a global variable. (inline cache version)
+ */
+bool
+rt_get_global_with_cache(
+	struct rt_env *env,
+	const char *name,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val)
+{
+	uint32_t i;
+
+	assert(ic != NULL);
+
+	ACQUIRE_GLOBAL();
+
+	/* Hit: the table has not moved since the slot was cached. */
+	if (ic->stamp == env->vm->global_version) {
+		*val = env->vm->global[ic->slot].val;
 		RELEASE_GLOBAL();
 		return true;
 	}
 
-	/* Not found. */
+	/* Miss: probe and remember the slot. */
+	if (!rt_find_global_slot(env, name, len, hash, &i)) {
+		RELEASE_GLOBAL();
+		rt_error(env, N_TR("Symbol \"%s\" not found."), name);
+		return false;
+	}
+	ic->stamp = env->vm->global_version;
+	ic->slot = i;
+
+	*val = env->vm->global[i].val;
 	RELEASE_GLOBAL();
-	rt_error(env, N_TR("Symbol \"%s\" not found."), name);
-	return false;
+	return true;
 }
 
 /*
@@ -2066,6 +3206,79 @@ rt_set_global_with_hash(
 	return false;
 }
 
+/*
+ * Set a global variable. (inline cache version)
+ */
+bool
+rt_set_global_with_cache(
+	struct rt_env *env,
+	const char *name,
+	size_t len,		/* Including NUL. */
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val)
+{
+	uint32_t i;
+
+	assert(ic != NULL);
+
+	ACQUIRE_GLOBAL();
+
+	/* Hit: overwrite the cached slot. */
+	if (ic->stamp == env->vm->global_version) {
+		env->vm->global[ic->slot].val = *val;
+		RELEASE_GLOBAL();
+		return true;
+	}
+	RELEASE_GLOBAL();
+
+	/* Miss: store and remember the slot. */
+	if (!rt_set_global_with_hash(env, name, len, hash, val))
+		return false;
+
+	ACQUIRE_GLOBAL();
+	if (rt_find_global_slot(env, name, len, hash, &i)) {
+		ic->stamp = env->vm->global_version;
+		ic->slot = i;
+	}
+	RELEASE_GLOBAL();
+
+	return true;
+}
+
+/* Find the slot of a global variable. (The caller holds the lock.) */
+static bool
+rt_find_global_slot(
+	struct rt_env *env,
+	const char *name,
+	size_t len,
+	uint32_t hash,
+	uint32_t *slot)
+{
+	uint32_t index, i;
+
+	index = hash & ((uint32_t)env->vm->global_alloc_size - 1) ;
+	for (i = index;
+	     i != ((index - 1 + env->vm->global_alloc_size) & (env->vm->global_alloc_size - 1));
+	     i = (i + 1) & (env->vm->global_alloc_size - 1)) {
+		if (env->vm->global[i].is_removed)
+			continue;
+		if (env->vm->global[i].name == NULL)
+			break;
+		if (env->vm->global[i].name_len != len)
+			continue;
+		if (env->vm->global[i].name_hash != hash)
+			continue;
+		if (strcmp(env->vm->global[i].name, name) != 0)
+			continue;
+
+		*slot = i;
+		return true;
+	}
+
+	return false;
+}
+
 /* Expand the global variable table. */
 static bool
 rt_expand_global(
@@ -2106,6 +3319,9 @@ rt_expand_global(
 	env->vm->global = new_tbl;
 	env->vm->global_alloc_size = new_size;
 
+	/* Invalidate the inline caches. */
+	env->vm->global_version++;
+
 	return true;
 }
 
@@ -2202,7 +3418,7 @@ const char *
 rt_get_error_file(
 	struct rt_env *env)
 {
-	return &env->file_name[0];
+	return env->file_name;
 }
 
 /*
@@ -15,22 +15,60 @@
 #include <noct/noct.h>
 #include "gc.h"
 
+/*
+ * Initial size of the frame table. (grows)
+ */
+#define RT_FRAME_INIT		32
+
 /*
  * Maximum number of the stack depth.
+ *  - A call also uses the C stack, that RT_C_STACK_MAX limits too.
+ */
+#define RT_FRAME_MAX		1024
+
+/*
+ * Maximum size of the C stack that the nested calls use.
+ *  - This stops a deep recursion before the C stack overflows. It
+ *    fits in a 1MB stack, with the frames of the host.
+ *  - On Emscripten, the free size of the C stack is checked instead,
+ *    because the stack size is set at link time. (64KB by default)
  */
-#define RT_FRAME_MAX		32
+#if !defined(RT_C_STACK_MAX)
+#define RT_C_STACK_MAX		(768 * 1024)
+#endif
+#define RT_C_STACK_MARGIN	(16 * 1024)
 
 /*
- * Maximum number of the tmpvar in a stack.
+ * Number of the tmpvar in the bottom frame, used by the C API.
  */
 #define RT_TMPVAR_MAX		128
 
+/*
+ * Minimum number of the tmpvar in a stack chunk.
+ */
+#define RT_STACK_CHUNK_SIZE	2048
+
 /*
  * Maximum number of the C pinned variables.
  */
 #define RT_GLOBAL_PIN_MAX	64
 #define RT_LOCAL_PIN_MAX	32
 
+/*
+ * Buffer size for a number formatted by rt_format_number().
+ */
+#define RT_NUMBER_BUF_SIZE	64
+
+/*
+ * Maximum number of the keys in a shaped dictionary.
+ */
+#define RT_SHAPE_KEY_MAX	16
+
+/*
+ * Maximum number of the dictionary shapes in a VM.
+ */
+#define RT_SHAPE_MAX		4096
+
 struct rt_vm;
 struct rt_env;
 struct rt_frame;
@@ -39,6 +77,7 @@ struct rt_object_header;
 struct rt_string;
 struct rt_array;
 struct rt_dict;
+struct rt_shape;
 struct rt_func;
 struct rt_bindglobal;
 
@@ -79,6 +118,10 @@ struct rt_array {
 
 /*
  * Dictionary object.
+ *  - A dictionary starts as a shaped one that has a shape and a value
+ *    vector. The value of the key index i is value[i].
+ *  - It becomes a hash table when a key is removed, or when the shape
+ *    can't grow. (open addressing on key and value)
  */
 struct rt_dict {
 	struct rt_gc_object head;
@@ -89,12 +132,15 @@ struct rt_dict {
 	/* Current used elements. */
 	size_t size;
 
-	/* Key table. */
+	/* Key table. (NULL if shaped) */
 	struct rt_value *key;
 
 	/* Value table. */
 	struct rt_value *value;
 
+	/* Shape. (NULL if a hash table) */
+	struct rt_shape *shape;
+
 	/* Copy-On-Resize forwarding. (RCU-style) */
 	struct rt_dict *newer;
 
@@ -106,6 +152,57 @@ struct rt_dict {
 
 #define RT_DICT_KEY_REMOVED ((struct rt_value *)((intptr_t)-1))
 
+/* Check if a dictionary slot is in use. */
+#define RT_DICT_SLOT_USED(d, i)	((d)->shape != NULL ? (i) < (d)->size : (d)->key[i].type == NOCT_VALUE_STRING)
+
+/*
+ * Dictionary shape. (hidden class)
+ *  - A shape is a key layout shared by the dictionaries that got the
+ *    same keys in the same order.
+ *  - Shapes form a transition tree from the empty shape, and live
+ *    until the VM is destroyed. The keys are GC roots.
+ */
+struct rt_shape {
+	/* Parent shape. (NULL for the empty shape) */
+	struct rt_shape *parent;
+
+	/* Key added by the transition from the parent. (a string) */
+	struct rt_value key;
+
+	/* Number of the keys. (The index of the key is count - 1.) */
+	uint32_t count;
+
+	/* Unique ID. (for inline caches) */
+	uint32_t id;
+
+	/* Transitions. (the first child and the siblings) */
+	struct rt_shape *child;
+	struct rt_shape *sibling;
+
+	/* Shape list. */
+	struct rt_shape *next;
+};
+
+/* The ID of the empty shape. (1 is for a hash table slot) */
+#define RT_SHAPE_ID_EMPTY	2
+
+/*
+ * Inline cache entry for a LOADSYMBOL/STORESYMBOL/LOADDOT/STOREDOT site.
+ */
+struct rt_inline_cache {
+	/*
+	 * Global table version (symbols), or for dots, 1 for a hash table
+	 * slot or a shape ID. (zero if invalid)
+	 */
+	uint32_t stamp;
+
+	/* Cached slot index. (or key index) */
+	uint32_t slot;
+};
+
+/* A site is keyed by its string operand offset divided by 8. */
+#define RT_INLINE_CACHE_SHIFT	3
+
 /*
  * Function object.
  */
@@ -123,6 +220,9 @@ struct rt_func {
 	uint8_t *bytecode;
 	uint32_t tmpvar_size;
 
+	/* Inline caches. (indexed by the string operand offset) */
+	struct rt_inline_cache *ic;
+
 	/* JIT-generated code. */
 	bool (CDECL *jit_code)(struct rt_env *env);
 	int call_count;
@@ -172,16 +272,35 @@ struct rt_frame {
 	 */
 	struct rt_func *func;
 
+	/*
+	 * Stack chunk that holds the tmpvar.
+	 */
+	struct rt_stack_chunk *chunk;
+
 	/*
 	 * Pinned C local variables.
 	 */
 	struct rt_value *pinned[RT_LOCAL_PIN_MAX];
 	uint32_t pinned_count;
+};
 
-	/*
-	 * tmpvar body.
-	 */
-	struct rt_value tmpvar_alloc[RT_TMPVAR_MAX];
+/*
+ * Stack chunk.
+ *  - The tmpvar of the frames are allocated contiguously in a chunk.
+ *  - A new chunk is linked when the current one is full, so that the
+ *    tmpvar never move. (JIT code keeps the tmpvar address.)
+ */
+struct rt_stack_chunk {
+	struct rt_stack_chunk *next;
+
+	/* Number of the values. */
+	uint32_t size;
+
+	/* Number of the used values. */
+	uint32_t top;
+
+	/* Values. (variable length) */
+	struct rt_value value[1];
 };
 
 /*
@@ -211,15 +330,34 @@ struct rt_env {
 	struct rt_vm *vm;
 
 	/*
-	 * Stack allocation table, referenced by the "frame" field.
+	 * Stack frame table, referenced by the "frame" field.
+	 *  - Grows on demand. A frame never moves once allocated.
 	 */
-	struct rt_frame frame_alloc[RT_FRAME_MAX];
+	struct rt_frame **frame_tbl;
+	int frame_tbl_size;
 	int cur_frame_index;
 
+	/*
+	 * C stack address at the first call from the bottom frame.
+	 */
+	char *c_stack_base;
+
+	/*
+	 * tmpvar stack. (a list of chunks)
+	 */
+	struct rt_stack_chunk *stack_bottom;
+	struct rt_stack_chunk *stack_top;
+
 	/*
 	 * Execution file name. Set by "rt_call()".
+	 *  - Points to the function's file name, or compile_file_name.
+	 */
+	const char *file_name;
+
+	/*
+	 * File name of a compile error.
 	 */
-	char file_name[256];
+	char compile_file_name[256];
 
 	/*
 	 * Error message. Set by "rt_error()".
@@ -246,6 +384,9 @@ struct rt_vm {
 	uint32_t global_size;
 	struct rt_bindglobal *global;
 
+	/* Incremented when the global table moves. (for inline caches) */
+	uint32_t global_version;
+
 	/* Function list. */
 	struct rt_func *func_list;
 
@@ -259,6 +400,11 @@ struct rt_vm {
 	struct rt_value *pinned[RT_GLOBAL_PIN_MAX];
 	uint32_t pinned_count;
 
+	/* Dictionary shapes. (the empty shape and the list of the others) */
+	struct rt_shape shape_empty;
+	struct rt_shape *shape_list;
+	uint32_t shape_count;
+
 	/* Is JIT code written and not commited? */
 	bool is_jit_dirty;
 
@@ -274,6 +420,9 @@ struct rt_vm {
 
 	/* Atomic counter for global variables. */
 	int global_var_counter;
+
+	/* Lock for shape transitions. */
+	int shape_lock;
 #endif
 };
 
@@ -310,6 +459,18 @@ rt_register_source(
 	const char *file_name,
 	const char *source_text);
 
+/*
+ * Register functions from a souce text, and return the equivalent
+ * bytecode image. The image must be freed by noct_free().
+ */
+bool
+rt_register_source_with_bytecode(
+	struct rt_env *env,
+	const char *file_name,
+	const char *source_text,
+	uint8_t **image,
+	size_t *image_size);
+
 /* Register functions from bytecode data. */
 bool
 rt_register_bytecode(
@@ -369,6 +530,20 @@ rt_make_string_with_hash(
 	size_t len,
 	uint32_t hash);
 
+/* Make a string value by concatenating two strings or numbers. */
+bool
+rt_make_string_concat(
+	struct rt_env *env,
+	struct rt_value *dst,
+	struct rt_value *src1,
+	struct rt_value *src2);
+
+/* Format an integer or a float as "+" does. Returns the length. */
+size_t
+rt_format_number(
+	struct rt_value *val,
+	char *buf);
+
 /* Cache the hash of a string. */
 void
 rt_cache_string_hash(
@@ -439,6 +614,13 @@ rt_make_empty_dict(
 	struct rt_env *env,
 	struct rt_value *val);
 
+/* Make an empty dictionary that has room for keys. */
+bool
+rt_make_dict_with_capacity(
+	struct rt_env *env,
+	struct rt_value *val,
+	uint32_t size);
+
 /* Get the size of a dictionary. */
 bool
 rt_get_dict_size(
@@ -470,6 +652,15 @@ rt_get_dict_value_by_index(
 	uint32_t index,
 	struct rt_value *val);
 
+/* Get a dictionary key-value pair by a cursor. */
+bool
+rt_get_dict_elem_by_cursor(
+	struct rt_env *env,
+	struct rt_dict *dict,
+	uint32_t *cursor,
+	struct rt_value *key,
+	struct rt_value *val);
+
 /* Retrieves the value by a key in a dictionary. */
 bool
 rt_get_dict_elem(
@@ -506,18 +697,40 @@ rt_set_dict_elem_with_hash(
 	uint32_t hash,
 	struct rt_value *val);
 
+/* Retrieves the value by a key in a dictionary. (inline cache version) */
+bool
+rt_get_dict_elem_with_cache(
+	struct rt_env *env,
+	struct rt_dict *dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val);
+
+/* Stores a key-value-pair to a dictionary. (inline cache version) */
+bool
+rt_set_dict_elem_with_cache(
+	struct rt_env *env,
+	struct rt_dict **dict,
+	const char *key,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val);
+
 /* Remove a dictionary key. */
 bool
 rt_remove_dict_elem(
 	struct rt_env *env,
-	struct rt_dict *dict,
+	struct rt_dict **dict,
 	const char *key);
 
 /* Remove a dictionary key. (hash version) */
 bool
 rt_remove_dict_elem_with_hash(
 	struct rt_env *env,
-	struct rt_dict *dict,
+	struct rt_dict **dict,
 	const char *key,
 	size_t len,
 	uint32_t hash);
@@ -571,6 +784,26 @@ rt_set_global_with_hash(
 	uint32_t hash,
 	struct rt_value *val);
 
+/* Get a global variable. (inline cache version) */
+bool
+rt_get_global_with_cache(
+	struct rt_env *env,
+	const char *name,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val);
+
+/* Set a global variable. (inline cache version) */
+bool
+rt_set_global_with_cache(
+	struct rt_env *env,
+	const char *name,
+	size_t len,
+	uint32_t hash,
+	struct rt_inline_cache *ic,
+	struct rt_value *val);
+
 /*
  * FFI Pin
  */
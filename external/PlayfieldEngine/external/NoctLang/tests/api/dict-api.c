@@ -0,0 +1,247 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Noct Programming Language
+ * Copyright (c) 2025, 2026, Awe Morris
+ */
+
+/*
+ * API Tests: noct_make_dict_with_capacity() and noct_get_dict_elem_by_cursor()
+ */
+
+#include <noct/noct.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Capacities: empty, shaped, the shape limit, and hash tables. */
+static const uint32_t capacities[] = { 0, 1, 2, 16, 17, 100, 5000 };
+
+static int failures;
+
+static void
+check(
+	bool cond,
+	const char *name,
+	uint32_t cap,
+	uint32_t n)
+{
+	if (!cond) {
+		printf("FAIL: %s (capacity %u, keys %u)\n", name, cap, n);
+		failures++;
+	}
+}
+
+/*
+ * Traverse a dictionary by the cursor, and check that every key is
+ * visited once with its value, in the order of the index functions.
+ * (Nothing here allocates, so the values need no pins.)
+ */
+static bool
+traverse(
+	NoctEnv *env,
+	NoctValue *dict,
+	uint32_t n,
+	uint32_t removed)
+{
+	NoctValue k, v, k2, v2;
+	const char *s, *s2;
+	char *seen;
+	uint32_t size, cursor, i, id;
+	int val;
+
+	if (!noct_get_dict_size(env, dict, &size) || size != n)
+		return false;
+
+	seen = calloc(1, n + removed + 1);
+	if (seen == NULL)
+		return false;
+
+	cursor = 0;
+	for (i = 0; i < size; i++) {
+		if (!noct_get_dict_elem_by_cursor(env, dict, &cursor, &k, &v) ||
+		    !noct_get_string(env, &k, &s) ||
+		    !noct_get_int(env, &v, &val))
+			break;
+
+		/* The value is the key number, and the key is new. */
+		id = (uint32_t)atoi(s + 1);
+		if (s[0] != 'k' || (int)id != val || id >= n + removed || seen[id])
+			break;
+		seen[id] = 1;
+
+		/* Same as the index functions. */
+		if (!noct_get_dict_key_by_index(env, dict, i, &k2) ||
+		    !noct_get_dict_value_by_index(env, dict, i, &v2) ||
+		    !noct_get_string(env, &k2, &s2) ||
+		    strcmp(s, s2) != 0)
+			break;
+	}
+	free(seen);
+	if (i != size)
+		return false;
+
+	/* The cursor stops at the end. */
+	if (noct_get_dict_elem_by_cursor(env, dict, &cursor, &k, &v))
+		return false;
+
+	return true;
+}
+
+/* Make a dictionary with a capacity, add keys, and check it. */
+static void
+test_capacity(
+	NoctEnv *env,
+	uint32_t cap,
+	uint32_t n)
+{
+	NoctValue dict, v;
+	char key[32];
+	uint32_t i;
+	int val;
+
+	if (!noct_pin_local(env, 2, &dict, &v)) {
+		check(false, "pin", cap, n);
+		return;
+	}
+
+	check(noct_make_dict_with_capacity(env, &dict, cap), "make", cap, n);
+	check(traverse(env, &dict, 0, 0), "empty", cap, n);
+
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "k%u", i);
+		if (!noct_make_int(env, &v, (int)i) ||
+		    !noct_set_dict_elem(env, &dict, key, &v)) {
+			check(false, "set", cap, n);
+			break;
+		}
+	}
+	check(traverse(env, &dict, n, 0), "traverse", cap, n);
+
+	/* Lookups by the keys. */
+	for (i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "k%u", i);
+		if (!noct_get_dict_elem(env, &dict, key, &v) ||
+		    !noct_get_int(env, &v, &val) ||
+		    val != (int)i) {
+			check(false, "lookup", cap, n);
+			break;
+		}
+	}
+
+	/* The dictionary survives a GC. */
+	noct_full_gc(env);
+	check(traverse(env, &dict, n, 0), "gc", cap, n);
+
+	/* A removal leaves a hole that the cursor skips. */
+	if (n > 0) {
+		check(noct_remove_dict_elem(env, &dict, "k0"), "remove", cap, n);
+		check(traverse(env, &dict, n - 1, 1), "removed", cap, n);
+	}
+
+	noct_unpin_local(env, 2, &dict, &v);
+}
+
+/* Up to 16 keys, the cursor follows the order of the additions. */
+static void
+test_order(
+	NoctEnv *env)
+{
+	NoctValue dict, k, v;
+	const char *s;
+	char key[32];
+	uint32_t cursor;
+	int i;
+
+	if (!noct_pin_local(env, 3, &dict, &k, &v)) {
+		check(false, "pin", 16, 16);
+		return;
+	}
+	check(noct_make_dict_with_capacity(env, &dict, 16), "make", 16, 16);
+	for (i = 15; i >= 0; i--) {
+		snprintf(key, sizeof(key), "k%d", i);
+		if (!noct_make_int(env, &v, i) ||
+		    !noct_set_dict_elem(env, &dict, key, &v)) {
+			check(false, "order set", 16, 16);
+			break;
+		}
+	}
+	cursor = 0;
+	for (i = 15; i >= 0; i--) {
+		snprintf(key, sizeof(key), "k%d", i);
+		if (!noct_get_dict_elem_by_cursor(env, &dict, &cursor, &k, &v) ||
+		    !noct_get_string(env, &k, &s) ||
+		    strcmp(s, key) != 0) {
+			check(false, "order", 16, 16);
+			break;
+		}
+	}
+
+	noct_unpin_local(env, 3, &dict, &k, &v);
+}
+
+/* A non-dictionary is an error. */
+static void
+test_type(
+	NoctEnv *env)
+{
+	NoctValue a, k, v;
+	uint32_t cursor;
+
+	cursor = 0;
+	check(noct_make_int(env, &a, 1) &&
+	      !noct_get_dict_elem_by_cursor(env, &a, &cursor, &k, &v),
+	      "type", 0, 0);
+}
+
+/* test() */
+static bool
+cfunc_test(
+	NoctEnv *env)
+{
+	uint32_t i, cap;
+
+	/* Fewer keys, as many keys, and more keys than the capacity. */
+	for (i = 0; i < sizeof(capacities) / sizeof(capacities[0]); i++) {
+		cap = capacities[i];
+		test_capacity(env, cap, 0);
+		test_capacity(env, cap, 1);
+		test_capacity(env, cap, 17);
+		test_capacity(env, cap, cap);
+		test_capacity(env, cap, cap + 50);
+	}
+	test_order(env);
+	test_type(env);
+
+	return true;
+}
+
+int
+main(void)
+{
+	static const char *src = "func main() { test(); }";
+	NoctVM *vm;
+	NoctEnv *env;
+	NoctValue ret;
+	const char *msg;
+
+	if (!noct_create_vm(&vm, &env, NULL))
+		return 1;
+	if (!noct_register_cfunc(env, "test", 0, NULL, cfunc_test, NULL) ||
+	    !noct_register_source(env, "main.noct", src) ||
+	    !noct_enter_vm(env, "main", 0, NULL, &ret)) {
+		noct_get_error_message(env, &msg);
+		printf("%s\n", msg);
+		return 1;
+	}
+	noct_destroy_vm(vm);
+
+	if (failures > 0) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
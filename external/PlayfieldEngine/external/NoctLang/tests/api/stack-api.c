@@ -0,0 +1,104 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Noct Programming Language
+ * Copyright (c) 2025, 2026, Awe Morris
+ */
+
+/*
+ * API Tests: the C stack guard
+ *
+ * A C function that uses a large C stack calls back into the script,
+ * so the recursion runs out of the C stack long before the frame
+ * limit. The call must fail with "Stack overflow." instead of
+ * crashing, and the VM must be usable afterwards.
+ */
+
+#include <noct/noct.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* C stack used by a callback. */
+#define CALLBACK_STACK_SIZE	(16 * 1024)
+
+static int failures;
+static int depth;
+
+static void
+check(
+	bool cond,
+	const char *name)
+{
+	if (!cond) {
+		printf("FAIL: %s\n", name);
+		failures++;
+	}
+}
+
+static bool
+cfunc_callback(
+	NoctEnv *env)
+{
+	volatile char buf[CALLBACK_STACK_SIZE];
+	NoctValue ret;
+	int i;
+
+	/* Touch the whole buffer so that it is not optimized out. */
+	for (i = 0; i < CALLBACK_STACK_SIZE; i++)
+		buf[i] = (char)i;
+
+	depth++;
+	if (!noct_enter_vm(env, "down", 0, NULL, &ret))
+		return false;
+
+	/* The buffer is intact after the nested calls. */
+	return buf[CALLBACK_STACK_SIZE - 1] == (char)(CALLBACK_STACK_SIZE - 1);
+}
+
+int
+main(void)
+{
+	static const char *src =
+		"func down() { callback(); }\n"
+		"func add(a, b) { return a + b; }\n";
+	NoctVM *vm;
+	NoctEnv *env;
+	NoctValue ret, args[2];
+	const char *msg;
+	int i;
+
+	if (!noct_create_vm(&vm, &env, NULL))
+		return 1;
+	if (!noct_register_cfunc(env, "callback", 0, NULL, cfunc_callback, NULL) ||
+	    !noct_register_source(env, "main.noct", src)) {
+		noct_get_error_message(env, &msg);
+		printf("%s\n", msg);
+		return 1;
+	}
+
+	/* The recursion stops at the C stack guard. */
+	depth = 0;
+	check(!noct_enter_vm(env, "down", 0, NULL, &ret), "recursion fails");
+	noct_get_error_message(env, &msg);
+	check(strstr(msg, "Stack overflow.") != NULL, "error message");
+	check(depth > 0 && depth < 1024 / 2, "stopped by the C stack");
+
+	/* The VM still works. */
+	noct_make_int(env, &args[0], 1);
+	noct_make_int(env, &args[1], 2);
+	check(noct_enter_vm(env, "add", 2, args, &ret) &&
+	      noct_get_int(env, &ret, &i) && i == 3,
+	      "call after the overflow");
+
+	noct_destroy_vm(vm);
+
+	if (failures > 0) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
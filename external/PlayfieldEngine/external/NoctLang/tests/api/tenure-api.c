@@ -0,0 +1,191 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Noct Programming Language
+ * Copyright (c) 2025, 2026, Awe Morris
+ */
+
+/*
+ * API Tests: the tenure free list, through noct_get_heap_stats()
+ *
+ * Large strings go straight to the tenure region, so this can place
+ * blocks side by side, make holes between them, and check that the
+ * holes are counted and merged back.
+ */
+
+#include <noct/noct.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Number of the blocks. */
+#define BLOCK_COUNT	(64)
+
+/* String length of a block. (Above the threshold below.) */
+#define BLOCK_LEN	(4096)
+
+/* Large-object-promotion threshold. */
+#define LOP_THRESHOLD	(1024)
+
+struct stats {
+	size_t free_size;
+	size_t largest;
+	size_t count;
+};
+
+static int failures;
+
+static void
+check(
+	bool cond,
+	const char *name)
+{
+	if (!cond) {
+		printf("FAIL: %s\n", name);
+		failures++;
+	}
+}
+
+static void
+get_stats(
+	NoctEnv *env,
+	struct stats *s)
+{
+	if (!noct_get_heap_stats(env, &s->free_size, &s->largest, &s->count)) {
+		printf("FAIL: noct_get_heap_stats()\n");
+		failures++;
+		memset(s, 0, sizeof(*s));
+	}
+}
+
+/* Put a large string to the global "bN". */
+static bool
+alloc_block(
+	NoctEnv *env,
+	int n,
+	const char *data)
+{
+	NoctValue val;
+	char name[16];
+
+	snprintf(name, sizeof(name), "b%d", n);
+	if (!noct_make_string(env, &val, data))
+		return false;
+	return noct_set_global(env, name, &val);
+}
+
+/* Drop the string in the global "bN". */
+static bool
+free_block(
+	NoctEnv *env,
+	int n)
+{
+	NoctValue val;
+	char name[16];
+
+	snprintf(name, sizeof(name), "b%d", n);
+	noct_make_int(env, &val, 0);
+	return noct_set_global(env, name, &val);
+}
+
+static bool
+cfunc_test(
+	NoctEnv *env)
+{
+	struct stats init, s;
+	char *data;
+	int i;
+
+	data = malloc(BLOCK_LEN + 1);
+	if (data == NULL)
+		return false;
+	memset(data, 'x', BLOCK_LEN);
+	data[BLOCK_LEN] = '\0';
+
+	/* Settle the heap, and take the initial state. */
+	noct_compact_gc(env);
+	get_stats(env, &init);
+	check(init.count >= 1, "initial free block");
+	check(init.largest <= init.free_size, "initial largest");
+
+	/* Allocate the blocks side by side. */
+	for (i = 0; i < BLOCK_COUNT; i++) {
+		if (!alloc_block(env, i, data)) {
+			free(data);
+			return false;
+		}
+	}
+	noct_full_gc(env);
+	get_stats(env, &s);
+	check(s.free_size + BLOCK_COUNT * BLOCK_LEN <= init.free_size, "allocation");
+	check(s.count == init.count, "allocation keeps the free blocks");
+
+	/* Free every other block, and the holes can't merge. */
+	for (i = 0; i < BLOCK_COUNT; i += 2)
+		free_block(env, i);
+	noct_full_gc(env);
+	get_stats(env, &s);
+	check(s.count == init.count + BLOCK_COUNT / 2, "fragmentation count");
+	check(s.largest < s.free_size, "fragmentation largest");
+	check(s.free_size + BLOCK_COUNT / 2 * BLOCK_LEN <= init.free_size, "fragmentation size");
+
+	/* Free the rest, and every hole merges with its neighbors. */
+	for (i = 1; i < BLOCK_COUNT; i += 2)
+		free_block(env, i);
+	noct_full_gc(env);
+	get_stats(env, &s);
+	check(s.count == init.count, "coalescing count");
+	check(s.free_size == init.free_size, "coalescing size");
+	check(s.largest == init.largest, "coalescing largest");
+
+	/* Make holes again, and the compaction removes them. */
+	for (i = 0; i < BLOCK_COUNT; i++) {
+		if (!alloc_block(env, i, data)) {
+			free(data);
+			return false;
+		}
+	}
+	for (i = 0; i < BLOCK_COUNT; i += 2)
+		free_block(env, i);
+	noct_compact_gc(env);
+	get_stats(env, &s);
+	check(s.count == 1, "compaction count");
+	check(s.largest == s.free_size, "compaction largest");
+
+	free(data);
+	return true;
+}
+
+int
+main(void)
+{
+	static const char *src = "func main() { test(); }";
+	NoctConfig conf;
+	NoctVM *vm;
+	NoctEnv *env;
+	NoctValue ret;
+	const char *msg;
+
+	noct_set_default_config(&conf);
+	conf.gc_lop_threshold = LOP_THRESHOLD;
+
+	if (!noct_create_vm(&vm, &env, &conf))
+		return 1;
+	if (!noct_register_cfunc(env, "test", 0, NULL, cfunc_test, NULL) ||
+	    !noct_register_source(env, "main.noct", src) ||
+	    !noct_enter_vm(env, "main", 0, NULL, &ret)) {
+		noct_get_error_message(env, &msg);
+		printf("%s\n", msg);
+		return 1;
+	}
+	noct_destroy_vm(vm);
+
+	if (failures > 0) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,14 @@
+#!/bin/sh
+
+set -eu
+
+echo 'NoctLang API Tests'
+echo
+
+for tc in api/*.c; do
+    echo "$tc";
+    cc -O2 -I../include -o api-test $tc ../build/libnoct.a -lm -lpthread;
+    ./api-test;
+done
+rm -f api-test
+echo 'All tests passed.'
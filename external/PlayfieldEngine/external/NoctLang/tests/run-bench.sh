@@ -0,0 +1,15 @@
+#!/bin/sh
+
+set -eu
+
+echo 'NoctLang Benchmarks'
+echo
+
+for tc in bench/*.noct; do
+    echo "$tc";
+    echo "(Interpreter)";
+    time ../build/noct --disable-jit $tc;
+    echo "(JIT)";
+    time ../build/noct --force-jit $tc;
+    echo;
+done
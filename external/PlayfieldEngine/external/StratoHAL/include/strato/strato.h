@@ -198,7 +198,10 @@ struct hal_callback {
 	/* Callback for two-finger swipe up.*/
 	void (*on_swipe_up)(float speed, float amount);
 
-	void *reserved[49];
+	/* Callback to check if a frame has to be rendered. (optional) */
+	bool (*on_check_render)(void);
+
+	void *reserved[48];
 };
 
 /* --- */
@@ -374,6 +377,27 @@ void
 hal_close_wfile(
 	struct hal_wfile *wf);
 
+/*
+ * Write a whole file in the background.
+ *  - The HAL takes the ownership of data and frees it by free().
+ *  - A queued write to the same file is replaced by the new data.
+ *  - On targets without a writer thread, the file is written before return.
+ */
+HAL_DLL
+bool
+hal_write_file_async(
+	const char *file,
+	void *data,
+	size_t size);
+
+/*
+ * Wait for all background file writes.
+ *  - Returns false if a background write failed after the last call.
+ */
+HAL_DLL
+bool
+hal_wait_file_writes(void);
+
 /*
  * Remove a file.
  */
@@ -420,6 +444,21 @@ struct hal_image {
 
 	/* Context ID. (platform handle) */
 	int context;
+
+	/* Dirty rectangle to upload. (right and bottom are exclusive) */
+	int dirty_left;
+	int dirty_top;
+	int dirty_right;
+	int dirty_bottom;
+
+	/* Is the current update notification for the dirty rectangle only? */
+	bool is_rect_update;
+
+	/* Mip levels for the software minification. (level 1 and below) */
+	hal_pixel_t *mip_pixels;
+
+	/* Are the mip levels made after the last update? */
+	bool is_mip_valid;
 };
 
 /*
@@ -967,6 +1006,21 @@ void
 hal_notify_image_update(
 	struct hal_image *img);
 
+/*
+ * Notify an image update for a rectangle.
+ *  - This function tells a HAL that a part of an image needs to be uploaded to GPU.
+ *  - Rectangles are accumulated until the next upload.
+ *  - A HAL that doesn't support partial uploads uploads the whole image.
+ */
+HAL_DLL
+void
+hal_notify_image_update_rect(
+	struct hal_image *img,
+	int left,
+	int top,
+	int width,
+	int height);
+
 /*
  * Notify an image free.
  *  - This function tells a HAL that an image is no longer used.
@@ -1128,6 +1182,14 @@ hal_create_wave_from_file(
 	bool loop,
 	struct hal_wave **w);
 
+/*
+ * Decode a short sound file in advance and keep it in the cache.
+ */
+HAL_DLL
+bool
+hal_preload_wave(
+	const char *file);
+
 /*
  * Destroy a wave stream.
  */
@@ -1163,6 +1225,74 @@ hal_get_wave_samples(
 	uint32_t *buf,
 	int samples);
 
+/*
+ * Create a voice pool, a wave stream that mixes up to `voices` streams.
+ *  - The pool never reaches end-of-stream and plays silence when idle.
+ */
+HAL_DLL
+bool
+hal_create_wave_pool(
+	int voices,
+	struct hal_wave **w);
+
+/*
+ * Add a stream to a voice pool and return a voice handle.
+ *  - The pool takes the ownership of the stream on success.
+ *  - Returns -1 if all voices are busy.
+ */
+HAL_DLL
+int
+hal_add_wave_voice(
+	struct hal_wave *w,
+	struct hal_wave *voice,
+	float vol);
+
+/*
+ * Set the volume of a voice in a pool.
+ */
+HAL_DLL
+void
+hal_set_wave_voice_volume(
+	struct hal_wave *w,
+	int voice,
+	float vol);
+
+/*
+ * Stop a voice in a pool.
+ */
+HAL_DLL
+void
+hal_stop_wave_voice(
+	struct hal_wave *w,
+	int voice);
+
+/*
+ * Check if a voice in a pool is finished.
+ */
+HAL_DLL
+bool
+hal_is_wave_voice_finished(
+	struct hal_wave *w,
+	int voice);
+
+/*
+ * Get the number of the playing voices in a pool.
+ */
+HAL_DLL
+int
+hal_get_wave_voice_count(
+	struct hal_wave *w);
+
+/*
+ * Check if a wave stream is a voice pool.
+ *  - A pool applies the voice changes when its samples are read, so a
+ *    sound backend should not read it far ahead.
+ */
+HAL_DLL
+bool
+hal_is_wave_pool(
+	struct hal_wave *w);
+
 /* --- */
 
 /*
@@ -370,6 +370,8 @@ void
 hal_notify_image_update(
     struct hal_image *img)
 {
+    img->is_mip_valid = false;
+
     if (theCommandBuffer == nil) {
         assert(theInitialUploadArrayCount < 128);
         assert(img->width > 0 && img->width < 4096);
@@ -378,7 +380,20 @@ hal_notify_image_update(
         return;
     }
 
-    MTLRegion region = {{ 0, 0, 0 }, {(NSUInteger)img->width, (NSUInteger)img->height, 1}};
+    // Get the region to upload.
+    int left = 0, top = 0, right = img->width, bottom = img->height;
+    if (img->is_rect_update && img->texture != NULL) {
+        left = img->dirty_left;
+        top = img->dirty_top;
+        right = img->dirty_right;
+        bottom = img->dirty_bottom;
+    }
+    img->dirty_left = 0;
+    img->dirty_top = 0;
+    img->dirty_right = 0;
+    img->dirty_bottom = 0;
+
+    MTLRegion region = {{ (NSUInteger)left, (NSUInteger)top, 0 }, {(NSUInteger)(right - left), (NSUInteger)(bottom - top), 1}};
     id<MTLTexture> texture = nil;
     
     if (img->texture == NULL) {
@@ -401,7 +416,7 @@ hal_notify_image_update(
         theBlitEncoder = [theCommandBuffer blitCommandEncoder];
         theBlitEncoder.label = @"Texture Encoder";
     }
-    [texture replaceRegion:region mipmapLevel:0 withBytes:img->pixels bytesPerRow:(NSUInteger)(img->width * 4)];
+    [texture replaceRegion:region mipmapLevel:0 withBytes:img->pixels + top * img->width + left bytesPerRow:(NSUInteger)(img->width * 4)];
 }
 
 //
@@ -34,14 +34,22 @@
 #include <strato/strato.h>
 
 /* Standard C */
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
 #include <math.h>
 
 /* POSIX */
 #include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
 
 /* ALSA */
 #include <alsa/asoundlib.h>
 
+/* Interface */
+#include "asound.h"
+
 /*
  * Format
  */
@@ -52,49 +60,164 @@
 
 /*
  * Sound Buffer Config
+ *  - All tracks are mixed into one device, so we can afford a
+ *    shorter buffer than a per-track device had. (about 46ms)
  */
-#define BUF_FRAMES		(SAMPLING_RATE / 8)
-#define BUF_SIZE		(BUF_FRAMES * FRAME_SIZE)
+#define BUF_FRAMES		(2048)
 #define PERIODS			(4)
 #define PERIOD_FRAMES		(BUF_FRAMES / PERIODS)
-#define PERIOD_SIZE		(BUF_SIZE / PERIODS)
-#define PERIOD_FRAMES_PAD	((PERIOD_SIZE + 63) / 64 * 64 - PERIOD_SIZE)
 
 /*
- * Stream Data
+ * Decode-ahead Ring Config
+ *  - A ring holds about 186ms of samples per track.
+ *  - The decoder fills a ring by chunks.
+ *  - Must be powers of two.
  */
+#define RING_FRAMES		(8192)
+#define DECODE_FRAMES		(1024)
 
-/* ALSA Devices */
-static snd_pcm_t *pcm[HAL_SOUND_TRACKS];
+/*
+ * Decode-ahead of a Voice Pool
+ *  - A pool applies new voices, stops and fades when it is decoded,
+ *    so a full ring would delay them by about 186ms.
+ *  - Keep one period ahead of the period that the mixer reads next.
+ */
+#define POOL_RING_FRAMES	(PERIOD_FRAMES * 2)
 
-/* Input Streams */
-static struct hal_wave *wave[HAL_SOUND_TRACKS];
+/*
+ * Command Queue Config
+ *  - Must be a power of two.
+ */
+#define CMD_QUEUE_SIZE		(64)
+
+/*
+ * Gain
+ *  - A gain is a Q15 fixed point value, and 1.0 is GAIN_ONE.
+ *  - A gain change is ramped over a period instead of a step.
+ */
+#define GAIN_SHIFT		(15)
+#define GAIN_ONE		(1 << GAIN_SHIFT)
+
+/*
+ * Device Name
+ *  - The environment variable can select an ALSA device.
+ *  - "null" runs the mixer without a device, for headless benchmarks.
+ */
+#define DEVICE_ENV		"STRATOHAL_SOUND_DEVICE"
+#define DEVICE_DEFAULT		"default"
+#define DEVICE_NULL		"null"
 
-/* Sound Threads */
-static pthread_t thread[HAL_SOUND_TRACKS];
+/*
+ * Atomics
+ *  - The rings and the command queue are single-producer and
+ *    single-consumer, so acquire/release ordering is enough.
+ */
+#define LOAD_ACQUIRE(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
 
-/* Mutex Objects (mutually exclude between the main thread and a sound thread) */
-static pthread_mutex_t mutex[HAL_SOUND_TRACKS];
+/*
+ * Decode-ahead Ring (decoder thread to mixer thread)
+ *  - head and tail are free-running frame counters.
+ */
+struct ring {
+	uint32_t head;		/* Written by the decoder. */
+	uint32_t tail;		/* Written by the mixer. */
+	uint32_t buf[RING_FRAMES];
+};
+
+/*
+ * Command (main thread to mixer thread)
+ */
+enum cmd_type {
+	CMD_PLAY,		/* Discard the ring and acknowledge a serial. */
+	CMD_STOP,		/* Same as CMD_PLAY, but no stream follows. */
+	CMD_VOLUME,		/* Set a target gain. */
+};
+
+struct cmd {
+	int type;
+	int track;
+	uint32_t value;
+};
+
+/*
+ * Stream Data
+ */
+
+/* ALSA Device (NULL for the null device) */
+static snd_pcm_t *pcm;
+
+/* Is the mixer running? */
+static bool is_running;
 
 /* Exit Requst */
 static bool exit_req;
 
-/* Buffers */
-static uint32_t period_buf[HAL_SOUND_TRACKS][PERIOD_FRAMES + PERIOD_FRAMES_PAD];
+/* Input Streams (decoder thread, under the mutex) */
+static struct hal_wave *wave[HAL_SOUND_TRACKS];
 
-/* Volume Values */
-static float volume[HAL_SOUND_TRACKS];
+/* Mutex Object (mutually exclude between the main thread and the decoder thread) */
+static pthread_mutex_t mutex;
 
-/* Finish Flags */
-static bool finish[HAL_SOUND_TRACKS];
+/* Semaphore to wake up the decoder thread. */
+static sem_t decode_sem;
+
+/* Threads */
+static pthread_t mixer_thread_id;
+static pthread_t decoder_thread_id;
+
+/* Decode-ahead Rings */
+static struct ring ring[HAL_SOUND_TRACKS];
+
+/* Command Queue */
+static struct cmd cmd_queue[CMD_QUEUE_SIZE];
+static uint32_t cmd_head;	/* Written by the main thread. */
+static uint32_t cmd_tail;	/* Written by the mixer thread. */
+
+/*
+ * Track Serials
+ *  - serial is incremented by the main thread on each play or stop.
+ *  - ack_serial is set by the mixer after the ring is flushed, and the
+ *    decoder doesn't fill the ring until it matches serial.
+ *  - eos_serial is set by the decoder after the last samples.
+ *  - finish_serial is set by the mixer after playing the last samples.
+ */
+static uint32_t serial[HAL_SOUND_TRACKS];
+static uint32_t ack_serial[HAL_SOUND_TRACKS];
+static uint32_t eos_serial[HAL_SOUND_TRACKS];
+static uint32_t finish_serial[HAL_SOUND_TRACKS];
+
+/* Playback States (mixer thread) */
+static bool is_playing[HAL_SOUND_TRACKS];
+static bool is_primed[HAL_SOUND_TRACKS];
+
+/* Current Gains (mixer thread) */
+static int32_t gain_cur[HAL_SOUND_TRACKS];
+static int32_t gain_target[HAL_SOUND_TRACKS];
+
+/* Telemetry (written by the mixer thread) */
+static struct sound_stats stats[HAL_SOUND_TRACKS];
+static uint32_t device_underruns;
+
+/* Buffers */
+static uint32_t decode_buf[DECODE_FRAMES];
+static int32_t mix_buf[PERIOD_FRAMES * CHANNELS];
+static uint32_t out_buf[PERIOD_FRAMES];
 
 /*
  * Forward Declarations
  */
-static bool init_pcm(int n);
-static void *sound_thread(void *p);
-static bool playback_period(int n);
-static void scale_samples(uint32_t *buf, int frames, float vol);
+static bool init_pcm(const char *device);
+static bool push_cmd(int type, int track, uint32_t value);
+static void *decoder_thread(void *p);
+static void decode_track(int n);
+static void *mixer_thread(void *p);
+static void run_cmds(void);
+static void mix_period(void);
+static void mix_track(const uint32_t *src, int frames, int32_t from, int32_t to);
+static void pack_samples(uint32_t *dst, const int32_t *src, int frames);
+static void write_period(void);
+static int32_t volume_to_gain(float vol);
 
 /*
  * Initialize ALSA.
@@ -102,32 +225,78 @@ static void scale_samples(uint32_t *buf, int frames, float vol);
 bool
 init_sound(void)
 {
-	int n, ret;
+	const char *device;
+	int n;
 
 	exit_req = false;
 
+	/* Initialize per track data. */
 	for (n = 0; n < HAL_SOUND_TRACKS; n++) {
-		/* Initialize per stream data. */
-		pcm[n] = NULL;
 		wave[n] = NULL;
-		volume[n] = 1.0f;
-		finish[n] = false;
-
-		/* Initialize a device. */
-		if (!init_pcm(n))
+		ring[n].head = 0;
+		ring[n].tail = 0;
+		serial[n] = 0;
+		ack_serial[n] = 0;
+		eos_serial[n] = (uint32_t)-1;
+		finish_serial[n] = (uint32_t)-1;
+		is_playing[n] = false;
+		is_primed[n] = false;
+		gain_cur[n] = GAIN_ONE;
+		gain_target[n] = GAIN_ONE;
+		memset(&stats[n], 0, sizeof(struct sound_stats));
+		stats[n].min_fill = RING_FRAMES;
+	}
+	cmd_head = 0;
+	cmd_tail = 0;
+	device_underruns = 0;
+
+	/* Open the device unless the null device is selected. */
+	device = getenv(DEVICE_ENV);
+	if (device == NULL || device[0] == '\0')
+		device = DEVICE_DEFAULT;
+	if (strcmp(device, DEVICE_NULL) == 0) {
+		pcm = NULL;
+	} else {
+		if (!init_pcm(device)) {
+			if (pcm != NULL) {
+				snd_pcm_close(pcm);
+				pcm = NULL;
+			}
 			return false;
+		}
+	}
 
-		/* Create a mutex object. */
-		pthread_mutex_init(&mutex[n], NULL);
+	/* Create synchronization objects. */
+	pthread_mutex_init(&mutex, NULL);
+	sem_init(&decode_sem, 0, 0);
+
+	/* Start the decoder thread. */
+	if (pthread_create(&decoder_thread_id, NULL, decoder_thread, NULL) != 0) {
+		sem_destroy(&decode_sem);
+		pthread_mutex_destroy(&mutex);
+		if (pcm != NULL) {
+			snd_pcm_close(pcm);
+			pcm = NULL;
+		}
+		return false;
+	}
 
-		/* Start a sound thread. */
-		ret = pthread_create(&thread[n], NULL, sound_thread, (void *)(intptr_t)n);
-		if (ret != 0) {
-			pthread_mutex_unlock(&mutex[n]);
-			return false;
+	/* Start the mixer thread. */
+	if (pthread_create(&mixer_thread_id, NULL, mixer_thread, NULL) != 0) {
+		STORE_RELEASE(&exit_req, true);
+		sem_post(&decode_sem);
+		pthread_join(decoder_thread_id, NULL);
+		sem_destroy(&decode_sem);
+		pthread_mutex_destroy(&mutex);
+		if (pcm != NULL) {
+			snd_pcm_close(pcm);
+			pcm = NULL;
 		}
+		return false;
 	}
 
+	is_running = true;
+
 	return true;
 }
 
@@ -137,28 +306,36 @@ init_sound(void)
 void
 cleanup_sound(void)
 {
-	void *p1;
 	int n;
 
-	exit_req = true;
-
-	for (n = 0; n < HAL_SOUND_TRACKS; n++) {
-		if (pcm[n] == NULL)
-			continue;
-
-		hal_stop_sound(n);
+	if (!is_running)
+		return;
 
-		/* Wait for an exit of the sound thread. */
-		pthread_join(thread[n], &p1);
+	/* Wait for exits of the threads. */
+	STORE_RELEASE(&exit_req, true);
+	sem_post(&decode_sem);
+	pthread_join(mixer_thread_id, NULL);
+	pthread_join(decoder_thread_id, NULL);
+	is_running = false;
 
-		/* Close a device. */
-		if (pcm[n] != NULL)
-			snd_pcm_close(pcm[n]);
+	/* Report underruns. */
+	for (n = 0; n < HAL_SOUND_TRACKS; n++) {
+		if (stats[n].underruns > 0)
+			hal_log_info("Sound track %d: %u underrun(s).", n, stats[n].underruns);
+	}
+	if (device_underruns > 0)
+		hal_log_info("Sound device: %u underrun(s).", device_underruns);
 
-		/* Destroy a mutex. */
-		pthread_mutex_destroy(&mutex[n]);
+	/* Close the device. */
+	if (pcm != NULL) {
+		snd_pcm_close(pcm);
+		pcm = NULL;
 	}
 
+	/* Destroy synchronization objects. */
+	sem_destroy(&decode_sem);
+	pthread_mutex_destroy(&mutex);
+
 	/* Free caches for Valgrind check. */
 	snd_config_update_free_global();
 }
@@ -171,25 +348,28 @@ hal_play_sound(
 	int n,
 	struct hal_wave *w)
 {
+	uint32_t s;
+
 	assert(n < HAL_SOUND_TRACKS);
 	assert(w != NULL);
 
 	/* If ALSA is not available, just return. */
-	if (pcm[n] == NULL)
+	if (!is_running)
 		return true;
 
-	pthread_mutex_lock(&mutex[n]);
+	pthread_mutex_lock(&mutex);
 	{
-		/* Drop the current buffer. */
-		snd_pcm_drop(pcm[n]);
-
 		/* Set a PCM stream. */
 		wave[n] = w;
 
-		/* Reset a finish flag. */
-		finish[n] = false;
+		/* Start a new serial. The decoder waits for the flush. */
+		s = serial[n] + 1;
+		STORE_RELEASE(&serial[n], s);
 	}
-	pthread_mutex_unlock(&mutex[n]);
+	pthread_mutex_unlock(&mutex);
+
+	/* Flush the ring of the previous stream. */
+	push_cmd(CMD_PLAY, n, s);
 
 	return true;
 }
@@ -201,23 +381,28 @@ bool
 hal_stop_sound(
 	int n)
 {
+	uint32_t s;
+
 	assert(n < HAL_SOUND_TRACKS);
 
 	/* If ALSA is not available, just return. */
-	if (pcm[n] == NULL)
+	if (!is_running)
 		return true;
 
-	pthread_mutex_lock(&mutex[n]);
+	/* After the unlock, the decoder doesn't touch the stream. */
+	pthread_mutex_lock(&mutex);
 	{
-		if (wave[n] != NULL) {
-			/* Cancel playback status. */
-			wave[n] = NULL;
+		/* Cancel playback status. */
+		wave[n] = NULL;
 
-			/* Stop an in-flight buffer. */
-			snd_pcm_drop(pcm[n]);
-		}
+		/* Start a new serial. */
+		s = serial[n] + 1;
+		STORE_RELEASE(&serial[n], s);
 	}
-	pthread_mutex_unlock(&mutex[n]);
+	pthread_mutex_unlock(&mutex);
+
+	/* Drop the samples in the ring. */
+	push_cmd(CMD_STOP, n, s);
 
 	return true;
 }
@@ -233,10 +418,11 @@ hal_set_sound_volume(
 	assert(n < HAL_SOUND_TRACKS);
 	assert(vol >= 0 && vol <= 1.0f);
 
-	volume[n] = vol;
+	/* If ALSA is not available, just return. */
+	if (!is_running)
+		return true;
 
-	/* For relaxed consistencies. Not needed for x86 and arm processors. */
-	__sync_synchronize();
+	push_cmd(CMD_VOLUME, n, (uint32_t)volume_to_gain(vol));
 
 	return true;
 }
@@ -249,69 +435,85 @@ hal_is_sound_finished(
 	int n)
 {
 	/* If ALSA is not available, just return. */
-	if (pcm[n] == NULL)
+	if (!is_running)
 		return true;
 
-	/* For relaxed consistencies. Not needed for x86 and arm processors. */
-	__sync_synchronize();
-
-	if (!finish[n])
+	if (LOAD_ACQUIRE(&finish_serial[n]) != serial[n])
 		return false;
 
 	return true;
 }
 
-/* Initialize a device for a stream. */
+/*
+ * Get the telemetry of a stream.
+ */
+void
+get_sound_stats(
+	int n,
+	struct sound_stats *st)
+{
+	assert(n < HAL_SOUND_TRACKS);
+	assert(st != NULL);
+
+	st->underruns = LOAD_ACQUIRE(&stats[n].underruns);
+	st->fill = LOAD_ACQUIRE(&ring[n].head) - LOAD_ACQUIRE(&ring[n].tail);
+	st->min_fill = LOAD_ACQUIRE(&stats[n].min_fill);
+	st->device_underruns = LOAD_ACQUIRE(&device_underruns);
+}
+
+/* Initialize the device. */
 static bool
 init_pcm(
-	int n)
+	const char *device)
 {
-	/* Open a device. */
+	snd_pcm_hw_params_t *params;
+	snd_pcm_uframes_t frames;
 	int ret;
-	ret = snd_pcm_open(&pcm[n], "default", SND_PCM_STREAM_PLAYBACK, 0);
+
+	/* Open a device. */
+	ret = snd_pcm_open(&pcm, device, SND_PCM_STREAM_PLAYBACK, 0);
 	if (ret < 0) {
 		hal_log_info("snd_pcm_open() failed.");
+		pcm = NULL;
 		return false;
 	}
 
 	/* Set the format (44.1kHz, stereo, 16-bit signed little endian) */
-	snd_pcm_hw_params_t *params;
-	snd_pcm_uframes_t frames;
 	snd_pcm_hw_params_alloca(&params);
-	ret = snd_pcm_hw_params_any(pcm[n], params);
+	ret = snd_pcm_hw_params_any(pcm, params);
 	if (ret < 0) {
 		hal_log_info("snd_pcm_hw_params_any() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_access(pcm[n], params,
+	if (snd_pcm_hw_params_set_access(pcm, params,
 					 SND_PCM_ACCESS_RW_INTERLEAVED) < 0) {
 		hal_log_info("snd_pcm_hw_params_set_access() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_format(pcm[n], params, SND_PCM_FORMAT_S16_LE) < 0) {
+	if (snd_pcm_hw_params_set_format(pcm, params, SND_PCM_FORMAT_S16_LE) < 0) {
 		hal_log_info("snd_pcm_hw_params_set_format() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_rate(pcm[n], params, SAMPLING_RATE, 0) < 0) {
+	if (snd_pcm_hw_params_set_rate(pcm, params, SAMPLING_RATE, 0) < 0) {
 		hal_log_info("snd_pcm_hw_params_set_rate() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_channels(pcm[n], params, 2) < 0) {
+	if (snd_pcm_hw_params_set_channels(pcm, params, CHANNELS) < 0) {
 		hal_log_info("snd_pcm_hw_params_set_channels() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_periods(pcm[n], params, PERIODS, 0) < 0) {
+	if (snd_pcm_hw_params_set_periods(pcm, params, PERIODS, 0) < 0) {
 		hal_log_info("snd_pcm_hw_params_set_periods() failed.");
 		return false;
 	}
-	if (snd_pcm_hw_params_set_buffer_size(pcm[n], params, BUF_FRAMES) < 0) {
+	if (snd_pcm_hw_params_set_buffer_size(pcm, params, BUF_FRAMES) < 0) {
 		frames = BUF_FRAMES;
-		if (snd_pcm_hw_params_set_buffer_size_near(pcm[n], params, &frames) < 0) {
+		if (snd_pcm_hw_params_set_buffer_size_near(pcm, params, &frames) < 0) {
 			hal_log_info("snd_pcm_hw_params_set_buffer_size_near() failed.");
 			return false;
 		}
 	}
-	if (snd_pcm_hw_params(pcm[n], params) < 0) {
+	if (snd_pcm_hw_params(pcm, params) < 0) {
 		hal_log_info("snd_pcm_hw_params() failed.");
 		return false;
 	}
@@ -320,118 +522,340 @@ init_pcm(
 }
 
 /*
- * Sound Threads
+ * Push a command to the mixer thread. (main thread)
+ *  - Waits if the queue is full, which is rare since the mixer drains
+ *    the queue every period.
  */
+static bool
+push_cmd(
+	int type,
+	int track,
+	uint32_t value)
+{
+	struct timespec ts;
+	uint32_t head;
+
+	head = cmd_head;
+	while (head - LOAD_ACQUIRE(&cmd_tail) >= CMD_QUEUE_SIZE) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = 1000000;
+		nanosleep(&ts, NULL);
+	}
 
-/* The entrypoint of a per-device sound thread. */
-static void *sound_thread(void *p)
+	cmd_queue[head & (CMD_QUEUE_SIZE - 1)].type = type;
+	cmd_queue[head & (CMD_QUEUE_SIZE - 1)].track = track;
+	cmd_queue[head & (CMD_QUEUE_SIZE - 1)].value = value;
+	STORE_RELEASE(&cmd_head, head + 1);
+
+	return true;
+}
+
+/*
+ * Decoder Thread
+ */
+
+/*
+ * The entrypoint of the decoder thread.
+ *  - Woken up by the mixer after each period and after a flush.
+ */
+static void *
+decoder_thread(
+	void *p)
 {
-	int n = (int)(intptr_t)p;
+	int n;
 
-	while (!exit_req) {
-		/* Run a playback loop. */
-		while (playback_period(n)) {
-#if defined(__linux__)
-			/*
-			 * [Important]
-			 *  - We execute context-switch explicitly on Linux by sleep(0).
-			 *  - If we do not call sleep(0), the main thread stops.
-			 *  - We have confirmed this issue on Linux 4.4.0 x86_64.
-			 *  - As we understand, sched_yield() does not solve this issue.
-			 */
-			sleep(0);
-#elif defined(__NetBSD__)
-			/*
-			 * [Important]
-			 *  - We execute context-switch explicitly on NetBSD by sched_yield().
-			 *  - If we do not call sched_yield(), the main thread cannot acquire a mutex.
-			 *  - We have confirmed this issue on NetBSD 9.1 amd64.
-			 *  - As we understand, sleep(0) does not solve this issue.
-			 */
-			sched_yield();
-#endif
+	UNUSED_PARAMETER(p);
+
+	while (!LOAD_ACQUIRE(&exit_req)) {
+		sem_wait(&decode_sem);
+
+		pthread_mutex_lock(&mutex);
+		{
+			for (n = 0; n < HAL_SOUND_TRACKS; n++)
+				decode_track(n);
 		}
+		pthread_mutex_unlock(&mutex);
 	}
 
 	return (void *)0;
 }
 
-/* Write to a buffer. */
-static bool playback_period(int n)
+/* Fill the ring of a track. (with the mutex) */
+static void
+decode_track(
+	int n)
 {
+	struct ring *r;
+	uint32_t head, pos, first, limit, chunk;
 	int size;
 
-	pthread_mutex_lock(&mutex[n]);
-	{
-		/* Return false if the main thread stopped a playback. */
-		if (wave[n] == NULL) {
-			pthread_mutex_unlock(&mutex[n]);
-			return false;
-		}
+	if (wave[n] == NULL)
+		return;
+
+	/* Wait until the mixer flushes the ring of the previous stream. */
+	if (LOAD_ACQUIRE(&ack_serial[n]) != serial[n])
+		return;
 
+	/* Decode a pool just in time. */
+	if (hal_is_wave_pool(wave[n])) {
+		limit = POOL_RING_FRAMES;
+		chunk = PERIOD_FRAMES;
+	} else {
+		limit = RING_FRAMES;
+		chunk = DECODE_FRAMES;
+	}
+
+	r = &ring[n];
+	head = r->head;
+	while ((head - LOAD_ACQUIRE(&r->tail)) + chunk <= limit) {
 		/* Get PCM samples. */
-		size = hal_get_wave_samples(wave[n], period_buf[n], PERIOD_FRAMES);
+		size = hal_get_wave_samples(wave[n], decode_buf, (int)chunk);
+		if (size < 0)
+			size = 0;
+
+		/* Copy to the ring. */
+		pos = head & (RING_FRAMES - 1);
+		first = RING_FRAMES - pos;
+		if (first > (uint32_t)size)
+			first = (uint32_t)size;
+		memcpy(&r->buf[pos], decode_buf, first * FRAME_SIZE);
+		memcpy(&r->buf[0], decode_buf + first, ((uint32_t)size - first) * FRAME_SIZE);
+		head += (uint32_t)size;
+		STORE_RELEASE(&r->head, head);
+
+		/* Finish the stream if we reached an end-of-stream. */
+		if (hal_is_wave_eos(wave[n]) || size == 0) {
+			wave[n] = NULL;
+			STORE_RELEASE(&eos_serial[n], serial[n]);
+			break;
+		}
+	}
+}
 
-		/* Fill the remaining samples by zeros for a case where we have reached an end-of-stream. */
-		if (size < PERIOD_FRAMES)
-			memset(period_buf[n] + size, 0, (size_t)(PERIOD_FRAMES - size) * FRAME_SIZE);
+/*
+ * Mixer Thread
+ */
 
-		/* Scale samples by a volume value. */
-		scale_samples(period_buf[n], PERIOD_FRAMES, volume[n]);
+/*
+ * The entrypoint of the mixer thread.
+ *  - A blocking write paces the thread.
+ *  - This thread doesn't take a lock nor decode.
+ */
+static void *
+mixer_thread(
+	void *p)
+{
+	UNUSED_PARAMETER(p);
 
-		/* Write to the device (repeat while under-running) */
-		while (snd_pcm_writei(pcm[n], period_buf[n], PERIOD_FRAMES) < 0)
-			snd_pcm_prepare(pcm[n]);
+	while (!LOAD_ACQUIRE(&exit_req)) {
+		run_cmds();
+		mix_period();
+		sem_post(&decode_sem);
+		write_period();
+	}
 
-		/* Return false if we reached an end-of-stream. */
-		if (hal_is_wave_eos(wave[n])) {
-			wave[n] = NULL;
-			finish[n] = true;
-			pthread_mutex_unlock(&mutex[n]);
-			return false;
+	return (void *)0;
+}
+
+/* Run the commands from the main thread. */
+static void
+run_cmds(void)
+{
+	struct cmd *c;
+	uint32_t tail, head;
+
+	tail = cmd_tail;
+	head = LOAD_ACQUIRE(&cmd_head);
+	while (tail != head) {
+		c = &cmd_queue[tail & (CMD_QUEUE_SIZE - 1)];
+		switch (c->type) {
+		case CMD_PLAY:
+		case CMD_STOP:
+			/* Discard the samples and let the decoder start the new stream. */
+			STORE_RELEASE(&ring[c->track].tail, LOAD_ACQUIRE(&ring[c->track].head));
+			is_playing[c->track] = c->type == CMD_PLAY;
+			is_primed[c->track] = false;
+			STORE_RELEASE(&stats[c->track].min_fill, RING_FRAMES);
+			gain_cur[c->track] = gain_target[c->track];
+			STORE_RELEASE(&ack_serial[c->track], c->value);
+
+			/* Let the decoder fill the ring now. */
+			if (c->type == CMD_PLAY)
+				sem_post(&decode_sem);
+			break;
+		case CMD_VOLUME:
+			gain_target[c->track] = (int32_t)c->value;
+			break;
+		default:
+			assert(0);
+			break;
 		}
+		tail++;
 	}
-	pthread_mutex_unlock(&mutex[n]);
+	STORE_RELEASE(&cmd_tail, tail);
+}
 
-	return true;
+/* Mix all tracks into the output buffer. */
+static void
+mix_period(void)
+{
+	struct ring *r;
+	uint32_t head, tail, avail, pos, first, s;
+	int32_t from, to;
+	int n, frames;
+
+	memset(mix_buf, 0, sizeof(mix_buf));
+
+	for (n = 0; n < HAL_SOUND_TRACKS; n++) {
+		r = &ring[n];
+		s = ack_serial[n];
+
+		/* Get the available samples. */
+		head = LOAD_ACQUIRE(&r->head);
+		tail = r->tail;
+		avail = head - tail;
+
+		if (!is_playing[n])
+			continue;
+
+		/* Finish the stream if the decoder reached the end. */
+		if (avail == 0 && LOAD_ACQUIRE(&eos_serial[n]) == s) {
+			is_playing[n] = false;
+			STORE_RELEASE(&finish_serial[n], s);
+			continue;
+		}
+
+		/* Count an underrun after the first samples, except at the end. */
+		frames = avail < PERIOD_FRAMES ? (int)avail : PERIOD_FRAMES;
+		if (is_primed[n] && LOAD_ACQUIRE(&eos_serial[n]) != s) {
+			if (avail < stats[n].min_fill)
+				STORE_RELEASE(&stats[n].min_fill, avail);
+			if (frames < PERIOD_FRAMES)
+				STORE_RELEASE(&stats[n].underruns, stats[n].underruns + 1);
+		}
+		if (frames == 0)
+			continue;
+		is_primed[n] = true;
+
+		/* Ramp the gain to the target over the period. */
+		from = gain_cur[n];
+		to = gain_target[n];
+		gain_cur[n] = to;
+
+		/* Sum. */
+		if (from != 0 || to != 0) {
+			pos = tail & (RING_FRAMES - 1);
+			first = RING_FRAMES - pos;
+			if (first > (uint32_t)frames)
+				first = (uint32_t)frames;
+			mix_track(&r->buf[pos], (int)first, from, to);
+			if (first < (uint32_t)frames)
+				mix_track(&r->buf[0], frames - (int)first, to, to);
+		}
+
+		/* Consume. */
+		STORE_RELEASE(&r->tail, tail + (uint32_t)frames);
+	}
+
+	pack_samples(out_buf, mix_buf, PERIOD_FRAMES);
 }
 
-/* Apply a volume value. */
-static void scale_samples(uint32_t *buf, int frames, float vol)
+/*
+ * Add samples to the mix buffer with a gain ramp.
+ *  - The loops are simple enough for the compiler to vectorize.
+ */
+static void
+mix_track(
+	const uint32_t *src,
+	int frames,
+	int32_t from,
+	int32_t to)
 {
-	float scale;
-	uint32_t frame;
-	int32_t il, ir;	/* intermediate L/R */
-	int16_t sl, sr;	/* source L/R*/
-	int16_t dl, dr;	/* destination L/R */
+	int32_t gain, step;
 	int i;
 
-	/* For relaxed consistencies. Not needed for x86 and arm processors. */
-	__sync_synchronize();
-
-	/* Convert a scale factor to an exponential value. */
-	scale = (powf(10.0f, vol) - 1.0f) / (10.0f - 1.0f);
+	/* Constant gain. */
+	if (from == to) {
+		for (i = 0; i < frames; i++) {
+			mix_buf[i * 2] += ((int32_t)(int16_t)(uint16_t)src[i] * from) >> GAIN_SHIFT;
+			mix_buf[i * 2 + 1] += ((int32_t)(int16_t)(uint16_t)(src[i] >> 16) * from) >> GAIN_SHIFT;
+		}
+		return;
+	}
 
-	/* Scale samples. */
+	/* Linear ramp. (The gain is kept in Q15 with a fractional step.) */
+	step = (int32_t)((((int64_t)to - from) << 8) / frames);
+	gain = from << 8;
 	for (i = 0; i < frames; i++) {
-		frame = buf[i];
+		mix_buf[i * 2] += ((int32_t)(int16_t)(uint16_t)src[i] * (gain >> 8)) >> GAIN_SHIFT;
+		mix_buf[i * 2 + 1] += ((int32_t)(int16_t)(uint16_t)(src[i] >> 16) * (gain >> 8)) >> GAIN_SHIFT;
+		gain += step;
+	}
+}
+/* Saturate the mixed samples to 16-bit and interleave them. */
+static void
+pack_samples(
+	uint32_t *dst,
+	const int32_t *src,
+	int frames)
+{
+	int32_t l, r;
+	int i;
 
-		sl = (int16_t)(uint16_t)frame;
-		sr = (int16_t)(uint16_t)(frame >> 16);
+	for (i = 0; i < frames; i++) {
+		l = src[i * 2];
+		r = src[i * 2 + 1];
 
-		il = (int)(sl * scale);
-		ir = (int)(sr * scale);
+		l = l > 32767 ? 32767 : l;
+		l = l < -32768 ? -32768 : l;
+		r = r > 32767 ? 32767 : r;
+		r = r < -32768 ? -32768 : r;
 
-		il = il > 32767 ? 32767 : il;
-		il = il < -32768 ? -32768 : il;
-		ir = ir > 32767 ? 32767 : ir;
-		ir = ir < -32768 ? -32768 : ir;
+		dst[i] = ((uint32_t)(uint16_t)(int16_t)l) |
+			 (((uint32_t)(uint16_t)(int16_t)r) << 16);
+	}
+}
 
-		dl = (int16_t)il;
-		dr = (int16_t)ir;
+/* Write the output buffer to the device. */
+static void
+write_period(void)
+{
+	struct timespec ts;
+	snd_pcm_sframes_t ret;
+	int done;
+
+	/* For the null device, just wait for a period. */
+	if (pcm == NULL) {
+		ts.tv_sec = 0;
+		ts.tv_nsec = (long)PERIOD_FRAMES * 1000000000L / SAMPLING_RATE;
+		nanosleep(&ts, NULL);
+		return;
+	}
 
-		buf[i] = ((uint32_t)(uint16_t)dl) | (((uint32_t)(uint16_t)dr) << 16);
+	/* Write to the device (recover while under-running) */
+	done = 0;
+	while (done < PERIOD_FRAMES && !LOAD_ACQUIRE(&exit_req)) {
+		ret = snd_pcm_writei(pcm, out_buf + done, (snd_pcm_uframes_t)(PERIOD_FRAMES - done));
+		if (ret < 0) {
+			STORE_RELEASE(&device_underruns, device_underruns + 1);
+			if (snd_pcm_recover(pcm, (int)ret, 1) < 0)
+				snd_pcm_prepare(pcm);
+			continue;
+		}
+		done += (int)ret;
 	}
 }
 
+/* Convert a volume value to an exponential gain. */
+static int32_t
+volume_to_gain(
+	float vol)
+{
+	float scale;
+
+	scale = (powf(10.0f, vol) - 1.0f) / (10.0f - 1.0f);
+
+	return (int32_t)(scale * (float)GAIN_ONE);
+}
+
 #endif /* defined(__linux__) */
@@ -39,4 +39,22 @@ bool init_sound(void);
 /* Cleanup ALSA. */
 void cleanup_sound(void);
 
+/* Sound telemetry of a track. */
+struct sound_stats {
+	/* Periods that the decoder couldn't fill in time. */
+	uint32_t underruns;
+
+	/* Frames in the decode-ahead ring. */
+	uint32_t fill;
+
+	/* Minimum frames in the ring since the playback started. */
+	uint32_t min_fill;
+
+	/* Underruns of the device. (shared by all tracks) */
+	uint32_t device_underruns;
+};
+
+/* Get the telemetry of a track. */
+void get_sound_stats(int n, struct sound_stats *st);
+
 #endif
@@ -341,7 +341,7 @@ static void process_input(void)
 
 void hal_notify_image_update(struct hal_image *img)
 {
-	UNUSED_PARAMETER(img);
+	img->is_mip_valid = false;
 }
 
 void hal_notify_image_free(struct hal_image *img)
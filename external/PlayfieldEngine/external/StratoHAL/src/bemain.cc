@@ -244,6 +244,7 @@ void
 hal_notify_image_update(
     struct hal_image *img)
 {
+	img->is_mip_valid = false;
 }
 
 void
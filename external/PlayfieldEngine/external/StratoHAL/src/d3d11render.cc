@@ -841,6 +841,15 @@ VOID
 D3D11NotifyImageUpdate(
 	struct hal_image *img)
 {
+    // Upload the whole image unless a rectangle is notified.
+    if (!img->is_rect_update)
+    {
+        img->dirty_left = 0;
+        img->dirty_top = 0;
+        img->dirty_right = img->width;
+        img->dirty_bottom = img->height;
+    }
+
     img->need_upload = true;
 }
 
@@ -1531,12 +1540,18 @@ UploadTextureIfNeeded(
         desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
         desc.SampleDesc.Count = 1;
         desc.SampleDesc.Quality = 0;
-        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
 
-        HRESULT hr = g_pd3dDevice->CreateTexture2D(&desc, nullptr, &pTextureBundle->pTexture);
+        // Create a texture with the initial pixels.
+        D3D11_SUBRESOURCE_DATA initData;
+        initData.pSysMem = img->pixels;
+        initData.SysMemPitch = 4U * (UINT)img->width;
+        initData.SysMemSlicePitch = 0;
+
+        HRESULT hr = g_pd3dDevice->CreateTexture2D(&desc, &initData, &pTextureBundle->pTexture);
         if (FAILED(hr))
             return FALSE;
 
@@ -1555,18 +1570,40 @@ UploadTextureIfNeeded(
 
         img->texture = pTextureBundle;
     }
-
-    TextureBundle *pTextureBundle = (TextureBundle *)img->texture;
-
-    D3D11_MAPPED_SUBRESOURCE resource;
-    g_pImmediateContext->Map(pTextureBundle->pTexture, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-    for (int row = 0; row < img->height; row++)
+    else
     {
-        memcpy((char*)resource.pData + resource.RowPitch * (UINT)row, (char *)img->pixels + 4 * img->width * row, 4U * (UINT)img->width);
+        TextureBundle *pTextureBundle = (TextureBundle *)img->texture;
+
+        // Get the dirty rectangle.
+        D3D11_BOX box;
+        box.left = (UINT)img->dirty_left;
+        box.top = (UINT)img->dirty_top;
+        box.right = (UINT)img->dirty_right;
+        box.bottom = (UINT)img->dirty_bottom;
+        box.front = 0;
+        box.back = 1;
+        if (box.left >= box.right || box.top >= box.bottom)
+        {
+            box.left = 0;
+            box.top = 0;
+            box.right = (UINT)img->width;
+            box.bottom = (UINT)img->height;
+        }
+
+        // Update the rectangle.
+        g_pImmediateContext->UpdateSubresource(pTextureBundle->pTexture,
+                                               0,
+                                               &box,
+                                               img->pixels + img->width * (int)box.top + (int)box.left,
+                                               4U * (UINT)img->width,
+                                               0);
     }
-    g_pImmediateContext->Unmap(pTextureBundle->pTexture, 0);
 
     img->need_upload = FALSE;
+    img->dirty_left = 0;
+    img->dirty_top = 0;
+    img->dirty_right = 0;
+    img->dirty_bottom = 0;
 
     return TRUE;
 }
@@ -508,6 +508,15 @@ VOID
 D3D9NotifyImageUpdate(
 	struct hal_image *img)
 {
+	// Upload the whole image unless a rectangle is notified.
+	if (!img->is_rect_update)
+	{
+		img->dirty_left = 0;
+		img->dirty_top = 0;
+		img->dirty_right = img->width;
+		img->dirty_bottom = img->height;
+	}
+
 	img->need_upload = true;
 }
 
@@ -1260,6 +1269,7 @@ UploadTextureIfNeeded(
 		return TRUE;
 
 	IDirect3DTexture9 *pTex = (IDirect3DTexture9 *)img->texture;
+	BOOL bCreated = FALSE;
 	if (pTex == NULL)
 	{
 		// Create a Direct3D texture object.
@@ -1275,11 +1285,26 @@ UploadTextureIfNeeded(
 			return FALSE;
 
 		img->texture = pTex;
+		bCreated = TRUE;
+	}
+
+	// Get the dirty rectangle. A new texture needs the whole image.
+	RECT rc;
+	rc.left = img->dirty_left;
+	rc.top = img->dirty_top;
+	rc.right = img->dirty_right;
+	rc.bottom = img->dirty_bottom;
+	if (bCreated || rc.left >= rc.right || rc.top >= rc.bottom)
+	{
+		rc.left = 0;
+		rc.top = 0;
+		rc.right = img->width;
+		rc.bottom = img->height;
 	}
 
 	// Lock a Direct3D texture rectangle.
 	D3DLOCKED_RECT lockedRect;
-	hResult = pTex->LockRect(0, &lockedRect, NULL, 0);
+	hResult = pTex->LockRect(0, &lockedRect, &rc, 0);
 	if (FAILED(hResult))
 	{
 		pTex->Release();
@@ -1288,9 +1313,12 @@ UploadTextureIfNeeded(
 	}
 
 	// Copy pixel data.
-	memcpy(lockedRect.pBits,
-		   img->pixels,
-		   (UINT)img->width * (UINT)img->height * sizeof(hal_pixel_t));
+	for (LONG y = rc.top; y < rc.bottom; y++)
+	{
+		memcpy((BYTE *)lockedRect.pBits + lockedRect.Pitch * (y - rc.top),
+			   img->pixels + img->width * y + rc.left,
+			   (UINT)(rc.right - rc.left) * sizeof(hal_pixel_t));
+	}
 
 	// Unlock the rectangle.
 	hResult = pTex->UnlockRect(0);
@@ -1303,6 +1331,10 @@ UploadTextureIfNeeded(
 
 	// Finished an upload.
 	img->need_upload = false;
+	img->dirty_left = 0;
+	img->dirty_top = 0;
+	img->dirty_right = 0;
+	img->dirty_bottom = 0;
 	return TRUE;
 }
 
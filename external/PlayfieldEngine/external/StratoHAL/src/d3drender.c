@@ -218,6 +218,8 @@ void
 hal_notify_image_update(
 	struct hal_image *img)
 {
+	img->is_mip_valid = false;
+
 	switch (nGraphicsMode)
 	{
 #ifndef HAL_NOD3D12
@@ -30,6 +30,7 @@
  */
 
 #include <strato/strato.h>
+#include <math.h>
 #include <assert.h>
 
 /*
@@ -63,6 +64,194 @@ void scanline_conversion_2(float x1, float y1, float tx1, float ty1,
                            float x3, float y3, float tx3, float ty3,
                            float x4, float y4, float tx4, float ty4);
 
+const hal_pixel_t *get_image_mip(struct hal_image *img, int level, int *width, int *height);
+
+/* Max footprint size of the box filter for minification. */
+#define BOX_FILTER_MAX  (64)
+
+/* Max taps of the box filter per axis. A larger footprint uses a mip level. */
+#define BOX_TAPS_MAX    (4)
+
+/*
+ * Box filter of a minifying draw.
+ *  - The taps and the clip rectangle are in the texels of the mip level.
+ */
+struct box_filter {
+        const uint32_t *pixels;
+        int width;
+        int level;
+        int box_w;
+        int box_h;
+        int clip_left;
+        int clip_top;
+        int clip_right;
+        int clip_bottom;
+};
+
+/*
+ * Calculate the box filter size along a quad edge.
+ *  - Returns 1 for identity and magnification. (nearest neighbor)
+ */
+static INLINE int
+calc_box_size(
+        float x1,
+        float y1,
+        float x2,
+        float y2,
+        float texels)
+{
+        float len, ratio;
+
+        len = sqrtf((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+        if (len < 1.0f)
+                return 1;
+
+        ratio = texels / len;
+        if (ratio < 1.5f)
+                return 1;
+        if (ratio > (float)BOX_FILTER_MAX)
+                return BOX_FILTER_MAX;
+
+        return (int)(ratio + 0.5f);
+}
+
+/*
+ * Set up the box filter of a draw.
+ *  - Picks the first mip level where the footprint fits in BOX_TAPS_MAX taps.
+ *  - The clip rectangle is rounded inward so that no level texel covers
+ *    source texels outside it. (a frame of a strip)
+ *  - Falls back to the upper levels if the rectangle vanishes.
+ */
+static INLINE void
+setup_box_filter(
+        struct box_filter *bf,
+        struct hal_image *src_image,
+        float x1,
+        float y1,
+        float x2,
+        float y2,
+        float x3,
+        float y3,
+        int src_width,
+        int src_height,
+        int clip_left,
+        int clip_top,
+        int clip_right,
+        int clip_bottom)
+{
+        const hal_pixel_t *pixels;
+        int box_w, box_h, level, unit, w, h;
+
+        box_w = calc_box_size(x1, y1, x2, y2, (float)src_width);
+        box_h = calc_box_size(x1, y1, x3, y3, (float)src_height);
+        if (box_w > clip_right - clip_left)
+                box_w = clip_right - clip_left;
+        if (box_h > clip_bottom - clip_top)
+                box_h = clip_bottom - clip_top;
+        if (box_w < 1 || box_h < 1) {
+                box_w = 1;
+                box_h = 1;
+        }
+
+        /* Find the level. */
+        level = 0;
+        while (((box_w - 1) >> level) >= BOX_TAPS_MAX ||
+               ((box_h - 1) >> level) >= BOX_TAPS_MAX)
+                level++;
+
+        for (; level > 0; level--) {
+                pixels = get_image_mip(src_image, level, &w, &h);
+                if (pixels == NULL)
+                        continue;
+
+                unit = 1 << level;
+                bf->clip_left = (clip_left + unit - 1) >> level;
+                bf->clip_top = (clip_top + unit - 1) >> level;
+                bf->clip_right = clip_right >> level;
+                bf->clip_bottom = clip_bottom >> level;
+                if (bf->clip_left >= bf->clip_right ||
+                    bf->clip_top >= bf->clip_bottom)
+                        continue;
+
+                bf->pixels = pixels;
+                bf->width = w;
+                bf->level = level;
+                bf->box_w = (box_w + unit - 1) >> level;
+                bf->box_h = (box_h + unit - 1) >> level;
+                if (bf->box_w > bf->clip_right - bf->clip_left)
+                        bf->box_w = bf->clip_right - bf->clip_left;
+                if (bf->box_h > bf->clip_bottom - bf->clip_top)
+                        bf->box_h = bf->clip_bottom - bf->clip_top;
+                return;
+        }
+
+        /* Use the image itself. */
+        bf->pixels = src_image->pixels;
+        bf->width = src_image->width;
+        bf->level = 0;
+        bf->box_w = box_w;
+        bf->box_h = box_h;
+        bf->clip_left = clip_left;
+        bf->clip_top = clip_top;
+        bf->clip_right = clip_right;
+        bf->clip_bottom = clip_bottom;
+}
+
+/*
+ * Sample a texel footprint with a box filter.
+ *  - The footprint is centered on (tx, ty) and clipped to the source rectangle.
+ *  - Colors are weighted by alpha so that transparent texels don't darken edges.
+ *  - The inner loop is branch-free so that it vectorizes.
+ */
+static INLINE uint32_t
+sample_box(
+        const struct box_filter *bf,
+        int tx,
+        int ty)
+{
+        const uint32_t *row;
+        uint32_t pix, pa, sum_a, sum_c1, sum_c2, sum_c3;
+        int x, y;
+
+        /* Center the footprint on the sample point. */
+        tx = (tx >> bf->level) - bf->box_w / 2;
+        ty = (ty >> bf->level) - bf->box_h / 2;
+
+        /* Keep the footprint inside the source rectangle. */
+        if (tx + bf->box_w > bf->clip_right)
+                tx = bf->clip_right - bf->box_w;
+        if (tx < bf->clip_left)
+                tx = bf->clip_left;
+        if (ty + bf->box_h > bf->clip_bottom)
+                ty = bf->clip_bottom - bf->box_h;
+        if (ty < bf->clip_top)
+                ty = bf->clip_top;
+
+        sum_a = 0;
+        sum_c1 = 0;
+        sum_c2 = 0;
+        sum_c3 = 0;
+        row = bf->pixels + ty * bf->width + tx;
+        for (y = 0; y < bf->box_h; y++) {
+                for (x = 0; x < bf->box_w; x++) {
+                        pix = row[x];
+                        pa = hal_get_pixel_a(pix);
+                        sum_a += pa;
+                        sum_c1 += pa * hal_get_pixel_c1(pix);
+                        sum_c2 += pa * hal_get_pixel_c2(pix);
+                        sum_c3 += pa * hal_get_pixel_c3(pix);
+                }
+                row += bf->width;
+        }
+        if (sum_a == 0)
+                return 0;
+
+        return hal_make_pixel_fast(sum_a / (uint32_t)(bf->box_w * bf->box_h),
+                                   sum_c1 / sum_a,
+                                   sum_c2 / sum_a,
+                                   sum_c3 / sum_a);
+}
+
 void
 DRAW_IMAGE_COPY(
         struct hal_image *dst_image,
@@ -93,7 +282,7 @@ DRAW_IMAGE_COPY(
                 dst_ptr += dw;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -155,7 +344,7 @@ DRAW_IMAGE_ALPHA(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -220,7 +409,7 @@ DRAW_IMAGE_GLYPH(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -280,7 +469,7 @@ DRAW_IMAGE_EMOJI(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -351,7 +540,7 @@ DRAW_IMAGE_ADD(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -422,7 +611,7 @@ DRAW_IMAGE_SUB(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -483,7 +672,7 @@ DRAW_IMAGE_DIM(
                 dst_ptr += dst_line_inc;
         }
 
-        hal_notify_image_update(dst_image);
+        hal_notify_image_update_rect(dst_image, dst_left, dst_top, width, height);
 }
 
 void
@@ -642,6 +831,8 @@ DRAW_IMAGE_3D_ALPHA(
 {
         int x, y;
         int sw, sh, dw, dst_y_max;
+        struct box_filter bf;
+        int clip_left, clip_top, clip_right, clip_bottom;
         uint32_t *dst_pixel, *src_pixel;
         uint32_t src_pix, dst_pix;
         float a, src_r, src_g, src_b, src_a, dst_r, dst_g, dst_b, dst_a;
@@ -652,16 +843,16 @@ DRAW_IMAGE_3D_ALPHA(
                             (float)src_top,
                             (float)x2,
                             (float)y2,
-                            (float)src_width,
+                            (float)(src_left + src_width),
                             (float)src_top,
                             (float)x3,
                             (float)y3,
                             (float)src_left,
-                            (float)src_height,
+                            (float)(src_top + src_height),
                             (float)x4,
                             (float)y4,
-                            (float)src_width,
-                            (float)src_height);                     
+                            (float)(src_left + src_width),
+                            (float)(src_top + src_height));                     
         dw = dst_image->width;
         sw = src_image->width;
         sh = src_image->height;
@@ -670,6 +861,17 @@ DRAW_IMAGE_3D_ALPHA(
         dst_y_max = (dst_image->height > SC_LINES) ? SC_LINES : dst_image->height;
         a = (float)alpha / 255.0f;
 
+        /* Keep the box footprint inside the source rectangle. (a frame of a strip) */
+        clip_left = src_left;
+        clip_top = src_top;
+        clip_right = src_left + src_width > sw ? sw : src_left + src_width;
+        clip_bottom = src_top + src_height > sh ? sh : src_top + src_height;
+
+        /* Use a box filter when minifying. */
+        setup_box_filter(&bf, src_image, x1, y1, x2, y2, x3, y3,
+                         src_width, src_height,
+                         clip_left, clip_top, clip_right, clip_bottom);
+
         for (y = 0; y < dst_y_max; y++) {
                 int min_x, max_x;
                 float div, tx, ty, tx_inc, ty_inc;
@@ -700,17 +902,20 @@ DRAW_IMAGE_3D_ALPHA(
                                 break;
 
                         /* Wrap texture sampling. */
-                        if (tx < 0)
-                                tx = 0;
-                        if (tx >= sw)
-                                tx = (float)sw - 1;
-                        if (ty < 0)
-                                ty = 0;
-                        if (ty >= sh)
-                                ty = (float)sh - 1;
+                        if (tx < clip_left)
+                                tx = (float)clip_left;
+                        if (tx >= clip_right)
+                                tx = (float)clip_right - 1;
+                        if (ty < clip_top)
+                                ty = (float)clip_top;
+                        if (ty >= clip_bottom)
+                                ty = (float)clip_bottom - 1;
 
                         /* Sample the texture. */
-                        src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        if (bf.level == 0 && bf.box_w == 1 && bf.box_h == 1)
+                                src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        else
+                                src_pix = sample_box(&bf, (int)tx, (int)ty);
 
                         /* Get the destination pixel value for blending. */
                         dst_pix = dst_pixel[y * dw + x];
@@ -761,6 +966,8 @@ DRAW_IMAGE_3D_ADD(
 {
         int x, y;
         int sw, sh, dw, dst_y_max;
+        struct box_filter bf;
+        int clip_left, clip_top, clip_right, clip_bottom;
         uint32_t *dst_pixel, *src_pixel;
         uint32_t src_pix, dst_pix;
         uint32_t add_r, add_g, add_b;
@@ -773,16 +980,16 @@ DRAW_IMAGE_3D_ADD(
                             (float)src_top,
                             (float)x2,
                             (float)y2,
-                            (float)src_width,
+                            (float)(src_left + src_width),
                             (float)src_top,
                             (float)x3,
                             (float)y3,
                             (float)src_left,
-                            (float)src_height,
+                            (float)(src_top + src_height),
                             (float)x4,
                             (float)y4,
-                            (float)src_width,
-                            (float)src_height);                     
+                            (float)(src_left + src_width),
+                            (float)(src_top + src_height));                     
 
         dw = dst_image->width;
         sw = src_image->width;
@@ -792,6 +999,17 @@ DRAW_IMAGE_3D_ADD(
         dst_y_max = (dst_image->height > SC_LINES) ? SC_LINES : dst_image->height;
         a = (float)alpha / 255.0f;
 
+        /* Keep the box footprint inside the source rectangle. (a frame of a strip) */
+        clip_left = src_left;
+        clip_top = src_top;
+        clip_right = src_left + src_width > sw ? sw : src_left + src_width;
+        clip_bottom = src_top + src_height > sh ? sh : src_top + src_height;
+
+        /* Use a box filter when minifying. */
+        setup_box_filter(&bf, src_image, x1, y1, x2, y2, x3, y3,
+                         src_width, src_height,
+                         clip_left, clip_top, clip_right, clip_bottom);
+
         for (y = 0; y < dst_y_max; y++) {
                 int min_x, max_x;
                 float div, tx, ty, tx_inc, ty_inc;
@@ -826,17 +1044,20 @@ DRAW_IMAGE_3D_ADD(
                                 break;
 
                         /* Wrap texture sampling. */
-                        if (tx < 0)
-                                tx = 0;
-                        if (tx >= sw)
-                                tx = (float)sw - 1;
-                        if (ty < 0)
-                                ty = 0;
-                        if (ty >= sh)
-                                ty = (float)sh - 1;
+                        if (tx < clip_left)
+                                tx = (float)clip_left;
+                        if (tx >= clip_right)
+                                tx = (float)clip_right - 1;
+                        if (ty < clip_top)
+                                ty = (float)clip_top;
+                        if (ty >= clip_bottom)
+                                ty = (float)clip_bottom - 1;
 
                         /* Sample the texture. */
-                        src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        if (bf.level == 0 && bf.box_w == 1 && bf.box_h == 1)
+                                src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        else
+                                src_pix = sample_box(&bf, (int)tx, (int)ty);
 
                         /* Get the destination pixel value for blending. */
                         dst_pix = dst_pixel[y * dw + x];
@@ -897,6 +1118,8 @@ DRAW_IMAGE_3D_SUB(
 {
         int x, y;
         int sw, sh, dw, dst_y_max;
+        struct box_filter bf;
+        int clip_left, clip_top, clip_right, clip_bottom;
         uint32_t *dst_pixel, *src_pixel;
         uint32_t src_pix, dst_pix;
         uint32_t add_r, add_g, add_b;
@@ -909,16 +1132,16 @@ DRAW_IMAGE_3D_SUB(
                             (float)src_top,
                             (float)x2,
                             (float)y2,
-                            (float)src_width,
+                            (float)(src_left + src_width),
                             (float)src_top,
                             (float)x3,
                             (float)y3,
                             (float)src_left,
-                            (float)src_height,
+                            (float)(src_top + src_height),
                             (float)x4,
                             (float)y4,
-                            (float)src_width,
-                            (float)src_height);                     
+                            (float)(src_left + src_width),
+                            (float)(src_top + src_height));                     
 
         dw = dst_image->width;
         sw = src_image->width;
@@ -928,6 +1151,17 @@ DRAW_IMAGE_3D_SUB(
         dst_y_max = (dst_image->height > SC_LINES) ? SC_LINES : dst_image->height;
         a = (float)alpha / 255.0f;
 
+        /* Keep the box footprint inside the source rectangle. (a frame of a strip) */
+        clip_left = src_left;
+        clip_top = src_top;
+        clip_right = src_left + src_width > sw ? sw : src_left + src_width;
+        clip_bottom = src_top + src_height > sh ? sh : src_top + src_height;
+
+        /* Use a box filter when minifying. */
+        setup_box_filter(&bf, src_image, x1, y1, x2, y2, x3, y3,
+                         src_width, src_height,
+                         clip_left, clip_top, clip_right, clip_bottom);
+
         for (y = 0; y < dst_y_max; y++) {
                 int min_x, max_x;
                 float div, tx, ty, tx_inc, ty_inc;
@@ -962,17 +1196,20 @@ DRAW_IMAGE_3D_SUB(
                                 break;
 
                         /* Wrap texture sampling. */
-                        if (tx < 0)
-                                tx = 0;
-                        if (tx >= sw)
-                                tx = (float)sw - 1;
-                        if (ty < 0)
-                                ty = 0;
-                        if (ty >= sh)
-                                ty = (float)sh - 1;
+                        if (tx < clip_left)
+                                tx = (float)clip_left;
+                        if (tx >= clip_right)
+                                tx = (float)clip_right - 1;
+                        if (ty < clip_top)
+                                ty = (float)clip_top;
+                        if (ty >= clip_bottom)
+                                ty = (float)clip_bottom - 1;
 
                         /* Sample the texture. */
-                        src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        if (bf.level == 0 && bf.box_w == 1 && bf.box_h == 1)
+                                src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        else
+                                src_pix = sample_box(&bf, (int)tx, (int)ty);
 
                         /* Get the destination pixel value for blending. */
                         dst_pix = dst_pixel[y * dw + x];
@@ -1033,6 +1270,8 @@ DRAW_IMAGE_3D_DIM(
 {
         int x, y;
         int sw, sh, dw, dst_y_max;
+        struct box_filter bf;
+        int clip_left, clip_top, clip_right, clip_bottom;
         uint32_t *dst_pixel, *src_pixel;
         uint32_t src_pix, dst_pix;
         float a, src_r, src_g, src_b, src_a, dst_r, dst_g, dst_b, dst_a;
@@ -1043,16 +1282,16 @@ DRAW_IMAGE_3D_DIM(
                             (float)src_top,
                             (float)x2,
                             (float)y2,
-                            (float)src_width,
+                            (float)(src_left + src_width),
                             (float)src_top,
                             (float)x3,
                             (float)y3,
                             (float)src_left,
-                            (float)src_height,
+                            (float)(src_top + src_height),
                             (float)x4,
                             (float)y4,
-                            (float)src_width,
-                            (float)src_height);                     
+                            (float)(src_left + src_width),
+                            (float)(src_top + src_height));                     
 
         dw = dst_image->width;
         sw = src_image->width;
@@ -1062,6 +1301,17 @@ DRAW_IMAGE_3D_DIM(
         dst_y_max = (dst_image->height > SC_LINES) ? SC_LINES : dst_image->height;
         a = (float)alpha / 255.0f;
 
+        /* Keep the box footprint inside the source rectangle. (a frame of a strip) */
+        clip_left = src_left;
+        clip_top = src_top;
+        clip_right = src_left + src_width > sw ? sw : src_left + src_width;
+        clip_bottom = src_top + src_height > sh ? sh : src_top + src_height;
+
+        /* Use a box filter when minifying. */
+        setup_box_filter(&bf, src_image, x1, y1, x2, y2, x3, y3,
+                         src_width, src_height,
+                         clip_left, clip_top, clip_right, clip_bottom);
+
         for (y = 0; y < dst_y_max; y++) {
                 int min_x, max_x;
                 float div, tx, ty, tx_inc, ty_inc;
@@ -1096,17 +1346,20 @@ DRAW_IMAGE_3D_DIM(
                                 break;
 
                         /* Wrap texture sampling. */
-                        if (tx < 0)
-                                tx = 0;
-                        if (tx >= sw)
-                                tx = (float)sw - 1;
-                        if (ty < 0)
-                                ty = 0;
-                        if (ty >= sh)
-                                ty = (float)sh - 1;
+                        if (tx < clip_left)
+                                tx = (float)clip_left;
+                        if (tx >= clip_right)
+                                tx = (float)clip_right - 1;
+                        if (ty < clip_top)
+                                ty = (float)clip_top;
+                        if (ty >= clip_bottom)
+                                ty = (float)clip_bottom - 1;
 
                         /* Sample the texture. */
-                        src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        if (bf.level == 0 && bf.box_w == 1 && bf.box_h == 1)
+                                src_pix = src_pixel[(int)ty * sw + (int)tx];
+                        else
+                                src_pix = sample_box(&bf, (int)tx, (int)ty);
 
                         /* Get the destination pixel value for blending. */
                         dst_pix = dst_pixel[y * dw + x];
@@ -143,9 +143,8 @@ main(
 
 		process_input();
 
-		hal_clear_image(image, 0);
-
 		if (is_gst_playing) {
+			/* This fills the whole frame image. */
 			need_flip = draw_video_frame();
 
 			if (!gstplay_is_playing()) {
@@ -158,6 +157,8 @@ main(
 		} else {
 			need_flip = true;
 
+			hal_clear_image(image, 0);
+
 			if (!hal_callback_on_event_frame())
 				break;
 		}
@@ -450,44 +451,15 @@ process_event(
 static bool
 draw_video_frame(void)
 {
-	struct hal_image *video_image;
-	int dst_width, dst_height, dst_x, dst_y;
-
-	/* Update the playback stauts. */
-	video_image = gstplay_loop_iteration();
-	if (video_image == NULL) {
+	/*
+	 * Update the playback stauts, and convert a new YUV frame straight
+	 * into the frame image with the letterbox.
+	 */
+	if (!gstplay_draw_frame(image)) {
 		/* Rendering is not required for this game frame. */
 		return false;
 	}
 
-	/* Fit while preserving aspect ratio. */
-	if (screen_width * video_image->height <= screen_height * video_image->width) {
-		dst_width = screen_width;
-		dst_height = screen_width * video_image->height / video_image->width;
-	} else {
-		dst_height = screen_height;
-		dst_width = screen_height * video_image->width / video_image->height;
-	}
-	dst_x = (screen_width - dst_width) / 2;
-	dst_y = (screen_height - dst_height) / 2;
-
-	/* Draw. */
-	hal_draw_image_3d_alpha(image,
-				dst_x,
-				dst_y,
-				dst_x + dst_width,
-				dst_y,
-				dst_x,
-				dst_y + dst_height,
-				dst_x + dst_width,
-				dst_y + dst_height,
-				video_image,
-				0,
-				0,
-				video_image->width,
-				video_image->height,
-				255);
-
 	return true;
 }
 
@@ -497,7 +469,7 @@ draw_video_frame(void)
 
 void hal_notify_image_update(struct hal_image *img)
 {
-	UNUSED_PARAMETER(img);
+	img->is_mip_valid = false;
 }
 
 void hal_notify_image_free(struct hal_image *img)
@@ -902,7 +874,7 @@ hal_play_video(
 	is_gst_playing = true;
 	is_gst_skippable = is_skippable;
 
-	gstplay_play(path);
+	gstplay_play_yuv(path);
 
 	free(path);
 
@@ -86,6 +86,8 @@
 /* Frame Time */
 #define FRAME_MILLI	(16)	/* Millisec of a frame */
 #define SLEEP_MILLI	(5)	/* Millisec to sleep */
+#define IDLE_MILLI	(50)	/* Millisec of an idle frame */
+#define IDLE_FRAMES	(30)	/* Frames without rendering to become idle */
 
 /* Virtual Screen Config */
 static char *window_title;
@@ -118,6 +120,12 @@ static EGLSurface esurf;
 /* Frame Start Time */
 static struct timeval tv_start;
 
+/* Flag to force rendering of the next frame. (e.g., after a video) */
+static bool is_render_forced = true;
+
+/* Count of the consecutive frames that skipped rendering. */
+static int idle_frame_count;
+
 /* Log File */
 #define LOG_BUF_SIZE	(4096)
 static FILE *log_fp;
@@ -157,6 +165,7 @@ static void destroy_window(void);
 static void destroy_icon_image(void);
 static void run_game_loop(void);
 static bool run_frame(void);
+static bool is_render_needed(void);
 static void render_video_frame(void);
 static void flip(void);
 static bool wait_for_next_frame(void);
@@ -585,14 +594,21 @@ run_frame(void)
 
 		/* Call a frame event. */
 		cont = hal_callback.on_update();
-		hal_callback.on_render();
-
-		/* End rendering. */
-		opengl_end_rendering();
-
-		/* Swap buffers. */
-		eglSwapBuffers(dpy, esurf);
-		flip();
+		if (is_render_needed()) {
+			hal_callback.on_render();
+
+			/* End rendering. */
+			opengl_end_rendering();
+
+			/* Swap buffers. */
+			eglSwapBuffers(dpy, esurf);
+			flip();
+			idle_frame_count = 0;
+		} else {
+			/* Nothing changed: keep the last presented frame. */
+			opengl_end_rendering();
+			idle_frame_count++;
+		}
 	} else {
 		/* Render. */
 		render_video_frame();
@@ -605,12 +621,29 @@ run_frame(void)
 		if (!gstplay_is_playing()) {
 			gstplay_stop();
 			is_gst_playing = false;
+			is_render_forced = true;
 		}
 	}
 
 	return cont;
 }
 
+/* Check whether the current frame has to be rendered. */
+static bool
+is_render_needed(void)
+{
+	if (is_render_forced) {
+		is_render_forced = false;
+		return true;
+	}
+
+	/* If the app doesn't track changes, always render. */
+	if (hal_callback.on_check_render == NULL)
+		return true;
+
+	return hal_callback.on_check_render();
+}
+
 /* Render a video frame. */
 static void
 render_video_frame(void)
@@ -694,10 +727,14 @@ wait_for_next_frame(void)
 	struct timeval tv_end;
 	uint32_t lap, wait, span;
 
-	span = FRAME_MILLI;
-
 	/* Do event processing and sleep until the time of next frame start. */
 	do {
+		/* Process events if exist. */
+		process_input();
+
+		/* Lower the frame rate while the screen is idle. */
+		span = idle_frame_count >= IDLE_FRAMES ? IDLE_MILLI : FRAME_MILLI;
+
 		/* Get a lap time. */
 		gettimeofday(&tv_end, NULL);
 		lap = (uint32_t)((tv_end.tv_sec - tv_start.tv_sec) * 1000 +
@@ -757,6 +794,9 @@ update_viewport_size(
 
 	/* Update the screen offset and scale for drawing subsystem. */
 	opengl_set_screen(orig_x, orig_y, viewport_width, viewport_height);
+
+	/* Redraw the screen even if the stage is unchanged. */
+	is_render_forced = true;
 }
 
 static bool
@@ -829,6 +869,9 @@ process_event(
 		return;
 	}
 
+	/* Leave the idle frame rate on any input. */
+	idle_frame_count = 0;
+
 	/* printf("Event: type=%d, code=%d, value=%d\n", e.type, e.code, e.value); */
 
 	/* Process by a type. */
@@ -1446,6 +1489,7 @@ hal_stop_video(void)
 	gstplay_stop();
 
 	is_gst_playing = false;
+	is_render_forced = true;
 }
 
 /*
@@ -114,6 +114,29 @@
 #include "glhelper.h"
 #endif
 
+/*
+ * Texture uploads.
+ *  - We can specify GL_UNPACK_ROW_LENGTH to upload a sub-rectangle on
+ *    desktop OpenGL and WebGL 2.0, but not on OpenGL ES 2.0 contexts.
+ *  - We can allocate immutable storage by glTexStorage2D() on WebGL 2.0.
+ */
+#if !defined(HAL_USE_QT) && \
+    (defined(HAL_TARGET_WASM) || \
+     ((defined(HAL_TARGET_LINUX) || \
+       defined(HAL_TARGET_FREEBSD) || \
+       defined(HAL_TARGET_NETBSD) || \
+       defined(HAL_TARGET_OPENBSD)) && \
+      !defined(HAL_USE_GLES) && \
+      !defined(HAL_TARGET_ANDROID) && \
+      !defined(HAL_TARGET_OPENHARMONY)) || \
+     defined(HAL_TARGET_WINDOWS) || \
+     defined(HAL_TARGET_MACOS))
+#define USE_UNPACK_ROW_LENGTH
+#endif
+#if defined(HAL_TARGET_WASM)
+#define USE_TEX_STORAGE
+#endif
+
 /*
  * Pipeline types.
  */
@@ -153,6 +176,45 @@ enum {
 	V_SIZE = 8,
 };
 
+/*
+ * Sprite batching.
+ *  - Quads that share a pipeline and textures are accumulated into
+ *    batch_vertex[] and drawn by a single glDrawElements() call.
+ *  - A batch is flushed when the pipeline or a texture changes, when it
+ *    is full, when a texture in use is re-uploaded or deleted, and at the
+ *    end of a frame.
+ *  - The VBO is orphaned by glBufferData() on each flush so that the
+ *    driver doesn't have to wait for the previous draw to finish.
+ */
+
+/* Maximum quads in a batch. (All vertex indices must fit in GLushort.) */
+#define BATCH_QUADS		1024
+
+/* Vertices of the current batch. (4 vertices per quad) */
+static GLfloat batch_vertex[BATCH_QUADS * 4 * V_SIZE];
+
+/* Indices for BATCH_QUADS quads. (2 triangles per quad) */
+static GLushort batch_index[BATCH_QUADS * 6];
+
+/* Quad count in the current batch. */
+static int batch_quads;
+
+/* Pipeline and textures of the current batch. */
+static int batch_pipeline;
+static GLuint batch_tex1;
+static GLuint batch_tex2;
+
+/* The pipeline that is currently bound. (-1 for none) */
+static int bound_pipeline = -1;
+
+/* Statistics for the current frame. */
+static int frame_draw_calls;
+static int frame_quads;
+
+/* Statistics for the last frame. */
+static int last_draw_calls;
+static int last_quads;
+
 /*
  * The sole vertex shader that is shared between all fragment shaders.
  */
@@ -478,6 +540,10 @@ static void draw_elements_3d(float x1,
 			     int alpha,
 			     int pipeline);
 static void update_texture_if_needed(struct hal_image *img);
+static void upload_dirty_rect(struct hal_image *img);
+static void init_batch_index(void);
+static void bind_pipeline(int pipeline);
+static void flush_batch(void);
 
 /*
  * Initialize OpenGL.
@@ -500,6 +566,11 @@ init_opengl(
 	glViewport(0, 0, window_height, window_width);
 #endif
 
+	/* Make the index array for batches. */
+	init_batch_index();
+	batch_quads = 0;
+	bound_pipeline = -1;
+
 	/* Setup a vertex shader. */
 	if (!setup_vertex_shader(&vertex_shader_src, &vertex_shader))
 		return false;
@@ -624,8 +695,6 @@ setup_fragment_shader(
 	GLint is_succeeded;
 	int err_len;
 
-	const GLushort indices[] = {0, 1, 2, 3};
-
 	/* Create a fragment shader. */
 	*fshader = glCreateShader(GL_FRAGMENT_SHADER);
 	glShaderSource(*fshader, 1, fshader_src, NULL);
@@ -712,10 +781,10 @@ setup_fragment_shader(
 		glUniform1i(sampler2_loc, 1);
 	}
 
-	/* Create an IBO. */
+	/* Create an IBO for batches. */
 	glGenBuffers(1, ibo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ibo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(batch_index), batch_index,
 		     GL_STATIC_DRAW);
 
 	return true;
@@ -759,6 +828,10 @@ cleanup_fragment_shader(
 void
 cleanup_opengl(void)
 {
+	/* Discard a pending batch. */
+	batch_quads = 0;
+	bound_pipeline = -1;
+
 	if (fragment_shader_normal != (GLuint)-1) {
 		cleanup_fragment_shader(fragment_shader_normal,
 					program_normal,
@@ -803,6 +876,12 @@ cleanup_opengl(void)
 void
 opengl_start_rendering(void)
 {
+	/* Flush a batch before clearing. */
+	flush_batch();
+
+	/* The platform code may have changed the GL state between frames. */
+	bound_pipeline = -1;
+
 #if defined(HAL_USE_QT) || defined(HAL_USE_WAYLAND)
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -818,15 +897,37 @@ opengl_start_rendering(void)
 void
 opengl_end_rendering(void)
 {
+	/* Draw the last batch. */
+	flush_batch();
+
 	glFlush();
 	is_after_reinit = false;
+
+	/* Update the statistics. */
+	last_draw_calls = frame_draw_calls;
+	last_quads = frame_quads;
+	frame_draw_calls = 0;
+	frame_quads = 0;
+}
+
+/*
+ * Get the rendering statistics of the last frame.
+ */
+void
+opengl_get_frame_stats(
+	int *draw_calls,	/* OUT: glDrawElements() call count, i.e. batch count. */
+	int *quads)		/* OUT: Rendered quad count. */
+{
+	*draw_calls = last_draw_calls;
+	*quads = last_quads;
 }
 
 /*
  * Texture manipulation:
  *  - "Texture" here is a GPU backend of an image.
  *  - The app abstracts modifications of textures by "notify" operations.
- *  - Updated textures will be uploaded to GPU using glTexImage2D() when they are rendered.
+ *  - A texture is allocated once when an image is rendered for the first time.
+ *  - Updated rectangles will be uploaded to GPU using glTexSubImage2D() when they are rendered.
  */
 
 /*
@@ -838,7 +939,16 @@ void
 opengl_notify_image_update(
 	struct hal_image *img)
 {
+	/* Upload the whole image unless a rectangle is notified. */
+	if (!img->is_rect_update) {
+		img->dirty_left = 0;
+		img->dirty_top = 0;
+		img->dirty_right = img->width;
+		img->dirty_bottom = img->height;
+	}
+
 	img->need_upload = true;
+	img->is_mip_valid = false;
 }
 
 /*
@@ -852,6 +962,10 @@ opengl_notify_image_free(
 
 	id = (GLuint)(uintptr_t)img->texture - 1;
 
+	/* Draw a pending batch that refers the texture. */
+	if (batch_quads > 0 && (id == batch_tex1 || id == batch_tex2))
+		flush_batch();
+
 	/* FIXME: is_after_reinit */
 	if (id != 0) {
 		glDeleteTextures(1, &id);
@@ -1474,8 +1588,8 @@ draw_elements_3d(
 	int alpha,
 	int pipeline)
 {
-	GLfloat pos[32];
-	float hw, hh, tw1, th1, tw2, th2;
+	GLfloat *pos;
+	float hw, hh, tw1, th1, tw2, th2, a;
 	GLuint tex1, tex2;
 
 	update_texture_if_needed(src1_image);
@@ -1486,11 +1600,26 @@ draw_elements_3d(
 	assert(tex1 != 0);
 	if (src2_image != NULL) {
 		tex2 = (GLuint)(intptr_t)src2_image->texture - 1;
-		assert(tex1 != 0);
+		assert(tex2 != 0);
 	} else {
 		tex2 = 0;
 	}
 
+	/* Flush the current batch if we can't append to it. */
+	if (batch_quads > 0 &&
+	    (batch_quads == BATCH_QUADS ||
+	     pipeline != batch_pipeline ||
+	     tex1 != batch_tex1 ||
+	     tex2 != batch_tex2))
+		flush_batch();
+
+	/* Start a new batch. */
+	if (batch_quads == 0) {
+		batch_pipeline = pipeline;
+		batch_tex1 = tex1;
+		batch_tex2 = tex2;
+	}
+
 	/* Get the half of the window size. */
 	hw = (float)window_width / 2.0f;
 	hh = (float)window_height / 2.0f;
@@ -1506,6 +1635,12 @@ draw_elements_3d(
 		th2 = 1;
 	}
 
+	/* Get the alpha value. */
+	a = (float)alpha / 255.0f;
+
+	/* Append 4 vertices to the batch. */
+	pos = &batch_vertex[batch_quads * 4 * V_SIZE];
+
 	/* Left-Top */
 	pos[0] = (x1 - hw) / hw;
 	pos[1] = -(y1 - hh) / hh;
@@ -1514,7 +1649,7 @@ draw_elements_3d(
 	pos[4] = src1_ty1 / th1;
 	pos[5] = src2_tx1 / tw2;
 	pos[6] = src2_ty1 / th2;
-	pos[7] = (float)alpha / 255.0f;
+	pos[7] = a;
 
 	/* Right-Top */
 	pos[8] = (x2 - hw) / hw;
@@ -1524,7 +1659,7 @@ draw_elements_3d(
 	pos[12] = src1_ty2 / th1;
 	pos[13] = src2_tx2 / tw2;
 	pos[14] = src2_ty2 / th2;
-	pos[15] = (float)alpha / 255.0f;
+	pos[15] = a;
 
 	/* Left-Bottom */
 	pos[16] = (x3 - hw) / hw;
@@ -1534,7 +1669,7 @@ draw_elements_3d(
 	pos[20] = src1_ty3 / th1;
 	pos[21] = src2_tx3 / tw2;
 	pos[22] = src2_ty3 / th2;
-	pos[23] = (float)alpha / 255.0f;
+	pos[23] = a;
 
 	/* Right-Bottom */
 	pos[24] = (x4 - hw) / hw;
@@ -1544,7 +1679,36 @@ draw_elements_3d(
 	pos[28] = src1_ty4 / th1;
 	pos[29] = src2_tx4 / tw2;
 	pos[30] = src2_ty4 / th2;
-	pos[31] = (float)alpha / 255.0f;
+	pos[31] = a;
+
+	batch_quads++;
+	frame_quads++;
+}
+
+/* Make the index array for batches. */
+static void
+init_batch_index(void)
+{
+	int i;
+
+	/* A quad is "Left-Top, Right-Top, Left-Bottom, Right-Bottom". */
+	for (i = 0; i < BATCH_QUADS; i++) {
+		batch_index[i * 6 + 0] = (GLushort)(i * 4 + 0);
+		batch_index[i * 6 + 1] = (GLushort)(i * 4 + 1);
+		batch_index[i * 6 + 2] = (GLushort)(i * 4 + 2);
+		batch_index[i * 6 + 3] = (GLushort)(i * 4 + 2);
+		batch_index[i * 6 + 4] = (GLushort)(i * 4 + 1);
+		batch_index[i * 6 + 5] = (GLushort)(i * 4 + 3);
+	}
+}
+
+/* Bind a pipeline if it is not bound. */
+static void
+bind_pipeline(
+	int pipeline)
+{
+	if (pipeline == bound_pipeline)
+		return;
 
 	/* Setup the shader. */
 	switch (pipeline) {
@@ -1616,19 +1780,38 @@ draw_elements_3d(
 		break;
 	}
 
-	/* Transfer the vertices */
-	glBufferData(GL_ARRAY_BUFFER, sizeof(pos), pos, GL_STATIC_DRAW);
+	bound_pipeline = pipeline;
+}
+
+/* Draw the current batch. */
+static void
+flush_batch(void)
+{
+	if (batch_quads == 0)
+		return;
+
+	/* Setup the shader. */
+	bind_pipeline(batch_pipeline);
+
+	/* Transfer the vertices. (This orphans the previous storage.) */
+	glBufferData(GL_ARRAY_BUFFER,
+		     (GLsizeiptr)((size_t)batch_quads * 4 * V_SIZE * sizeof(GLfloat)),
+		     batch_vertex,
+		     GL_STREAM_DRAW);
 
 	/* Select textures. */
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tex1);
-	if (src2_image != NULL) {
+	if (batch_tex2 != 0) {
 		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, tex2);
+		glBindTexture(GL_TEXTURE_2D, batch_tex2);
 	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, batch_tex1);
 
 	/* Render primitives. */
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, 0);
+	glDrawElements(GL_TRIANGLES, batch_quads * 6, GL_UNSIGNED_SHORT, 0);
+
+	frame_draw_calls++;
+	batch_quads = 0;
 }
 
 /* Upload a texture. */
@@ -1637,6 +1820,7 @@ update_texture_if_needed(
 	struct hal_image *img)
 {
 	GLuint id;
+	bool is_new;
 
 	if (img == NULL)
 		return;
@@ -1646,26 +1830,94 @@ update_texture_if_needed(
 	if (img->context != reinit_count || is_after_reinit || img->texture == NULL) {
 		glGenTextures(1, &id);
 		img->texture = (void *)(intptr_t)(id + 1);
+		is_new = true;
 	} else {
 		id = (GLuint)(intptr_t)img->texture - 1;
+		is_new = false;
+
+		/* Draw a pending batch that refers the old pixels. */
+		if (batch_quads > 0 && (id == batch_tex1 || id == batch_tex2))
+			flush_batch();
 	}
 
-	/* Create or update an OpenGL texture. */
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, id);
+	if (is_new) {
+		/* Create an OpenGL texture. */
 #ifdef HAL_TARGET_WASM
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 #else
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 #endif
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->width, img->height, 0,
-		     GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
-	glActiveTexture(GL_TEXTURE0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+#if defined(USE_TEX_STORAGE)
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, img->width, img->height);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, img->width, img->height,
+				GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
+#else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, img->width, img->height, 0,
+			     GL_RGBA, GL_UNSIGNED_BYTE, img->pixels);
+#endif
+	} else {
+		/* Update the dirty rectangle of the OpenGL texture. */
+		upload_dirty_rect(img);
+	}
 
 	img->need_upload = false;
 	img->context = reinit_count;
+	img->dirty_left = 0;
+	img->dirty_top = 0;
+	img->dirty_right = 0;
+	img->dirty_bottom = 0;
+}
+
+/* Upload the dirty rectangle of an image to the bound texture. */
+static void
+upload_dirty_rect(
+	struct hal_image *img)
+{
+	int left, top, right, bottom;
+
+	left = img->dirty_left;
+	top = img->dirty_top;
+	right = img->dirty_right;
+	bottom = img->dirty_bottom;
+	if (left >= right || top >= bottom) {
+		left = 0;
+		top = 0;
+		right = img->width;
+		bottom = img->height;
+	}
+
+#if defined(USE_UNPACK_ROW_LENGTH)
+	/* Upload the rectangle. */
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, img->width);
+	glTexSubImage2D(GL_TEXTURE_2D,
+			0,
+			left,
+			top,
+			right - left,
+			bottom - top,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			img->pixels + top * img->width + left);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#else
+	/* Upload the whole lines because we can't specify a row length. */
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	glTexSubImage2D(GL_TEXTURE_2D,
+			0,
+			0,
+			top,
+			img->width,
+			bottom - top,
+			GL_RGBA,
+			GL_UNSIGNED_BYTE,
+			img->pixels + top * img->width);
+#endif
 }
 
 /*
@@ -1673,6 +1925,9 @@ update_texture_if_needed(
  */
 void opengl_set_screen(int x, int y, int w, int h)
 {
+	/* Draw a pending batch with the current viewport. */
+	flush_batch();
+
 #if !defined(HAL_USE_ROT90)
 	glViewport(x, y, w, h);
 #else
@@ -37,6 +37,7 @@ bool init_opengl(int width, int height);
 void cleanup_opengl(void);
 void opengl_start_rendering(void);
 void opengl_end_rendering(void);
+void opengl_get_frame_stats(int *draw_calls, int *quads);
 void opengl_notify_image_update(struct hal_image *img);
 void opengl_notify_image_free(struct hal_image *img);
 
@@ -107,6 +107,14 @@ static void draw_glyph_dim_func(
 	int image_x,
 	int image_y,
 	hal_pixel_t color);
+static void notify_glyph_update(
+	struct hal_image *img,
+	int image_x,
+	int image_y,
+	int margin_left,
+	int margin_top,
+	int font_width,
+	int font_height);
 
 /*
  * Initialize the font render.
@@ -594,6 +602,13 @@ draw_glyph_with_outline(
 					    y - (font_size - base_font_size),
 					    outline_color);
 		}
+		notify_glyph_update(img,
+				    x,
+				    y - (font_size - base_font_size),
+				    bitmapGlyph->left,
+				    font_size - bitmapGlyph->top,
+				    (int)bitmapGlyph->bitmap.width,
+				    (int)bitmapGlyph->bitmap.rows);
 	}
 	descent = (int)bitmapGlyph->bitmap.rows - bitmapGlyph->top;
 	*ret_h = font_size + descent;
@@ -636,6 +651,13 @@ draw_glyph_with_outline(
 					    y - (font_size - base_font_size),
 					    outline_color);
 		}
+		notify_glyph_update(img,
+				    x,
+				    y - (font_size - base_font_size),
+				    bitmapGlyph->left,
+				    font_size - bitmapGlyph->top,
+				    (int)bitmapGlyph->bitmap.width,
+				    (int)bitmapGlyph->bitmap.rows);
 	}
 	*ret_w = (int)face[font_index]->glyph->advance.x / SCALE;
 	descent = (int)bitmapGlyph->bitmap.rows - bitmapGlyph->top + outline_size;
@@ -677,6 +699,13 @@ draw_glyph_with_outline(
 					    y - (font_size - base_font_size),
 					    color);
 		}
+		notify_glyph_update(img,
+				    x,
+				    y - (font_size - base_font_size),
+				    bitmapGlyph->left,
+				    font_size - bitmapGlyph->top,
+				    (int)bitmapGlyph->bitmap.width,
+				    (int)bitmapGlyph->bitmap.rows);
 	}
 	descent = (int)bitmapGlyph->bitmap.rows - bitmapGlyph->top;
 	if (font_size + descent > *ret_h)
@@ -684,10 +713,6 @@ draw_glyph_with_outline(
 
 	FT_Done_Glyph(glyph);
 
-	/* Update a GPU texture. */
-	if (img != NULL)
-		hal_notify_image_update(img);
-
 	return true;
 }
 
@@ -750,6 +775,13 @@ draw_glyph_without_outline(
 					    y - (font_size - base_font_size),
 					    color);
 		}
+		notify_glyph_update(img,
+				    x,
+				    y - (font_size - base_font_size),
+				    face[font_index]->glyph->bitmap_left,
+				    font_size - face[font_index]->glyph->bitmap_top,
+				    (int)face[font_index]->glyph->bitmap.width,
+				    (int)face[font_index]->glyph->bitmap.rows);
 	}
 
 	/* Get a descent. */
@@ -760,10 +792,6 @@ draw_glyph_without_outline(
 	*ret_w = (int)face[font_index]->glyph->advance.x / SCALE;
 	*ret_h = font_size + descent;
 
-	/* Update a GPU texture. */
-	if (img != NULL)
-		hal_notify_image_update(img);
-
 	return true;
 }
 
@@ -804,6 +832,24 @@ hal_isgraph_extended(
 	return false;
 }
 
+/* Notify a texture update for a glyph rectangle. */
+static void
+notify_glyph_update(
+	struct hal_image *img,
+	int image_x,
+	int image_y,
+	int margin_left,
+	int margin_top,
+	int font_width,
+	int font_height)
+{
+	hal_notify_image_update_rect(img,
+				     image_x + margin_left,
+				     image_y + margin_top,
+				     font_width,
+				     font_height);
+}
+
 /* Draw a glyph to an image. */
 static void
 draw_glyph_func(
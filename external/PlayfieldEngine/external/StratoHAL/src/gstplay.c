@@ -46,6 +46,17 @@
 
 /* Standard C */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * YUV to RGB coefficients in 8-bit fixed point (limited range)
+ */
+struct yuv_coef {
+  int y, vr, ug, vg, ub;
+};
+static const struct yuv_coef coef_bt601 = { 298, 409, -100, -208, 516 };
+static const struct yuv_coef coef_bt709 = { 298, 459, -55, -136, 541 };
 
 static GstElement * pipeline;
 static GstElement *vsink;
@@ -54,6 +65,28 @@ static guintptr video_window_handle;
 static _Bool is_eos;
 static struct hal_image *image;
 
+/* A converted source row for scaling. */
+static hal_pixel_t *row_buf;
+static int row_buf_width;
+
+static void
+play (const char *fname, const char *caps_str);
+
+static int
+alloc_row_buf (int width);
+
+static void
+convert_row_i420 (const guint8 * __restrict y, const guint8 * __restrict u,
+                  const guint8 * __restrict v, hal_pixel_t * __restrict dst,
+                  int width, const struct yuv_coef *k);
+
+static void
+convert_row_nv12 (const guint8 * __restrict y, const guint8 * __restrict uv,
+                  hal_pixel_t * __restrict dst, int width, const struct yuv_coef *k);
+
+static void
+scale_row (const hal_pixel_t *src, int src_width, hal_pixel_t *dst, int dst_width);
+
 static GstBusSyncReply
 bus_sync_handler (GstBus * bus, GstMessage * message, gpointer user_data);
 
@@ -71,6 +104,23 @@ gstplay_init (int argc, char *argv[])
 
 void
 gstplay_play(const char *fname)
+{
+  play(fname, "video/x-raw,format=RGBA");
+}
+
+/*
+ * Play with YUV frames for gstplay_draw_frame().
+ *  - Skips the RGBA conversion pass in videoconvert, and a decoder that
+ *    outputs I420 or NV12 needs no conversion at all.
+ */
+void
+gstplay_play_yuv(const char *fname)
+{
+  play(fname, "video/x-raw,format={I420,NV12}");
+}
+
+static void
+play(const char *fname, const char *caps_str)
 {
   GMainLoop *loop;
   GstElement *src, *dec, *capsfilter, *aconv, *asink;
@@ -92,7 +142,7 @@ gstplay_play(const char *fname)
       capsfilter == NULL || vsink == NULL || aconv == NULL)
     return;
 
-  caps = gst_caps_from_string("video/x-raw,format=RGBA");
+  caps = gst_caps_from_string(caps_str);
   g_object_set(capsfilter, "caps", caps, NULL);
   gst_caps_unref(caps);
 
@@ -245,6 +295,10 @@ gstplay_stop (void)
 
   gst_object_unref (pipeline);
   pipeline = NULL;
+
+  free(row_buf);
+  row_buf = NULL;
+  row_buf_width = 0;
 }
 
 int
@@ -309,6 +363,221 @@ gstplay_loop_iteration(void)
   return image;
 }
 
+/*
+ * Draw a YUV frame into an image, fitting it while preserving the aspect
+ * ratio.
+ *  - The mapped GstBuffer is read in place. Each source row is converted
+ *    once in a vectorizable loop and scaled straight into dst.
+ *  - Returns 1 if a new frame is drawn.
+ */
+int
+gstplay_draw_frame(struct hal_image *dst)
+{
+  GstSample *sample;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  const struct yuv_coef *k;
+  const guint8 *yp, *up, *vp;
+  hal_pixel_t *d, black;
+  int width, height, dst_w, dst_h, dst_x, dst_y, y, sy, last_sy;
+  int is_nv12;
+
+  g_main_context_iteration(g_main_context_default(), FALSE);
+
+  /* Non-blocking. */
+  sample = gst_app_sink_try_pull_sample(GST_APP_SINK(vsink), 0);
+  if (sample == NULL)
+    return 0;
+
+  caps = gst_sample_get_caps(sample);
+  if (caps == NULL || !gst_video_info_from_caps(&info, caps)) {
+    gst_sample_unref(sample);
+    return 0;
+  }
+
+  buffer = gst_sample_get_buffer(sample);
+  if (!gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ)) {
+    gst_sample_unref(sample);
+    return 0;
+  }
+
+  width = GST_VIDEO_FRAME_WIDTH(&frame);
+  height = GST_VIDEO_FRAME_HEIGHT(&frame);
+  is_nv12 = GST_VIDEO_FRAME_FORMAT(&frame) == GST_VIDEO_FORMAT_NV12;
+  k = info.colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT709 ? &coef_bt709 : &coef_bt601;
+
+  /* Fit while preserving aspect ratio. */
+  if (dst->width * height <= dst->height * width) {
+    dst_w = dst->width;
+    dst_h = dst->width * height / width;
+  } else {
+    dst_h = dst->height;
+    dst_w = dst->height * width / height;
+  }
+  dst_x = (dst->width - dst_w) / 2;
+  dst_y = (dst->height - dst_h) / 2;
+
+  if ((dst_w != width && !alloc_row_buf(width)) || dst_w <= 0 || dst_h <= 0) {
+    gst_video_frame_unmap(&frame);
+    gst_sample_unref(sample);
+    return 0;
+  }
+
+  /* Letterbox. */
+  black = hal_make_pixel(0xff, 0, 0, 0);
+  hal_clear_image_rect(dst, 0, 0, dst->width, dst_y, black);
+  hal_clear_image_rect(dst, 0, dst_y + dst_h, dst->width, dst->height - dst_y - dst_h, black);
+  hal_clear_image_rect(dst, 0, dst_y, dst_x, dst_h, black);
+  hal_clear_image_rect(dst, dst_x + dst_w, dst_y, dst->width - dst_x - dst_w, dst_h, black);
+
+  last_sy = -1;
+  for (y = 0; y < dst_h; y++) {
+    d = dst->pixels + (dst_y + y) * dst->width + dst_x;
+
+    /* Repeat the previous row when upscaling. */
+    sy = y * height / dst_h;
+    if (sy == last_sy) {
+      memcpy(d, d - dst->width, (size_t)dst_w * sizeof(hal_pixel_t));
+      continue;
+    }
+    last_sy = sy;
+
+    /* Convert the source row. */
+    yp = (const guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, 0) +
+         sy * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+    up = (const guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, 1) +
+         (sy / 2) * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 1);
+    if (is_nv12) {
+      convert_row_nv12(yp, up, dst_w == width ? d : row_buf, width, k);
+    } else {
+      vp = (const guint8 *)GST_VIDEO_FRAME_PLANE_DATA(&frame, 2) +
+           (sy / 2) * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 2);
+      convert_row_i420(yp, up, vp, dst_w == width ? d : row_buf, width, k);
+    }
+
+    /* Scale it into the destination. */
+    if (dst_w != width)
+      scale_row(row_buf, width, d, dst_w);
+  }
+
+  gst_video_frame_unmap(&frame);
+  gst_sample_unref(sample);
+
+  hal_notify_image_update(dst);
+
+  return 1;
+}
+
+static int
+alloc_row_buf(int width)
+{
+  if (row_buf_width >= width)
+    return 1;
+
+  free(row_buf);
+  row_buf = malloc((size_t)width * sizeof(hal_pixel_t));
+  if (row_buf == NULL) {
+    row_buf_width = 0;
+    return 0;
+  }
+  row_buf_width = width;
+
+  return 1;
+}
+
+/* Saturate a fixed point component. */
+#define CLAMP_COMPONENT(v) ((uint32_t)((v) < 0 ? 0 : ((v) > 255 * 256 ? 255 : (v) >> 8)))
+
+/* Convert a YUV pixel to a pixel value. */
+static INLINE hal_pixel_t
+yuv_to_pixel(int y, int cr, int cg, int cb)
+{
+  return hal_make_pixel(0xff, CLAMP_COMPONENT(y + cr), CLAMP_COMPONENT(y + cg), CLAMP_COMPONENT(y + cb));
+}
+
+/*
+ * Convert a row of I420 pixels.
+ *  - The loop has no branch and no aliasing, so that the compiler
+ *    vectorizes it. (SSE2 / NEON)
+ */
+static void
+convert_row_i420(const guint8 * __restrict y, const guint8 * __restrict u,
+                 const guint8 * __restrict v, hal_pixel_t * __restrict dst,
+                 int width, const struct yuv_coef *k)
+{
+  const int ky = k->y, kvr = k->vr, kug = k->ug, kvg = k->vg, kub = k->ub;
+  int i, cu, cv, cr, cg, cb, y0, y1;
+
+  for (i = 0; i < width / 2; i++) {
+    cu = u[i] - 128;
+    cv = v[i] - 128;
+    cr = kvr * cv + 128;
+    cg = kug * cu + kvg * cv + 128;
+    cb = kub * cu + 128;
+    y0 = (y[i * 2] - 16) * ky;
+    y1 = (y[i * 2 + 1] - 16) * ky;
+    dst[i * 2] = yuv_to_pixel(y0, cr, cg, cb);
+    dst[i * 2 + 1] = yuv_to_pixel(y1, cr, cg, cb);
+  }
+
+  /* An odd width. */
+  if (width & 1) {
+    cu = u[i] - 128;
+    cv = v[i] - 128;
+    y0 = (y[i * 2] - 16) * ky;
+    dst[i * 2] = yuv_to_pixel(y0, kvr * cv + 128, kug * cu + kvg * cv + 128, kub * cu + 128);
+  }
+}
+
+/*
+ * Convert a row of NV12 pixels.
+ *  - Same as above except the interleaved chroma plane.
+ */
+static void
+convert_row_nv12(const guint8 * __restrict y, const guint8 * __restrict uv,
+                 hal_pixel_t * __restrict dst, int width, const struct yuv_coef *k)
+{
+  const int ky = k->y, kvr = k->vr, kug = k->ug, kvg = k->vg, kub = k->ub;
+  int i, cu, cv, cr, cg, cb, y0, y1;
+
+  for (i = 0; i < width / 2; i++) {
+    cu = uv[i * 2] - 128;
+    cv = uv[i * 2 + 1] - 128;
+    cr = kvr * cv + 128;
+    cg = kug * cu + kvg * cv + 128;
+    cb = kub * cu + 128;
+    y0 = (y[i * 2] - 16) * ky;
+    y1 = (y[i * 2 + 1] - 16) * ky;
+    dst[i * 2] = yuv_to_pixel(y0, cr, cg, cb);
+    dst[i * 2 + 1] = yuv_to_pixel(y1, cr, cg, cb);
+  }
+
+  /* An odd width. */
+  if (width & 1) {
+    cu = uv[i * 2] - 128;
+    cv = uv[i * 2 + 1] - 128;
+    y0 = (y[i * 2] - 16) * ky;
+    dst[i * 2] = yuv_to_pixel(y0, kvr * cv + 128, kug * cu + kvg * cv + 128, kub * cu + 128);
+  }
+}
+
+/* Scale a row by the nearest neighbor. */
+static void
+scale_row(const hal_pixel_t *src, int src_width, hal_pixel_t *dst, int dst_width)
+{
+  unsigned int pos, step;
+  int x;
+
+  step = (unsigned int)(((unsigned long)src_width << 16) / (unsigned long)dst_width);
+  pos = 0;
+  for (x = 0; x < dst_width; x++) {
+    dst[x] = src[pos >> 16];
+    pos += step;
+  }
+}
+
 #else /* #ifndef NO_GST */
 
 #include <strato/c89compat.h>
@@ -326,6 +595,12 @@ gstplay_play (const char *fname)
   UNUSED_PARAMETER(fname);
 }
 
+void
+gstplay_play_yuv (const char *fname)
+{
+  UNUSED_PARAMETER(fname);
+}
+
 void
 gstplay_stop (void)
 {
@@ -343,4 +618,11 @@ gstplay_loop_iteration (void)
   return NULL;
 }
 
+int
+gstplay_draw_frame (struct hal_image *dst)
+{
+  UNUSED_PARAMETER(dst);
+  return 0;
+}
+
 #endif /* defined(HAL_USE_GSTREAMER) */
@@ -37,6 +37,9 @@ gstplay_init (int argc, char *argv[]);
 void
 gstplay_play (const char *fname);
 
+void
+gstplay_play_yuv (const char *fname);
+
 void
 gstplay_stop (void);
 
@@ -46,4 +49,7 @@ gstplay_is_playing (void);
 struct hal_image *
 gstplay_loop_iteration (void);
 
+int
+gstplay_draw_frame (struct hal_image *dst);
+
 #endif
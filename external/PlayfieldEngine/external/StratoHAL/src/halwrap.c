@@ -276,6 +276,7 @@ void
 hal_notify_image_update(
 	struct hal_image *img)
 {
+	img->is_mip_valid = false;
 	wrap_notify_image_update(
 		img->id,
 		img->width,
@@ -992,6 +993,37 @@ hal_close_wfile(
 }
 #endif
 
+#if defined(HAL_TARGET_UNITY)
+bool
+hal_write_file_async(
+	const char *file,
+	void *data,
+	size_t size)
+{
+	struct hal_wfile *wf;
+	size_t ret;
+	bool is_ok;
+
+	if (!hal_open_wfile(file, &wf)) {
+		free(data);
+		return false;
+	}
+	is_ok = hal_write_wfile(wf, data, size, &ret) && ret == size;
+	hal_close_wfile(wf);
+	free(data);
+
+	return is_ok;
+}
+#endif
+
+#if defined(HAL_TARGET_UNITY)
+bool
+hal_wait_file_writes(void)
+{
+	return true;
+}
+#endif
+
 #if defined(HAL_TARGET_UNITY)
 bool
 hal_remove_file(
@@ -47,6 +47,9 @@
 /* Scanline max  */
 #define SC_LINES	(1024)
 
+/* Mip levels below the image. (1/2 to 1/16) */
+#define MIP_LEVELS	(4)
+
 /* Texture ID */
 static int id_top;
 
@@ -93,6 +96,16 @@ check_draw_image(
 	int *src_top,
 	int alpha);
 
+const hal_pixel_t *
+get_image_mip(
+	struct hal_image *img,
+	int level,
+	int *width,
+	int *height);
+
+static bool make_mip(struct hal_image *img);
+static void shrink_half(const hal_pixel_t *src, int sw, hal_pixel_t *dst, int dw, int dh);
+
 #if defined(HAL_TARGET_WINDOWS)
 static void *wrap_aligned_malloc(size_t size, size_t align);
 static void wrap_aligned_free(void *p);
@@ -230,6 +243,10 @@ hal_destroy_image(
 	}
 	img->pixels = NULL;
 
+	/* Free the mip levels. */
+	free(img->mip_pixels);
+	img->mip_pixels = NULL;
+
 	/* Free a struct buffer. */
 	free(img);
 }
@@ -287,7 +304,7 @@ hal_clear_image_rect(
 			pixels[img->width * i + j] = color;
 
 	/* Request a texture update. */
-	hal_notify_image_update(img);
+	hal_notify_image_update_rect(img, x, y, w, h);
 }
 
 /*
@@ -1413,6 +1430,199 @@ hal_clip_by_dest(
 	return true;
 }
 
+/*
+ * Mip Levels
+ */
+
+/*
+ * Get a mip level of an image for the minifying draws.
+ *  - Level 0 is the image itself, and level n is 1/2^n of it.
+ *  - Level n's texel (x, y) covers the texels from (x << n, y << n).
+ *  - The levels are made on the first use after an update.
+ *  - Returns NULL if the level is too small, or if out of memory.
+ */
+const hal_pixel_t *
+get_image_mip(
+	struct hal_image *img,
+	int level,
+	int *width,
+	int *height)
+{
+	const hal_pixel_t *p;
+	int i;
+
+	if (level == 0) {
+		*width = img->width;
+		*height = img->height;
+		return img->pixels;
+	}
+	if (level > MIP_LEVELS ||
+	    (img->width >> level) == 0 ||
+	    (img->height >> level) == 0)
+		return NULL;
+
+	/* Make the levels if the image is updated. */
+	if (!img->is_mip_valid) {
+		if (!make_mip(img))
+			return NULL;
+		img->is_mip_valid = true;
+	}
+
+	/* Skip the upper levels. */
+	p = img->mip_pixels;
+	for (i = 1; i < level; i++)
+		p += (img->width >> i) * (img->height >> i);
+
+	*width = img->width >> level;
+	*height = img->height >> level;
+	return p;
+}
+
+/* Make the mip levels from the image. */
+static bool
+make_mip(
+	struct hal_image *img)
+{
+	const hal_pixel_t *src;
+	hal_pixel_t *dst;
+	size_t size;
+	int i, sw, w, h;
+
+	/* Allocate the levels at once. (A third of the image at most) */
+	if (img->mip_pixels == NULL) {
+		size = 0;
+		for (i = 1; i <= MIP_LEVELS; i++) {
+			w = img->width >> i;
+			h = img->height >> i;
+			if (w == 0 || h == 0)
+				break;
+			size += (size_t)w * (size_t)h;
+		}
+		if (size == 0)
+			return false;
+		img->mip_pixels = malloc(size * sizeof(hal_pixel_t));
+		if (img->mip_pixels == NULL) {
+			hal_log_out_of_memory();
+			return false;
+		}
+	}
+
+	/* Shrink each level from the level above. */
+	src = img->pixels;
+	sw = img->width;
+	dst = img->mip_pixels;
+	for (i = 1; i <= MIP_LEVELS; i++) {
+		w = img->width >> i;
+		h = img->height >> i;
+		if (w == 0 || h == 0)
+			break;
+		shrink_half(src, sw, dst, w, h);
+		src = dst;
+		sw = w;
+		dst += w * h;
+	}
+
+	return true;
+}
+
+/*
+ * Shrink pixels to half with a 2x2 box filter.
+ *  - Colors are weighted by alpha, as the box filter of the 3D draws.
+ *  - An odd last row and column are dropped.
+ */
+static void
+shrink_half(
+	const hal_pixel_t *src,
+	int sw,
+	hal_pixel_t *dst,
+	int dw,
+	int dh)
+{
+	const hal_pixel_t *s0, *s1;
+	uint32_t p[4], pa, sum_a, sum_c1, sum_c2, sum_c3;
+	int x, y, i;
+
+	for (y = 0; y < dh; y++) {
+		s0 = src + (y * 2) * sw;
+		s1 = s0 + sw;
+		for (x = 0; x < dw; x++) {
+			p[0] = s0[x * 2];
+			p[1] = s0[x * 2 + 1];
+			p[2] = s1[x * 2];
+			p[3] = s1[x * 2 + 1];
+			sum_a = 0;
+			sum_c1 = 0;
+			sum_c2 = 0;
+			sum_c3 = 0;
+			for (i = 0; i < 4; i++) {
+				pa = hal_get_pixel_a(p[i]);
+				sum_a += pa;
+				sum_c1 += pa * hal_get_pixel_c1(p[i]);
+				sum_c2 += pa * hal_get_pixel_c2(p[i]);
+				sum_c3 += pa * hal_get_pixel_c3(p[i]);
+			}
+			if (sum_a == 0) {
+				dst[y * dw + x] = 0;
+				continue;
+			}
+			dst[y * dw + x] = hal_make_pixel_fast((sum_a + 2) / 4,
+							      (sum_c1 + sum_a / 2) / sum_a,
+							      (sum_c2 + sum_a / 2) / sum_a,
+							      (sum_c3 + sum_a / 2) / sum_a);
+		}
+	}
+}
+
+/*
+ * Notify an image update for a rectangle.
+ */
+void
+hal_notify_image_update_rect(
+	struct hal_image *img,
+	int left,
+	int top,
+	int width,
+	int height)
+{
+	int right, bottom;
+
+	/* Clip the rectangle by the image size. */
+	right = left + width;
+	bottom = top + height;
+	if (left < 0)
+		left = 0;
+	if (top < 0)
+		top = 0;
+	if (right > img->width)
+		right = img->width;
+	if (bottom > img->height)
+		bottom = img->height;
+	if (left >= right || top >= bottom)
+		return;
+
+	/* Extend the dirty rectangle if it is not empty. */
+	if (img->dirty_left < img->dirty_right &&
+	    img->dirty_top < img->dirty_bottom) {
+		if (left > img->dirty_left)
+			left = img->dirty_left;
+		if (top > img->dirty_top)
+			top = img->dirty_top;
+		if (right < img->dirty_right)
+			right = img->dirty_right;
+		if (bottom < img->dirty_bottom)
+			bottom = img->dirty_bottom;
+	}
+	img->dirty_left = left;
+	img->dirty_top = top;
+	img->dirty_right = right;
+	img->dirty_bottom = bottom;
+
+	/* Tell the HAL that only the dirty rectangle needs an upload. */
+	img->is_rect_update = true;
+	hal_notify_image_update(img);
+	img->is_rect_update = false;
+}
+
 /*
  * _aligned_malloc() is not supported on Windows 9x and 2000.
  * Just use malloc() instead on 9x and 2000.
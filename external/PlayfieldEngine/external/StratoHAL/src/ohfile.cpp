@@ -361,6 +361,40 @@ hal_close_wfile(
 	}
 }
 
+//
+// Write a whole file.
+//  - There is no background writer on this platform.
+//
+bool
+hal_write_file_async(
+	const char *file,
+	void *data,
+	size_t size)
+{
+	struct hal_wfile *wf;
+	size_t ret;
+	bool is_ok;
+
+	if (!hal_open_wfile(file, &wf)) {
+		free(data);
+		return false;
+	}
+	is_ok = hal_write_wfile(wf, data, size, &ret) && ret == size;
+	hal_close_wfile(wf);
+	free(data);
+
+	return is_ok;
+}
+
+//
+// Wait for all background file writes.
+//
+bool
+hal_wait_file_writes(void)
+{
+	return true;
+}
+
 //
 // Remove a file.
 //
@@ -1415,6 +1415,13 @@ void q_glTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei wi
     F->glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
 }
 
+extern "C"
+void q_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const GLvoid *pixels)
+{
+    // Just map.
+    F->glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
 extern "C"
 void q_glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices)
 {
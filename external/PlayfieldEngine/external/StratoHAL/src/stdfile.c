@@ -55,6 +55,18 @@
 #include <fcntl.h>
 #endif
 
+/* Background writer thread. */
+#if defined(HAL_TARGET_WINDOWS)
+#include <windows.h>
+#include <io.h>			/* _commit() */
+#define USE_WRITER_THREAD
+#elif !defined(HAL_TARGET_WASM) && !defined(HAL_TARGET_PC98) && !defined(HAL_TARGET_PCAT)
+#include <unistd.h>		/* fsync() */
+#include <pthread.h>
+#define USE_WRITER_THREAD
+#define USE_FSYNC
+#endif
+
 /*
  * The "key" of obfuscation
  */
@@ -144,8 +156,67 @@ struct hal_rfile {
 struct hal_wfile {
 	FILE *fp;
 	uint64_t next_random;
+
+	/* Set if a write was short; the file is kept as is on close. */
+	bool is_failed;
+
+	/* The real path and the temporary file path. */
+#if defined(HAL_TARGET_WINDOWS) && defined(_UNICODE)
+	wchar_t *path;
+	wchar_t *tmp_path;
+#else
+	char *path;
+	char *tmp_path;
+#endif
 };
 
+/*
+ * Background write job.
+ */
+struct write_job {
+	struct write_job *next;
+
+	/* File name given by the app. */
+	char *file;
+
+	/* Opened by the writer thread. */
+	struct hal_wfile *wf;
+
+	/* Whole file content. */
+	void *data;
+	size_t size;
+};
+
+#ifdef USE_WRITER_THREAD
+
+/* Job queue. */
+static struct write_job *job_head;
+static struct write_job *job_tail;
+
+/* The job being written. */
+static struct write_job *job_running;
+
+/* Writer thread state. */
+static bool is_writer_started;
+static bool is_writer_quit;
+
+/* Set by the writer thread and cleared by hal_wait_file_writes(). */
+static bool is_write_failed;
+
+#if defined(HAL_TARGET_WINDOWS)
+static HANDLE writer_thread;
+static CRITICAL_SECTION job_lock;
+static HANDLE job_event;
+static HANDLE idle_event;
+#else
+static pthread_t writer_thread;
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+#endif /* USE_WRITER_THREAD */
+
 /*
  * Forward declarations.
  */
@@ -155,6 +226,30 @@ static void ungetc_rfile(struct hal_rfile *rf, char c);
 static void set_random_seed(uint64_t index, uint64_t *next_random);
 static char get_next_random(uint64_t *next_random, uint64_t *prev_random);
 static void rewind_random(uint64_t *next_random, uint64_t *prev_random);
+static struct hal_wfile *prepare_wfile(const char *file);
+static bool open_tmp_file(struct hal_wfile *wf);
+static bool commit_wfile(struct hal_wfile *wf);
+static void free_wfile(struct hal_wfile *wf);
+static bool write_job_file(struct write_job *job);
+static void free_job(struct write_job *job);
+static void wait_for_file(const char *file);
+#ifdef USE_WRITER_THREAD
+static void queue_job(struct write_job *job);
+static void run_writer(void);
+static bool start_writer(void);
+static void stop_writer(void);
+#if defined(HAL_TARGET_WINDOWS)
+static DWORD WINAPI writer_thread_proc(LPVOID param);
+#else
+static void *writer_thread_proc(void *param);
+#endif
+static void lock_jobs(void);
+static void unlock_jobs(void);
+static void wait_job_event(void);
+static void notify_job_event(void);
+static void wait_idle_event(void);
+static void notify_idle_event(void);
+#endif
 
 /*
  * Initialize the stdfile module.
@@ -245,6 +340,11 @@ init_file(void)
 void
 cleanup_file(void)
 {
+#ifdef USE_WRITER_THREAD
+	/* Write the queued files. */
+	stop_writer();
+#endif
+
 	if (package_path != NULL) {
 		free(package_path);
 		package_path = NULL;
@@ -280,6 +380,9 @@ hal_check_file_exist(
 	}
 #endif
 
+	/* Let a background write to the file finish. */
+	wait_for_file(file);
+
 	/* Make a real file path. */
 	real_path = make_real_path(file);
 	if (real_path == NULL)
@@ -415,6 +518,9 @@ open_real(
 {
 	char *real_path;
 
+	/* Let a background write to the file finish. */
+	wait_for_file(path);
+
 	/* Make a real path on the OS's file system. */
 	real_path = make_real_path(path);
 	if (real_path == NULL)
@@ -729,17 +835,22 @@ set_random_seed(
 	uint64_t index,
 	uint64_t *next_random)
 {
-	uint64_t i, next, lsb;
+	uint64_t i, next, lsb, key;
 
 	/* The key is shuffled so that decompilers cannot read it directly. */
-	key_reversed = ((((key_obfuscated >> 56) & 0xff) << 0) |
-			(((key_obfuscated >> 48) & 0xff) << 8) |
-			(((key_obfuscated >> 40) & 0xff) << 16) |
-			(((key_obfuscated >> 32) & 0xff) << 24) |
-			(((key_obfuscated >> 24) & 0xff) << 32) |
-			(((key_obfuscated >> 16) & 0xff) << 40) |
-			(((key_obfuscated >> 8)  & 0xff) << 48) |
-			(((key_obfuscated >> 0)  & 0xff) << 56));
+	key = ((((key_obfuscated >> 56) & 0xff) << 0) |
+	       (((key_obfuscated >> 48) & 0xff) << 8) |
+	       (((key_obfuscated >> 40) & 0xff) << 16) |
+	       (((key_obfuscated >> 32) & 0xff) << 24) |
+	       (((key_obfuscated >> 24) & 0xff) << 32) |
+	       (((key_obfuscated >> 16) & 0xff) << 40) |
+	       (((key_obfuscated >> 8)  & 0xff) << 48) |
+	       (((key_obfuscated >> 0)  & 0xff) << 56));
+
+	/* Store only once; the writer thread may be reading it. */
+	if (*key_ref != key)
+		key_reversed = key;
+
 	next = ~(*key_ref);
 	for (i = 0; i < index; i++) {
 		/* This XOR mask is not a secret. */
@@ -789,55 +900,29 @@ rewind_random(
 
 /*
  * Open a write file stream.
+ *  - The bytes go to "<file>.tmp", which replaces the file on close,
+ *    so that a crash in the middle never leaves a broken file.
  */
 bool
 hal_open_wfile(
 	const char *file,
 	struct hal_wfile **wf)
 {
-	char *path;
+	/* Let a background write to the same file finish first. */
+	wait_for_file(file);
 
 	/* Allocate wfile struct. */
-	*wf = malloc(sizeof(struct hal_wfile));
-	if (*wf == NULL) {
-		hal_log_out_of_memory();
-		return false;
-	}
-
-	/* Make a real file path. */
-	path = make_real_path(file);
-	if (path == NULL) {
-		hal_log_out_of_memory();
-		free(*wf);
-		*wf = NULL;
+	*wf = prepare_wfile(file);
+	if (*wf == NULL)
 		return false;
-	}
-
-	/* Make a directory. */
-	make_save_directory();
 
-	/* Open a real file. */
-#ifdef HAL_TARGET_WINDOWS
-	_fmode = _O_BINARY;
-#ifdef _UNICODE
-	(*wf)->fp = _wfopen(win32_utf8_to_utf16(path), L"wb");
-#else
-	(*wf)->fp = fopen(path, "wb");
-#endif
-#else
-	(*wf)->fp = fopen(path, "w");
-#endif
-	if ((*wf)->fp == NULL) {
-		/*hal_log_error("OOPS: Failed to open the file \"%s\".", path);*/
-		free(path);
-		free(*wf);
+	/* Open a temporary file. */
+	if (!open_tmp_file(*wf)) {
+		/*hal_log_error("OOPS: Failed to open the file \"%s\".", file);*/
+		free_wfile(*wf);
 		*wf = NULL;
 		return false;
 	}
-	free(path);
-
-	/* Initialize the random seed. */
-	set_random_seed(0, &(*wf)->next_random);
 
 	return true;
 }
@@ -875,6 +960,8 @@ hal_write_wfile(
 		/* Write the block to the stream. */
 		out = fwrite(obf, 1, block_size, wf->fp);
 		if (out != block_size) {
+			/* Don't replace the file on close. */
+			wf->is_failed = true;
 			*ret = total + out;
 			return true;
 		}
@@ -896,11 +983,548 @@ hal_close_wfile(
 	assert(wf != NULL);
 	assert(wf->fp != NULL);
 
-	fflush(wf->fp);
-	fclose(wf->fp);
+	commit_wfile(wf);
+	free_wfile(wf);
+}
+
+/* Allocate a wfile struct and make the real paths. */
+static struct hal_wfile *
+prepare_wfile(
+	const char *file)
+{
+	struct hal_wfile *wf;
+	char *path, *tmp_path;
+
+	/* Allocate wfile struct. */
+	wf = malloc(sizeof(struct hal_wfile));
+	if (wf == NULL) {
+		hal_log_out_of_memory();
+		return NULL;
+	}
+	wf->fp = NULL;
+	wf->is_failed = false;
+
+	/* Make a real file path and a temporary file path. */
+	path = make_real_path(file);
+	if (path == NULL) {
+		hal_log_out_of_memory();
+		free(wf);
+		return NULL;
+	}
+	tmp_path = malloc(strlen(path) + 5);
+	if (tmp_path == NULL) {
+		hal_log_out_of_memory();
+		free(path);
+		free(wf);
+		return NULL;
+	}
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+
+	/* Convert the paths here since the conversion buffer is not reentrant. */
+#if defined(HAL_TARGET_WINDOWS) && defined(_UNICODE)
+	wf->path = _wcsdup(win32_utf8_to_utf16(path));
+	wf->tmp_path = _wcsdup(win32_utf8_to_utf16(tmp_path));
+	free(path);
+	free(tmp_path);
+	if (wf->path == NULL || wf->tmp_path == NULL) {
+		hal_log_out_of_memory();
+		free(wf->path);
+		free(wf->tmp_path);
+		free(wf);
+		return NULL;
+	}
+#else
+	wf->path = path;
+	wf->tmp_path = tmp_path;
+#endif
+
+	/* Make a directory. */
+	make_save_directory();
+
+	/* Initialize the random seed. */
+	set_random_seed(0, &wf->next_random);
+
+	return wf;
+}
+
+/* Open the temporary file. (Thread-safe, no logging) */
+static bool
+open_tmp_file(
+	struct hal_wfile *wf)
+{
+#if defined(HAL_TARGET_WINDOWS) && defined(_UNICODE)
+	wf->fp = _wfopen(wf->tmp_path, L"wb");
+#else
+	wf->fp = fopen(wf->tmp_path, "wb");
+#endif
+	if (wf->fp == NULL)
+		return false;
+
+	return true;
+}
+
+/* Flush the temporary file and replace the file. (Thread-safe, no logging) */
+static bool
+commit_wfile(
+	struct hal_wfile *wf)
+{
+	bool is_ok;
+
+	/* Flush the stdio buffer and then the OS cache. */
+	is_ok = !wf->is_failed;
+	if (fflush(wf->fp) != 0)
+		is_ok = false;
+#if defined(HAL_TARGET_WINDOWS)
+	if (is_ok && _commit(_fileno(wf->fp)) != 0)
+		is_ok = false;
+#elif defined(USE_FSYNC)
+	if (is_ok && fsync(fileno(wf->fp)) != 0)
+		is_ok = false;
+#endif
+	if (fclose(wf->fp) != 0)
+		is_ok = false;
+	wf->fp = NULL;
+
+	/* Keep the old file if we could not write the whole new one. */
+	if (!is_ok) {
+#if defined(HAL_TARGET_WINDOWS) && defined(_UNICODE)
+		_wremove(wf->tmp_path);
+#else
+		remove(wf->tmp_path);
+#endif
+		return false;
+	}
+
+	/* Replace the file. */
+#if defined(HAL_TARGET_WINDOWS)
+#ifdef _UNICODE
+	if (MoveFileExW(wf->tmp_path, wf->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return true;
+
+	/* Windows 9x doesn't have MoveFileEx(). */
+	_wremove(wf->path);
+	if (_wrename(wf->tmp_path, wf->path) == 0)
+		return true;
+	_wremove(wf->tmp_path);
+#else
+	if (MoveFileExA(wf->tmp_path, wf->path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		return true;
+
+	/* Windows 9x doesn't have MoveFileEx(). */
+	remove(wf->path);
+	if (rename(wf->tmp_path, wf->path) == 0)
+		return true;
+	remove(wf->tmp_path);
+#endif
+#else
+	/* rename() replaces the file atomically. */
+	if (rename(wf->tmp_path, wf->path) == 0)
+		return true;
+	remove(wf->tmp_path);
+#endif
+
+	return false;
+}
+
+/* Free a wfile struct. */
+static void
+free_wfile(
+	struct hal_wfile *wf)
+{
+	free(wf->path);
+	free(wf->tmp_path);
 	free(wf);
 }
 
+/*
+ * Background Write
+ */
+
+/*
+ * Write a whole file in the background.
+ */
+bool
+hal_write_file_async(
+	const char *file,
+	void *data,
+	size_t size)
+{
+	struct write_job *job;
+	bool ret;
+
+	/* Make the paths on this thread. */
+	job = malloc(sizeof(struct write_job));
+	if (job == NULL) {
+		hal_log_out_of_memory();
+		free(data);
+		return false;
+	}
+	job->next = NULL;
+	job->data = data;
+	job->size = size;
+	job->file = strdup(file);
+	if (job->file == NULL) {
+		hal_log_out_of_memory();
+		free(data);
+		free(job);
+		return false;
+	}
+	job->wf = prepare_wfile(file);
+	if (job->wf == NULL) {
+		free_job(job);
+		return false;
+	}
+
+#ifdef USE_WRITER_THREAD
+	/* Pass the job to the writer thread. */
+	if (start_writer()) {
+		queue_job(job);
+		return true;
+	}
+#endif
+
+	/* Write on this thread. */
+	ret = write_job_file(job);
+	free_job(job);
+
+	return ret;
+}
+
+/*
+ * Wait for all background file writes.
+ */
+bool
+hal_wait_file_writes(void)
+{
+#ifdef USE_WRITER_THREAD
+	bool ret;
+
+	if (!is_writer_started)
+		return true;
+
+	lock_jobs();
+	while (job_head != NULL || job_running != NULL)
+		wait_idle_event();
+	ret = !is_write_failed;
+	is_write_failed = false;
+	unlock_jobs();
+
+	return ret;
+#else
+	return true;
+#endif
+}
+
+/* Write the file of a job. (Thread-safe, no logging) */
+static bool
+write_job_file(
+	struct write_job *job)
+{
+	size_t ret;
+
+	if (!open_tmp_file(job->wf))
+		return false;
+
+	hal_write_wfile(job->wf, job->data, job->size, &ret);
+
+	return commit_wfile(job->wf);
+}
+
+/* Free a job. */
+static void
+free_job(
+	struct write_job *job)
+{
+	if (job->wf != NULL)
+		free_wfile(job->wf);
+	free(job->file);
+	free(job->data);
+	free(job);
+}
+
+/* Wait until the writes to a file are done. */
+static void
+wait_for_file(
+	const char *file)
+{
+#ifdef USE_WRITER_THREAD
+	struct write_job *job;
+
+	if (!is_writer_started)
+		return;
+
+	lock_jobs();
+	while (1) {
+		if (job_running != NULL && strcmp(job_running->file, file) == 0) {
+			wait_idle_event();
+			continue;
+		}
+		for (job = job_head; job != NULL; job = job->next) {
+			if (strcmp(job->file, file) == 0)
+				break;
+		}
+		if (job == NULL)
+			break;
+		wait_idle_event();
+	}
+	unlock_jobs();
+#else
+	UNUSED_PARAMETER(file);
+#endif
+}
+
+#ifdef USE_WRITER_THREAD
+
+/* Append a job to the queue, or merge it to a queued job to the same file. */
+static void
+queue_job(
+	struct write_job *job)
+{
+	struct write_job *j;
+
+	lock_jobs();
+
+	/* An older snapshot of the same file doesn't need to be written. */
+	for (j = job_head; j != NULL; j = j->next) {
+		if (strcmp(j->file, job->file) == 0) {
+			free(j->data);
+			j->data = job->data;
+			j->size = job->size;
+			job->data = NULL;
+			break;
+		}
+	}
+	if (j == NULL) {
+		if (job_tail == NULL)
+			job_head = job;
+		else
+			job_tail->next = job;
+		job_tail = job;
+		notify_job_event();
+	}
+
+	unlock_jobs();
+
+	if (j != NULL)
+		free_job(job);
+}
+
+/* The writer thread body. */
+static void
+run_writer(void)
+{
+	struct write_job *job;
+	bool is_ok;
+
+	lock_jobs();
+	while (1) {
+		/* Wait for a job. */
+		while (job_head == NULL && !is_writer_quit)
+			wait_job_event();
+		if (job_head == NULL)
+			break;
+
+		/* Dequeue. */
+		job = job_head;
+		job_head = job->next;
+		if (job_head == NULL)
+			job_tail = NULL;
+		job_running = job;
+
+		/* Write without holding the lock. */
+		unlock_jobs();
+		is_ok = write_job_file(job);
+		lock_jobs();
+
+		if (!is_ok)
+			is_write_failed = true;
+		job_running = NULL;
+		free_job(job);
+		notify_idle_event();
+	}
+	unlock_jobs();
+}
+
+/* Stop the writer thread after the queued jobs are written. */
+static void
+stop_writer(void)
+{
+	if (!is_writer_started)
+		return;
+
+	lock_jobs();
+	is_writer_quit = true;
+	notify_job_event();
+	unlock_jobs();
+
+#if defined(HAL_TARGET_WINDOWS)
+	WaitForSingleObject(writer_thread, INFINITE);
+	CloseHandle(writer_thread);
+	CloseHandle(job_event);
+	CloseHandle(idle_event);
+	DeleteCriticalSection(&job_lock);
+#else
+	pthread_join(writer_thread, NULL);
+#endif
+
+	is_writer_started = false;
+	is_writer_quit = false;
+}
+
+#if defined(HAL_TARGET_WINDOWS)
+
+/* Start the writer thread. */
+static bool
+start_writer(void)
+{
+	if (is_writer_started)
+		return true;
+
+	/* Both events are auto-reset since each has a single waiter. */
+	job_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	idle_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (job_event == NULL || idle_event == NULL) {
+		if (job_event != NULL)
+			CloseHandle(job_event);
+		if (idle_event != NULL)
+			CloseHandle(idle_event);
+		return false;
+	}
+	InitializeCriticalSection(&job_lock);
+
+	writer_thread = CreateThread(NULL, 0, writer_thread_proc, NULL, 0, NULL);
+	if (writer_thread == NULL) {
+		CloseHandle(job_event);
+		CloseHandle(idle_event);
+		DeleteCriticalSection(&job_lock);
+		return false;
+	}
+
+	is_writer_started = true;
+	return true;
+}
+
+static DWORD WINAPI
+writer_thread_proc(
+	LPVOID param)
+{
+	UNUSED_PARAMETER(param);
+
+	run_writer();
+
+	return 0;
+}
+
+static void
+lock_jobs(void)
+{
+	EnterCriticalSection(&job_lock);
+}
+
+static void
+unlock_jobs(void)
+{
+	LeaveCriticalSection(&job_lock);
+}
+
+/* Called with the lock held. The events keep a signal until consumed. */
+static void
+wait_job_event(void)
+{
+	LeaveCriticalSection(&job_lock);
+	WaitForSingleObject(job_event, INFINITE);
+	EnterCriticalSection(&job_lock);
+}
+
+static void
+notify_job_event(void)
+{
+	SetEvent(job_event);
+}
+
+static void
+wait_idle_event(void)
+{
+	LeaveCriticalSection(&job_lock);
+	WaitForSingleObject(idle_event, INFINITE);
+	EnterCriticalSection(&job_lock);
+}
+
+static void
+notify_idle_event(void)
+{
+	SetEvent(idle_event);
+}
+
+#else /* defined(HAL_TARGET_WINDOWS) */
+
+/* Start the writer thread. */
+static bool
+start_writer(void)
+{
+	if (is_writer_started)
+		return true;
+
+	if (pthread_create(&writer_thread, NULL, writer_thread_proc, NULL) != 0)
+		return false;
+
+	is_writer_started = true;
+	return true;
+}
+
+static void *
+writer_thread_proc(
+	void *param)
+{
+	UNUSED_PARAMETER(param);
+
+	run_writer();
+
+	return NULL;
+}
+
+static void
+lock_jobs(void)
+{
+	pthread_mutex_lock(&job_lock);
+}
+
+static void
+unlock_jobs(void)
+{
+	pthread_mutex_unlock(&job_lock);
+}
+
+/* Called with the lock held. */
+static void
+wait_job_event(void)
+{
+	pthread_cond_wait(&job_cond, &job_lock);
+}
+
+static void
+notify_job_event(void)
+{
+	pthread_cond_signal(&job_cond);
+}
+
+static void
+wait_idle_event(void)
+{
+	pthread_cond_wait(&idle_cond, &job_lock);
+}
+
+static void
+notify_idle_event(void)
+{
+	pthread_cond_signal(&idle_cond);
+}
+
+#endif /* defined(HAL_TARGET_WINDOWS) */
+
+#endif /* USE_WRITER_THREAD */
+
 /*
  * Remove a real file.
  */
@@ -910,6 +1534,9 @@ hal_remove_file(
 {
 	char *path;
 
+	/* Let a background write to the file finish. */
+	wait_for_file(file);
+
 	/* Make a real path. */
 	path = make_real_path(file);
 	if (path == NULL) {
@@ -55,6 +55,95 @@
 #define SAMPLING_RATE	(44100)
 #define IOSIZE		(4096)
 
+/*
+ * PCM Cache Config
+ *  - A non-looped file smaller than CACHE_FILE_SIZE is decoded at once,
+ *    and the PCM is shared by the streams of the same file.
+ *  - Unused clips are evicted in LRU order over CACHE_TOTAL_BYTES.
+ */
+#define CACHE_FILE_SIZE		(128 * 1024)
+#define CACHE_CLIP_FRAMES	(SAMPLING_RATE * 10)
+#define CACHE_TOTAL_BYTES	(16 * 1024 * 1024)
+#define CACHE_CHUNK_FRAMES	(SAMPLING_RATE / 4)
+
+/*
+ * Voice Pool Config
+ *  - A pool mixes its voices in POOL_CHUNK_FRAMES units.
+ *  - A voice changes its gain along a ramp over a chunk, so a stop or
+ *    a fade doesn't click.
+ */
+#define POOL_MAX_VOICES		(64)
+#define POOL_CHUNK_FRAMES	(512)
+#define POOL_GAIN_ONE		(32768)
+#define POOL_GEN_MASK		(0xffffff)
+
+/* Voice states. */
+#define VOICE_FREE		(0)	/* Owned by the caller thread. */
+#define VOICE_PLAYING		(1)	/* Owned by the sound thread. */
+#define VOICE_DONE		(2)	/* Returned to the caller thread. */
+
+/* Atomic access between the caller thread and the sound thread. */
+#if defined(__GNUC__)
+#define LOAD_ACQUIRE(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+#else
+#define LOAD_ACQUIRE(p)		(*(volatile int *)(p))
+#define STORE_RELEASE(p, v)	(*(volatile int *)(p) = (v))
+#endif
+
+/*
+ * Voice in a pool
+ */
+struct pool_voice {
+	/* Stream. (valid unless VOICE_FREE) */
+	struct hal_wave *w;
+
+	/* VOICE_FREE, VOICE_PLAYING or VOICE_DONE. */
+	int state;
+
+	/* Target gain in Q15 and a stop request. (by the caller thread) */
+	int gain;
+	int stop;
+
+	/* Current gain in Q15. (by the sound thread) */
+	int cur;
+
+	/* Generation to tell a reused slot. */
+	int gen;
+};
+
+/*
+ * Voice pool
+ */
+struct wave_pool {
+	int voices;
+	struct pool_voice voice[POOL_MAX_VOICES];
+
+	/* Work buffers for the sound thread. */
+	int32_t acc[POOL_CHUNK_FRAMES * 2];
+	uint32_t tmp[POOL_CHUNK_FRAMES];
+};
+
+/*
+ * Decoded PCM clip
+ */
+struct pcm_clip {
+	/* File name. (NULL if not in the cache) */
+	char *file;
+
+	/* PCM samples. */
+	uint32_t *samples;
+	int frames;
+
+	/* Reference count by streams. */
+	int ref;
+
+	/* Last use for LRU. */
+	uint32_t stamp;
+
+	struct pcm_clip *next;
+};
+
 /*
  * PCM stream with a format of 44.1kHz, 16bit, stereo
  */
@@ -77,21 +166,58 @@ struct hal_wave {
 	/* Status. */
 	bool eos;
 	bool err;
-	bool do_skip;
 	long consumed_bytes;
 
+	/*
+	 * Whole file image for a looped stream to seek.
+	 *  - NULL if reading from rf.
+	 */
+	unsigned char *mem;
+	size_t mem_size;
+	size_t mem_pos;
+
 	/* Vorbis object. */
 	OggVorbis_File ovf;
+
+	/* Cached PCM. (NULL if streaming) */
+	struct pcm_clip *clip;
+	int clip_pos;
+
+	/* Voices to mix. (NULL if not a pool) */
+	struct wave_pool *pool;
 };
 
+/*
+ * PCM Cache
+ */
+static struct pcm_clip *clip_list;
+static size_t clip_total_bytes;
+static uint32_t clip_stamp;
+
 /*
  * Forward declarations.
  */
-static bool reopen(struct hal_wave *w, bool loop);
+static bool reopen(struct hal_wave *w);
+static bool load_to_memory(struct hal_wave *w);
+static bool seek_to_loop_start(struct hal_wave *w, int sample_bytes);
 static size_t read_func(void *ptr, size_t size, size_t nmemb, void *datasource);
+static int seek_func(void *datasource, ogg_int64_t offset, int whence);
+static long tell_func(void *datasource);
 static int get_wave_samples_monaural(struct hal_wave *w, uint32_t *buf, int samples);
 static int get_wave_samples_stereo(struct hal_wave *w, uint32_t *buf, int samples);
-static void skip_if_needed(struct hal_wave *w, int sample_bytes);
+static bool create_wave_from_clip(struct pcm_clip *clip, struct hal_wave **w);
+static struct pcm_clip *find_clip(const char *fname);
+static bool should_cache(struct hal_wave *w);
+static bool make_clip(struct hal_wave *w);
+static bool cancel_clip(struct hal_wave *w, struct pcm_clip *clip);
+static void insert_clip(struct pcm_clip *clip);
+static void release_clip(struct pcm_clip *clip);
+static void free_clip(struct pcm_clip *clip);
+static struct pool_voice *get_voice(struct hal_wave *w, int voice);
+static void reap_voices(struct wave_pool *p);
+static int vol_to_gain(float vol);
+static int get_pool_samples(struct hal_wave *w, uint32_t *buf, int samples);
+static void mix_pool_chunk(struct wave_pool *p, uint32_t *buf, int frames);
 
 /*
  * Create a PCM stream from a file.
@@ -118,6 +244,14 @@ hal_create_wave_from_file(
 	UNUSED_PARAMETER(OV_CALLBACKS_NOCLOSE);
 	UNUSED_PARAMETER(OV_CALLBACKS_DEFAULT);
 
+	/* Share the PCM if the file is cached. */
+	if (!loop) {
+		struct pcm_clip *clip;
+		clip = find_clip(fname);
+		if (clip != NULL)
+			return create_wave_from_clip(clip, w);
+	}
+
 	/* Alloc a wave struct. */
 	*w = malloc(sizeof(struct hal_wave));
 	if (*w == NULL) {
@@ -136,7 +270,7 @@ hal_create_wave_from_file(
 	}
 
 	/* Open a file. */
-	if (!reopen(*w, false)) {
+	if (!reopen(*w)) {
 		*w = NULL;
 		return false;
 	}
@@ -152,7 +286,6 @@ hal_create_wave_from_file(
 	(*w)->times = -1;
 	(*w)->eos = false;
 	(*w)->err = false;
-	(*w)->do_skip = false;
 	(*w)->consumed_bytes = 0;
 
 	/* Get LOOPSTART and LOOPLENGTH. */
@@ -169,15 +302,268 @@ hal_create_wave_from_file(
 		}
 	}
 
+	/* Make a looped stream seekable. */
+	if ((*w)->loop) {
+		if (!load_to_memory(*w)) {
+			*w = NULL;
+			return false;
+		}
+	}
+
+	/* Decode a short clip at once and cache it. */
+	if (should_cache(*w)) {
+		if (!make_clip(*w)) {
+			*w = NULL;
+			return false;
+		}
+	}
+
 	/* Succeeded. */
 	return true;
 }
 
+/*
+ * Decode a file and keep the PCM in the cache.
+ */
+bool
+hal_preload_wave(
+	const char *fname)
+{
+	struct hal_wave *w;
+
+	/* Already cached. */
+	if (find_clip(fname) != NULL)
+		return true;
+
+	/* Creating a stream caches the file if it is short. */
+	if (!hal_create_wave_from_file(fname, false, &w))
+		return false;
+	hal_destroy_wave(w);
+
+	return true;
+}
+
+/* Create a stream that plays a cached clip. */
+static bool
+create_wave_from_clip(
+	struct pcm_clip *clip,
+	struct hal_wave **w)
+{
+	*w = malloc(sizeof(struct hal_wave));
+	if (*w == NULL) {
+		hal_log_out_of_memory();
+		return false;
+	}
+	memset(*w, 0, sizeof(struct hal_wave));
+
+	(*w)->clip = clip;
+	(*w)->clip_pos = 0;
+	(*w)->times = -1;
+	clip->ref++;
+	clip->stamp = ++clip_stamp;
+
+	return true;
+}
+
+/* Find a clip in the cache. */
+static struct pcm_clip *
+find_clip(
+	const char *fname)
+{
+	struct pcm_clip *clip;
+
+	for (clip = clip_list; clip != NULL; clip = clip->next) {
+		if (strcmp(clip->file, fname) == 0)
+			return clip;
+	}
+
+	return NULL;
+}
+
+/* Check if a stream is a short clip to cache. */
+static bool
+should_cache(
+	struct hal_wave *w)
+{
+	size_t size;
+
+	if (w->loop)
+		return false;
+	if (!hal_get_rfile_size(w->rf, &size))
+		return false;
+	if (size > CACHE_FILE_SIZE)
+		return false;
+
+	return true;
+}
+
+/*
+ * Decode a whole stream to a clip, and switch the stream to it.
+ *  - If the stream is longer than expected, rewind it for streaming.
+ *  - On an error, the stream is freed.
+ */
+static bool
+make_clip(
+	struct hal_wave *w)
+{
+	struct pcm_clip *clip;
+	uint32_t *p;
+	int alloc_frames, ret;
+
+	clip = malloc(sizeof(struct pcm_clip));
+	if (clip == NULL) {
+		hal_log_out_of_memory();
+		hal_destroy_wave(w);
+		return false;
+	}
+	memset(clip, 0, sizeof(struct pcm_clip));
+
+	/* Decode. */
+	alloc_frames = 0;
+	while (!w->eos) {
+		/* Give up a long stream. */
+		if (clip->frames >= CACHE_CLIP_FRAMES)
+			return cancel_clip(w, clip);
+
+		/* Grow the buffer. */
+		if (clip->frames + CACHE_CHUNK_FRAMES > alloc_frames) {
+			alloc_frames += CACHE_CHUNK_FRAMES;
+			p = realloc(clip->samples, (size_t)alloc_frames * sizeof(uint32_t));
+			if (p == NULL) {
+				hal_log_out_of_memory();
+				free(clip->samples);
+				free(clip);
+				hal_destroy_wave(w);
+				return false;
+			}
+			clip->samples = p;
+		}
+
+		ret = hal_get_wave_samples(w, clip->samples + clip->frames, CACHE_CHUNK_FRAMES);
+		if (ret < 0) {
+			/* Decode error. Don't cache a broken clip. */
+			hal_log_warn("Audio decode error (%s).", w->file);
+			return cancel_clip(w, clip);
+		}
+		clip->frames += ret;
+		if (ret < CACHE_CHUNK_FRAMES)
+			break;
+	}
+
+	/* Close the file. */
+	ov_clear(&w->ovf);
+	hal_close_rfile(w->rf);
+	w->rf = NULL;
+
+	/* Register. (The name moves to the clip.) */
+	clip->file = w->file;
+	w->file = NULL;
+	insert_clip(clip);
+
+	/* Switch to the clip. */
+	w->clip = clip;
+	w->clip_pos = 0;
+	w->eos = false;
+	clip->ref++;
+	clip->stamp = ++clip_stamp;
+
+	return true;
+}
+
+/*
+ * Discard a clip being made, and stream the file instead.
+ *  - On an error, the stream is freed.
+ */
+static bool
+cancel_clip(
+	struct hal_wave *w,
+	struct pcm_clip *clip)
+{
+	free(clip->samples);
+	free(clip);
+	ov_clear(&w->ovf);
+	if (!reopen(w))
+		return false;
+	w->eos = false;
+	return true;
+}
+
+/*
+ * Insert a clip to the cache.
+ *  - Evicts unused clips in LRU order to keep the limit.
+ *  - If the clip doesn't fit, it is kept out of the cache and freed
+ *    when the stream is destroyed.
+ */
+static void
+insert_clip(
+	struct pcm_clip *clip)
+{
+	struct pcm_clip *c, *prev, *lru, *lru_prev;
+	size_t bytes;
+
+	bytes = (size_t)clip->frames * sizeof(uint32_t);
+
+	while (clip_total_bytes + bytes > CACHE_TOTAL_BYTES) {
+		/* Find the least recently used clip. */
+		lru = NULL;
+		lru_prev = NULL;
+		prev = NULL;
+		for (c = clip_list; c != NULL; c = c->next) {
+			if (c->ref == 0 && (lru == NULL || c->stamp < lru->stamp)) {
+				lru = c;
+				lru_prev = prev;
+			}
+			prev = c;
+		}
+		if (lru == NULL) {
+			/* Don't cache. */
+			free(clip->file);
+			clip->file = NULL;
+			return;
+		}
+
+		/* Evict. */
+		if (lru_prev != NULL)
+			lru_prev->next = lru->next;
+		else
+			clip_list = lru->next;
+		clip_total_bytes -= (size_t)lru->frames * sizeof(uint32_t);
+		free_clip(lru);
+	}
+
+	clip->next = clip_list;
+	clip_list = clip;
+	clip_total_bytes += bytes;
+}
+
+/* Release a reference to a clip. */
+static void
+release_clip(
+	struct pcm_clip *clip)
+{
+	assert(clip->ref > 0);
+
+	clip->ref--;
+
+	/* Free a clip that is not in the cache. */
+	if (clip->ref == 0 && clip->file == NULL)
+		free_clip(clip);
+}
+
+/* Free a clip. */
+static void
+free_clip(
+	struct pcm_clip *clip)
+{
+	free(clip->file);
+	free(clip->samples);
+	free(clip);
+}
+
 /* Reopen a file. */
 static bool
 reopen(
-	struct hal_wave *w,
-	bool loop)
+	struct hal_wave *w)
 {
 	ov_callbacks cb;
 	int err;
@@ -207,12 +593,87 @@ reopen(
 		return false;
 	}
 
-	w->do_skip = loop;
 	w->consumed_bytes = 0;
 
 	return true;
 }
 
+/*
+ * Read a whole file into memory and open it as a seekable stream.
+ *  - The file HAL has no seek, and a looped stream seeks to LOOPSTART
+ *    instead of reopening the file and decoding the intro again.
+ *  - On an error, the stream is freed.
+ */
+static bool
+load_to_memory(
+	struct hal_wave *w)
+{
+	ov_callbacks cb;
+	size_t len;
+	int err;
+
+	ov_clear(&w->ovf);
+
+	/* Read the file. */
+	if (!hal_get_rfile_size(w->rf, &w->mem_size) || w->mem_size == 0) {
+		hal_log_error("Audio file format error (%s).", w->file);
+		hal_destroy_wave(w);
+		return false;
+	}
+	w->mem = malloc(w->mem_size);
+	if (w->mem == NULL) {
+		hal_log_out_of_memory();
+		hal_destroy_wave(w);
+		return false;
+	}
+	hal_rewind_rfile(w->rf);
+	if (!hal_read_rfile(w->rf, w->mem, w->mem_size, &len) || len != w->mem_size) {
+		hal_log_error("Audio file format error (%s).", w->file);
+		hal_destroy_wave(w);
+		return false;
+	}
+	w->mem_pos = 0;
+
+	/* The file is not needed anymore. */
+	hal_close_rfile(w->rf);
+	w->rf = NULL;
+
+	/* Open with seek. */
+	memset(&cb, 0, sizeof(cb));
+	cb.read_func = read_func;
+	cb.close_func = NULL;
+	cb.seek_func = seek_func;
+	cb.tell_func = tell_func;
+	err = ov_open_callbacks(w, &w->ovf, NULL, 0, cb);
+	if (err != 0) {
+		hal_log_error("Audio file format error (%s).", w->file);
+		free(w->mem);
+		free(w->file);
+		free(w);
+		return false;
+	}
+
+	w->consumed_bytes = 0;
+
+	return true;
+}
+
+/* Seek to LOOPSTART. */
+static bool
+seek_to_loop_start(
+	struct hal_wave *w,
+	int sample_bytes)
+{
+	if (ov_pcm_seek(&w->ovf, (ogg_int64_t)w->loop_start) != 0) {
+		hal_log_error("Audio file format error (%s).", w->file);
+		return false;
+	}
+
+	w->consumed_bytes = (long)w->loop_start * sample_bytes;
+
+	return true;
+}
+
 /* File input callback. */
 static size_t
 read_func(
@@ -229,12 +690,72 @@ read_func(
 
 	w = (struct hal_wave *)datasource;
 
+	/* Read from the memory. */
+	if (w->mem != NULL) {
+		len = size * nmemb;
+		if (len > w->mem_size - w->mem_pos)
+			len = (w->mem_size - w->mem_pos) / size * size;
+		memcpy(ptr, w->mem + w->mem_pos, len);
+		w->mem_pos += len;
+		return len / size;
+	}
+
 	if (!hal_read_rfile(w->rf, ptr, size * nmemb, &len))
 		return 0;
 
 	return len / size;
 }
 
+/* Memory seek callback. */
+static int
+seek_func(
+	void *datasource,
+	ogg_int64_t offset,
+	int whence)
+{
+	struct hal_wave *w;
+	ogg_int64_t pos;
+
+	assert(datasource != NULL);
+
+	w = (struct hal_wave *)datasource;
+	assert(w->mem != NULL);
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = (ogg_int64_t)w->mem_pos + offset;
+		break;
+	case SEEK_END:
+		pos = (ogg_int64_t)w->mem_size + offset;
+		break;
+	default:
+		return -1;
+	}
+	if (pos < 0 || pos > (ogg_int64_t)w->mem_size)
+		return -1;
+
+	w->mem_pos = (size_t)pos;
+
+	return 0;
+}
+
+/* Memory tell callback. */
+static long
+tell_func(
+	void *datasource)
+{
+	struct hal_wave *w;
+
+	assert(datasource != NULL);
+
+	w = (struct hal_wave *)datasource;
+
+	return (long)w->mem_pos;
+}
+
 #if 0
 /* File close callback. */
 static int
@@ -277,7 +798,27 @@ void
 hal_destroy_wave(
 	struct hal_wave *w)
 {
+	int i;
+
+	if (w->clip != NULL) {
+		release_clip(w->clip);
+		free(w);
+		return;
+	}
+
+	if (w->pool != NULL) {
+		for (i = 0; i < w->pool->voices; i++) {
+			if (w->pool->voice[i].state != VOICE_FREE)
+				hal_destroy_wave(w->pool->voice[i].w);
+		}
+		free(w->pool);
+		free(w);
+		return;
+	}
+
 	ov_clear(&w->ovf);
+	free(w->mem);
+	w->mem = NULL;
 	free(w->file);
 	w->file = NULL;
 	if (w->rf != NULL) {
@@ -306,10 +847,28 @@ hal_get_wave_samples(
 	uint32_t *buf,
 	int samples)
 {
+	int n;
+
 	/* If already reached end-of-stream. */
 	if (w->eos)
 		return 0;
 
+	/* Cached case. */
+	if (w->clip != NULL) {
+		n = w->clip->frames - w->clip_pos;
+		if (n > samples)
+			n = samples;
+		memcpy(buf, w->clip->samples + w->clip_pos, (size_t)n * sizeof(uint32_t));
+		w->clip_pos += n;
+		if (w->clip_pos == w->clip->frames)
+			w->eos = true;
+		return n;
+	}
+
+	/* Pool case. */
+	if (w->pool != NULL)
+		return get_pool_samples(w, buf, samples);
+
 	/* Monaural case. */
 	if (w->monaural)
 		return get_wave_samples_monaural(w, buf, samples);
@@ -318,6 +877,288 @@ hal_get_wave_samples(
 	return get_wave_samples_stereo(w, buf, samples);
 }
 
+/*
+ * Create a voice pool that mixes streams into one stream.
+ */
+bool
+hal_create_wave_pool(
+	int voices,
+	struct hal_wave **w)
+{
+	assert(voices > 0);
+
+	if (voices > POOL_MAX_VOICES)
+		voices = POOL_MAX_VOICES;
+
+	*w = malloc(sizeof(struct hal_wave));
+	if (*w == NULL) {
+		hal_log_out_of_memory();
+		return false;
+	}
+	memset(*w, 0, sizeof(struct hal_wave));
+
+	(*w)->pool = malloc(sizeof(struct wave_pool));
+	if ((*w)->pool == NULL) {
+		hal_log_out_of_memory();
+		free(*w);
+		*w = NULL;
+		return false;
+	}
+	memset((*w)->pool, 0, sizeof(struct wave_pool));
+
+	(*w)->pool->voices = voices;
+	(*w)->times = -1;
+
+	return true;
+}
+
+/*
+ * Add a stream to a voice pool.
+ */
+int
+hal_add_wave_voice(
+	struct hal_wave *w,
+	struct hal_wave *voice,
+	float vol)
+{
+	struct pool_voice *v;
+	int i;
+
+	assert(w != NULL);
+	assert(w->pool != NULL);
+	assert(voice != NULL);
+
+	/* Free the voices that the sound thread returned. */
+	reap_voices(w->pool);
+
+	for (i = 0; i < w->pool->voices; i++) {
+		v = &w->pool->voice[i];
+		if (LOAD_ACQUIRE(&v->state) != VOICE_FREE)
+			continue;
+
+		/* The sound thread starts mixing after the release. */
+		v->w = voice;
+		v->gain = vol_to_gain(vol);
+		v->cur = v->gain;
+		v->stop = 0;
+		v->gen = (v->gen + 1) & POOL_GEN_MASK;
+		STORE_RELEASE(&v->state, VOICE_PLAYING);
+
+		return v->gen * POOL_MAX_VOICES + i;
+	}
+
+	/* All voices are busy. */
+	return -1;
+}
+
+/*
+ * Set the volume of a voice in a pool.
+ */
+void
+hal_set_wave_voice_volume(
+	struct hal_wave *w,
+	int voice,
+	float vol)
+{
+	struct pool_voice *v;
+
+	v = get_voice(w, voice);
+	if (v != NULL)
+		STORE_RELEASE(&v->gain, vol_to_gain(vol));
+}
+
+/*
+ * Stop a voice in a pool.
+ */
+void
+hal_stop_wave_voice(
+	struct hal_wave *w,
+	int voice)
+{
+	struct pool_voice *v;
+
+	v = get_voice(w, voice);
+	if (v != NULL)
+		STORE_RELEASE(&v->stop, 1);
+}
+
+/*
+ * Check if a voice in a pool is finished.
+ */
+bool
+hal_is_wave_voice_finished(
+	struct hal_wave *w,
+	int voice)
+{
+	if (get_voice(w, voice) != NULL)
+		return false;
+
+	return true;
+}
+
+/*
+ * Get the number of the playing voices in a pool.
+ */
+int
+hal_get_wave_voice_count(
+	struct hal_wave *w)
+{
+	int i, count;
+
+	assert(w != NULL);
+	assert(w->pool != NULL);
+
+	reap_voices(w->pool);
+
+	count = 0;
+	for (i = 0; i < w->pool->voices; i++) {
+		if (LOAD_ACQUIRE(&w->pool->voice[i].state) == VOICE_PLAYING)
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * Check if a wave stream is a voice pool.
+ */
+bool
+hal_is_wave_pool(
+	struct hal_wave *w)
+{
+	assert(w != NULL);
+
+	return w->pool != NULL;
+}
+
+/* Get a playing voice by a handle. */
+static struct pool_voice *
+get_voice(
+	struct hal_wave *w,
+	int voice)
+{
+	struct pool_voice *v;
+
+	assert(w != NULL);
+	assert(w->pool != NULL);
+
+	if (voice < 0)
+		return NULL;
+
+	v = &w->pool->voice[voice % POOL_MAX_VOICES];
+	if (v->gen != voice / POOL_MAX_VOICES)
+		return NULL;
+	if (LOAD_ACQUIRE(&v->state) != VOICE_PLAYING)
+		return NULL;
+
+	return v;
+}
+
+/* Destroy the streams of the finished voices. */
+static void
+reap_voices(
+	struct wave_pool *p)
+{
+	struct pool_voice *v;
+	int i;
+
+	for (i = 0; i < p->voices; i++) {
+		v = &p->voice[i];
+		if (LOAD_ACQUIRE(&v->state) != VOICE_DONE)
+			continue;
+
+		hal_destroy_wave(v->w);
+		v->w = NULL;
+		STORE_RELEASE(&v->state, VOICE_FREE);
+	}
+}
+
+/* Convert a volume to a Q15 gain. */
+static int
+vol_to_gain(
+	float vol)
+{
+	if (vol <= 0)
+		return 0;
+	if (vol >= 1.0f)
+		return POOL_GAIN_ONE;
+
+	return (int)(vol * (float)POOL_GAIN_ONE);
+}
+
+/* Get mixed samples from a pool. */
+static int
+get_pool_samples(
+	struct hal_wave *w,
+	uint32_t *buf,
+	int samples)
+{
+	int pos, n;
+
+	for (pos = 0; pos < samples; pos += n) {
+		n = samples - pos;
+		if (n > POOL_CHUNK_FRAMES)
+			n = POOL_CHUNK_FRAMES;
+		mix_pool_chunk(w->pool, buf + pos, n);
+	}
+
+	/* A pool never reaches end-of-stream. */
+	return samples;
+}
+
+/* Mix a chunk of the playing voices. */
+static void
+mix_pool_chunk(
+	struct wave_pool *p,
+	uint32_t *buf,
+	int frames)
+{
+	struct pool_voice *v;
+	int32_t *acc, l, r;
+	int i, j, n, stop, target, gain, step;
+
+	acc = p->acc;
+	memset(acc, 0, (size_t)frames * 2 * sizeof(int32_t));
+
+	for (i = 0; i < p->voices; i++) {
+		v = &p->voice[i];
+		if (LOAD_ACQUIRE(&v->state) != VOICE_PLAYING)
+			continue;
+
+		/* A stop request fades out in this chunk. */
+		stop = LOAD_ACQUIRE(&v->stop);
+		target = stop ? 0 : LOAD_ACQUIRE(&v->gain);
+
+		/* Decode. */
+		n = hal_get_wave_samples(v->w, p->tmp, frames);
+
+		/* Accumulate along a gain ramp. */
+		gain = v->cur;
+		step = (target - gain) / frames;
+		for (j = 0; j < n; j++) {
+			l = (int16_t)(uint16_t)(p->tmp[j] & 0xffff);
+			r = (int16_t)(uint16_t)(p->tmp[j] >> 16);
+			acc[j * 2] += (l * gain) >> 15;
+			acc[j * 2 + 1] += (r * gain) >> 15;
+			gain += step;
+		}
+		v->cur = target;
+
+		/* Return the voice to the caller thread. */
+		if (stop || n < frames || hal_is_wave_eos(v->w))
+			STORE_RELEASE(&v->state, VOICE_DONE);
+	}
+
+	/* Saturate and pack. */
+	for (j = 0; j < frames; j++) {
+		l = acc[j * 2];
+		r = acc[j * 2 + 1];
+		l = l > 32767 ? 32767 : (l < -32768 ? -32768 : l);
+		r = r > 32767 ? 32767 : (r < -32768 ? -32768 : r);
+		buf[j] = (uint32_t)(uint16_t)l | ((uint32_t)(uint16_t)r << 16);
+	}
+}
+
 /* Get samples from a monaural stream. */
 static int
 get_wave_samples_monaural(
@@ -334,9 +1175,6 @@ get_wave_samples_monaural(
 	retain = 0;
 	last_ret_bytes = -1;
 	while (retain < samples) {
-		/* Skip for LOOPSTART. */
-		skip_if_needed(w, 2);
-
 		/* Decode. */
 		read_bytes = (samples - retain) * 2 > IOSIZE ? IOSIZE :
 			     (samples - retain) * 2;
@@ -350,11 +1188,10 @@ get_wave_samples_monaural(
 		if (ret_bytes == 0 || (loop_end && ret_bytes == read_bytes)) {
 			/* End-of-stream. */
 			if ((w->loop && (w->times == -1 || w->times > 0)) || loop_end) {
-				/* Reopen. */
+				/* Seek to LOOPSTART. */
 				if (last_ret_bytes == 0)
 					return 0; 	/* Error */
-				ov_clear(&w->ovf);
-				if (!reopen(w, true))
+				if (!seek_to_loop_start(w, 2))
 					return 0;	/* Error */
 				last_ret_bytes = 0;
 				if (w->times != -1)
@@ -397,9 +1234,6 @@ get_wave_samples_stereo(
 	retain = 0;
 	last_ret_bytes = -1;
 	while (retain < samples) {
-		/* Skip for LOOPSTART. */
-		skip_if_needed(w, 4);
-
 		/* Decode. */
 		read_bytes = (samples - retain) * 4;
 		loop_end = false;
@@ -412,11 +1246,10 @@ get_wave_samples_stereo(
 		if (ret_bytes == 0 || (loop_end && ret_bytes == read_bytes)) {
 			/* End-of-stream. */
 			if ((w->loop && (w->times == -1 || w->times > 0)) || loop_end) {
-				/* Reopen. */
+				/* Seek to LOOPSTART. */
 				if (last_ret_bytes == 0)
 					return 0; 	/* Error. */
-				ov_clear(&w->ovf);
-				if (!reopen(w, true))
+				if (!seek_to_loop_start(w, 4))
 					return 0;	/* Error. */
 				last_ret_bytes = 0;
 				if (w->times != -1)
@@ -436,42 +1269,6 @@ get_wave_samples_stereo(
 	return samples;
 }
 
-/* Skip for LOOPSTART. */
-static void
-skip_if_needed(
-	struct hal_wave *w,
-	int sample_bytes)
-{
-	uint32_t buf[1024];
-	size_t remain_samples;
-	size_t get_samples;
-	long ret_bytes;
-	int bitstream;
-
-	if (!w->do_skip || w->loop_start == 0)
-		return;
-
-	remain_samples = w->loop_start;
-	while (remain_samples > 0) {
-		get_samples = remain_samples > 1024 ? 1024 : remain_samples;
-
-		ret_bytes = ov_read(&w->ovf,
-				    (char *)buf,
-				    (int)get_samples * sample_bytes,
-				    0,
-				    2,
-				    1,
-				    &bitstream);
-		if (ret_bytes <= 0)
-			break;
-
-		remain_samples -= (size_t)(ret_bytes / sample_bytes);
-	}
-
-	w->do_skip = false;
-	w->consumed_bytes = (long)w->loop_start * sample_bytes;
-}
-
 #else
 
 #include <strato/strato.h>
@@ -495,6 +1292,15 @@ hal_create_wave_from_file(
 	return true;
 }
 
+bool
+hal_preload_wave(
+	const char *fname)
+{
+	UNUSED_PARAMETER(fname);
+
+	return true;
+}
+
 void
 hal_set_wave_repeat_times(
 	struct hal_wave *w,
@@ -527,4 +1333,69 @@ hal_get_wave_samples(
 	return 0;
 }
 
+bool
+hal_create_wave_pool(
+	int voices,
+	struct hal_wave **w)
+{
+	UNUSED_PARAMETER(voices);
+
+	*w = &dummy_wave;
+
+	return true;
+}
+
+int
+hal_add_wave_voice(
+	struct hal_wave *w,
+	struct hal_wave *voice,
+	float vol)
+{
+	UNUSED_PARAMETER(w);
+	UNUSED_PARAMETER(voice);
+	UNUSED_PARAMETER(vol);
+
+	return 0;
+}
+
+void
+hal_set_wave_voice_volume(
+	struct hal_wave *w,
+	int voice,
+	float vol)
+{
+	UNUSED_PARAMETER(w);
+	UNUSED_PARAMETER(voice);
+	UNUSED_PARAMETER(vol);
+}
+
+void
+hal_stop_wave_voice(
+	struct hal_wave *w,
+	int voice)
+{
+	UNUSED_PARAMETER(w);
+	UNUSED_PARAMETER(voice);
+}
+
+bool
+hal_is_wave_voice_finished(
+	struct hal_wave *w,
+	int voice)
+{
+	UNUSED_PARAMETER(w);
+	UNUSED_PARAMETER(voice);
+
+	return true;
+}
+
+int
+hal_get_wave_voice_count(
+	struct hal_wave *w)
+{
+	UNUSED_PARAMETER(w);
+
+	return 0;
+}
+
 #endif
@@ -83,6 +83,8 @@
 /* Frame Time */
 #define FRAME_MILLI	(16)	/* Millisec of a frame */
 #define SLEEP_MILLI	(5)	/* Millisec to sleep */
+#define IDLE_MILLI	(50)	/* Millisec of an idle frame */
+#define IDLE_FRAMES	(30)	/* Frames without rendering to become idle */
 
 /* Virtual Screen Config */
 static char *window_title;
@@ -117,6 +119,12 @@ static EGLSurface egl_surf;
 /* Frame Start Time */
 static struct timeval tv_start;
 
+/* Flag to force rendering of the next frame. (e.g., after a resize) */
+static bool is_render_forced = true;
+
+/* Count of the consecutive frames that skipped rendering. */
+static int idle_frame_count;
+
 /* Log File */
 #define LOG_BUF_SIZE	(4096)
 static FILE *log_fp;
@@ -149,6 +157,7 @@ static void close_display(void);
 static void cleanup_hal(void);
 static void run_game_loop(void);
 static bool run_frame(void);
+static bool is_render_needed(void);
 static void render_video_frame(void);
 static bool wait_for_next_frame(void);
 static void update_viewport_size(int width, int height);
@@ -704,15 +713,21 @@ run_frame(void)
 
 		/* Call a frame event. */
 		cont = hal_callback.on_update();
-		if (cont)
+		if (cont && is_render_needed()) {
 			hal_callback.on_render();
 
-		/* End rendering. */
-		opengl_end_rendering();
-
-		/* Sync. */
-		eglSwapBuffers(egl_dpy, egl_surf);
-		wl_display_flush(egl_dpy);
+			/* End rendering. */
+			opengl_end_rendering();
+
+			/* Sync. */
+			eglSwapBuffers(egl_dpy, egl_surf);
+			wl_display_flush(egl_dpy);
+			idle_frame_count = 0;
+		} else {
+			/* Nothing changed: keep the last presented frame. */
+			opengl_end_rendering();
+			idle_frame_count++;
+		}
 	} else {
 		/* Render. */
 		render_video_frame();
@@ -724,12 +739,29 @@ run_frame(void)
 		if (!gstplay_is_playing()) {
 			gstplay_stop();
 			is_gst_playing = false;
+			is_render_forced = true;
 		}
 	}
 
 	return cont;
 }
 
+/* Check whether the current frame has to be rendered. */
+static bool
+is_render_needed(void)
+{
+	if (is_render_forced) {
+		is_render_forced = false;
+		return true;
+	}
+
+	/* If the app doesn't track changes, always render. */
+	if (hal_callback.on_check_render == NULL)
+		return true;
+
+	return hal_callback.on_check_render();
+}
+
 /* Render a video frame. */
 static void
 render_video_frame(void)
@@ -782,10 +814,19 @@ wait_for_next_frame(void)
 	struct timeval tv_end;
 	uint32_t lap, wait, span;
 
-	span = FRAME_MILLI;
-
 	/* Do event processing and sleep until the time of next frame start. */
 	do {
+		/* Process events if exist. */
+		if (decor != NULL) {
+			if (libdecor_dispatch(decor, 0) < 0)
+				return false;
+		}
+		if (is_close_requested)
+			return false;
+
+		/* Lower the frame rate while the screen is idle. */
+		span = idle_frame_count >= IDLE_FRAMES ? IDLE_MILLI : FRAME_MILLI;
+
 		/* Get a lap time. */
 		gettimeofday(&tv_end, NULL);
 		lap = (uint32_t)((tv_end.tv_sec - tv_start.tv_sec) * 1000 +
@@ -843,6 +884,9 @@ static void update_viewport_size(int width, int height)
 
 	/* Update the screen offset and scale for drawing subsystem. */
 	opengl_set_screen(orig_x, orig_y, viewport_width, viewport_height);
+
+	/* Redraw the screen even if the stage is unchanged. */
+	is_render_forced = true;
 }
 
 static void
@@ -1037,6 +1081,9 @@ pointer_motion(
 	UNUSED_PARAMETER(pointer);
 	UNUSED_PARAMETER(time);
 
+	/* Leave the idle frame rate on any input. */
+	idle_frame_count = 0;
+
 	last_mouse_x = (int)((wl_fixed_to_double(sx) - mouse_ofs_x) * mouse_scale);
 	last_mouse_y = (int)((wl_fixed_to_double(sy) - mouse_ofs_y) * mouse_scale);
 
@@ -1057,6 +1104,9 @@ pointer_button(
 	UNUSED_PARAMETER(serial);
 	UNUSED_PARAMETER(time);
 
+	/* Leave the idle frame rate on any input. */
+	idle_frame_count = 0;
+
 	if (button == 272) {
 		if (state == WL_POINTER_BUTTON_STATE_PRESSED)
 			hal_callback.on_mouse_press(HAL_MOUSE_LEFT, last_mouse_x, last_mouse_y);
@@ -1083,6 +1133,9 @@ pointer_axis(
 	UNUSED_PARAMETER(time);
 	UNUSED_PARAMETER(axis);
 	UNUSED_PARAMETER(value);
+
+	/* Leave the idle frame rate on any input. */
+	idle_frame_count = 0;
 }
 
 static void
@@ -1146,6 +1199,9 @@ keyboard_key(
 	UNUSED_PARAMETER(serial);
 	UNUSED_PARAMETER(time);
 
+	/* Leave the idle frame rate on any input. */
+	idle_frame_count = 0;
+
 	keycode = get_keycode((int)key);
 
 	if (keycode == HAL_KEY_ALT) {
@@ -1859,6 +1915,7 @@ hal_stop_video_wl(void)
 	gstplay_stop();
 
 	is_gst_playing = false;
+	is_render_forced = true;
 }
 
 /*
@@ -91,6 +91,8 @@
 /* Frame Time */
 #define FRAME_MILLI	(16)	/* Millisec of a frame */
 #define SLEEP_MILLI	(5)	/* Millisec to sleep */
+#define IDLE_MILLI	(50)	/* Millisec of an idle frame */
+#define IDLE_FRAMES	(30)	/* Frames without rendering to become idle */
 
 /* Window config. */
 static char *window_title;
@@ -129,6 +131,12 @@ static EGLSurface egl_surface;
 /* Frame start time. */
 static struct timeval tv_start;
 
+/* Flag to force rendering of the next frame. (e.g., after an expose) */
+static bool is_render_forced = true;
+
+/* Count of the consecutive frames that skipped rendering. */
+static int idle_frame_count;
+
 /* Log file. */
 #define LOG_BUF_SIZE	(4096)
 static FILE *log_fp;
@@ -234,6 +242,7 @@ static void destroy_window(void);
 static void destroy_icon_image(void);
 static void run_game_loop(void);
 static bool run_frame(void);
+static bool is_render_needed(void);
 static void render_video_frame(void);
 static bool wait_for_next_frame(void);
 static bool next_event(void);
@@ -1167,18 +1176,24 @@ run_frame(void)
 
 		/* Call a frame event. */
 		cont = hal_callback.on_update();
-		if (cont)
+		if (cont && is_render_needed()) {
 			hal_callback.on_render();
 
-		/* End rendering. */
-		opengl_end_rendering();
+			/* End rendering. */
+			opengl_end_rendering();
 
-		/* Swap buffers. */
+			/* Swap buffers. */
 #if defined(HAL_USE_X11_ONLY)
-		glXSwapBuffers(display, glx_window);
+			glXSwapBuffers(display, glx_window);
 #else
-		eglSwapBuffers(egl_display, egl_surface);
+			eglSwapBuffers(egl_display, egl_surface);
 #endif
+			idle_frame_count = 0;
+		} else {
+			/* Nothing changed: keep the last presented frame. */
+			opengl_end_rendering();
+			idle_frame_count++;
+		}
 	} else {
 		/* Render. */
 		render_video_frame();
@@ -1190,12 +1205,29 @@ run_frame(void)
 		if (!gstplay_is_playing()) {
 			gstplay_stop();
 			is_gst_playing = false;
+			is_render_forced = true;
 		}
 	}
 
 	return cont;
 }
 
+/* Check whether the current frame has to be rendered. */
+static bool
+is_render_needed(void)
+{
+	if (is_render_forced) {
+		is_render_forced = false;
+		return true;
+	}
+
+	/* If the app doesn't track changes, always render. */
+	if (hal_callback.on_check_render == NULL)
+		return true;
+
+	return hal_callback.on_check_render();
+}
+
 /* Render a video frame. */
 static void
 render_video_frame(void)
@@ -1251,8 +1283,6 @@ wait_for_next_frame(void)
 	struct timeval tv_end;
 	uint32_t lap, wait, span;
 
-	span = FRAME_MILLI;
-
 	/* Do event processing and sleep until the time of next frame start. */
 	do {
 		/* Process events if exist. */
@@ -1260,6 +1290,9 @@ wait_for_next_frame(void)
 			if (!next_event())
 				return false;
 
+		/* Lower the frame rate while the screen is idle. */
+		span = idle_frame_count >= IDLE_FRAMES ? IDLE_MILLI : FRAME_MILLI;
+
 		/* Get a lap time. */
 		gettimeofday(&tv_end, NULL);
 		lap = (uint32_t)((tv_end.tv_sec - tv_start.tv_sec) * 1000 +
@@ -1289,6 +1322,10 @@ next_event(void)
 	XEvent event;
 
 	XNextEvent(display, &event);
+
+	/* Leave the idle frame rate on any event. */
+	idle_frame_count = 0;
+
 	switch (event.type) {
 	case KeyPress:
 		event_key_press(&event);
@@ -1311,6 +1348,9 @@ next_event(void)
 	case ConfigureNotify:
 		event_resize(&event);
 		break;
+	case Expose:
+		is_render_forced = true;
+		break;
 	case ClientMessage:
 		/* Close button was pressed. */
 		if ((Atom)event.xclient.data.l[0] == delete_message)
@@ -1636,6 +1676,9 @@ void update_viewport_size(
 
 	/* Update the screen offset and scale for drawing subsystem. */
 	opengl_set_screen(orig_x, orig_y, viewport_width, viewport_height);
+
+	/* Redraw the screen even if the stage is unchanged. */
+	is_render_forced = true;
 }
 
 /*
@@ -2210,6 +2253,7 @@ hal_stop_video_x11(void)
 	gstplay_stop();
 
 	is_gst_playing = false;
+	is_render_forced = true;
 }
 
 /*
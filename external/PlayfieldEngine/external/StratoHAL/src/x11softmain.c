@@ -77,6 +77,8 @@
 /* Frame Time */
 #define FRAME_MILLI	(16)	/* Millisec of a frame */
 #define SLEEP_MILLI	(5)	/* Millisec to sleep */
+#define IDLE_MILLI	(50)	/* Millisec of an idle frame */
+#define IDLE_FRAMES	(30)	/* Frames without rendering to become idle */
 
 /* Window Config */
 static char *window_title;
@@ -107,6 +109,12 @@ static uint8_t *low_bpp_pixels;
 /* Frame Start Time */
 static struct timeval tv_start;
 
+/* Flag to force rendering of the next frame. (e.g., after an expose) */
+static bool is_render_forced = true;
+
+/* Count of the consecutive frames that skipped rendering. */
+static int idle_frame_count;
+
 /* Log File */
 #define LOG_BUF_SIZE	(4096)
 static FILE *log_fp;
@@ -149,6 +157,7 @@ static void destroy_window(void);
 static void destroy_icon_image(void);
 static void run_game_loop(void);
 static bool run_frame(void);
+static bool is_render_needed(void);
 static bool draw_video_frame(void);
 static bool wait_for_next_frame(void);
 static bool next_event(void);
@@ -862,24 +871,29 @@ run_frame(void)
 	/* Read the gamepad. */
 	update_evgamepad();
 
-	/* Clear the back image. */
-	hal_clear_image(back_image, hal_make_pixel(0xff, 0, 0, 0));
-
 	if (!is_gst_playing) {
-		flip = true;
-
 		/* Call a frame event. */
 		cont = hal_callback.on_update();
-		if (cont)
+		flip = cont && is_render_needed();
+		if (flip) {
+			/* Clear the back image. */
+			hal_clear_image(back_image, hal_make_pixel(0xff, 0, 0, 0));
+
 			hal_callback.on_render();
+			idle_frame_count = 0;
+		} else {
+			/* Nothing changed: keep the last transferred frame. */
+			idle_frame_count++;
+		}
 	} else {
-		/* Process a video frame. */
+		/* Process a video frame. (this fills the whole back image) */
 		flip = draw_video_frame();
 
 		/* Check if the playback is finished. */
 		if (!gstplay_is_playing()) {
 			gstplay_stop();
 			is_gst_playing = false;
+			is_render_forced = true;
 		}
 
 		/* Call a frame event. */
@@ -951,47 +965,34 @@ run_frame(void)
 	return cont;
 }
 
+/* Check whether the current frame has to be rendered. */
 static bool
-draw_video_frame(void)
+is_render_needed(void)
 {
-	struct hal_image *video_image;
-	int dst_width, dst_height, dst_x, dst_y;
+	if (is_render_forced) {
+		is_render_forced = false;
+		return true;
+	}
+
+	/* If the app doesn't track changes, always render. */
+	if (hal_callback.on_check_render == NULL)
+		return true;
+
+	return hal_callback.on_check_render();
+}
 
-	/* Update the playback stauts. */
-	video_image = gstplay_loop_iteration();
-	if (video_image == NULL) {
+static bool
+draw_video_frame(void)
+{
+	/*
+	 * Update the playback stauts, and convert a new YUV frame straight
+	 * into the back image with the letterbox.
+	 */
+	if (!gstplay_draw_frame(back_image)) {
 		/* Rendering is not required for this game frame. */
 		return false;
 	}
 
-	/* Fit while preserving aspect ratio. */
-	if (screen_width * video_image->height <= screen_height * video_image->width) {
-		dst_width = screen_width;
-		dst_height = screen_width * video_image->height / video_image->width;
-	} else {
-		dst_height = screen_height;
-		dst_width = screen_height * video_image->width / video_image->height;
-	}
-	dst_x = (screen_width - dst_width) / 2;
-	dst_y = (screen_height - dst_height) / 2;
-
-	/* Draw. */
-	hal_draw_image_3d_alpha(back_image,
-				dst_x,
-				dst_y,
-				dst_x + dst_width,
-				dst_y,
-				dst_x,
-				dst_y + dst_height,
-				dst_x + dst_width,
-				dst_y + dst_height,
-				video_image,
-				0,
-				0,
-				video_image->width,
-				video_image->height,
-				255);
-
 	return true;
 }
 
@@ -1003,8 +1004,6 @@ wait_for_next_frame(void)
 	struct timeval tv_end;
 	uint32_t lap, wait, span;
 
-	span = FRAME_MILLI;
-
 	/* Do event processing and sleep until the time of next frame start. */
 	do {
 		/* Process events if exist. */
@@ -1012,6 +1011,9 @@ wait_for_next_frame(void)
 			if (!next_event())
 				return false;
 
+		/* Lower the frame rate while the screen is idle. */
+		span = idle_frame_count >= IDLE_FRAMES ? IDLE_MILLI : FRAME_MILLI;
+
 		/* Get a lap time. */
 		gettimeofday(&tv_end, NULL);
 		lap = (uint32_t)((tv_end.tv_sec - tv_start.tv_sec) * 1000 +
@@ -1041,6 +1043,10 @@ next_event(void)
 	XEvent event;
 
 	XNextEvent(display, &event);
+
+	/* Leave the idle frame rate on any event. */
+	idle_frame_count = 0;
+
 	switch (event.type) {
 	case KeyPress:
 		event_key_press(&event);
@@ -1062,6 +1068,10 @@ next_event(void)
 		break;
 	case ConfigureNotify:
 		event_resize(&event);
+		is_render_forced = true;
+		break;
+	case Expose:
+		is_render_forced = true;
 		break;
 	case ClientMessage:
 		/* Close button was pressed. */
@@ -1547,8 +1557,8 @@ void
 hal_notify_image_update(
 	struct hal_image *img)
 {
-	/* We don't use VRAM directly. No need to upload to VRAM. */
-	UNUSED_PARAMETER(img);
+	/* We don't use VRAM directly. Just remake the mip levels. */
+	img->is_mip_valid = false;
 }
 
 /*
@@ -2039,7 +2049,7 @@ hal_play_video(
 	is_gst_playing = true;
 	is_gst_skippable = is_skippable;
 
-	gstplay_play(path);
+	gstplay_play_yuv(path);
 
 	free(path);
 
@@ -2055,6 +2065,7 @@ hal_stop_video(void)
 	gstplay_stop();
 
 	is_gst_playing = false;
+	is_render_forced = true;
 }
 
 /*
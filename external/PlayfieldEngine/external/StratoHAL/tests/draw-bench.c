@@ -0,0 +1,204 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * StratoHAL
+ * Software 3D draw benchmark (minification)
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Copyright (c) 2025-2026 Awe Morris
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Usage: draw-bench
+ *
+ * This draws a 2048x2048 image with hal_draw_image_3d_alpha() at several
+ * scales, and prints the time per draw. src/image.c is linked as is, and
+ * the platform functions are provided here.
+ *  - "first" is the first draw after an update. (makes the mip levels)
+ *  - "next" is the average of the following draws.
+ */
+
+#include <strato/strato.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+/* Source size. */
+#define SRC_SIZE	(2048)
+
+/* Destination size. */
+#define DST_SIZE	(1024)
+
+/* Iterations. */
+#define LOOP_COUNT	(20)
+
+/*
+ * Platform functions used by image.c
+ */
+
+void
+hal_notify_image_update(
+	struct hal_image *img)
+{
+	img->is_mip_valid = false;
+}
+
+void
+hal_notify_image_free(
+	struct hal_image *img)
+{
+	(void)img;
+}
+
+bool
+hal_log_info(
+	const char *s,
+	...)
+{
+	(void)s;
+	return true;
+}
+
+bool
+hal_log_warn(
+	const char *s,
+	...)
+{
+	(void)s;
+	return true;
+}
+
+bool
+hal_log_error(
+	const char *s,
+	...)
+{
+	va_list ap;
+
+	va_start(ap, s);
+	vprintf(s, ap);
+	va_end(ap);
+	printf("\n");
+	return true;
+}
+
+bool
+hal_log_out_of_memory(void)
+{
+	printf("out of memory\n");
+	return true;
+}
+
+/*
+ * Benchmark
+ */
+
+static double
+get_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+/* Fill an image with a pattern that has fine details and alpha. */
+static void
+fill(
+	struct hal_image *img)
+{
+	uint32_t seed;
+	int x, y;
+
+	seed = 1;
+	for (y = 0; y < img->height; y++) {
+		for (x = 0; x < img->width; x++) {
+			seed = seed * 1103515245U + 12345U;
+			img->pixels[y * img->width + x] =
+				hal_make_pixel_fast((uint32_t)((x / 64 + y / 64) % 2 == 0 ? 255 : 128),
+						    (uint32_t)(x & 0xff),
+						    (uint32_t)(y & 0xff),
+						    (seed >> 16) & 0xff);
+		}
+	}
+	hal_notify_image_update(img);
+}
+
+static void
+draw(
+	struct hal_image *dst,
+	struct hal_image *src,
+	float size)
+{
+	hal_draw_image_3d_alpha(dst,
+				0, 0,
+				size, 0,
+				0, size,
+				size, size,
+				src,
+				0, 0, src->width, src->height,
+				255);
+}
+
+int
+main(void)
+{
+	static const int scales[] = { 2, 4, 8, 16, 32, 64, 128 };
+	struct hal_image *src, *dst;
+	double t0, first_ms, next_ms;
+	float size;
+	int i, j;
+
+	if (!hal_create_image(SRC_SIZE, SRC_SIZE, &src) ||
+	    !hal_create_image(DST_SIZE, DST_SIZE, &dst))
+		return 1;
+	fill(src);
+
+	printf("%dx%d source, ms per draw\n", SRC_SIZE, SRC_SIZE);
+	for (i = 0; i < (int)(sizeof(scales) / sizeof(scales[0])); i++) {
+		size = (float)SRC_SIZE / (float)scales[i];
+		if (size > (float)DST_SIZE)
+			size = (float)DST_SIZE;
+
+		/* The first draw after an update. */
+		hal_notify_image_update(src);
+		t0 = get_ms();
+		draw(dst, src, size);
+		first_ms = get_ms() - t0;
+
+		/* The following draws. */
+		t0 = get_ms();
+		for (j = 0; j < LOOP_COUNT; j++)
+			draw(dst, src, size);
+		next_ms = (get_ms() - t0) / LOOP_COUNT;
+
+		printf("1/%-3d (%4dx%-4d): first %8.3f, next %8.3f\n",
+		       scales[i], (int)size, (int)size, first_ms, next_ms);
+	}
+
+	hal_destroy_image(src);
+	hal_destroy_image(dst);
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+
+# Needs the system libpng, libjpeg and libwebp.
+
+set -eu
+
+echo 'StratoHAL Benchmarks'
+echo
+
+CC=${CC:-cc}
+OUT=${TMPDIR:-/tmp}/strato-draw-bench
+
+echo 'Software 3D draw (minification)'
+$CC -O2 -DHAL_USE_EXTDLL -I../include -o $OUT draw-bench.c ../src/image.c \
+    -lpng -ljpeg -lwebp -lm
+$OUT
+rm -f $OUT
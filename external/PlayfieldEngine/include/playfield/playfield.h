@@ -417,6 +417,14 @@ pf_play_sound(
 	const char *file,
 	bool is_loop);
 
+/*
+ * Decode a short sound file in advance to play it without a delay.
+ */
+PF_DLL
+bool
+pf_preload_sound(
+	const char *file);
+
 /*
  * Stop a sound on a stream.
  */
@@ -425,6 +433,55 @@ bool
 pf_stop_sound(
 	int stream);
 
+/*
+ * Set the number of the sounds that a stream plays at the same time.
+ */
+PF_DLL
+bool
+pf_set_sound_polyphony(
+	int stream,
+	int voices);
+
+/*
+ * Play a sound as a voice on a stream.
+ */
+PF_DLL
+bool
+pf_play_sound_voice(
+	int stream,
+	const char *file,
+	bool is_loop,
+	float vol,
+	int *voice);
+
+/*
+ * Stop a voice on a stream.
+ */
+PF_DLL
+bool
+pf_stop_sound_voice(
+	int stream,
+	int voice);
+
+/*
+ * Set the volume of a voice on a stream.
+ */
+PF_DLL
+bool
+pf_set_sound_voice_volume(
+	int stream,
+	int voice,
+	float vol);
+
+/*
+ * Check if a voice on a stream is completed.
+ */
+PF_DLL
+bool
+pf_is_sound_voice_finished(
+	int stream,
+	int voice);
+
 /*
  * Set a sound volume on a stream.
  */
@@ -489,6 +546,19 @@ uint64_t
 pf_get_lap_timer_millisec(
 	uint64_t *origin);
 
+/*
+ * Garbage Collection
+ */
+
+/*
+ * Set the time budget for the incremental GC per frame, in
+ * milliseconds. The GC runs after rendering a frame. (0 to disable)
+ */
+PF_DLL
+void
+pf_set_gc_budget(
+	int millisec);
+
 /*
  * Save Data
  */
@@ -503,6 +573,25 @@ pf_write_save_data(
 	const void *data,
 	size_t size);
 
+/*
+ * Write save data in the background.
+ *  - The engine takes the ownership of data and frees it.
+ *  - Reading the same save data waits for the write.
+ */
+PF_DLL
+bool
+pf_write_save_data_async(
+	const char *key,
+	void *data,
+	size_t size);
+
+/*
+ * Wait for the background writes of save data.
+ */
+PF_DLL
+bool
+pf_flush_save_data(void);
+
 /*
  * Read save data.
  */
@@ -564,6 +653,16 @@ PF_DLL
 void *
 pf_get_vm_env(void);
 
+/*
+ * Register a script file content, a source text or bytecode.
+ */
+PF_DLL
+bool
+pf_register_vm_script(
+	const char *file_name,
+	const char *data,
+	size_t size);
+
 /*
  * Call a VM function.
  */
@@ -885,6 +984,15 @@ PF_DLL
 extern bool
 (*pf_init_aot_code_ptr)(struct rt_env *env);
 
+/*
+ * Render check callback for derived engines.
+ *  - Returns false if the screen is unchanged since the last rendering.
+ *  - Set this in the init hook. NULL means always rendering.
+ */
+PF_DLL
+extern bool
+(*pf_check_render_hook_ptr)(void);
+
 /*
  * Entrypoint Definition
  */
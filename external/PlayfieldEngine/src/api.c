@@ -58,9 +58,12 @@ struct texture_entry {
 /* Texture table. */
 static struct texture_entry tex_tbl[TEXTURE_COUNT];
 
-/* Wave table. */
+/* Wave table. (a stream or a voice pool) */
 static struct hal_wave *wave_tbl[HAL_SOUND_TRACKS];
 
+/* Polyphony of the streams. (0 or 1 for a single voice) */
+static int polyphony_tbl[HAL_SOUND_TRACKS];
+
 /* Forward Declaration */
 static int search_free_entry(void);
 static bool create_texture(int width, int height, int *ret, struct hal_image **img);
@@ -95,7 +98,9 @@ pfi_cleanup_api(void)
 			hal_destroy_image(tex_tbl[i].img);
 		}
 	}
-	
+
+	/* Finish the background writes before exit. */
+	pf_flush_save_data();
 }
 
 /*
@@ -1034,11 +1039,17 @@ pf_play_sound(
 	const char *file,
 	bool is_loop)
 {
+	int voice;
+
 	if (stream < 0 || stream >= HAL_SOUND_TRACKS) {
 		hal_log_error(PF_TR("Invalid sound stream index."));
 		return false;
 	}
 
+	/* Add a voice if the stream is polyphonic. */
+	if (polyphony_tbl[stream] > 1)
+		return pf_play_sound_voice(stream, file, is_loop, 1.0f, &voice);
+
 	if (!hal_create_wave_from_file(file, is_loop, &wave_tbl[stream]))
 		return false;
 
@@ -1048,6 +1059,95 @@ pf_play_sound(
 	return true;
 }
 
+/*
+ * Set the number of the sounds that a stream plays at the same time.
+ *  - This stops the stream.
+ */
+PF_DLL
+bool
+pf_set_sound_polyphony(
+	int stream,
+	int voices)
+{
+	if (stream < 0 || stream >= HAL_SOUND_TRACKS) {
+		hal_log_error(PF_TR("Invalid sound stream index."));
+		return false;
+	}
+
+	if (!pf_stop_sound(stream))
+		return false;
+
+	polyphony_tbl[stream] = voices;
+
+	return true;
+}
+
+/*
+ * Play a sound as a voice on a stream.
+ *  - On a polyphonic stream, returns false if all voices are busy.
+ *  - On a single voice stream, this replaces the sound. (voice 0)
+ */
+PF_DLL
+bool
+pf_play_sound_voice(
+	int stream,
+	const char *file,
+	bool is_loop,
+	float vol,
+	int *voice)
+{
+	struct hal_wave *w;
+
+	if (stream < 0 || stream >= HAL_SOUND_TRACKS) {
+		hal_log_error(PF_TR("Invalid sound stream index."));
+		return false;
+	}
+
+	/* Single voice case. */
+	if (polyphony_tbl[stream] <= 1) {
+		*voice = 0;
+		if (!pf_stop_sound(stream))
+			return false;
+		return pf_play_sound(stream, file, is_loop);
+	}
+
+	/* Start the voice pool on the first voice. */
+	if (wave_tbl[stream] == NULL) {
+		if (!hal_create_wave_pool(polyphony_tbl[stream], &wave_tbl[stream]))
+			return false;
+		if (!hal_play_sound(stream, wave_tbl[stream])) {
+			hal_destroy_wave(wave_tbl[stream]);
+			wave_tbl[stream] = NULL;
+			return false;
+		}
+	}
+
+	if (!hal_create_wave_from_file(file, is_loop, &w))
+		return false;
+
+	*voice = hal_add_wave_voice(wave_tbl[stream], w, vol);
+	if (*voice == -1) {
+		hal_destroy_wave(w);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Decode a short sound file in advance to play it without a delay.
+ */
+PF_DLL
+bool
+pf_preload_sound(
+	const char *file)
+{
+	if (!hal_preload_wave(file))
+		return false;
+
+	return true;
+}
+
 /*
  * Stop the sound on a stream.
  */
@@ -1071,6 +1171,74 @@ pf_stop_sound(
 	return true;
 }
 
+/*
+ * Stop a voice on a stream.
+ */
+PF_DLL
+bool
+pf_stop_sound_voice(
+	int stream,
+	int voice)
+{
+	if (stream < 0 || stream >= HAL_SOUND_TRACKS) {
+		hal_log_error(PF_TR("Invalid sound stream index."));
+		return false;
+	}
+
+	if (polyphony_tbl[stream] <= 1)
+		return pf_stop_sound(stream);
+
+	if (wave_tbl[stream] != NULL)
+		hal_stop_wave_voice(wave_tbl[stream], voice);
+
+	return true;
+}
+
+/*
+ * Set the volume of a voice on a stream.
+ *  - This is multiplied by the stream volume.
+ *  - No effect on a single voice stream.
+ */
+PF_DLL
+bool
+pf_set_sound_voice_volume(
+	int stream,
+	int voice,
+	float vol)
+{
+	if (stream < 0 || stream >= HAL_SOUND_TRACKS) {
+		hal_log_error(PF_TR("Invalid sound stream index."));
+		return false;
+	}
+
+	if (polyphony_tbl[stream] > 1 && wave_tbl[stream] != NULL)
+		hal_set_wave_voice_volume(wave_tbl[stream], voice, vol);
+
+	return true;
+}
+
+/*
+ * Check if a voice on a stream is completed.
+ */
+PF_DLL
+bool
+pf_is_sound_voice_finished(
+	int stream,
+	int voice)
+{
+	if (stream < 0 || stream >= HAL_SOUND_TRACKS)
+		return true;
+	if (polyphony_tbl[stream] <= 1)
+		return pf_is_sound_finished(stream);
+	if (wave_tbl[stream] == NULL)
+		return true;
+
+	if (!hal_is_wave_voice_finished(wave_tbl[stream], voice))
+		return false;
+
+	return true;
+}
+
 /*
  * Set the sound volume on a stream.
  */
@@ -1098,6 +1266,13 @@ bool
 pf_is_sound_finished(
 	int stream)
 {
+	/* A voice pool never finishes, so see the voices. */
+	if (stream >= 0 && stream < HAL_SOUND_TRACKS && polyphony_tbl[stream] > 1) {
+		if (wave_tbl[stream] != NULL && hal_get_wave_voice_count(wave_tbl[stream]) > 0)
+			return false;
+		return true;
+	}
+
 	if (!hal_is_sound_finished(stream))
 		return false;
 
@@ -1166,6 +1341,21 @@ pf_get_lap_timer_millisec(
 	return hal_get_lap_timer_millisec(origin);
 }
 
+/*
+ * Garbage Collection
+ */
+
+/*
+ * Set the time budget for the incremental GC per frame.
+ */
+PF_DLL
+void
+pf_set_gc_budget(
+	int millisec)
+{
+	pfi_set_gc_budget(millisec);
+}
+
 /*
  * Save Data
  */
@@ -1211,6 +1401,52 @@ pf_write_save_data(
 	return true;
 }
 
+/*
+ * Write save data in the background.
+ */
+PF_DLL
+bool
+pf_write_save_data_async(
+	const char *key,
+	void *data,
+	size_t size)
+{
+	char *fname;
+
+	/* Make a save file name. */
+	fname = make_save_file_name(key);
+	if (fname == NULL) {
+		hal_log_error(PF_TR("Save data key too long."));
+		free(data);
+		return false;
+	}
+
+	/* Pass the data to the writer. */
+	if (!hal_write_file_async(fname, data, size)) {
+		hal_log_error(PF_TR("Cannot write to a save file."));
+		free(fname);
+		return false;
+	}
+	free(fname);
+
+	return true;
+}
+
+/*
+ * Wait for the background writes of save data.
+ */
+PF_DLL
+bool
+pf_flush_save_data(void)
+{
+	if (!hal_wait_file_writes()) {
+		hal_log_error(PF_TR("Cannot write to a save file."));
+		return false;
+	}
+
+	return true;
+}
+
 /*
  * Read save data.
  */
@@ -1264,6 +1500,64 @@ pf_read_save_data(
 	return true;
 }
 
+/*
+ * Open a save file stream to write.
+ */
+bool
+pfi_open_save_wfile(
+	const char *key,
+	struct hal_wfile **wf)
+{
+	char *fname;
+
+	/* Make a save file name. */
+	fname = make_save_file_name(key);
+	if (fname == NULL) {
+		hal_log_error(PF_TR("Save data key too long."));
+		return false;
+	}
+
+	/* Open a save file. */
+	if (!hal_open_wfile(fname, wf)) {
+		hal_log_error(PF_TR("Cannot open a save file."));
+		free(fname);
+		return false;
+	}
+	free(fname);
+
+	return true;
+}
+
+/*
+ * Open a save file stream to read. (De-obfuscated)
+ */
+bool
+pfi_open_save_rfile(
+	const char *key,
+	struct hal_rfile **rf)
+{
+	char *fname;
+
+	/* Make a save file name. */
+	fname = make_save_file_name(key);
+	if (fname == NULL) {
+		hal_log_error(PF_TR("Save data key too long."));
+		return false;
+	}
+
+	/* Open a save file. */
+	if (!hal_open_rfile(fname, rf)) {
+		free(fname);
+		return false;
+	}
+	free(fname);
+
+	/* Enable de-obfuscation. */
+	hal_decode_rfile(*rf);
+
+	return true;
+}
+
 /*
  * Check whether save data exist or not.
  */
@@ -1445,6 +1739,19 @@ pf_get_vm_env(void)
 	return pfi_get_vm_env();
 }
 
+/*
+ * Register a script file content, a source text or bytecode.
+ */
+PF_DLL
+bool
+pf_register_vm_script(
+	const char *file_name,
+	const char *data,
+	size_t size)
+{
+	return pfi_register_vm_script(file_name, data, size);
+}
+
 /*
  * Call a VM function.
  */
@@ -48,4 +48,14 @@ pfi_init_api(void);
 void
 pfi_cleanup_api(void);
 
+bool
+pfi_open_save_wfile(
+	const char *key,
+	struct hal_wfile **wf);
+
+bool
+pfi_open_save_rfile(
+	const char *key,
+	struct hal_rfile **rf);
+
 #endif
@@ -150,10 +150,14 @@ struct rt_env;
 PF_DLL bool (*pf_init_hook_ptr)(int width, int height) = NULL;
 PF_DLL bool (*pf_init_aot_code_ptr)(struct rt_env *);
 
+/* Render check hook. */
+PF_DLL bool (*pf_check_render_hook_ptr)(void) = NULL;
+
 /* Forward declaration. */
 static bool on_start(void);
 static bool on_update(void);
 static void on_render(void);
+static bool on_check_render(void);
 static void on_stop(void);
 static void on_key_press(int key);
 static void on_key_release(int key);
@@ -193,6 +197,7 @@ hal_bootstrap(
 	cb->on_analog_input  = on_analog_input;
 	cb->on_swipe_down    = on_swipe_down;
 	cb->on_swipe_up      = on_swipe_up;
+	cb->on_check_render  = on_check_render;
 
 #ifdef USE_TRANSLATION
 	/* Initialize the locale. */
@@ -446,6 +451,12 @@ on_update(void)
 {
 	int exit_flag;
 
+	/*
+	 * Run the GC slices here, that is after the last frame was
+	 * presented, so that they don't delay the presentation.
+	 */
+	pfi_run_gc_slices();
+
 	/* Get the lap timer. */
 	pfi_set_vm_int("millisec", (int)hal_get_lap_timer_millisec(&lap_origin));
 
@@ -485,6 +496,20 @@ on_render(void)
 	}
 }
 
+static bool
+on_check_render(void)
+{
+	/* Always render while a video is playing. */
+	if (hal_is_video_playing())
+		return true;
+
+	/* If the derived engine doesn't track changes. */
+	if (pf_check_render_hook_ptr == NULL)
+		return true;
+
+	return pf_check_render_hook_ptr();
+}
+
 static void
 on_stop(void)
 {
@@ -0,0 +1,948 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Playfield Engine
+ * Save data serialization
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Playfield Engine
+ * Copyright (c) 2025-2026 Awe Morris
+ *
+ * This software is derived from the codebase of Suika2.
+ * Copyright (c) 1996-2024 Keiichi Tabata
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include "savedata.h"
+#include "api.h"
+
+/* NoctLang */
+#include <noct/noct.h>
+
+/* StratoHAL */
+#include <strato/strato.h>
+
+/* Standard C */
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Noct Value Serialization
+ *
+ * Save data are a type-tagged value stream that starts with SER_MAGIC.
+ *  - Lengths, counts and integers are variable-length. (LEB128)
+ *  - A container has its element count first so that a reader can
+ *    presize it.
+ *  - A dictionary key is written once, and is referred by its index
+ *    after that. (The first SER_KEY_MAX keys are interned.)
+ * Data without the magic are read as the legacy fixed-width format.
+ * The stream is read and written through the HAL file API by chunks.
+ */
+
+/* Magic */
+#define SER_MAGIC		"NSV\x02"
+#define SER_MAGIC_SIZE		4
+
+/* Stream Buffer Size */
+#define SER_BUF_SIZE		(64 * 1024)
+
+/* Interned Key Max */
+#define SER_KEY_MAX		4096
+
+/* Key Hash Table Size (Power of 2, twice SER_KEY_MAX) */
+#define SER_KEY_HASH_SIZE	(8192)
+
+/*
+ * Nest Max
+ *  - The same for the writer and both formats, so that any loaded
+ *    data can be saved again. (The old writer had no limit.)
+ *  - This bounds the C stack for a broken file, and the writer's check
+ *    also stops a value that contains itself.
+ */
+#define SER_DEPTH_MAX		1024
+
+/* Interned Key (for write) */
+struct ser_key {
+	const char *s;
+	uint32_t id;
+};
+
+/* Serialize Context */
+struct ser_ctx {
+	/* File stream. (One of them.) */
+	struct hal_wfile *wf;
+	struct hal_rfile *rf;
+
+	/* Stream buffer. */
+	uint8_t *buf;
+	size_t buf_size;
+	size_t pos;
+	size_t len;
+
+	/* File size. (for read) */
+	size_t file_size;
+
+	/* Is in the legacy format? */
+	bool is_legacy;
+
+	/* Current nest level. (for read) */
+	int depth;
+
+	/*
+	 * Containers being read, by level. (for read)
+	 *  - The GC may move a value, so a level takes its container from
+	 *    here after each allocation.
+	 *  - The three values are pinned, so the reader doesn't need a pin
+	 *    per level.
+	 */
+	NoctValue stack;
+	uint32_t stack_size;
+	NoctValue cont;
+	NoctValue elem;
+
+	/* Interned keys. */
+	struct ser_key *key_hash;
+	char **key_tbl;
+	uint32_t key_count;
+
+	/* String buffer. */
+	char *sbuf;
+	size_t sbuf_size;
+};
+
+/* Value Type */
+enum {
+	SER_TYPE_INT,
+	SER_TYPE_FLOAT,
+	SER_TYPE_STRING,
+	SER_TYPE_ARRAY,
+	SER_TYPE_DICT,
+};
+
+/* Forward Declaration */
+static bool serialize_save_data_recursively(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool check_save_data(NoctEnv *env, NoctValue *value, int depth);
+static bool deserialize_save_data_recursively(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool deserialize_array(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool deserialize_dict(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool push_container(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool pop_container(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
+static bool ser_flush(struct ser_ctx *ctx);
+static bool ser_put_bytes(struct ser_ctx *ctx, const void *data, size_t size);
+static bool ser_put_u8(struct ser_ctx *ctx, uint8_t val);
+static bool ser_put_u32(struct ser_ctx *ctx, uint32_t val);
+static bool ser_put_varint(struct ser_ctx *ctx, uint32_t val);
+static bool ser_put_string(struct ser_ctx *ctx, const char *val);
+static bool ser_put_key(struct ser_ctx *ctx, const char *val);
+static bool ser_fill(struct ser_ctx *ctx, size_t size);
+static bool ser_get_u8(struct ser_ctx *ctx, uint8_t *val);
+static bool ser_get_u32(struct ser_ctx *ctx, uint32_t *val);
+static bool ser_get_varint(struct ser_ctx *ctx, uint32_t *val);
+static bool ser_get_count(struct ser_ctx *ctx, uint32_t *val);
+static bool ser_get_string(struct ser_ctx *ctx, char **val);
+static bool ser_get_key(struct ser_ctx *ctx, char **val, bool *is_copied);
+static uint32_t ser_hash(const char *s);
+
+/* Serialize a value to save data. */
+bool
+pfi_serialize_save_data(
+	NoctEnv *env,
+	const char *key,
+	NoctValue *value)
+{
+	struct ser_ctx ctx;
+	bool ret;
+
+	if (!check_save_data(env, value, 0))
+		return false;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	/* Allocate the buffers. */
+	ctx.buf_size = SER_BUF_SIZE;
+	ctx.buf = malloc(SER_BUF_SIZE);
+	ctx.key_hash = calloc(SER_KEY_HASH_SIZE, sizeof(struct ser_key));
+	if (ctx.buf == NULL || ctx.key_hash == NULL) {
+		hal_log_out_of_memory();
+		free(ctx.buf);
+		free(ctx.key_hash);
+		return false;
+	}
+
+	/* Open the save file. */
+	if (!pfi_open_save_wfile(key, &ctx.wf)) {
+		free(ctx.buf);
+		free(ctx.key_hash);
+		return false;
+	}
+
+	/* Write the stream. */
+	ret = ser_put_bytes(&ctx, SER_MAGIC, SER_MAGIC_SIZE) &&
+	      serialize_save_data_recursively(env, value, &ctx) &&
+	      ser_flush(&ctx);
+
+	/* Close the file. (A failed write doesn't replace the old file.) */
+	hal_close_wfile(ctx.wf);
+
+	free(ctx.buf);
+	free(ctx.key_hash);
+
+	return ret;
+}
+
+/* Serialize a value recursively. */
+static bool
+serialize_save_data_recursively(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	int type;
+	int ival;
+	float fval;
+	const char *sval;
+	uint32_t i, size, cursor;
+
+	if (!noct_get_value_type(env, value, &type))
+		return false;
+
+	switch (type) {
+	case NOCT_VALUE_INT:
+		if (!noct_get_int(env, value, &ival))
+			return false;
+		if (!ser_put_u8(ctx, SER_TYPE_INT))
+			return false;
+
+		/* Zigzag encoding makes a small negative value short. */
+		if (!ser_put_varint(ctx, ((uint32_t)ival << 1) ^ (ival < 0 ? 0xffffffff : 0)))
+			return false;
+		return true;
+	case NOCT_VALUE_FLOAT:
+		if (!noct_get_float(env, value, &fval))
+			return false;
+		ival = *(int *)&fval;
+		if (!ser_put_u8(ctx, SER_TYPE_FLOAT))
+			return false;
+		if (!ser_put_u32(ctx, (uint32_t)ival))
+			return false;
+		return true;
+	case NOCT_VALUE_STRING:
+		if (!noct_get_string(env, value, &sval))
+			return false;
+		if (!ser_put_u8(ctx, SER_TYPE_STRING))
+			return false;
+		if (!ser_put_string(ctx, sval))
+			return false;
+		return true;
+	case NOCT_VALUE_ARRAY:
+		if (!noct_get_array_size(env, value, &size))
+			return false;
+		if (!ser_put_u8(ctx, SER_TYPE_ARRAY))
+			return false;
+		if (!ser_put_varint(ctx, size))
+			return false;
+		for (i = 0; i < size; i++) {
+			NoctValue elem;
+			if (!noct_get_array_elem(env, value, i, &elem))
+				return false;
+			if (!serialize_save_data_recursively(env, &elem, ctx))
+				return false;
+		}
+		return true;
+	case NOCT_VALUE_DICT:
+		if (!noct_get_dict_size(env, value, &size))
+			return false;
+		if (!ser_put_u8(ctx, SER_TYPE_DICT))
+			return false;
+		if (!ser_put_varint(ctx, size))
+			return false;
+		cursor = 0;
+		for (i = 0; i < size; i++) {
+			NoctValue k, v;
+			if (!noct_get_dict_elem_by_cursor(env, value, &cursor, &k, &v))
+				return false;
+			if (!noct_get_string(env, &k, &sval))
+				return false;
+			if (!ser_put_key(ctx, sval))
+				return false;
+			if (!serialize_save_data_recursively(env, &v, ctx))
+				return false;
+		}
+		return true;
+	default:
+		/* Functions are rejected by check_save_data(). */
+		assert(0);
+		break;
+	}
+	return false;
+}
+
+/*
+ * Check that a value can be serialized.
+ *  - This runs before the save file is opened, as a failure after that
+ *    would replace the file with a partial one.
+ */
+static bool
+check_save_data(
+	NoctEnv *env,
+	NoctValue *value,
+	int depth)
+{
+	NoctValue k, elem;
+	int type;
+	uint32_t i, size, cursor;
+
+	if (!noct_get_value_type(env, value, &type))
+		return false;
+
+	switch (type) {
+	case NOCT_VALUE_ARRAY:
+	case NOCT_VALUE_DICT:
+		/* This also stops a value that contains itself. */
+		if (depth == SER_DEPTH_MAX) {
+			hal_log_error(PF_TR("Invalid save data."));
+			return false;
+		}
+		break;
+	case NOCT_VALUE_FUNC:
+		hal_log_error(PF_TR("Cannot deserialize function."));
+		return false;
+	default:
+		return true;
+	}
+
+	if (type == NOCT_VALUE_ARRAY) {
+		if (!noct_get_array_size(env, value, &size))
+			return false;
+		for (i = 0; i < size; i++) {
+			if (!noct_get_array_elem(env, value, i, &elem))
+				return false;
+			if (!check_save_data(env, &elem, depth + 1))
+				return false;
+		}
+	} else {
+		if (!noct_get_dict_size(env, value, &size))
+			return false;
+		cursor = 0;
+		for (i = 0; i < size; i++) {
+			if (!noct_get_dict_elem_by_cursor(env, value, &cursor, &k, &elem))
+				return false;
+			if (!check_save_data(env, &elem, depth + 1))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/* Deserialize a value from save data. */
+bool
+pfi_deserialize_save_data(
+	NoctEnv *env,
+	const char *key,
+	NoctValue *value)
+{
+	struct ser_ctx ctx;
+	uint32_t i;
+	bool ret;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	/* Allocate the buffers. */
+	ctx.buf_size = SER_BUF_SIZE;
+	ctx.buf = malloc(SER_BUF_SIZE);
+	ctx.key_tbl = malloc(SER_KEY_MAX * sizeof(char *));
+	if (ctx.buf == NULL || ctx.key_tbl == NULL) {
+		hal_log_out_of_memory();
+		free(ctx.buf);
+		free(ctx.key_tbl);
+		return false;
+	}
+
+	/* Open the save file. */
+	if (!pfi_open_save_rfile(key, &ctx.rf)) {
+		free(ctx.buf);
+		free(ctx.key_tbl);
+		return false;
+	}
+
+	/* Get the file size to reject a broken count. */
+	if (!hal_get_rfile_size(ctx.rf, &ctx.file_size)) {
+		hal_log_error(PF_TR("Cannot get the size of a save file."));
+		hal_close_rfile(ctx.rf);
+		free(ctx.buf);
+		free(ctx.key_tbl);
+		return false;
+	}
+
+	/* Check the magic. (The legacy format starts with a type.) */
+	if (ser_fill(&ctx, SER_MAGIC_SIZE) &&
+	    memcmp(ctx.buf, SER_MAGIC, SER_MAGIC_SIZE) == 0)
+		ctx.pos = SER_MAGIC_SIZE;
+	else
+		ctx.is_legacy = true;
+
+	/* Read the stream. */
+	ctx.stack.type = NOCT_VALUE_INT;
+	ctx.cont.type = NOCT_VALUE_INT;
+	ctx.elem.type = NOCT_VALUE_INT;
+	ret = false;
+	if (noct_pin_local(env, 3, &ctx.stack, &ctx.cont, &ctx.elem)) {
+		ret = noct_make_empty_array(env, &ctx.stack) &&
+		      deserialize_save_data_recursively(env, value, &ctx);
+		noct_unpin_local(env, 3, &ctx.stack, &ctx.cont, &ctx.elem);
+	}
+	if (!ret)
+		hal_log_error(PF_TR("Invalid save data."));
+
+	hal_close_rfile(ctx.rf);
+
+	for (i = 0; i < ctx.key_count; i++)
+		free(ctx.key_tbl[i]);
+	free(ctx.key_tbl);
+	free(ctx.sbuf);
+	free(ctx.buf);
+
+	return ret;
+}
+
+/* Deserialize a value recursively. */
+static bool
+deserialize_save_data_recursively(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	uint8_t type;
+	uint32_t ival;
+	float fval;
+	char *sval;
+
+	if (!ser_get_u8(ctx, &type))
+		return false;
+
+	switch (type) {
+	case SER_TYPE_INT:
+		if (ctx->is_legacy) {
+			if (!ser_get_u32(ctx, &ival))
+				return false;
+		} else {
+			if (!ser_get_varint(ctx, &ival))
+				return false;
+			ival = (ival >> 1) ^ (0 - (ival & 1));
+		}
+		if (!noct_make_int(env, value, (int)ival))
+			return false;
+		return true;
+	case SER_TYPE_FLOAT:
+		if (!ser_get_u32(ctx, &ival))
+			return false;
+		fval = *(float *)&ival;
+		if (!noct_make_float(env, value, fval))
+			return false;
+		return true;
+	case SER_TYPE_STRING:
+		if (!ser_get_string(ctx, &sval))
+			return false;
+		if (!noct_make_string(env, value, sval))
+			return false;
+		return true;
+	case SER_TYPE_ARRAY:
+		return deserialize_array(env, value, ctx);
+	case SER_TYPE_DICT:
+		return deserialize_dict(env, value, ctx);
+	default:
+		break;
+	}
+	return false;
+}
+
+/*
+ * Deserialize an array.
+ *  - The value must be pinned by the caller. It is used until the array
+ *    is pushed, and receives the finished array.
+ */
+static bool
+deserialize_array(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	uint32_t i, size;
+
+	if (!ser_get_count(ctx, &size))
+		return false;
+
+	/* Make a presized array. */
+	if (!noct_make_empty_array(env, value))
+		return false;
+	if (!noct_resize_array(env, value, size))
+		return false;
+	if (!push_container(env, value, ctx))
+		return false;
+
+	for (i = 0; i < size; i++) {
+		if (!deserialize_save_data_recursively(env, &ctx->elem, ctx))
+			return false;
+		if (!noct_get_array_elem(env, &ctx->stack, (uint32_t)ctx->depth - 1, &ctx->cont))
+			return false;
+		if (!noct_set_array_elem(env, &ctx->cont, i, &ctx->elem))
+			return false;
+	}
+
+	return pop_container(env, value, ctx);
+}
+
+/* Deserialize a dictionary. (See deserialize_array() for the value.) */
+static bool
+deserialize_dict(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	char *key;
+	uint32_t i, size;
+	bool is_copied, ret;
+
+	if (!ser_get_count(ctx, &size))
+		return false;
+
+	/* Make a presized dictionary. */
+	if (!noct_make_dict_with_capacity(env, value, size))
+		return false;
+	if (!push_container(env, value, ctx))
+		return false;
+
+	for (i = 0; i < size; i++) {
+		if (!ser_get_key(ctx, &key, &is_copied))
+			return false;
+		ret = deserialize_save_data_recursively(env, &ctx->elem, ctx) &&
+		      noct_get_array_elem(env, &ctx->stack, (uint32_t)ctx->depth - 1, &ctx->cont) &&
+		      noct_set_dict_elem(env, &ctx->cont, key, &ctx->elem);
+		if (is_copied)
+			free(key);
+		if (!ret)
+			return false;
+	}
+
+	return pop_container(env, value, ctx);
+}
+
+/* Enter a level with a new container. */
+static bool
+push_container(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	if (ctx->depth == SER_DEPTH_MAX)
+		return false;
+
+	if ((uint32_t)ctx->depth == ctx->stack_size) {
+		if (!noct_resize_array(env, &ctx->stack, ctx->stack_size + 16))
+			return false;
+		ctx->stack_size += 16;
+	}
+	if (!noct_set_array_elem(env, &ctx->stack, (uint32_t)ctx->depth, value))
+		return false;
+	ctx->depth++;
+
+	return true;
+}
+
+/* Leave a level and get the finished container. */
+static bool
+pop_container(
+	NoctEnv *env,
+	NoctValue *value,
+	struct ser_ctx *ctx)
+{
+	ctx->depth--;
+	if (!noct_get_array_elem(env, &ctx->stack, (uint32_t)ctx->depth, value))
+		return false;
+
+	return true;
+}
+
+/* Write the stream buffer to the file. */
+static bool
+ser_flush(
+	struct ser_ctx *ctx)
+{
+	size_t ret;
+
+	if (ctx->pos == 0)
+		return true;
+
+	if (!hal_write_wfile(ctx->wf, ctx->buf, ctx->pos, &ret) || ret != ctx->pos) {
+		hal_log_error(PF_TR("Cannot write to a save file."));
+		return false;
+	}
+	ctx->pos = 0;
+
+	return true;
+}
+
+/* Put bytes to the stream. */
+static bool
+ser_put_bytes(
+	struct ser_ctx *ctx,
+	const void *data,
+	size_t size)
+{
+	size_t ret;
+
+	if (ctx->pos + size > ctx->buf_size) {
+		if (!ser_flush(ctx))
+			return false;
+
+		/* Write a large block directly. */
+		if (size > ctx->buf_size) {
+			if (!hal_write_wfile(ctx->wf, data, size, &ret) || ret != size) {
+				hal_log_error(PF_TR("Cannot write to a save file."));
+				return false;
+			}
+			return true;
+		}
+	}
+
+	memcpy(ctx->buf + ctx->pos, data, size);
+	ctx->pos += size;
+
+	return true;
+}
+
+/* Put a u8 to the stream. */
+static bool
+ser_put_u8(
+	struct ser_ctx *ctx,
+	uint8_t val)
+{
+	if (ctx->pos + 1 > ctx->buf_size) {
+		if (!ser_flush(ctx))
+			return false;
+	}
+
+	ctx->buf[ctx->pos++] = val;
+
+	return true;
+}
+
+/* Put a u32 to the stream. */
+static bool
+ser_put_u32(
+	struct ser_ctx *ctx,
+	uint32_t val)
+{
+	uint8_t b[4];
+
+	b[0] = (uint8_t)(val & 0xff);
+	b[1] = (uint8_t)((val >> 8) & 0xff);
+	b[2] = (uint8_t)((val >> 16) & 0xff);
+	b[3] = (uint8_t)((val >> 24) & 0xff);
+
+	return ser_put_bytes(ctx, b, 4);
+}
+
+/* Put a variable-length u32 to the stream. (7 bits per byte) */
+static bool
+ser_put_varint(
+	struct ser_ctx *ctx,
+	uint32_t val)
+{
+	uint8_t b[5];
+	int n;
+
+	n = 0;
+	while (val >= 0x80) {
+		b[n++] = (uint8_t)(val | 0x80);
+		val >>= 7;
+	}
+	b[n++] = (uint8_t)val;
+
+	return ser_put_bytes(ctx, b, (size_t)n);
+}
+
+/* Put a string to the stream. */
+static bool
+ser_put_string(
+	struct ser_ctx *ctx,
+	const char *val)
+{
+	size_t len;
+
+	len = strlen(val);
+	if (!ser_put_varint(ctx, (uint32_t)len))
+		return false;
+	if (!ser_put_bytes(ctx, val, len))
+		return false;
+
+	return true;
+}
+
+/*
+ * Put a dictionary key to the stream.
+ *  - 0 and a string for a new key, or the index + 1 of an interned key.
+ *  - The table keeps the key pointers since no allocation happens
+ *    while serializing.
+ */
+static bool
+ser_put_key(
+	struct ser_ctx *ctx,
+	const char *val)
+{
+	uint32_t i;
+
+	/* Search the interned keys. */
+	i = ser_hash(val) & (SER_KEY_HASH_SIZE - 1);
+	while (ctx->key_hash[i].s != NULL) {
+		if (strcmp(ctx->key_hash[i].s, val) == 0)
+			return ser_put_varint(ctx, ctx->key_hash[i].id + 1);
+		i = (i + 1) & (SER_KEY_HASH_SIZE - 1);
+	}
+
+	/* Intern the key if the table has room. */
+	if (ctx->key_count < SER_KEY_MAX) {
+		ctx->key_hash[i].s = val;
+		ctx->key_hash[i].id = ctx->key_count++;
+	}
+
+	if (!ser_put_varint(ctx, 0))
+		return false;
+	if (!ser_put_string(ctx, val))
+		return false;
+
+	return true;
+}
+
+/* Make sure the stream buffer has the given bytes to read. */
+static bool
+ser_fill(
+	struct ser_ctx *ctx,
+	size_t size)
+{
+	uint8_t *new_buf;
+	size_t ret;
+
+	if (ctx->len - ctx->pos >= size)
+		return true;
+
+	/* Move the rest to the top. */
+	memmove(ctx->buf, ctx->buf + ctx->pos, ctx->len - ctx->pos);
+	ctx->len -= ctx->pos;
+	ctx->pos = 0;
+
+	/* Expand the buffer for a large string. */
+	if (size > ctx->buf_size) {
+		new_buf = realloc(ctx->buf, size);
+		if (new_buf == NULL) {
+			hal_log_out_of_memory();
+			return false;
+		}
+		ctx->buf = new_buf;
+		ctx->buf_size = size;
+	}
+
+	/* Read until the size. (Fails at EOF.) */
+	while (ctx->len < size) {
+		if (!hal_read_rfile(ctx->rf, ctx->buf + ctx->len, ctx->buf_size - ctx->len, &ret))
+			return false;
+		ctx->len += ret;
+	}
+
+	return true;
+}
+
+/* Get a u8 from the stream. */
+static bool
+ser_get_u8(
+	struct ser_ctx *ctx,
+	uint8_t *val)
+{
+	if (!ser_fill(ctx, 1))
+		return false;
+
+	*val = ctx->buf[ctx->pos++];
+
+	return true;
+}
+
+/* Get a u32 from the stream. */
+static bool
+ser_get_u32(
+	struct ser_ctx *ctx,
+	uint32_t *val)
+{
+	uint8_t *b;
+
+	if (!ser_fill(ctx, 4))
+		return false;
+
+	b = ctx->buf + ctx->pos;
+	*val = ((uint32_t)b[0]) |
+		((uint32_t)b[1] << 8) |
+		((uint32_t)b[2] << 16) |
+		((uint32_t)b[3] << 24);
+	ctx->pos += 4;
+
+	return true;
+}
+
+/* Get a variable-length u32 from the stream. */
+static bool
+ser_get_varint(
+	struct ser_ctx *ctx,
+	uint32_t *val)
+{
+	uint8_t b;
+	int shift;
+
+	*val = 0;
+	for (shift = 0; shift < 35; shift += 7) {
+		if (!ser_get_u8(ctx, &b))
+			return false;
+		*val |= (uint32_t)(b & 0x7f) << shift;
+		if ((b & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/* Get a length or a count from the stream. */
+static bool
+ser_get_count(
+	struct ser_ctx *ctx,
+	uint32_t *val)
+{
+	if (ctx->is_legacy) {
+		if (!ser_get_u32(ctx, val))
+			return false;
+	} else {
+		if (!ser_get_varint(ctx, val))
+			return false;
+	}
+
+	/* An element or a character takes at least one byte. */
+	if (*val > ctx->file_size)
+		return false;
+
+	return true;
+}
+
+/* Get a string from the stream. (Valid until the next string.) */
+static bool
+ser_get_string(
+	struct ser_ctx *ctx,
+	char **val)
+{
+	char *new_buf;
+	uint32_t len;
+
+	if (!ser_get_count(ctx, &len))
+		return false;
+	if (!ser_fill(ctx, len))
+		return false;
+
+	/* Expand the string buffer. */
+	if ((size_t)len + 1 > ctx->sbuf_size) {
+		new_buf = realloc(ctx->sbuf, (size_t)len + 1);
+		if (new_buf == NULL) {
+			hal_log_out_of_memory();
+			return false;
+		}
+		ctx->sbuf = new_buf;
+		ctx->sbuf_size = (size_t)len + 1;
+	}
+
+	memcpy(ctx->sbuf, ctx->buf + ctx->pos, len);
+	ctx->sbuf[len] = '\0';
+	ctx->pos += len;
+
+	*val = ctx->sbuf;
+
+	return true;
+}
+
+/*
+ * Get a dictionary key from the stream.
+ *  - An interned key is owned by the context. Otherwise, the caller
+ *    frees the copy since a value string may overwrite the buffer.
+ */
+static bool
+ser_get_key(
+	struct ser_ctx *ctx,
+	char **val,
+	bool *is_copied)
+{
+	char *s;
+	uint32_t id;
+
+	/* Get an index of an interned key. */
+	if (!ctx->is_legacy) {
+		if (!ser_get_varint(ctx, &id))
+			return false;
+		if (id != 0) {
+			if (id - 1 >= ctx->key_count)
+				return false;
+			*val = ctx->key_tbl[id - 1];
+			*is_copied = false;
+			return true;
+		}
+	}
+
+	/* Get a new key. */
+	if (!ser_get_string(ctx, &s))
+		return false;
+	s = strdup(s);
+	if (s == NULL) {
+		hal_log_out_of_memory();
+		return false;
+	}
+
+	/* Intern the key in the same order as the writer. */
+	if (!ctx->is_legacy && ctx->key_count < SER_KEY_MAX) {
+		ctx->key_tbl[ctx->key_count++] = s;
+		*is_copied = false;
+	} else {
+		*is_copied = true;
+	}
+	*val = s;
+
+	return true;
+}
+
+/* Get a hash of a key. (FNV-1a) */
+static uint32_t
+ser_hash(
+	const char *s)
+{
+	uint32_t h;
+
+	h = 2166136261u;
+	while (*s != '\0') {
+		h ^= (uint8_t)*s++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
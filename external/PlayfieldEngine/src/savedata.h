@@ -0,0 +1,63 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Playfield Engine
+ * Save data serialization
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Playfield Engine
+ * Copyright (c) 2025-2026 Awe Morris
+ *
+ * This software is derived from the codebase of Suika2.
+ * Copyright (c) 1996-2024 Keiichi Tabata
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef PLAYFIELD_SAVEDATA_H
+#define PLAYFIELD_SAVEDATA_H
+
+#include "playfield/playfield.h"
+
+#include <noct/noct.h>
+
+/*
+ * Serialize a value to save data.
+ *  - Functions and nesting deeper than 1024 are rejected before the file
+ *    is opened.
+ */
+bool
+pfi_serialize_save_data(
+	NoctEnv *env,
+	const char *key,
+	NoctValue *value);
+
+/*
+ * Deserialize a value from save data.
+ *  - The value must be pinned by the caller.
+ *  - Data in the legacy format are also read.
+ */
+bool
+pfi_deserialize_save_data(
+	NoctEnv *env,
+	const char *key,
+	NoctValue *value);
+
+#endif
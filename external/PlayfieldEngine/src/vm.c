@@ -35,6 +35,7 @@
 #include "engine.h"
 #include "api.h"
 #include "common.h"
+#include "savedata.h"
 
 /* NoctLang */
 #include <noct/noct.h>
@@ -52,15 +53,46 @@
 /* Bytecode File Header */
 #define BYTECODE_HEADER		"Noct Bytecode"
 
-/* Save data size. */
-#define SERIALIZE_SIZE		(1 * 1024 * 1024)
+/*
+ * Bytecode Cache Header
+ *  - Bump the version when the cache layout changes.
+ *  - The header also carries NOCT_BYTECODE_VERSION, so that a cache
+ *    written by another NoctLang build is rejected.
+ */
+#define BYTECODE_CACHE_HEADER	"Playfield Bytecode Cache 2"
+
+/* Bytecode cache key prefix. */
+#define BYTECODE_CACHE_PREFIX	"bytecode:"
+
+/* Steps of an incremental GC slice. */
+#define GC_SLICE_STEPS		(256)
+
+/* Default GC time budget per frame. (millisec) */
+#define GC_BUDGET_DEFAULT	(2)
 
 /* NoctLang */
 static NoctVM *vm;
 static NoctEnv *env;
 
+/* GC time budget per frame. */
+static int gc_budget_millisec = GC_BUDGET_DEFAULT;
+
+#if defined(DEBUG)
+/* Whether an incremental GC cycle was in progress at the last slice. */
+static bool is_gc_cycle_running;
+
+static void log_heap_stats(void);
+#endif
+
 /* Forward Declaration */
 static bool load_startup_file(void);
+static bool register_source(const char *file_name, const char *data, size_t size);
+#if defined(PF_USE_BYTECODE_CACHE)
+static bool load_bytecode_cache(const char *key, uint32_t hash, size_t size);
+static void save_bytecode_cache(const char *key, uint32_t hash, size_t size, uint8_t *bytecode, uint32_t bytecode_size);
+static uint32_t get_source_hash(const char *data, size_t size);
+#endif
+static void log_vm_error(void);
 static bool call_setup(char **title, int *width, int *height, bool *fullscreen);
 static bool serialize_printer(NoctEnv *env, char *buf, size_t size, NoctValue *value, bool is_inside_obj);
 static bool get_int_param(NoctEnv *env, const char *name, int *ret);
@@ -70,8 +102,6 @@ static bool get_float_param(NoctEnv *env, const char *name, float *ret);
 static bool get_string_param(NoctEnv *env, const char *name, const char **ret);
 static bool get_value_param(NoctEnv *env, const char *name, NoctValue *value);
 static bool get_dict_elem_int_param(NoctEnv *env, const char *name, const char *key, int *ret);
-static bool serialize_save_data(NoctEnv *env, NoctValue *value, void *data, size_t buf_size, size_t *ret);
-static bool deserialize_save_data(NoctEnv *env, NoctValue *value, void *data, size_t buf_size);
 static bool install_api(NoctEnv *env);
 
 /* External. */
@@ -151,20 +181,140 @@ static bool
 load_startup_file(void)
 {
 	char *buf;
+	size_t size;
 
 	/* Load a file content, i.e., a script text. */
-	if (!pfi_load_file(STARTUP_FILE, &buf, NULL))
+	if (!pfi_load_file(STARTUP_FILE, &buf, &size))
 		return false;
 
 	/* Register the script text to the language runtime. */
-	if (!noct_register_source(env, STARTUP_FILE, buf)) {
-		const char *file;
-		int line;
-		const char *msg;
-		noct_get_error_file(env, &file);
-		noct_get_error_line(env, &line);
-		noct_get_error_message(env, &msg);
-		hal_log_error(PF_TR("Error: %s:%d: %s"), file, line, msg);
+	if (!pfi_register_vm_script(STARTUP_FILE, buf, size)) {
+		free(buf);
+		return false;
+	}
+
+	free(buf);
+
+	return true;
+}
+
+/*
+ * Register a script file content, a source text or bytecode.
+ */
+bool
+pfi_register_vm_script(
+	const char *file_name,
+	const char *data,
+	size_t size)
+{
+	/* Check for the bytecode header. */
+	if (size >= strlen(BYTECODE_HEADER) &&
+	    strncmp(data, BYTECODE_HEADER, strlen(BYTECODE_HEADER)) == 0) {
+		/* It's a bytecode file. */
+		if (!noct_register_bytecode(env, (uint8_t *)data, (uint32_t)size)) {
+			log_vm_error();
+			return false;
+		}
+		return true;
+	}
+
+	/* It's a source file. */
+	if (!register_source(file_name, data, size)) {
+		log_vm_error();
+		return false;
+	}
+
+	return true;
+}
+
+#if !defined(PF_USE_BYTECODE_CACHE)
+
+/* Register a source text. */
+static bool
+register_source(
+	const char *file_name,
+	const char *data,
+	size_t size)
+{
+	UNUSED_PARAMETER(size);
+
+	return noct_register_source(env, file_name, data);
+}
+
+#else
+
+/* Register a source text, using the bytecode cache if it is valid. */
+static bool
+register_source(
+	const char *file_name,
+	const char *data,
+	size_t size)
+{
+	char key[256];
+	uint8_t *bytecode;
+	uint32_t hash, bytecode_size;
+
+	/* Make a cache key from the file name. */
+	if (strlen(file_name) + strlen(BYTECODE_CACHE_PREFIX) >= sizeof(key))
+		return noct_register_source(env, file_name, data);
+	snprintf(key, sizeof(key), "%s%s", BYTECODE_CACHE_PREFIX, file_name);
+
+	/* Use the cache if the source is not changed since it was written. */
+	hash = get_source_hash(data, size);
+	if (load_bytecode_cache(key, hash, size))
+		return true;
+
+	/* Compile the source, and get its bytecode. */
+	if (!noct_register_source_with_bytecode(env, file_name, data, &bytecode, &bytecode_size))
+		return false;
+
+	/* Write the cache for the next run. */
+	save_bytecode_cache(key, hash, size, bytecode, bytecode_size);
+	noct_free(bytecode);
+
+	return true;
+}
+
+/* Load bytecode from the cache. */
+static bool
+load_bytecode_cache(
+	const char *key,
+	uint32_t hash,
+	size_t size)
+{
+	char header[128];
+	char *buf;
+	size_t buf_size, header_size;
+
+	if (!pf_check_save_data(key))
+		return false;
+	if (!pf_get_save_data_size(key, &buf_size))
+		return false;
+
+	buf = malloc(buf_size + 1);
+	if (buf == NULL) {
+		hal_log_out_of_memory();
+		return false;
+	}
+	if (!pf_read_save_data(key, buf, buf_size, &buf_size)) {
+		free(buf);
+		return false;
+	}
+	buf[buf_size] = '\0';
+
+	/* Check the header, the bytecode version, the source hash, and the source size. */
+	snprintf(header, sizeof(header), "%s\n%d %08x %lu\n",
+		 BYTECODE_CACHE_HEADER, NOCT_BYTECODE_VERSION, hash, (unsigned long)size);
+	header_size = strlen(header);
+	if (buf_size <= header_size || strncmp(buf, header, header_size) != 0) {
+		free(buf);
+		return false;
+	}
+
+	/* Register the bytecode. Fallback to the source if failed. */
+	if (!noct_register_bytecode(env, (uint8_t *)buf + header_size,
+				    (uint32_t)(buf_size - header_size))) {
+		free(buf);
 		return false;
 	}
 
@@ -173,6 +323,71 @@ load_startup_file(void)
 	return true;
 }
 
+/* Write bytecode to the cache. */
+static void
+save_bytecode_cache(
+	const char *key,
+	uint32_t hash,
+	size_t size,
+	uint8_t *bytecode,
+	uint32_t bytecode_size)
+{
+	char header[128];
+	char *buf;
+	size_t header_size;
+
+	snprintf(header, sizeof(header), "%s\n%d %08x %lu\n",
+		 BYTECODE_CACHE_HEADER, NOCT_BYTECODE_VERSION, hash, (unsigned long)size);
+	header_size = strlen(header);
+
+	buf = malloc(header_size + bytecode_size);
+	if (buf == NULL) {
+		hal_log_out_of_memory();
+		return;
+	}
+	memcpy(buf, header, header_size);
+	memcpy(buf + header_size, bytecode, bytecode_size);
+
+	/* A failure is not fatal. */
+	pf_write_save_data(key, buf, header_size + bytecode_size);
+
+	free(buf);
+}
+
+/* Get the FNV-1a hash of a source text. */
+static uint32_t
+get_source_hash(
+	const char *data,
+	size_t size)
+{
+	uint32_t hash;
+	size_t i;
+
+	hash = 2166136261u;
+	for (i = 0; i < size; i++) {
+		hash ^= (uint32_t)(unsigned char)data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+#endif /* defined(PF_USE_BYTECODE_CACHE) */
+
+/* Print the last VM error. */
+static void
+log_vm_error(void)
+{
+	const char *file;
+	int line;
+	const char *msg;
+
+	noct_get_error_file(env, &file);
+	noct_get_error_line(env, &line);
+	noct_get_error_message(env, &msg);
+	hal_log_error(PF_TR("Error: %s:%d: %s"), file, line, msg);
+}
+
 /* Call "setup()" function to determin a title, width, and height. */
 static bool
 call_setup(
@@ -349,6 +564,72 @@ pfi_get_heap_usage(void)
 	return usage;
 }
 
+/*
+ * Get the free space statistics of the VM old generation heap.
+ */
+void
+pfi_get_heap_stats(
+	size_t *free_size,
+	size_t *largest_free_size,
+	size_t *free_count)
+{
+	noct_get_heap_stats(env, free_size, largest_free_size, free_count);
+}
+
+/*
+ * Set the time budget for the incremental GC per frame.
+ */
+void
+pfi_set_gc_budget(
+	int millisec)
+{
+	gc_budget_millisec = millisec;
+}
+
+/*
+ * Run the incremental GC within the time budget.
+ */
+void
+pfi_run_gc_slices(void)
+{
+	uint64_t origin;
+	bool is_running;
+
+	if (gc_budget_millisec <= 0)
+		return;
+
+	hal_reset_lap_timer(&origin);
+	do {
+		/* Run a slice, and stop if no cycle is in progress. */
+		is_running = noct_incremental_gc(env, GC_SLICE_STEPS);
+		if (!is_running)
+			break;
+	} while (hal_get_lap_timer_millisec(&origin) < (uint64_t)gc_budget_millisec);
+
+#if defined(DEBUG)
+	/* Log the heap when a cycle finishes. */
+	if (is_gc_cycle_running && !is_running)
+		log_heap_stats();
+	is_gc_cycle_running = is_running;
+#endif
+}
+
+#if defined(DEBUG)
+/* Log the heap usage and the fragmentation of the old generation. */
+static void
+log_heap_stats(void)
+{
+	size_t free_size, largest_free_size, free_count;
+
+	pfi_get_heap_stats(&free_size, &largest_free_size, &free_count);
+	hal_log_info("GC: heap %lu bytes, free %lu bytes in %lu blocks (largest %lu)",
+		     (unsigned long)pfi_get_heap_usage(),
+		     (unsigned long)free_size,
+		     (unsigned long)free_count,
+		     (unsigned long)largest_free_size);
+}
+#endif
+
 /*
  * Get the VM environment pointer.
  */
@@ -475,29 +756,10 @@ static bool import(NoctEnv *env)
 	if (!pfi_load_file(file_s, &data, &len))
 		return false;
 
-	/* Check for the bytecode header. */
-	if (strncmp(data, BYTECODE_HEADER, strlen(BYTECODE_HEADER)) != 0) {
-		/* It's a source file. */
-		if (!noct_register_source(env, file_s, data)) {
-			const char *file, *msg;
-			int line;
-			noct_get_error_file(env, &file);
-			noct_get_error_line(env, &line);
-			noct_get_error_message(env, &msg);
-			hal_log_error(PF_TR("Error: %s:%d: %s"), file, line, msg);
-			return false;
-		}
-	} else {
-		/* It's a bytecode file. */
-		if (!noct_register_bytecode(env, (void *)data, (uint32_t)len)) {
-			const char *file, *msg;
-			int line;
-			noct_get_error_file(env, &file);
-			noct_get_error_line(env, &line);
-			noct_get_error_message(env, &msg);
-			hal_log_error(PF_TR("Error: %s:%d: %s"), file, line, msg);
-			return false;
-		}
+	/* Register the source or bytecode. */
+	if (!pfi_register_vm_script(file_s, data, len)) {
+		free(data);
+		return false;
 	}
 
 	free(data);
@@ -920,31 +1182,14 @@ static bool Engine_writeSaveData(NoctEnv *env)
 {
 	const char *key;
 	NoctValue value;
-	void *data;
-	size_t size;
 
 	if (!get_string_param(env, "key", &key))
 		return false;
 	if (!get_value_param(env, "value", &value))
 		return false;
 
-	data = malloc(SERIALIZE_SIZE);
-	if (data == NULL) {
-		hal_log_out_of_memory();
-		return false;
-	}
-
-	if (!serialize_save_data(env, &value, data, SERIALIZE_SIZE, &size)) {
-		free(data);
-		return false;
-	}
-
-	if (!pf_write_save_data(key, data, size)) {
-		free(data);
+	if (!pfi_serialize_save_data(env, key, &value))
 		return false;
-	}
-
-	free(data);
 
 	return true;
 }
@@ -954,31 +1199,25 @@ static bool Engine_readSaveData(NoctEnv *env)
 {
 	const char *key;
 	NoctValue ret;
-	void *data;
-	size_t size;
 
 	if (!get_string_param(env, "key", &key))
 		return false;
 
-	data = malloc(SERIALIZE_SIZE);
-	if (data == NULL) {
-		hal_log_out_of_memory();
+	ret.type = NOCT_VALUE_INT;
+	if (!noct_pin_local(env, 1, &ret))
 		return false;
-	}
 
-	if (!pf_read_save_data(key, data, SERIALIZE_SIZE, &size)) {
-		free(data);
+	if (!pfi_deserialize_save_data(env, key, &ret)) {
+		noct_unpin_local(env, 1, &ret);
 		return false;
 	}
 
-	if (!deserialize_save_data(env, &ret, data, size)) {
-		free(data);
+	if (!noct_set_return(env, &ret)) {
+		noct_unpin_local(env, 1, &ret);
 		return false;
 	}
-	free(data);
 
-	if (!noct_set_return(env, &ret))
-		return false;
+	noct_unpin_local(env, 1, &ret);
 
 	return true;
 }
@@ -1206,374 +1445,3 @@ install_api(
 
 	return true;
 }
-
-/*
- * Noct Value Serialization
- */
-
-/* String Size Max */
-#define SER_STRING_MAX		4096
-
-/* Serialize Context */
-struct ser_ctx {
-	uint8_t *data;
-	size_t size;
-	size_t pos;
-	char sbuf[SER_STRING_MAX];
-};
-
-/* Value Type */
-enum {
-	SER_TYPE_INT,
-	SER_TYPE_FLOAT,
-	SER_TYPE_STRING,
-	SER_TYPE_ARRAY,
-	SER_TYPE_DICT,
-};
-
-/* Forward Declaration */
-static bool serialize_save_data_recursively(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
-static bool deserialize_save_data_recursively(NoctEnv *env, NoctValue *value, struct ser_ctx *ctx);
-static bool ser_put_u8(struct ser_ctx *ctx, uint8_t val);
-static bool ser_put_u32(struct ser_ctx *ctx, uint32_t val);
-static bool ser_put_string(struct ser_ctx *ctx, const char *val);
-static bool ser_get_u8(struct ser_ctx *ctx, uint8_t *val);
-static bool ser_get_u32(struct ser_ctx *ctx, uint32_t *val);
-static bool ser_get_string(struct ser_ctx *ctx, char **val);
-
-/* Serialize a value to a data buffer. */
-static bool
-serialize_save_data(
-	NoctEnv *env,
-	NoctValue *value,
-	void *data,
-	size_t buf_size,
-	size_t *ret)
-{
-	struct ser_ctx ctx;
-
-	ctx.data = (uint8_t *)data;
-	ctx.size = buf_size;
-	ctx.pos = 0;
-
-	if (!serialize_save_data_recursively(env, value, &ctx))
-		return false;
-
-	assert(ctx.pos <= ctx.size);
-
-	*ret = ctx.pos;
-
-	return true;
-}
-
-/* Serialize a value recursively. */
-static bool
-serialize_save_data_recursively(
-	NoctEnv *env,
-	NoctValue *value,
-	struct ser_ctx *ctx)
-{
-	int type;
-	int ival;
-	float fval;
-	const char *sval;
-	uint32_t i, size;
-
-	if (!noct_get_value_type(env, value, &type))
-		return false;
-
-	switch (type) {
-	case NOCT_VALUE_INT:
-		if (!noct_get_int(env, value, &ival))
-			return false;
-		if (!ser_put_u8(ctx, SER_TYPE_INT))
-			return false;
-		if (!ser_put_u32(ctx, (uint32_t)ival))
-			return false;
-		return true;
-	case NOCT_VALUE_FLOAT:
-		if (!noct_get_float(env, value, &fval))
-			return false;
-		ival = *(int *)&fval;
-		if (!ser_put_u8(ctx, SER_TYPE_FLOAT))
-			return false;
-		if (!ser_put_u32(ctx, (uint32_t)ival))
-			return false;
-		return true;
-	case NOCT_VALUE_STRING:
-		if (!noct_get_string(env, value, &sval))
-			return false;
-		if (!ser_put_u8(ctx, SER_TYPE_STRING))
-			return false;
-		if (!ser_put_string(ctx, sval))
-			return false;
-		return true;
-	case NOCT_VALUE_ARRAY:
-		if (!noct_get_array_size(env, value, &size))
-			return false;
-		if (!ser_put_u8(ctx, SER_TYPE_ARRAY))
-			return false;
-		if (!ser_put_u32(ctx, size))
-			return false;
-		for (i = 0; i < size; i++) {
-			NoctValue elem;
-			if (!noct_get_array_elem(env, value, i, &elem))
-				return false;
-			if (!serialize_save_data_recursively(env, &elem, ctx))
-				return false;
-		}
-		return true;
-	case NOCT_VALUE_DICT:
-		if (!noct_get_dict_size(env, value, &size))
-			return false;
-		if (!ser_put_u8(ctx, SER_TYPE_DICT))
-			return false;
-		if (!ser_put_u32(ctx, size))
-			return false;
-		for (i = 0; i < size; i++) {
-			NoctValue k, v;
-			if (!noct_get_dict_key_by_index(env, value, i, &k))
-				return false;
-			if (!noct_get_string(env, &k, &sval))
-				return false;
-			if (!ser_put_string(ctx, sval))
-				return false;
-			if (!noct_get_dict_value_by_index(env, value, i, &v))
-				return false;
-			if (!serialize_save_data_recursively(env, &v, ctx))
-				return false;
-		}
-		return true;
-	case NOCT_VALUE_FUNC:
-		hal_log_error(PF_TR("Cannot deserialize function."));
-		return false;
-	default:
-		assert(0);
-		break;
-	}
-	return false;
-}
-
-/* Deserialize a value from a data buffer. */
-static bool
-deserialize_save_data(
-	NoctEnv *env,
-	NoctValue *value,
-	void *data,
-	size_t buf_size)
-{
-	struct ser_ctx ctx;
-
-	ctx.data = (uint8_t *)data;
-	ctx.size = buf_size;
-	ctx.pos = 0;
-
-	if (!deserialize_save_data_recursively(env, value, &ctx))
-		return false;
-
-	assert(ctx.pos <= ctx.size);
-
-	return true;
-}
-
-/* Deserialize a value recursively. */
-static bool
-deserialize_save_data_recursively(
-	NoctEnv *env,
-	NoctValue *value,
-	struct ser_ctx *ctx)
-{
-	uint8_t type;
-	uint32_t ival;
-	float fval;
-	char *sval;
-	uint32_t i, size;
-
-	if (!ser_get_u8(ctx, &type))
-		return false;
-
-	switch (type) {
-	case SER_TYPE_INT:
-		if (!ser_get_u32(ctx, &ival))
-			return false;
-		if (!noct_make_int(env, value, (int)ival))
-			return false;
-		return true;
-	case SER_TYPE_FLOAT:
-		if (!ser_get_u32(ctx, &ival))
-			return false;
-		fval = *(float *)&ival;
-		if (!noct_make_float(env, value, fval))
-			return false;
-		return true;
-	case SER_TYPE_STRING:
-		if (!ser_get_string(ctx, &sval))
-			return false;
-		if (!noct_make_string(env, value, sval))
-			return false;
-		return true;
-	case SER_TYPE_ARRAY:
-		if (!ser_get_u32(ctx, (uint32_t *)&size))
-			return false;
-		if (!noct_make_empty_array(env, value))
-			return false;
-		if (!noct_resize_array(env, value, (uint32_t)size))
-			return false;
-		for (i = 0; i < size; i++) {
-			NoctValue elem;
-			if (!deserialize_save_data_recursively(env, &elem, ctx))
-				return false;
-			if (!noct_set_array_elem(env, value, i, &elem))
-				return false;
-		}
-		return true;
-	case SER_TYPE_DICT:
-		if (!ser_get_u32(ctx, (uint32_t *)&size))
-			return false;
-		if (!noct_make_empty_dict(env, value))
-			return false;
-		for (i = 0; i < size; i++) {
-			NoctValue elem;
-			char key[SER_STRING_MAX];
-			if (!ser_get_string(ctx, &sval))
-				return false;
-			strcpy(key, sval);
-			if (!deserialize_save_data_recursively(env, &elem, ctx))
-				return false;
-			if (!noct_set_dict_elem(env, value, key, &elem))
-				return false;
-		}
-		return true;
-	default:
-		hal_log_error(PF_TR("Invalid save data."));
-		return false;
-	}
-	return false;
-}
-
-/* Put a u8 to the data buffer. */
-static bool
-ser_put_u8(
-	struct ser_ctx *ctx,
-	uint8_t val)
-{
-	if (ctx->pos + 1 > ctx->size)
-		return false;
-
-	ctx->data[ctx->pos] = val;
-	ctx->pos++;
-
-	return true;
-}
-
-/* Put a u32 to the data buffer. */
-static bool
-ser_put_u32(
-	struct ser_ctx *ctx,
-	uint32_t val)
-{
-	if (ctx->pos + 4 > ctx->size)
-		return false;
-
-	ctx->data[ctx->pos + 0] = (uint8_t)(val & 0xff);
-	ctx->data[ctx->pos + 1] = (uint8_t)((val >> 8) & 0xff);
-	ctx->data[ctx->pos + 2] = (uint8_t)((val >> 16) & 0xff);
-	ctx->data[ctx->pos + 3] = (uint8_t)((val >> 24) & 0xff);
-
-	ctx->pos += 4;
-
-	return true;
-}
-
-/* Put a string to the data buffer. */
-static bool
-ser_put_string(
-	struct ser_ctx *ctx,
-	const char *val)
-{
-	size_t len;
-
-	len = strlen(val);
-	if (len > SER_STRING_MAX) {
-		hal_log_error(PF_TR("String too long."));
-		return false;
-	}
-
-	if (ctx->pos + 4 + len > ctx->size)
-		return false;
-
-	ctx->data[ctx->pos + 0] = (uint8_t)(len & 0xff);
-	ctx->data[ctx->pos + 1] = (uint8_t)((len >> 8) & 0xff);
-	ctx->data[ctx->pos + 2] = (uint8_t)((len >> 16) & 0xff);
-	ctx->data[ctx->pos + 3] = (uint8_t)((len >> 24) & 0xff);
-	ctx->pos += 4;
-
-	memcpy(ctx->data + ctx->pos, val, len);
-	ctx->pos += len;
-
-	return true;
-}
-
-/* Get a u8 from the data buffer. */
-static bool
-ser_get_u8(
-	struct ser_ctx *ctx,
-	uint8_t *val)
-{
-	if (ctx->pos + 1 > ctx->size)
-		return false;
-
-	*val = ctx->data[ctx->pos];
-	ctx->pos++;
-
-	return true;
-}
-
-/* Get a u32 from the data buffer. */
-static bool
-ser_get_u32(
-	struct ser_ctx *ctx,
-	uint32_t *val)
-{
-	if (ctx->pos + 4 > ctx->size)
-		return false;
-
-	*val = ((uint32_t)ctx->data[ctx->pos + 0]) |
-		((uint32_t)ctx->data[ctx->pos + 1] << 8) |
-		((uint32_t)ctx->data[ctx->pos + 2] << 16) |
-		((uint32_t)ctx->data[ctx->pos + 3] << 24);
-	ctx->pos += 4;
-
-	return true;
-}
-
-/* Get a string from the data buffer. */
-static bool
-ser_get_string(
-	struct ser_ctx *ctx,
-	char **val)
-{
-	uint32_t len;
-
-	if (ctx->pos + 4 > ctx->size)
-		return false;
-
-	len = ((uint32_t)ctx->data[ctx->pos + 0]) |
-		((uint32_t)ctx->data[ctx->pos + 1] << 8) |
-		((uint32_t)ctx->data[ctx->pos + 2] << 16) |
-		((uint32_t)ctx->data[ctx->pos + 3] << 24);
-	ctx->pos += 4;
-
-	if (len >= SER_STRING_MAX) {
-		hal_log_error(PF_TR("String too long."));
-		return false;
-	}
-
-	memcpy(ctx->sbuf, ctx->data + ctx->pos, len);
-	ctx->sbuf[len] = '\0';
-	ctx->pos += len;
-
-	*val = ctx->sbuf;
-
-	return true;
-}
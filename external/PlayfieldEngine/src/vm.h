@@ -52,6 +52,16 @@ pfi_create_vm(
 void
 pfi_destroy_vm(void);
 
+/*
+ * Register a script file content, a source text or bytecode.
+ *  - A source text is compiled through the bytecode cache if enabled.
+ */
+bool
+pfi_register_vm_script(
+	const char *file_name,
+	const char *data,
+	size_t size);
+
 /*
  * Call a NoctLang function in the VM.
  */
@@ -88,6 +98,17 @@ pfi_get_vm_int(
 size_t
 pfi_get_heap_usage(void);
 
+/*
+ * Get the free space statistics of the VM old generation heap.
+ * A large gap between the free size and the largest free size
+ * indicates fragmentation.
+ */
+void
+pfi_get_heap_stats(
+	size_t *free_size,
+	size_t *largest_free_size,
+	size_t *free_count);
+
 /*
  * Perform a fast garbage collection in the VM.
  */
@@ -100,6 +121,19 @@ pfi_fast_gc(void);
 void
 pfi_full_gc(void);
 
+/*
+ * Set the time budget for the incremental GC per frame.
+ */
+void
+pfi_set_gc_budget(
+	int millisec);
+
+/*
+ * Run the incremental GC within the time budget.
+ */
+void
+pfi_run_gc_slices(void);
+
 /*
  * Get the VM environment pointer.
  */
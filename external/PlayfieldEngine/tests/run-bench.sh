@@ -0,0 +1,21 @@
+#!/bin/sh
+
+# Build NoctLang in ../external/NoctLang/build first.
+
+set -eu
+
+echo 'Playfield Engine Benchmarks'
+echo
+
+cc -O2 -I../include -I../external/NoctLang/include -I../external/StratoHAL/include \
+   -o savedata-test savedata-test.c ../src/savedata.c \
+   ../external/NoctLang/build/libnoct.a -lm -lpthread
+
+for tc in bench/*.noct; do
+    echo "$tc";
+    rm -rf save;
+    mkdir save;
+    ./savedata-test $tc save;
+    echo;
+done
+rm -rf save savedata-test
@@ -0,0 +1,23 @@
+#!/bin/sh
+
+# Build NoctLang in ../external/NoctLang/build first.
+
+set -eu
+
+echo 'Playfield Engine Tests'
+echo
+
+cc -O2 -I../include -I../external/NoctLang/include -I../external/StratoHAL/include \
+   -o savedata-test savedata-test.c ../src/savedata.c \
+   ../external/NoctLang/build/libnoct.a -lm -lpthread
+
+echo 'Running save data tests...'
+for tc in savedata/*.noct; do
+    echo "$tc";
+    rm -rf save;
+    mkdir save;
+    ./savedata-test $tc save > out || true;
+    diff $tc.out out;
+done
+rm -rf save out savedata-test
+echo 'All tests passed.'
@@ -0,0 +1,699 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Playfield Engine
+ * Save data serialization test driver
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Playfield Engine
+ * Copyright (c) 2025-2026 Awe Morris
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Usage: savedata-test <script.noct> <save dir>
+ *
+ * This runs a script with the functions below. The serializer in
+ * src/savedata.c is linked as is, and the HAL file API is provided here
+ * on top of stdio.
+ *
+ *  save(key, value)       Write save data. Returns 1, or 0 on failure.
+ *  load(key)              Read save data. Returns -1 on failure.
+ *  oldsave(key, value)    Write save data in the legacy format.
+ *  eq(a, b)               Compare two values deeply. Returns 1 or 0.
+ *  cut(src, dst, size)    Copy the first size bytes of a save file.
+ *  poke(src, dst, pos, b) Copy a save file with the byte at pos replaced.
+ *  filesize(key)          Get the size of a save file.
+ *  ms()                   Get the milliseconds since the start.
+ *  print(s)               Print a string or an integer.
+ */
+
+#include "../src/savedata.h"
+
+/* NoctLang */
+#include <noct/noct.h>
+
+/* Standard C */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+/* Legacy Format Type */
+enum {
+	LEGACY_TYPE_INT,
+	LEGACY_TYPE_FLOAT,
+	LEGACY_TYPE_STRING,
+	LEGACY_TYPE_ARRAY,
+	LEGACY_TYPE_DICT
+};
+
+/* HAL File Streams */
+struct hal_rfile {
+	FILE *fp;
+};
+struct hal_wfile {
+	FILE *fp;
+};
+
+static const char *save_dir;
+static struct timespec start_time;
+
+static bool write_legacy(NoctEnv *env, FILE *fp, NoctValue *value);
+static void put_legacy_u32(FILE *fp, uint32_t val);
+static bool is_equal(NoctEnv *env, NoctValue *a, NoctValue *b);
+static void make_path(const char *key, char *path, size_t size);
+static bool return_int(NoctEnv *env, int i);
+
+/*
+ * HAL
+ */
+
+bool
+hal_log_error(
+	const char *s,
+	...)
+{
+	/* The tests check the results, so the messages are not printed. */
+	(void)s;
+	return true;
+}
+
+bool
+hal_log_out_of_memory(void)
+{
+	printf("Out of memory.\n");
+	return true;
+}
+
+bool
+hal_get_rfile_size(
+	struct hal_rfile *rf,
+	size_t *ret)
+{
+	long pos, size;
+
+	pos = ftell(rf->fp);
+	fseek(rf->fp, 0, SEEK_END);
+	size = ftell(rf->fp);
+	fseek(rf->fp, pos, SEEK_SET);
+	*ret = (size_t)size;
+
+	return true;
+}
+
+bool
+hal_read_rfile(
+	struct hal_rfile *rf,
+	void *buf,
+	size_t size,
+	size_t *ret)
+{
+	*ret = fread(buf, 1, size, rf->fp);
+	return *ret > 0;
+}
+
+void
+hal_close_rfile(
+	struct hal_rfile *rf)
+{
+	fclose(rf->fp);
+	free(rf);
+}
+
+bool
+hal_write_wfile(
+	struct hal_wfile *wf,
+	const void *buf,
+	size_t size,
+	size_t *ret)
+{
+	*ret = fwrite(buf, 1, size, wf->fp);
+	return *ret == size;
+}
+
+void
+hal_close_wfile(
+	struct hal_wfile *wf)
+{
+	fclose(wf->fp);
+	free(wf);
+}
+
+bool
+pfi_open_save_wfile(
+	const char *key,
+	struct hal_wfile **wf)
+{
+	char path[1024];
+
+	make_path(key, path, sizeof(path));
+	*wf = malloc(sizeof(struct hal_wfile));
+	if (*wf == NULL)
+		return false;
+	(*wf)->fp = fopen(path, "wb");
+	if ((*wf)->fp == NULL) {
+		free(*wf);
+		return false;
+	}
+
+	return true;
+}
+
+bool
+pfi_open_save_rfile(
+	const char *key,
+	struct hal_rfile **rf)
+{
+	char path[1024];
+
+	make_path(key, path, sizeof(path));
+	*rf = malloc(sizeof(struct hal_rfile));
+	if (*rf == NULL)
+		return false;
+	(*rf)->fp = fopen(path, "rb");
+	if ((*rf)->fp == NULL) {
+		free(*rf);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Script Functions
+ */
+
+/* save(key, value) */
+static bool
+cfunc_save(
+	NoctEnv *env)
+{
+	NoctValue key, value;
+	const char *s;
+
+	if (!noct_get_arg(env, 0, &key) ||
+	    !noct_get_arg(env, 1, &value) ||
+	    !noct_get_string(env, &key, &s))
+		return false;
+
+	return return_int(env, pfi_serialize_save_data(env, s, &value) ? 1 : 0);
+}
+
+/* load(key) */
+static bool
+cfunc_load(
+	NoctEnv *env)
+{
+	NoctValue key, ret;
+	const char *s;
+	char buf[256];
+
+	if (!noct_get_arg(env, 0, &key) ||
+	    !noct_get_string(env, &key, &s))
+		return false;
+	snprintf(buf, sizeof(buf), "%s", s);
+
+	ret.type = NOCT_VALUE_INT;
+	if (!noct_pin_local(env, 1, &ret))
+		return false;
+	if (!pfi_deserialize_save_data(env, buf, &ret)) {
+		if (!noct_make_int(env, &ret, -1))
+			return false;
+	}
+	if (!noct_set_return(env, &ret))
+		return false;
+	noct_unpin_local(env, 1, &ret);
+
+	return true;
+}
+
+/* oldsave(key, value) */
+static bool
+cfunc_oldsave(
+	NoctEnv *env)
+{
+	NoctValue key, value;
+	const char *s;
+	char path[1024];
+	FILE *fp;
+	bool ret;
+
+	if (!noct_get_arg(env, 0, &key) ||
+	    !noct_get_arg(env, 1, &value) ||
+	    !noct_get_string(env, &key, &s))
+		return false;
+
+	make_path(s, path, sizeof(path));
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+		return return_int(env, 0);
+	ret = write_legacy(env, fp, &value);
+	fclose(fp);
+
+	return return_int(env, ret ? 1 : 0);
+}
+
+/* eq(a, b) */
+static bool
+cfunc_eq(
+	NoctEnv *env)
+{
+	NoctValue a, b;
+
+	if (!noct_get_arg(env, 0, &a) ||
+	    !noct_get_arg(env, 1, &b))
+		return false;
+
+	return return_int(env, is_equal(env, &a, &b) ? 1 : 0);
+}
+
+/* Copy a save file with a change. */
+static bool
+copy_file(
+	NoctEnv *env,
+	int size,
+	int pos,
+	int byte)
+{
+	NoctValue src, dst;
+	const char *s;
+	char path[1024];
+	FILE *fp;
+	uint8_t *buf;
+	size_t len;
+	long file_size;
+
+	if (!noct_get_arg(env, 0, &src) ||
+	    !noct_get_arg(env, 1, &dst) ||
+	    !noct_get_string(env, &src, &s))
+		return false;
+
+	make_path(s, path, sizeof(path));
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return return_int(env, 0);
+	fseek(fp, 0, SEEK_END);
+	file_size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = malloc((size_t)file_size + 1);
+	if (buf == NULL) {
+		fclose(fp);
+		return false;
+	}
+	len = fread(buf, 1, (size_t)file_size, fp);
+	fclose(fp);
+
+	if (size >= 0 && (size_t)size < len)
+		len = (size_t)size;
+	if (pos >= 0 && (size_t)pos < len)
+		buf[pos] = (uint8_t)byte;
+
+	if (!noct_get_string(env, &dst, &s)) {
+		free(buf);
+		return false;
+	}
+	make_path(s, path, sizeof(path));
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		free(buf);
+		return return_int(env, 0);
+	}
+	fwrite(buf, 1, len, fp);
+	fclose(fp);
+	free(buf);
+
+	return return_int(env, 1);
+}
+
+/* cut(src, dst, size) */
+static bool
+cfunc_cut(
+	NoctEnv *env)
+{
+	NoctValue tmp;
+	int size;
+
+	if (!noct_get_arg_check_int(env, 2, &tmp, &size))
+		return false;
+
+	return copy_file(env, size, -1, 0);
+}
+
+/* poke(src, dst, pos, byte) */
+static bool
+cfunc_poke(
+	NoctEnv *env)
+{
+	NoctValue tmp;
+	int pos, byte;
+
+	if (!noct_get_arg_check_int(env, 2, &tmp, &pos) ||
+	    !noct_get_arg_check_int(env, 3, &tmp, &byte))
+		return false;
+
+	return copy_file(env, -1, pos, byte);
+}
+
+/* filesize(key) */
+static bool
+cfunc_filesize(
+	NoctEnv *env)
+{
+	NoctValue key;
+	const char *s;
+	char path[1024];
+	FILE *fp;
+	long size;
+
+	if (!noct_get_arg(env, 0, &key) ||
+	    !noct_get_string(env, &key, &s))
+		return false;
+
+	make_path(s, path, sizeof(path));
+	fp = fopen(path, "rb");
+	if (fp == NULL)
+		return return_int(env, -1);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fclose(fp);
+
+	return return_int(env, (int)size);
+}
+
+/* ms() */
+static bool
+cfunc_ms(
+	NoctEnv *env)
+{
+	struct timespec ts;
+	long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ms = (long)(ts.tv_sec - start_time.tv_sec) * 1000 +
+	     (ts.tv_nsec - start_time.tv_nsec) / 1000000;
+
+	return return_int(env, (int)ms);
+}
+
+/* print(s) */
+static bool
+cfunc_print(
+	NoctEnv *env)
+{
+	NoctValue value;
+	const char *s;
+	int type, i;
+
+	if (!noct_get_arg(env, 0, &value) ||
+	    !noct_get_value_type(env, &value, &type))
+		return false;
+
+	if (type == NOCT_VALUE_STRING) {
+		if (!noct_get_string(env, &value, &s))
+			return false;
+		printf("%s\n", s);
+	} else if (type == NOCT_VALUE_INT) {
+		if (!noct_get_int(env, &value, &i))
+			return false;
+		printf("%d\n", i);
+	}
+
+	return true;
+}
+
+/*
+ * Helpers
+ */
+
+/* Write a value in the legacy format. (The old writer did the same.) */
+static bool
+write_legacy(
+	NoctEnv *env,
+	FILE *fp,
+	NoctValue *value)
+{
+	NoctValue k, v;
+	const char *s;
+	uint32_t i, size, cursor;
+	int type, ival;
+	float fval;
+
+	if (!noct_get_value_type(env, value, &type))
+		return false;
+
+	switch (type) {
+	case NOCT_VALUE_INT:
+		if (!noct_get_int(env, value, &ival))
+			return false;
+		fputc(LEGACY_TYPE_INT, fp);
+		put_legacy_u32(fp, (uint32_t)ival);
+		return true;
+	case NOCT_VALUE_FLOAT:
+		if (!noct_get_float(env, value, &fval))
+			return false;
+		memcpy(&ival, &fval, 4);
+		fputc(LEGACY_TYPE_FLOAT, fp);
+		put_legacy_u32(fp, (uint32_t)ival);
+		return true;
+	case NOCT_VALUE_STRING:
+		if (!noct_get_string(env, value, &s))
+			return false;
+		fputc(LEGACY_TYPE_STRING, fp);
+		put_legacy_u32(fp, (uint32_t)strlen(s));
+		fwrite(s, 1, strlen(s), fp);
+		return true;
+	case NOCT_VALUE_ARRAY:
+		if (!noct_get_array_size(env, value, &size))
+			return false;
+		fputc(LEGACY_TYPE_ARRAY, fp);
+		put_legacy_u32(fp, size);
+		for (i = 0; i < size; i++) {
+			if (!noct_get_array_elem(env, value, i, &v))
+				return false;
+			if (!write_legacy(env, fp, &v))
+				return false;
+		}
+		return true;
+	case NOCT_VALUE_DICT:
+		if (!noct_get_dict_size(env, value, &size))
+			return false;
+		fputc(LEGACY_TYPE_DICT, fp);
+		put_legacy_u32(fp, size);
+		cursor = 0;
+		for (i = 0; i < size; i++) {
+			if (!noct_get_dict_elem_by_cursor(env, value, &cursor, &k, &v))
+				return false;
+			if (!noct_get_string(env, &k, &s))
+				return false;
+			put_legacy_u32(fp, (uint32_t)strlen(s));
+			fwrite(s, 1, strlen(s), fp);
+			if (!write_legacy(env, fp, &v))
+				return false;
+		}
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static void
+put_legacy_u32(
+	FILE *fp,
+	uint32_t val)
+{
+	fputc((int)(val & 0xff), fp);
+	fputc((int)((val >> 8) & 0xff), fp);
+	fputc((int)((val >> 16) & 0xff), fp);
+	fputc((int)((val >> 24) & 0xff), fp);
+}
+
+/* Compare two values deeply. Floats are compared by bits. */
+static bool
+is_equal(
+	NoctEnv *env,
+	NoctValue *a,
+	NoctValue *b)
+{
+	NoctValue k, x, y;
+	const char *sa, *sb;
+	uint32_t i, size_a, size_b, cursor;
+	int type_a, type_b, ia, ib;
+	float fa, fb;
+	bool has_key;
+
+	if (!noct_get_value_type(env, a, &type_a) ||
+	    !noct_get_value_type(env, b, &type_b))
+		return false;
+	if (type_a != type_b)
+		return false;
+
+	switch (type_a) {
+	case NOCT_VALUE_INT:
+		noct_get_int(env, a, &ia);
+		noct_get_int(env, b, &ib);
+		return ia == ib;
+	case NOCT_VALUE_FLOAT:
+		noct_get_float(env, a, &fa);
+		noct_get_float(env, b, &fb);
+		return memcmp(&fa, &fb, sizeof(float)) == 0;
+	case NOCT_VALUE_STRING:
+		noct_get_string(env, a, &sa);
+		noct_get_string(env, b, &sb);
+		return strcmp(sa, sb) == 0;
+	case NOCT_VALUE_ARRAY:
+		noct_get_array_size(env, a, &size_a);
+		noct_get_array_size(env, b, &size_b);
+		if (size_a != size_b)
+			return false;
+		for (i = 0; i < size_a; i++) {
+			if (!noct_get_array_elem(env, a, i, &x) ||
+			    !noct_get_array_elem(env, b, i, &y))
+				return false;
+			if (!is_equal(env, &x, &y))
+				return false;
+		}
+		return true;
+	case NOCT_VALUE_DICT:
+		noct_get_dict_size(env, a, &size_a);
+		noct_get_dict_size(env, b, &size_b);
+		if (size_a != size_b)
+			return false;
+		cursor = 0;
+		for (i = 0; i < size_a; i++) {
+			if (!noct_get_dict_elem_by_cursor(env, a, &cursor, &k, &x))
+				return false;
+			if (!noct_get_string(env, &k, &sa))
+				return false;
+			if (!noct_check_dict_key(env, b, sa, &has_key) || !has_key)
+				return false;
+			if (!noct_get_dict_elem(env, b, sa, &y))
+				return false;
+			if (!is_equal(env, &x, &y))
+				return false;
+		}
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static void
+make_path(
+	const char *key,
+	char *path,
+	size_t size)
+{
+	snprintf(path, size, "%s/%s.sav", save_dir, key);
+}
+
+static bool
+return_int(
+	NoctEnv *env,
+	int i)
+{
+	NoctValue ret;
+
+	if (!noct_make_int(env, &ret, i))
+		return false;
+	if (!noct_set_return(env, &ret))
+		return false;
+
+	return true;
+}
+
+/*
+ * Main
+ */
+
+int
+main(
+	int argc,
+	char *argv[])
+{
+	static const char *p0[] = { NULL };
+	static const char *p1[] = { "a" };
+	static const char *p2[] = { "a", "b" };
+	static const char *p3[] = { "a", "b", "c" };
+	static const char *p4[] = { "a", "b", "c", "d" };
+	NoctVM *vm;
+	NoctEnv *env;
+	NoctValue ret;
+	FILE *fp;
+	char *src;
+	const char *msg;
+	long size;
+	int line;
+
+	if (argc != 3) {
+		printf("Usage: savedata-test <script.noct> <save dir>\n");
+		return 1;
+	}
+	save_dir = argv[2];
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	/* Read the script. */
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		printf("Cannot open %s\n", argv[1]);
+		return 1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	src = calloc(1, (size_t)size + 1);
+	if (src == NULL || fread(src, 1, (size_t)size, fp) != (size_t)size) {
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	/* Run. */
+	if (!noct_create_vm(&vm, &env, NULL))
+		return 1;
+	if (!noct_register_cfunc(env, "save", 2, p2, cfunc_save, NULL) ||
+	    !noct_register_cfunc(env, "load", 1, p1, cfunc_load, NULL) ||
+	    !noct_register_cfunc(env, "oldsave", 2, p2, cfunc_oldsave, NULL) ||
+	    !noct_register_cfunc(env, "eq", 2, p2, cfunc_eq, NULL) ||
+	    !noct_register_cfunc(env, "cut", 3, p3, cfunc_cut, NULL) ||
+	    !noct_register_cfunc(env, "poke", 4, p4, cfunc_poke, NULL) ||
+	    !noct_register_cfunc(env, "filesize", 1, p1, cfunc_filesize, NULL) ||
+	    !noct_register_cfunc(env, "ms", 0, p0, cfunc_ms, NULL) ||
+	    !noct_register_cfunc(env, "print", 1, p1, cfunc_print, NULL))
+		return 1;
+	if (!noct_register_source(env, argv[1], src) ||
+	    !noct_enter_vm(env, "main", 0, NULL, &ret)) {
+		noct_get_error_line(env, &line);
+		noct_get_error_message(env, &msg);
+		printf("%s:%d: %s\n", argv[1], line, msg);
+		return 1;
+	}
+
+	noct_destroy_vm(vm);
+	free(src);
+
+	return 0;
+}
@@ -1915,6 +1915,13 @@ s3_set_mixer_input_file(
 	const char *file,
 	bool is_looped);
 
+/*
+ * Decode a short sound file in advance.
+ */
+bool
+s3_preload_mixer_file(
+	const char *file);
+
 /*
  * Set the volume for a mixer track.
  */
@@ -2519,11 +2526,21 @@ s3_get_save_last_message(
 
 /*
  * Get the thumbnail of a save data.
+ *  - A thumbnail is loaded from the save file on the first call.
  */
 struct s3_image *
 s3_get_save_thumbnail(
 	int index);
 
+/*
+ * Release the thumbnails out of a slot range.
+ *  - Call with the slots on screen, or with (0, 0) to release all.
+ */
+void
+s3_cache_save_thumbnails(
+	int start,
+	int count);
+
 
 /*
  * Functions for History Subsystem (history.c)
@@ -2733,6 +2750,22 @@ s3_write_save_data(
 	const void *data,
 	size_t size);
 
+/*
+ * Write save data in the background.
+ *  - The engine takes the ownership of data and frees it.
+ */
+bool
+s3_write_save_data_async(
+	const char *key,
+	void *data,
+	size_t size);
+
+/*
+ * Wait for the background writes of save data.
+ */
+bool
+s3_flush_save_data(void);
+
 /*
  * Read save data.
  */
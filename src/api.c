@@ -32,6 +32,7 @@
 #include <noct/noct.h>
 #include "game.h"
 #include "image.h"
+#include "stage.h"
 #include "text.h"
 
 #include <stdio.h>
@@ -1173,19 +1174,10 @@ Suika_loadPlugin(
 	if (!s3_read_file_content(path, &data, &len))
 		return false;
 
-	/* Check for the bytecode header. */
-	if (strncmp(data, NOCT_BYTECODE_HEADER, strlen(NOCT_BYTECODE_HEADER)) != 0) {
-		/* It's a source file. */
-		if (!noct_register_source(env, path, data)) {
-			free(data);
-			return false;
-		}
-	} else {
-		/* It's a bytecode file. */
-		if (!noct_register_bytecode(env, (void *)data, (uint32_t)len)) {
-			free(data);
-			return false;
-		}
+	/* Register the source or bytecode. (may be cached) */
+	if (!pf_register_vm_script(path, data, len)) {
+		free(data);
+		return false;
 	}
 	free(data);
 
@@ -5309,6 +5301,9 @@ Suika_renderImage(
 				alpha,
 				blend);
 
+		/* Direct rendering is not tracked: keep rendering. */
+		s3i_notify_direct_render();
+
 		/* Set the return value. */
 		if (!pf_set_return_int(1))
 			break;
@@ -5384,6 +5379,9 @@ Suika_renderImage3d(
 				   alpha,
 				   blend);
 
+		/* Direct rendering is not tracked: keep rendering. */
+		s3i_notify_direct_render();
+
 		/* Set the return value. */
 		if (!pf_set_return_int(1))
 			break;
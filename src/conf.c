@@ -425,6 +425,7 @@ float conf_sound_vol_bgm;
 float conf_sound_vol_voice;
 float conf_sound_vol_se;
 float conf_sound_vol_per_character;
+int conf_sound_polyphony_se;
 
 /*
  * Character Settings
@@ -870,6 +871,9 @@ static struct rule {
 	{'f',	"sound.vol.se",			&conf_sound_vol_se,			MUST,	NOSAVE,	GLOBAL},
 	{'f',	"sound.vol.per_character",	&conf_sound_vol_per_character,		MUST,	NOSAVE,	GLOBAL},
 
+	/* Polyphony (no need to save) */
+	{'i',	"sound.polyphony.se",		&conf_sound_polyphony_se,		OPTIONAL, NOSAVE,	GLOBAL},
+
 	/* Character */
 	{'f',	"character.eyeblink.interval",	&conf_character_eyeblink_interval,	MUST,	NOSAVE,	GLOBAL},
 	{'f',	"character.eyeblink.frame",	&conf_character_eyeblink_frame,		MUST,	NOSAVE, GLOBAL},
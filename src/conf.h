@@ -413,6 +413,9 @@ extern float conf_sound_vol_voice;
 extern float conf_sound_vol_se;
 extern float conf_sound_vol_per_character;
 
+/* Number of the SE sounds that play at the same time. */
+extern int conf_sound_polyphony_se;
+
 /*
  * Character Settings
  */
@@ -164,6 +164,7 @@ bool init_aot_code(struct rt_env *env);
 
 /* Forward declaration. */
 bool pf_init_hook(int width, int height);
+static bool check_render_hook(void);
 
 /*
  * Entrypoint.
@@ -194,9 +195,21 @@ pf_init_hook(
 	if (!s3i_install_tag_funcs())
 		return false;
 
+	/* Skip rendering while the stage is unchanged. */
+	pf_check_render_hook_ptr = check_render_hook;
+
 	return true;
 }
 
+/*
+ * Called before a frame is rendered.
+ */
+static bool
+check_render_hook(void)
+{
+	return s3i_is_stage_render_needed();
+}
+
 /*
  * Called when the game starts.
  */
@@ -300,6 +313,10 @@ s3i_on_game_update(void)
 	bool tag_end;
 	const char *tag_name;
 
+	/* Render the frame on a mouse move. (for hover effects) */
+	if (pf_mouse_pos_x != mouse_pos_x || pf_mouse_pos_y != mouse_pos_y)
+		s3i_update_stage_generation();
+
 	mouse_pos_x = pf_mouse_pos_x;
 	mouse_pos_y = pf_mouse_pos_y;
 	is_mouse_left_pressed = pf_is_mouse_left_pressed;
@@ -320,6 +337,17 @@ s3i_on_game_update(void)
 	is_touch_canceled = pf_is_touch_canceled;
 	is_swiped = pf_is_swiped;
 
+	/* Render the frame on other inputs. */
+	if (is_mouse_left_pressed || is_mouse_right_pressed ||
+	    is_mouse_left_clicked || is_mouse_right_clicked ||
+	    is_mouse_dragging || is_space_key_pressed ||
+	    is_return_key_pressed || is_escape_key_pressed ||
+	    is_up_key_pressed || is_down_key_pressed ||
+	    is_left_key_pressed || is_right_key_pressed ||
+	    is_s_key_pressed || is_l_key_pressed || is_h_key_pressed ||
+	    is_touch_canceled || is_swiped)
+		s3i_update_stage_generation();
+
 	/* Start Kirakira effect. */
 	if (is_mouse_left_clicked || is_mouse_right_clicked)
 		s3i_start_kirakira(mouse_pos_x, mouse_pos_y);
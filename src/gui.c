@@ -140,6 +140,34 @@ enum save_text_type {
 #define DRAG_TICK_INTERVAL (20)
 #endif
 
+/* Maximum draw calls cached for a button. (bar and knob for a slider) */
+#define BUTTON_BLITS (2)
+
+/* A draw call resolved from the layer parameters. */
+struct gui_blit {
+	/* Source image. */
+	struct s3_image *img;
+
+	/* Is rotated or scaled? */
+	bool is_3d;
+
+	/* Destination vertices. (only [0] is used for 2D) */
+	float x[4];
+	float y[4];
+
+	/* Destination size for 2D. */
+	int dst_width;
+	int dst_height;
+
+	/* Source size. */
+	int src_width;
+	int src_height;
+
+	/* Layer alpha and blend. (multiplied by the GUI alpha at rendering) */
+	int alpha;
+	int blend;
+};
+
 /* Button. */
 struct gui_button {
 	bool is_initialized;
@@ -291,6 +319,20 @@ struct gui_button {
 
 		/* Stopwatch for message showing and auto mode wait. */
 		uint64_t sw;
+
+		/*
+		 * Render cache.
+		 */
+
+		/* Need to rebuild the cached draw calls? */
+		bool is_dirty;
+
+		/* Was an anime running on the previous render? */
+		bool is_animating;
+
+		/* Cached draw calls. */
+		struct gui_blit blit[BUTTON_BLITS];
+		int blit_count;
 	} rt;
 };
 static struct gui_button button[S3_BUTTON_LAYERS];
@@ -388,6 +430,9 @@ static bool is_fading_in;
 /* Is fading out? */
 static bool is_fading_out;
 
+/* Was the previous render done during a fade? */
+static bool was_fading;
+
 /* Stopwatch for fade. */
 static uint64_t fade_sw;
 
@@ -441,15 +486,18 @@ static bool process_button_point(int index, bool key);
 static bool process_button_drag(int index);
 static float calc_slider_value(int index);
 static bool process_button_click(int index);
+static void invalidate_button(int index);
+static void invalidate_all_buttons(void);
+static void process_button_compose(int index);
+static void process_button_compose_slider(int index);
+static void process_button_compose_slider_vertical(int index);
+static void process_button_compose_generic(int index);
+static void process_button_compose_language(int index);
+static void process_button_compose_var(int index);
+static void process_button_compose_preview(int index);
+static void process_button_compose_save(int index);
+static void process_button_compose_page(int index);
 static void process_button_render(int index);
-static void process_button_render_slider(int index);
-static void process_button_render_slider_vertical(int index);
-static void process_button_render_generic(int index);
-static void process_button_render_language(int index);
-static void process_button_render_var(int index);
-static void process_button_render_preview(int index);
-static void process_button_render_save(int index);
-static void process_button_render_page(int index);
 static bool init_save_buttons(void);
 static void update_save_buttons(void);
 static void draw_save_button(int button_index);
@@ -463,7 +511,7 @@ static void draw_history_buttons(void);
 static void draw_history_button(struct s3_image *target, struct s3_image *source, int index);
 static void draw_history_name_item(struct s3_image *target, int index, const char *name);
 static void draw_history_text_item(struct s3_image *target, int index, const char *text, bool has_name);
-static void process_button_render_history(int button_index);
+static void process_button_compose_history(int button_index);
 static void process_history_scroll_up(void);
 static void process_history_scroll_down(void);
 static void process_history_scroll_at(float pos, bool force);
@@ -485,9 +533,11 @@ static void draw_var_value(int index);
 static void process_char(int index);
 static void truncate_variable(const char *var);
 static void process_language(int index);
-static void render_image_helper(struct s3_image *img, int bid);
+static void compose_image_helper(int index, struct s3_image *img);
+static void compose_plain_image(int index, struct s3_image *img, int x, int y, int width, int height);
 static void play_se(const char *file);
 static void play_sys_se(const char *file);
+static void preload_se(void);
 static void speak(const char *text);
 static bool load_gui_file(const char *file);
 static void set_gui_call_arg(int bid);
@@ -702,6 +752,9 @@ s3_load_gui_file(
 	/* Prepare the state of buttons. */
 	update_runtime_props(true);
 
+	/* Decode the sound effects so that a click doesn't decode. */
+	preload_se();
+
 	/* Set fade-in if needed. */
 	is_fading_in = fade_in_time > 0;
 	is_fading_out = false;
@@ -728,6 +781,7 @@ s3_start_gui(void)
 	if (is_fading_in)
 		s3_reset_lap_timer(&fade_sw);
 	is_fading_out = false;
+	was_fading = false;
 	is_saved_in_this_frame = false;
 	suppress_se = false;
 	suppress_se_forever = false;
@@ -774,8 +828,12 @@ s3_stop_gui(void)
 			}
 	}
 
+	/* Release the save thumbnails. */
+	s3_cache_save_thumbnails(0, 0);
+
 	/* Disable GUI mode. */
 	is_gui_running = false;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -819,6 +877,10 @@ s3i_run_gui_update(void)
 	if (!is_gui_running)
 		return true;
 
+	/* Render the frame while fading or on the first frame. */
+	if (is_first_frame || is_fading_in || is_fading_out)
+		s3i_update_stage_generation();
+
 	/* If first frame, reset the first frame flag. */
 	if (is_first_frame) {
 		is_first_frame = false;
@@ -1027,6 +1089,12 @@ static void process_input(void)
 	if (!is_fading_in && !is_fading_out)
 		is_key_detected = process_left_right_arrow_keys();
 
+	/* A mouse move takes over from the key selection. */
+	if (!is_key_detected && is_pointed_by_key &&
+	    (s3_get_mouse_pos_x() != save_mouse_pos_x ||
+	     s3_get_mouse_pos_y() != save_mouse_pos_y))
+		is_pointed_by_key = false;
+
 	/* Update the state of mouse pointing. */
 	if (!is_key_detected && !is_pointed_by_key && !is_fading_in && !is_fading_out) {
 		is_mouse_point_detected = false;
@@ -1040,6 +1108,7 @@ static void process_input(void)
 		}
 		if (i == -1) {
 			/* No pointed button. */
+			invalidate_button(pointed_index);
 			pointed_index = -1;
 		}
 	}
@@ -1170,6 +1239,8 @@ process_blit(void)
 static void
 update_runtime_props(bool is_first_time)
 {
+	float slider;
+	bool is_disabled;
 	int i;
 
 	/* If this is the first call. */
@@ -1180,6 +1251,9 @@ update_runtime_props(bool is_first_time)
 
 	/* Update each button. */
 	for (i = 0; i < S3_BUTTON_LAYERS; i++) {
+		slider = button[i].rt.slider;
+		is_disabled = button[i].rt.is_disabled;
+
 		switch (button[i].type) {
 		case TYPE_MASTERVOL:
 			button[i].rt.slider = s3_get_master_volume();
@@ -1228,6 +1302,11 @@ update_runtime_props(bool is_first_time)
 		default:
 			break;
 		}
+
+		/* Compose again only if the state has changed. */
+		if (button[i].rt.slider != slider ||
+		    button[i].rt.is_disabled != is_disabled)
+			button[i].rt.is_dirty = true;
 	}
 }
 
@@ -1540,6 +1619,8 @@ process_button_point(int index, bool key)
 			return false;
 
 		/* Set it to the pointed state. */
+		invalidate_button(pointed_index);
+		invalidate_button(index);
 		pointed_index = index;
 		is_pointed_by_key = true;
 		save_mouse_pos_x = mouse_pos_x;
@@ -1569,6 +1650,8 @@ process_button_point(int index, bool key)
 		/* If it is not yet pointed at. */
 		if (index != prev_pointed_index) {
 			/* Set it to the pointed state. */
+			invalidate_button(pointed_index);
+			invalidate_button(index);
 			pointed_index = index;
 			is_pointed_by_key = false;
 			is_mouse_point_detected = true;
@@ -1618,6 +1701,7 @@ process_button_drag(int index)
 		dragging_index = index;
 		b->rt.is_dragging = true;
 		b->rt.slider = calc_slider_value(index);
+		b->rt.is_dirty = true;
 		last_drag_tick = cur_tick - DRAG_TICK_INTERVAL;
 
 		switch (b->type) {
@@ -1649,6 +1733,7 @@ process_button_drag(int index)
 
 			/* Reflect the slider amount in the settings. */
 			b->rt.slider = calc_slider_value(index);
+			b->rt.is_dirty = true;
 			switch (b->type) {
 			case TYPE_MASTERVOL:
 				s3_set_master_volume(b->rt.slider);
@@ -1793,10 +1878,14 @@ process_button_click(
 	if (index == pointed_index &&
 	    (s3_is_mouse_left_pressed() ||
 	     s3_is_return_key_pressed())) {
+		if (!b->rt.is_pressed)
+			b->rt.is_dirty = true;
 		b->rt.is_pressed = true;
 		if (b->anime_press != NULL)
 			start_button_anime(index, b->anime_press);
 	} else {
+		if (b->rt.is_pressed)
+			b->rt.is_dirty = true;
 		b->rt.is_pressed = false;
 	}
 
@@ -1899,23 +1988,125 @@ process_button_click(
 static void
 process_render(void)
 {
+	struct gui_button *b;
+	bool is_fading, is_anime_running, is_animating;
 	int i;
 
+	/* Sliders are drawn differently during a fade. */
+	is_fading = is_fading_in || is_fading_out;
+	if (is_fading != was_fading) {
+		invalidate_all_buttons();
+		was_fading = is_fading;
+	}
+
+	is_anime_running = s3_is_anime_running();
+
 	/* Render each button according to its state. */
 	for (i = 0; i < S3_BUTTON_LAYERS; i++) {
-		if (!button[i].is_initialized)
+		b = &button[i];
+		if (!b->is_initialized)
 			continue;
 
+		/*
+		 * The layer parameters move while an anime is running.
+		 * Also rebuild once after it stops to catch the last frame.
+		 */
+		is_animating = is_anime_running &&
+			s3_is_anime_running_with_layer_mask(b->rt.used_layers);
+		if (is_animating || b->rt.is_animating)
+			b->rt.is_dirty = true;
+		b->rt.is_animating = is_animating;
+
+		/* Rebuild the draw calls only if the state has changed. */
+		if (b->rt.is_dirty) {
+			b->rt.blit_count = 0;
+			process_button_compose(i);
+			b->rt.is_dirty = false;
+		}
+
 		process_button_render(i);
 	}
 }
 
-/* Draw a button. */
+/* Mark a button to be composed again. */
+static void
+invalidate_button(
+	int index)
+{
+	if (index < 0 || index >= S3_BUTTON_LAYERS)
+		return;
+
+	button[index].rt.is_dirty = true;
+}
+
+/* Mark all buttons to be composed again. */
+static void
+invalidate_all_buttons(void)
+{
+	int i;
+
+	for (i = 0; i < S3_BUTTON_LAYERS; i++)
+		button[i].rt.is_dirty = true;
+}
+
+/* Draw the cached draw calls of a button. */
 static void
 process_button_render(
 	int index)
 {
 	struct gui_button *b;
+	struct gui_blit *blit;
+	int i, alpha;
+
+	b = &button[index];
+
+	for (i = 0; i < b->rt.blit_count; i++) {
+		blit = &b->rt.blit[i];
+
+		alpha = (int)(
+			  ((float)blit->alpha / 255.0f) *
+			  ((float)cur_alpha / 255.0f) *
+			  255.0f
+			);
+
+		if (blit->is_3d) {
+			s3_render_image_3d(blit->x[0],
+					   blit->y[0],
+					   blit->x[1],
+					   blit->y[1],
+					   blit->x[2],
+					   blit->y[2],
+					   blit->x[3],
+					   blit->y[3],
+					   blit->img,
+					   0,
+					   0,
+					   blit->src_width,
+					   blit->src_height,
+					   alpha,
+					   blit->blend);
+		} else {
+			s3_render_image((int)blit->x[0],
+					(int)blit->y[0],
+					blit->dst_width,
+					blit->dst_height,
+					blit->img,
+					0,
+					0,
+					blit->src_width,
+					blit->src_height,
+					alpha,
+					blit->blend);
+		}
+	}
+}
+
+/* Compose a button. */
+static void
+process_button_compose(
+	int index)
+{
+	struct gui_button *b;
 
 	b = &button[index];
 
@@ -1927,203 +2118,107 @@ process_button_render(
 	case TYPE_CHARACTERVOL:
 	case TYPE_TEXTSPEED:
 	case TYPE_AUTOSPEED:
-		/* Render a slider. */
-		process_button_render_slider(index);
+		/* Compose a slider. */
+		process_button_compose_slider(index);
 		break;
 	case TYPE_SAVE:
 	case TYPE_LOAD:
-		/* Render a save/load button. */
-		process_button_render_save(index);
+		/* Compose a save/load button. */
+		process_button_compose_save(index);
 		break;
 	case TYPE_HISTORY:
-		/* Render a history button. */
-		process_button_render_history(index);
+		/* Compose a history button. */
+		process_button_compose_history(index);
 		break;
 	case TYPE_HISTORYSCROLL:
-		/* Render a vertical slider. */
-		process_button_render_slider_vertical(index);
+		/* Compose a vertical slider. */
+		process_button_compose_slider_vertical(index);
 		break;
 	case TYPE_HISTORYSCROLL_HORIZONTAL:
-		/* Render a horizontal slider. */
-		process_button_render_slider(index);
+		/* Compose a horizontal slider. */
+		process_button_compose_slider(index);
 		break;
 	case TYPE_PREVIEW:
-		/* Render a preview button. */
-		process_button_render_preview(index);
+		/* Compose a preview button. */
+		process_button_compose_preview(index);
 		break;
 	case TYPE_VAR:
-		/* Render a variable button. */
-		process_button_render_var(index);
+		/* Compose a variable button. */
+		process_button_compose_var(index);
 		break;
 	case TYPE_SAVEPAGE:
-		/* Render a page button. */
-		process_button_render_page(index);
+		/* Compose a page button. */
+		process_button_compose_page(index);
 		break;
 	case TYPE_LANGUAGE:
-		/* Render a language button. */
-		process_button_render_language(index);
+		/* Compose a language button. */
+		process_button_compose_language(index);
 		break;
 	default:
-		/* Render a generic button. */
-		process_button_render_generic(index);
+		/* Compose a generic button. */
+		process_button_compose_generic(index);
 		break;
 	}
 }
 
-/* Render a slider button. */
+/* Compose a slider button. */
 static void
-process_button_render_slider(
+process_button_compose_slider(
 	int index)
 {
 	struct gui_button *b;
+	struct s3_image *img;
 
 	b = &button[index];
 
-	/* If the button is not pointed, draw the bar part with the idle image. */
-	if (index != pointed_index || is_fading_in || is_fading_out) {
-		if (b->rt.img_idle != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					b->rt.img_idle,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
-
-	/* If the button is pointed, draw the bar part with the hover image. */
-	if (index == pointed_index && !b->rt.is_pressed && !is_fading_in && !is_fading_out) {
-		struct s3_image *img;
+	/* Select the bar image by the pointed state. */
+	if (index != pointed_index || is_fading_in || is_fading_out)
+		img = b->rt.img_idle;
+	else if (!b->rt.is_pressed)
 		img = b->rt.img_hover != NULL ? b->rt.img_hover : b->rt.img_idle;
-		if (img != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					img,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
-
-	/* If the button is pressed, draw the bar part with the press image. */
-	if (index == pointed_index && b->rt.is_pressed && !is_fading_in && !is_fading_out) {
-		struct s3_image *img;
+	else
 		img = b->rt.img_press != NULL ? b->rt.img_press : b->rt.img_idle;
-		if (img != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					img,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
+
+	/* Draw the bar part. */
+	if (img != NULL)
+		compose_plain_image(index, img, b->x, b->y, b->width, b->height);
 
 	/* Draw the knob with the "disable" image. */
 	if (b->rt.img_disable != NULL) {
-		if (b->rt.img_disable != NULL) {
-			int x, y, knob_w, knob_h;
+		int x, y, knob_w, knob_h;
 
-			knob_w = s3_get_image_width(b->rt.img_disable);
-			knob_h = s3_get_image_height(b->rt.img_disable);
+		knob_w = s3_get_image_width(b->rt.img_disable);
+		knob_h = s3_get_image_height(b->rt.img_disable);
 
-			/* Calculate the drawing position. */
-			x = b->x + (int)((float)(b->width - knob_w) * b->rt.slider);
-			y = b->y + b->height / 2 - knob_h / 2;
+		/* Calculate the drawing position. */
+		x = b->x + (int)((float)(b->width - knob_w) * b->rt.slider);
+		y = b->y + b->height / 2 - knob_h / 2;
 
-			s3_render_image(x,
-					y,
-					knob_w,
-					knob_h,
-					b->rt.img_disable,
-					0,
-					0,
-					knob_w,
-					knob_h,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
+		compose_plain_image(index, b->rt.img_disable, x, y, knob_w, knob_h);
 	}
 }
 
-/* Render a vertical slider button. */
+/* Compose a vertical slider button. */
 static void
-process_button_render_slider_vertical(
+process_button_compose_slider_vertical(
 	int index)
 {
 	struct gui_button *b;
+	struct s3_image *img;
 
 	b = &button[index];
 
-	/* If the button is not pointed, draw the bar part with the idle image. */
-	if (index != pointed_index || is_fading_in || is_fading_out) {
-		if (b->rt.img_idle != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					b->rt.img_idle,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
-
-	/* If the button is pointed, draw the bar part with the hover image. */
-	if (index == pointed_index && !b->rt.is_pressed && !is_fading_in && !is_fading_out) {
-		struct s3_image *img;
+	/* Select the bar image by the pointed state. */
+	if (index != pointed_index || is_fading_in || is_fading_out)
+		img = b->rt.img_idle;
+	else if (!b->rt.is_pressed)
 		img = b->rt.img_hover != NULL ? b->rt.img_hover : b->rt.img_idle;
-		if (img != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					img,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
-
-	/* If the button is pressed, draw the bar part with the hover image. */
-	if (index == pointed_index && b->rt.is_pressed && !is_fading_in && !is_fading_out) {
-		struct s3_image *img;
+	else
 		img = b->rt.img_press != NULL ? b->rt.img_press : b->rt.img_idle;
-		if (img != NULL) {
-			s3_render_image(b->x,
-					b->y,
-					b->width,
-					b->height,
-					img,
-					0,
-					0,
-					b->width,
-					b->height,
-					cur_alpha,
-					S3_BLEND_ALPHA);
-		}
-	}
+
+	/* Draw the bar part. */
+	if (img != NULL)
+		compose_plain_image(index, img, b->x, b->y, b->width, b->height);
 
 	/* Draw the knob with the "disable" image. */
 	if (b->rt.img_disable != NULL) {
@@ -2136,35 +2231,25 @@ process_button_render_slider_vertical(
 		y = b->y + (int)((float)(b->height - knob_h) * b->rt.slider);
 		x = b->x + b->width / 2 - knob_w / 2;
 
-		s3_render_image(x,
-				y,
-				knob_w,
-				knob_h,
-				b->rt.img_disable,
-				0,
-				0,
-				knob_w,
-				knob_h,
-				cur_alpha,
-				S3_BLEND_ALPHA);
+		compose_plain_image(index, b->rt.img_disable, x, y, knob_w, knob_h);
 	}
 }
 
-/* Render a preview button. */
+/* Compose a preview button. */
 static void
-process_button_render_preview(
+process_button_compose_preview(
 	int index)
 {
 	struct gui_button *b;
 
 	b = &button[index];
 
-	render_image_helper(b->rt.img_canvas_idle, b->bid);
+	compose_image_helper(index, b->rt.img_canvas_idle);
 }
 
-/* Render a generic button. */
+/* Compose a generic button. */
 static void
-process_button_render_generic(
+process_button_compose_generic(
 	int index)
 {
 	struct gui_button *b;
@@ -2176,25 +2261,25 @@ process_button_render_generic(
 
 	if (index != pointed_index) {
 		if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	} else if (b->rt.is_pressed) {
 		if (b->rt.img_press != NULL)
-			render_image_helper(b->rt.img_press, b->bid);
+			compose_image_helper(index, b->rt.img_press);
 		else if (b->rt.img_hover != NULL)
-			render_image_helper(b->rt.img_hover, b->bid);
+			compose_image_helper(index, b->rt.img_hover);
 		else if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	} else {
 		if (b->rt.img_hover != NULL)
-			render_image_helper(b->rt.img_hover, b->bid);
+			compose_image_helper(index, b->rt.img_hover);
 		else if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	}
 }
 
-/* Render a generic button. */
+/* Compose a language button. */
 static void
-process_button_render_language(
+process_button_compose_language(
 	int index)
 {
 	struct gui_button *b;
@@ -2207,33 +2292,33 @@ process_button_render_language(
 	if (!b->rt.is_disabled) {
 		if (index != pointed_index) {
 			if (b->rt.img_idle != NULL)
-				render_image_helper(b->rt.img_idle, b->bid);
+				compose_image_helper(index, b->rt.img_idle);
 		} else {
 			if (b->rt.is_pressed) {
 				if (b->rt.img_press != NULL)
-					render_image_helper(b->rt.img_press, b->bid);
+					compose_image_helper(index, b->rt.img_press);
 				else if (b->rt.img_hover != NULL)
-					render_image_helper(b->rt.img_hover, b->bid);
+					compose_image_helper(index, b->rt.img_hover);
 				else if (b->rt.img_idle != NULL)
-					render_image_helper(b->rt.img_idle, b->bid);
+					compose_image_helper(index, b->rt.img_idle);
 			} else {
 				if (b->rt.img_hover != NULL)
-					render_image_helper(b->rt.img_hover, b->bid);
+					compose_image_helper(index, b->rt.img_hover);
 				else if (b->rt.img_idle != NULL)
-					render_image_helper(b->rt.img_idle, b->bid);
+					compose_image_helper(index, b->rt.img_idle);
 			}
 		}
 	} else {
 		if (b->rt.img_active != NULL)
-			render_image_helper(b->rt.img_active, b->bid);
+			compose_image_helper(index, b->rt.img_active);
 		else if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	}
 }
 
-/* Render a page button. */
+/* Compose a page button. */
 static void
-process_button_render_page(
+process_button_compose_page(
 	int index)
 {
 	struct gui_button *b;
@@ -2246,31 +2331,31 @@ process_button_render_page(
 	if (index == pointed_index) {
 		if (b->rt.is_pressed) {
 			if (b->rt.img_press != NULL)
-				render_image_helper(b->rt.img_press, b->bid);
+				compose_image_helper(index, b->rt.img_press);
 			else if (b->rt.img_hover != NULL)
-				render_image_helper(b->rt.img_hover, b->bid);
+				compose_image_helper(index, b->rt.img_hover);
 			else if (b->rt.img_idle != NULL)
-				render_image_helper(b->rt.img_idle, b->bid);
+				compose_image_helper(index, b->rt.img_idle);
 		} else {
 			if (b->rt.img_hover != NULL)
-				render_image_helper(b->rt.img_hover, b->bid);
+				compose_image_helper(index, b->rt.img_hover);
 			else if (b->rt.img_idle != NULL)
-				render_image_helper(b->rt.img_idle, b->bid);
+				compose_image_helper(index, b->rt.img_idle);
 		}
 	} else if (!b->rt.is_disabled) {
 		if (b->rt.img_active != NULL)
-			render_image_helper(b->rt.img_active, b->bid);
+			compose_image_helper(index, b->rt.img_active);
 		else if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	} else {
 		if (b->rt.img_idle != NULL)
-			render_image_helper(b->rt.img_idle, b->bid);
+			compose_image_helper(index, b->rt.img_idle);
 	}
 }
 
-/* Render a variable button. */
+/* Compose a variable button. */
 static void
-process_button_render_var(
+process_button_compose_var(
 	int index)
 {
 	struct gui_button *b;
@@ -2278,7 +2363,7 @@ process_button_render_var(
 	b = &button[index];
 	assert(b->type == TYPE_VAR);
 
-	render_image_helper(b->rt.img_canvas_idle, b->bid);
+	compose_image_helper(index, b->rt.img_canvas_idle);
 }
 
 /*
@@ -2331,6 +2416,9 @@ update_save_buttons(void)
 
 	base = save_slots * save_page;
 
+	/* Keep only the thumbnails on this page. */
+	s3_cache_save_thumbnails(base, save_slots);
+
 	for (i = 0; i < S3_BUTTON_LAYERS; i++) {
 		if (button[i].type != TYPE_SAVE && button[i].type != TYPE_LOAD)
 			continue;
@@ -2348,7 +2436,7 @@ update_save_buttons(void)
 	}
 }
 
-/* Render a save/load button. */
+/* Compose a save/load button. */
 static void
 draw_save_button(
 	int button_index)
@@ -2363,6 +2451,9 @@ draw_save_button(
 
 	b = &button[button_index];
 
+	/* The canvas and the NEW state will change. */
+	b->rt.is_dirty = true;
+
 	/* Calculate the save data number. */
 	save_index = save_slots * save_page + b->index;
 
@@ -2792,6 +2883,9 @@ process_save(
 
 	/* Update the button image. */
 	draw_save_button(button_index);
+
+	/* The NEW image moves to this slot. */
+	invalidate_all_buttons();
 }
 
 /* Perform a load operation. */
@@ -2821,9 +2915,9 @@ process_load(
 	s3_stop_gui();
 }
 
-/* Render a save/load button. */
+/* Compose a save/load button. */
 static void
-process_button_render_save(
+process_button_compose_save(
 	int index)
 {
 	struct gui_button *b;
@@ -2833,30 +2927,30 @@ process_button_render_save(
 
 	if (index != pointed_index) {
 		if (b->rt.img_canvas_idle != NULL)
-			render_image_helper(b->rt.img_canvas_idle, b->bid);
+			compose_image_helper(index, b->rt.img_canvas_idle);
 	} else {
 		if (b->rt.is_pressed) {
 			if (b->rt.img_canvas_press != NULL)
-				render_image_helper(b->rt.img_canvas_press, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_press);
 			else if (b->rt.img_canvas_hover != NULL)
-				render_image_helper(b->rt.img_canvas_hover, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_hover);
 			else if (b->rt.img_canvas_idle != NULL)
-				render_image_helper(b->rt.img_canvas_idle, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_idle);
 		} else {
 			if (b->rt.img_canvas_hover != NULL)
-				render_image_helper(b->rt.img_canvas_hover, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_hover);
 			else if (b->rt.img_canvas_idle != NULL)
-				render_image_helper(b->rt.img_canvas_idle, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_idle);
 		}
 	}
 
-	/* Render the NEW image. */
+	/* Compose the NEW image. */
 	save_index = save_page * save_slots + b->index;
 	if (b->rt.is_new_enabled &&
 	    save_index == s3_get_latest_save_index()) {
 		struct s3_image *img = s3i_get_savenew_image();
 		if (img != NULL)
-			render_image_helper(img, b->bid);
+			compose_image_helper(index, img);
 	}
 }
 
@@ -2938,9 +3032,9 @@ init_history_buttons(void)
 	return true;
 }
 
-/* Render a history button. */
+/* Compose a history button. */
 static void
-process_button_render_history(
+process_button_compose_history(
 	int index)
 {
 	struct gui_button *b;
@@ -2954,20 +3048,20 @@ process_button_render_history(
 	if (!b->rt.is_disabled && index == pointed_index) {
 		if (b->rt.is_pressed) {
 			if (b->rt.img_canvas_press != NULL)
-				render_image_helper(b->rt.img_canvas_press, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_press);
 			else if (b->rt.img_canvas_hover != NULL)
-				render_image_helper(b->rt.img_canvas_hover, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_hover);
 			else if (b->rt.img_canvas_idle != NULL)
-				render_image_helper(b->rt.img_canvas_idle, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_idle);
 		} else {
 			if (b->rt.img_canvas_hover != NULL)
-				render_image_helper(b->rt.img_canvas_hover, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_hover);
 			else if (b->rt.img_canvas_idle != NULL)
-				render_image_helper(b->rt.img_canvas_idle, b->bid);
+				compose_image_helper(index, b->rt.img_canvas_idle);
 		}
 	} else {
 		if (b->rt.img_canvas_idle != NULL)
-			render_image_helper(b->rt.img_canvas_idle, b->bid);
+			compose_image_helper(index, b->rt.img_canvas_idle);
 	}
 }
 
@@ -2980,6 +3074,10 @@ draw_history_buttons(void)
 	for (i = 0; i < S3_BUTTON_LAYERS; i++) {
 		if (button[i].type != TYPE_HISTORY)
 			continue;
+
+		/* The active state may change with the scroll. */
+		button[i].rt.is_dirty = true;
+
 		if (button[i].rt.img_canvas_idle != NULL) {
 			draw_history_button(button[i].rt.img_canvas_idle,
 					    button[i].rt.img_idle,
@@ -3864,19 +3962,26 @@ process_language(
 	s3_set_config("game.locale", b->lang);
 }
 
-/* Render a button image. */
+/* Add a draw call of a button image with the layer parameters. */
 static void
-render_image_helper(
-	struct s3_image *img,
-	int bid)
+compose_image_helper(
+	int index,
+	struct s3_image *img)
 {
-	int x, y, cx, cy, blend, alpha, layer;
+	struct gui_blit *blit;
+	int x, y, cx, cy, blend, alpha, layer, bid;
 	float sx, sy, rot;
 
+	bid = button[index].bid;
 	assert(bid >= 1 && bid <= S3_BUTTON_LAYERS);
 	if (bid < 1 || bid > S3_BUTTON_LAYERS)
 		return;
 
+	assert(button[index].rt.blit_count < BUTTON_BLITS);
+	if (button[index].rt.blit_count >= BUTTON_BLITS)
+		return;
+	blit = &button[index].rt.blit[button[index].rt.blit_count++];
+
 	/* Get the layer index. (ID 1 = S3_LAYER_GUI_BTN1) */
 	layer = S3_LAYER_GUI_BTN1 + bid - 1;
 
@@ -3889,11 +3994,13 @@ render_image_helper(
 	cy = s3_get_layer_center_y(layer);
 	rot = s3_get_layer_rotate(layer);
 	blend = s3_get_layer_blend(layer);
-	alpha = (int)(
-		  ((float)s3_get_layer_alpha(layer) / 255.0f) *
-		  ((float)cur_alpha / 255.0f) *
-		  255.0f
-		);
+	alpha = s3_get_layer_alpha(layer);
+
+	blit->img = img;
+	blit->src_width = img->width;
+	blit->src_height = img->height;
+	blit->alpha = alpha;
+	blit->blend = blend;
 
 	/* If 3D. */
 	if (rot != 0.0f ||
@@ -3976,37 +4083,54 @@ render_image_helper(
 		x4 += (float)x;
 		y4 += (float)y;
 
-		/* Render. */
-		s3_render_image_3d(x1,
-				   y1,
-				   x2,
-				   y2,
-				   x3,
-				   y3,
-				   x4,
-				   y4,
-				   img,
-				   0,
-				   0,
-				   img->width,
-				   img->height,
-				   alpha,
-				   blend);
+		/* Save the vertices. */
+		blit->is_3d = true;
+		blit->x[0] = x1;
+		blit->y[0] = y1;
+		blit->x[1] = x2;
+		blit->y[1] = y2;
+		blit->x[2] = x3;
+		blit->y[2] = y3;
+		blit->x[3] = x4;
+		blit->y[3] = y4;
 		return;
 	}
 
 	/* Otherwise 2D. */
-	s3_render_image(x,
-			y,
-			(int)((float)img->width * sx),
-			(int)((float)img->height * sy),
-			img,
-			0,
-			0,
-			img->width,
-			img->height,
-			alpha,
-			blend);
+	blit->is_3d = false;
+	blit->x[0] = (float)x;
+	blit->y[0] = (float)y;
+	blit->dst_width = (int)((float)img->width * sx);
+	blit->dst_height = (int)((float)img->height * sy);
+}
+
+/* Add a draw call of an image at a fixed position. (for sliders) */
+static void
+compose_plain_image(
+	int index,
+	struct s3_image *img,
+	int x,
+	int y,
+	int width,
+	int height)
+{
+	struct gui_blit *blit;
+
+	assert(button[index].rt.blit_count < BUTTON_BLITS);
+	if (button[index].rt.blit_count >= BUTTON_BLITS)
+		return;
+	blit = &button[index].rt.blit[button[index].rt.blit_count++];
+
+	blit->img = img;
+	blit->is_3d = false;
+	blit->x[0] = (float)x;
+	blit->y[0] = (float)y;
+	blit->dst_width = width;
+	blit->dst_height = height;
+	blit->src_width = width;
+	blit->src_height = height;
+	blit->alpha = 255;
+	blit->blend = S3_BLEND_ALPHA;
 }
 
 /*
@@ -4033,6 +4157,20 @@ play_sys_se(const char *file)
 	s3_set_mixer_input_file(S3_TRACK_SYS, file, false);
 }
 
+/* Preload the sound effects of the buttons. */
+static void
+preload_se(void)
+{
+	int i;
+
+	/* A failure is not an error here, and will be reported on a playback. */
+	s3_preload_mixer_file(cancel_se);
+	for (i = 0; i < S3_BUTTON_LAYERS; i++) {
+		s3_preload_mixer_file(button[i].clickse);
+		s3_preload_mixer_file(button[i].pointse);
+	}
+}
+
 /* Speak the alternative text of a button. */
 static void
 speak(const char *text)
@@ -5071,6 +5209,9 @@ stop_button_anime(
 {
 	int i, layer;
 
+	/* The layer parameters will be reset. */
+	invalidate_button(index);
+
 	/* Stop existing animations. */
 	for (i = 0; i < S3_STAGE_LAYERS; i++) {
 		if (button[index].rt.used_layers[i]) {
@@ -5101,6 +5242,9 @@ start_button_anime(
 	if (button[index].bid == -1)
 		return true;
 
+	/* The layer parameters will be reset. */
+	invalidate_button(index);
+
 	/* Reset the position. */
 	layer = S3_LAYER_GUI_BTN1 + button[index].bid - 1;
 	s3_set_layer_position(layer, button[index].x, button[index].y);
@@ -100,6 +100,27 @@ s3_write_save_data(
 	return pf_write_save_data(key, data, size);
 }
 
+/*
+ * Write save data in the background.
+ */
+bool
+s3_write_save_data_async(
+	const char *key,
+	void *data,
+	size_t size)
+{
+	return pf_write_save_data_async(key, data, size);
+}
+
+/*
+ * Wait for the background writes of save data.
+ */
+bool
+s3_flush_save_data(void)
+{
+	return pf_flush_save_data();
+}
+
 /*
  * Read save data.
  */
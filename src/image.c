@@ -31,6 +31,7 @@
 #include <playfield/playfield.h>
 #include <strato/strato.h>
 #include "image.h"
+#include "stage.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -301,6 +302,7 @@ void s3_notify_image_update(
 	struct s3_image *image)
 {
 	pf_notify_texture_update(image->tex_id);
+	s3i_update_stage_generation();
 }
 
 /*
@@ -361,6 +363,7 @@ s3_draw_image(
 			alpha,
 			pf_blend);
 		pf_notify_texture_update(dst->tex_id);
+		s3i_update_stage_generation();
 	}
 }
 
@@ -434,6 +437,7 @@ s3_draw_image_3d(
 			alpha,
 			pf_blend);
 		pf_notify_texture_update(dst_image->tex_id);
+		s3i_update_stage_generation();
 	}
 }
 
@@ -472,6 +476,7 @@ s3_fill_image_rect(
 			     width,
 			     height,
 			     color);
+	s3i_update_stage_generation();
 }
 
 /*
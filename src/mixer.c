@@ -37,6 +37,37 @@
 #include <string.h>
 #include <assert.h>
 
+/* Max polyphony of a track. */
+#define POLYPHONY_MAX		(16)
+
+/* Fade-out time of a stolen voice. */
+#define STEAL_SPAN		(0.05f)
+
+/*
+ * Voice on a polyphonic track
+ */
+struct voice {
+	/* Voice handle. (-1 if unused) */
+	int handle;
+
+	/* Start order for stealing. */
+	uint32_t order;
+
+	/* Is looped. */
+	bool is_looped;
+
+	/* Is stopping after the fade. */
+	bool is_stopping;
+
+	/* Fading. */
+	bool is_fading;
+	float vol_cur;
+	float vol_start;
+	float vol_end;
+	float vol_span;
+	uint64_t sw;
+};
+
 /* Is playing on the track. */
 static bool is_playing[S3_MIXER_TRACKS];
 
@@ -76,6 +107,22 @@ static int ch_vol_index;
 /* Track file name. */
 static char *track_file_name[S3_MIXER_TRACKS];
 
+/* Polyphony of the track. */
+static int polyphony[S3_MIXER_TRACKS];
+
+/* Voices on the track. (polyphony > 1) */
+static struct voice voice_tbl[S3_MIXER_TRACKS][POLYPHONY_MAX * 2];
+
+/* Voice start counter. */
+static uint32_t voice_order;
+
+/* Forward declarations. */
+static bool play_voice(int track, const char *file, bool is_looped);
+static void steal_voice(int track, bool is_looped);
+static void fade_voice(struct voice *v, float vol, float span, bool stop);
+static void clear_voices(int track);
+static void process_voice_fading(int track);
+
 /*
  * Initialize the mixer subsystem.
  */
@@ -90,7 +137,18 @@ s3i_init_mixer(void)
 	vol_global[S3_TRACK_SE] = conf_sound_vol_se;
 	vol_global[S3_TRACK_SYS] = conf_sound_vol_se;
 
+	/* SE and SYS mix multiple sounds if configured. */
+	polyphony[S3_TRACK_BGM] = 1;
+	polyphony[S3_TRACK_VOICE] = 1;
+	polyphony[S3_TRACK_SE] = conf_sound_polyphony_se;
+	polyphony[S3_TRACK_SYS] = conf_sound_polyphony_se;
+
 	for (track = 0; track < S3_MIXER_TRACKS; track++) {
+		if (polyphony[track] < 1)
+			polyphony[track] = 1;
+		if (polyphony[track] > POLYPHONY_MAX)
+			polyphony[track] = POLYPHONY_MAX;
+
 		is_playing[track] = false;
 		vol_cur[track] = 1.0f;
 		vol_local[track] = 1.0f;
@@ -99,7 +157,10 @@ s3i_init_mixer(void)
 			free(track_file_name[track]);
 			track_file_name[track] = NULL;
 		}
-		pf_stop_sound(track);
+		clear_voices(track);
+
+		/* Leave room for the stolen voices to fade out. */
+		pf_set_sound_polyphony(track, polyphony[track] > 1 ? polyphony[track] * 2 : 1);
 		pf_set_sound_volume(track, vol_master * vol_global[track]);
 	}
 
@@ -127,6 +188,7 @@ s3i_cleanup_mixer(void)
 			free(track_file_name[track]);
 			track_file_name[track] = NULL;
 		}
+		clear_voices(track);
 	}
 }
 
@@ -158,6 +220,10 @@ s3_set_mixer_input_file(
 		}
 	}
 
+	/* A polyphonic track adds a voice. */
+	if (polyphony[track] > 1 && file != NULL && strcmp(file, "") != 0)
+		return play_voice(track, file, is_looped);
+
 	if (is_playing[track]) {
 		pf_stop_sound(track);
 		is_playing[track] = false;
@@ -168,6 +234,8 @@ s3_set_mixer_input_file(
 		track_file_name[track] = NULL;
 	}
 
+	clear_voices(track);
+
 	if (file != NULL && strcmp(file, "") != 0) {
 		if (!pf_play_sound(track, file, is_looped)) {
 			s3_log_tag_error(S3_TR("Cannot play sound file \"%s\"."), file);
@@ -188,6 +256,142 @@ s3_set_mixer_input_file(
 	return true;
 }
 
+/* Play a sound file as a voice on a polyphonic track. */
+static bool
+play_voice(
+	int track,
+	const char *file,
+	bool is_looped)
+{
+	struct voice *v;
+	int i;
+
+	/* Make room for the new voice. */
+	steal_voice(track, is_looped);
+
+	/* Find a free slot. */
+	v = NULL;
+	for (i = 0; i < polyphony[track] * 2; i++) {
+		if (voice_tbl[track][i].handle == -1) {
+			v = &voice_tbl[track][i];
+			break;
+		}
+	}
+	if (v == NULL)
+		return true;	/* Too many voices are fading out. */
+
+	if (!pf_play_sound_voice(track, file, is_looped, 1.0f, &v->handle)) {
+		v->handle = -1;
+		s3_log_tag_error(S3_TR("Cannot play sound file \"%s\"."), file);
+		return false;
+	}
+	v->order = voice_order++;
+	v->is_looped = is_looped;
+	v->is_stopping = false;
+	v->is_fading = false;
+	v->vol_cur = 1.0f;
+
+	is_playing[track] = true;
+
+	/* Keep the file name of the looped voice. */
+	if (is_looped) {
+		if (track_file_name[track] != NULL)
+			free(track_file_name[track]);
+		track_file_name[track] = strdup(file);
+		if (track_file_name[track] == NULL) {
+			s3_log_out_of_memory();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Fade out the voices that the new voice replaces.
+ *  - A looped voice replaces the previous looped voice.
+ *  - Over the polyphony, the oldest voice is stolen, a one-shot first.
+ */
+static void
+steal_voice(
+	int track,
+	bool is_looped)
+{
+	struct voice *v, *oldest;
+	int i, count;
+
+	count = 0;
+	oldest = NULL;
+	for (i = 0; i < polyphony[track] * 2; i++) {
+		v = &voice_tbl[track][i];
+		if (v->handle == -1 || v->is_stopping)
+			continue;
+		if (is_looped && v->is_looped) {
+			fade_voice(v, 0, STEAL_SPAN, true);
+			continue;
+		}
+		count++;
+		if (oldest == NULL ||
+		    (oldest->is_looped && !v->is_looped) ||
+		    (oldest->is_looped == v->is_looped && v->order - oldest->order > 0x80000000U))
+			oldest = v;
+	}
+
+	if (count >= polyphony[track] && oldest != NULL) {
+		fade_voice(oldest, 0, STEAL_SPAN, true);
+		if (oldest->is_looped && track_file_name[track] != NULL) {
+			free(track_file_name[track]);
+			track_file_name[track] = NULL;
+		}
+	}
+}
+
+/* Start a fade of a voice. */
+static void
+fade_voice(
+	struct voice *v,
+	float vol,
+	float span,
+	bool stop)
+{
+	v->is_fading = true;
+	v->is_stopping = stop;
+	v->vol_start = v->vol_cur;
+	v->vol_end = vol;
+	v->vol_span = span;
+	pf_reset_lap_timer(&v->sw);
+}
+
+/* Forget the voices of a track. */
+static void
+clear_voices(
+	int track)
+{
+	int i;
+
+	for (i = 0; i < POLYPHONY_MAX * 2; i++)
+		voice_tbl[track][i].handle = -1;
+}
+
+/*
+ * Decode a short sound file in advance.
+ */
+bool
+s3_preload_mixer_file(
+	const char *file)
+{
+	if (file == NULL || strcmp(file, "") == 0)
+		return true;
+
+	if (!s3_check_file_exists(file))
+		return false;
+
+	if (!pf_preload_sound(file))
+		return false;
+
+	return true;
+}
+
 /*
  * Set the volume for a mixer track.
  */
@@ -382,5 +586,53 @@ void process_sound_fading(void)
 		vol_cur[track] = vol;
 		pf_set_sound_volume(track, vol_global[track] * vol_cur[track] * vol_master);
 	}
+
+	for (track = 0; track < S3_MIXER_TRACKS; track++) {
+		if (polyphony[track] > 1)
+			process_voice_fading(track);
+	}
+}
+
+/* Process the per-voice fading on a polyphonic track. */
+static void
+process_voice_fading(
+	int track)
+{
+	struct voice *v;
+	float lap;
+	int i;
+
+	for (i = 0; i < polyphony[track] * 2; i++) {
+		v = &voice_tbl[track][i];
+		if (v->handle == -1)
+			continue;
+
+		/* Forget a finished voice. */
+		if (pf_is_sound_voice_finished(track, v->handle)) {
+			v->handle = -1;
+			continue;
+		}
+
+		if (!v->is_fading)
+			continue;
+
+		/* Get the lap time. */
+		lap = (float)pf_get_lap_timer_millisec(&v->sw) / 1000.0f;
+		if (lap >= v->vol_span) {
+			lap = v->vol_span;
+			v->is_fading = false;
+		}
+
+		/* Set the volume. */
+		v->vol_cur = v->vol_start * (1.0f - lap / v->vol_span) +
+			     v->vol_end * (lap / v->vol_span);
+		pf_set_sound_voice_volume(track, v->handle, v->vol_cur);
+
+		/* Stop after a fade-out. */
+		if (!v->is_fading && v->is_stopping) {
+			pf_stop_sound_voice(track, v->handle);
+			v->handle = -1;
+		}
+	}
 }
 
@@ -0,0 +1,514 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Suika3
+ * Save Data Packing (QOI thumbnails and LZ compression)
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Copyright (c) 1996-2026 Awe Morris / SCHOLA SUIKAE
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * [QOI]
+ *  The "Quite OK Image Format" by Dominic Szablewski. (qoiformat.org)
+ *  Pixels are treated as four bytes in the memory order, so the result
+ *  is lossless regardless of the channel order of the platform.
+ *
+ * [LZ]
+ *  A byte-oriented LZ77 in the LZ4 block layout:
+ *
+ *  struct sequence {
+ *      u8 token;              // (literal length << 4) | (match length - 4)
+ *      u8 extra_literal[];    // If literal length is 15, 255 continues.
+ *      u8 literal[];
+ *      u16 offset;            // Not present in the last sequence.
+ *      u8 extra_match[];      // If match length - 4 is 15, 255 continues.
+ *  };
+ */
+
+#include <suika3/suika3.h>
+#include "pack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* QOI opcodes. */
+#define QOI_OP_INDEX	(0x00)
+#define QOI_OP_DIFF	(0x40)
+#define QOI_OP_LUMA	(0x80)
+#define QOI_OP_RUN	(0xc0)
+#define QOI_OP_RGB	(0xfe)
+#define QOI_OP_RGBA	(0xff)
+#define QOI_MASK_2	(0xc0)
+
+/* QOI header and end marker sizes. */
+#define QOI_HEADER_SIZE	(14)
+#define QOI_END_SIZE	(8)
+
+/* Hash of a pixel. */
+#define QOI_HASH(p)	(((p)[0] * 3 + (p)[1] * 5 + (p)[2] * 7 + (p)[3] * 11) % 64)
+
+/* LZ parameters. */
+#define LZ_MIN_MATCH	(4)
+#define LZ_MAX_OFFSET	(65535)
+#define LZ_HASH_BITS	(12)
+#define LZ_HASH_SIZE	(1 << LZ_HASH_BITS)
+
+static void write_be32(uint8_t *p, uint32_t v);
+static uint32_t read_be32(const uint8_t *p);
+static uint8_t *write_length(uint8_t *p, size_t len);
+static bool read_length(const uint8_t **p, const uint8_t *end, size_t *len);
+static uint32_t lz_hash(const uint8_t *p);
+
+/*
+ * QOI
+ */
+
+/*
+ * Encode RGBA pixels to the QOI format.
+ */
+bool
+s3i_encode_qoi(
+	const uint8_t *pixels,
+	int width,
+	int height,
+	uint8_t **ret,
+	size_t *ret_size)
+{
+	uint8_t index[64][4];
+	uint8_t prev[4];
+	const uint8_t *px;
+	uint8_t *buf, *p;
+	size_t count, i;
+	int run, h;
+	signed char vr, vg, vb, vg_r, vg_b;
+
+	count = (size_t)width * (size_t)height;
+
+	/* The worst case is QOI_OP_RGBA for every pixel. */
+	buf = malloc(QOI_HEADER_SIZE + count * 5 + QOI_END_SIZE);
+	if (buf == NULL) {
+		s3_log_out_of_memory();
+		return false;
+	}
+
+	/* Write the header. */
+	p = buf;
+	memcpy(p, "qoif", 4);
+	write_be32(p + 4, (uint32_t)width);
+	write_be32(p + 8, (uint32_t)height);
+	p[12] = 4;	/* channels */
+	p[13] = 0;	/* colorspace */
+	p += QOI_HEADER_SIZE;
+
+	memset(index, 0, sizeof(index));
+	prev[0] = 0;
+	prev[1] = 0;
+	prev[2] = 0;
+	prev[3] = 255;
+
+	run = 0;
+	for (i = 0; i < count; i++) {
+		px = pixels + i * 4;
+
+		/* Same as the previous pixel. */
+		if (memcmp(px, prev, 4) == 0) {
+			run++;
+			if (run == 62 || i == count - 1) {
+				*p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0) {
+			*p++ = (uint8_t)(QOI_OP_RUN | (run - 1));
+			run = 0;
+		}
+
+		/* Seen recently. */
+		h = QOI_HASH(px);
+		if (memcmp(index[h], px, 4) == 0) {
+			*p++ = (uint8_t)(QOI_OP_INDEX | h);
+		} else {
+			memcpy(index[h], px, 4);
+
+			if (px[3] == prev[3]) {
+				vr = (signed char)(px[0] - prev[0]);
+				vg = (signed char)(px[1] - prev[1]);
+				vb = (signed char)(px[2] - prev[2]);
+				vg_r = (signed char)(vr - vg);
+				vg_b = (signed char)(vb - vg);
+				if (vr > -3 && vr < 2 &&
+				    vg > -3 && vg < 2 &&
+				    vb > -3 && vb < 2) {
+					*p++ = (uint8_t)(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+				} else if (vg_r > -9 && vg_r < 8 &&
+					   vg > -33 && vg < 32 &&
+					   vg_b > -9 && vg_b < 8) {
+					*p++ = (uint8_t)(QOI_OP_LUMA | (vg + 32));
+					*p++ = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+				} else {
+					*p++ = QOI_OP_RGB;
+					*p++ = px[0];
+					*p++ = px[1];
+					*p++ = px[2];
+				}
+			} else {
+				*p++ = QOI_OP_RGBA;
+				*p++ = px[0];
+				*p++ = px[1];
+				*p++ = px[2];
+				*p++ = px[3];
+			}
+		}
+
+		memcpy(prev, px, 4);
+	}
+
+	/* Write the end marker. */
+	memset(p, 0, QOI_END_SIZE - 1);
+	p[QOI_END_SIZE - 1] = 1;
+	p += QOI_END_SIZE;
+
+	*ret = buf;
+	*ret_size = (size_t)(p - buf);
+
+	return true;
+}
+
+/*
+ * Decode QOI data to RGBA pixels.
+ */
+bool
+s3i_decode_qoi(
+	const uint8_t *data,
+	size_t size,
+	uint8_t *pixels,
+	int width,
+	int height)
+{
+	uint8_t index[64][4];
+	uint8_t px[4];
+	const uint8_t *p, *end;
+	uint8_t *dst;
+	size_t count, i;
+	int run, b1, b2, vg;
+
+	/* Check the header. */
+	if (size < QOI_HEADER_SIZE + QOI_END_SIZE)
+		return false;
+	if (memcmp(data, "qoif", 4) != 0)
+		return false;
+	if (read_be32(data + 4) != (uint32_t)width ||
+	    read_be32(data + 8) != (uint32_t)height)
+		return false;
+
+	p = data + QOI_HEADER_SIZE;
+	end = data + size - QOI_END_SIZE;
+	count = (size_t)width * (size_t)height;
+
+	memset(index, 0, sizeof(index));
+	px[0] = 0;
+	px[1] = 0;
+	px[2] = 0;
+	px[3] = 255;
+
+	run = 0;
+	dst = pixels;
+	for (i = 0; i < count; i++) {
+		if (run > 0) {
+			run--;
+		} else {
+			if (p >= end)
+				return false;
+			b1 = *p++;
+			if (b1 == QOI_OP_RGB) {
+				if (end - p < 3)
+					return false;
+				px[0] = *p++;
+				px[1] = *p++;
+				px[2] = *p++;
+			} else if (b1 == QOI_OP_RGBA) {
+				if (end - p < 4)
+					return false;
+				px[0] = *p++;
+				px[1] = *p++;
+				px[2] = *p++;
+				px[3] = *p++;
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+				memcpy(px, index[b1], 4);
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+				px[0] = (uint8_t)(px[0] + ((b1 >> 4) & 0x03) - 2);
+				px[1] = (uint8_t)(px[1] + ((b1 >> 2) & 0x03) - 2);
+				px[2] = (uint8_t)(px[2] + (b1 & 0x03) - 2);
+			} else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+				if (p >= end)
+					return false;
+				b2 = *p++;
+				vg = (b1 & 0x3f) - 32;
+				px[0] = (uint8_t)(px[0] + vg - 8 + ((b2 >> 4) & 0x0f));
+				px[1] = (uint8_t)(px[1] + vg);
+				px[2] = (uint8_t)(px[2] + vg - 8 + (b2 & 0x0f));
+			} else {
+				/* QOI_OP_RUN */
+				run = b1 & 0x3f;
+			}
+			memcpy(index[QOI_HASH(px)], px, 4);
+		}
+
+		memcpy(dst, px, 4);
+		dst += 4;
+	}
+
+	return true;
+}
+
+/*
+ * LZ
+ */
+
+/*
+ * Compress bytes.
+ */
+bool
+s3i_compress(
+	const uint8_t *src,
+	size_t src_size,
+	uint8_t **ret,
+	size_t *ret_size)
+{
+	uint32_t *table;
+	const uint8_t *ip, *anchor, *match, *end, *limit;
+	uint8_t *buf, *op, *token;
+	size_t lit_len, match_len;
+	uint32_t h;
+
+	/* The worst case is all literals. */
+	buf = malloc(src_size + src_size / 255 + 16);
+	if (buf == NULL) {
+		s3_log_out_of_memory();
+		return false;
+	}
+	table = malloc(sizeof(uint32_t) * LZ_HASH_SIZE);
+	if (table == NULL) {
+		s3_log_out_of_memory();
+		free(buf);
+		return false;
+	}
+	memset(table, 0xff, sizeof(uint32_t) * LZ_HASH_SIZE);
+
+	ip = src;
+	anchor = src;
+	end = src + src_size;
+	limit = src_size >= LZ_MIN_MATCH ? end - LZ_MIN_MATCH : src;
+	op = buf;
+	while (ip < limit) {
+		/* Look up the last position of the same 4 bytes. */
+		h = lz_hash(ip);
+		match = table[h] == 0xffffffff ? NULL : src + table[h];
+		table[h] = (uint32_t)(ip - src);
+		if (match == NULL ||
+		    ip - match > LZ_MAX_OFFSET ||
+		    memcmp(match, ip, LZ_MIN_MATCH) != 0) {
+			ip++;
+			continue;
+		}
+
+		/* Extend the match. */
+		match_len = LZ_MIN_MATCH;
+		while (ip + match_len < end && match[match_len] == ip[match_len])
+			match_len++;
+
+		/* Emit the literals and the match. */
+		lit_len = (size_t)(ip - anchor);
+		token = op++;
+		*token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+		if (lit_len >= 15)
+			op = write_length(op, lit_len - 15);
+		memcpy(op, anchor, lit_len);
+		op += lit_len;
+		*op++ = (uint8_t)((ip - match) & 0xff);
+		*op++ = (uint8_t)(((ip - match) >> 8) & 0xff);
+		*token |= (uint8_t)(match_len - LZ_MIN_MATCH >= 15 ? 15 : match_len - LZ_MIN_MATCH);
+		if (match_len - LZ_MIN_MATCH >= 15)
+			op = write_length(op, match_len - LZ_MIN_MATCH - 15);
+
+		ip += match_len;
+		anchor = ip;
+	}
+
+	/* Emit the last literals. */
+	lit_len = (size_t)(end - anchor);
+	token = op++;
+	*token = (uint8_t)((lit_len >= 15 ? 15 : lit_len) << 4);
+	if (lit_len >= 15)
+		op = write_length(op, lit_len - 15);
+	memcpy(op, anchor, lit_len);
+	op += lit_len;
+
+	free(table);
+
+	*ret = buf;
+	*ret_size = (size_t)(op - buf);
+
+	return true;
+}
+
+/*
+ * Decompress bytes to a buffer of the original size.
+ */
+bool
+s3i_decompress(
+	const uint8_t *src,
+	size_t src_size,
+	uint8_t *dst,
+	size_t dst_size)
+{
+	const uint8_t *ip, *end, *match;
+	uint8_t *op, *op_end;
+	size_t lit_len, match_len, offset, i;
+	int token;
+	bool last;
+
+	ip = src;
+	end = src + src_size;
+	op = dst;
+	op_end = dst + dst_size;
+	last = false;
+	while (ip < end) {
+		token = *ip++;
+
+		/* Copy the literals. */
+		lit_len = (size_t)(token >> 4);
+		if (lit_len == 15 && !read_length(&ip, end, &lit_len))
+			return false;
+		if ((size_t)(end - ip) < lit_len || (size_t)(op_end - op) < lit_len)
+			return false;
+		memcpy(op, ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+
+		/* The last sequence has no match. */
+		if (ip == end) {
+			last = true;
+			break;
+		}
+
+		/* Copy the match. (may overlap) */
+		if (end - ip < 2)
+			return false;
+		offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		match_len = (size_t)(token & 0x0f);
+		if (match_len == 15 && !read_length(&ip, end, &match_len))
+			return false;
+		match_len += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return false;
+		if ((size_t)(op_end - op) < match_len)
+			return false;
+		match = op - offset;
+		for (i = 0; i < match_len; i++)
+			op[i] = match[i];
+		op += match_len;
+	}
+
+	/* The data must end with the last sequence, and the size must match. */
+	if (!last || op != op_end)
+		return false;
+
+	return true;
+}
+
+/*
+ * Helpers
+ */
+
+static void
+write_be32(
+	uint8_t *p,
+	uint32_t v)
+{
+	p[0] = (uint8_t)((v >> 24) & 0xff);
+	p[1] = (uint8_t)((v >> 16) & 0xff);
+	p[2] = (uint8_t)((v >> 8) & 0xff);
+	p[3] = (uint8_t)(v & 0xff);
+}
+
+static uint32_t
+read_be32(
+	const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) |
+	       ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) |
+	       (uint32_t)p[3];
+}
+
+/* Write an extra length. (added to 15) */
+static uint8_t *
+write_length(
+	uint8_t *p,
+	size_t len)
+{
+	while (len >= 255) {
+		*p++ = 255;
+		len -= 255;
+	}
+	*p++ = (uint8_t)len;
+
+	return p;
+}
+
+/* Read an extra length and add it to *len. */
+static bool
+read_length(
+	const uint8_t **p,
+	const uint8_t *end,
+	size_t *len)
+{
+	int b;
+
+	do {
+		if (*p >= end)
+			return false;
+		b = *(*p)++;
+		*len += (size_t)b;
+	} while (b == 255);
+
+	return true;
+}
+
+/* Hash of 4 bytes. */
+static uint32_t
+lz_hash(
+	const uint8_t *p)
+{
+	uint32_t v;
+
+	v = (uint32_t)p[0] |
+	    ((uint32_t)p[1] << 8) |
+	    ((uint32_t)p[2] << 16) |
+	    ((uint32_t)p[3] << 24);
+
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
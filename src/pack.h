@@ -0,0 +1,80 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Suika3
+ * Save Data Packing (QOI thumbnails and LZ compression)
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Copyright (c) 1996-2026 Awe Morris / SCHOLA SUIKAE
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#ifndef SUIKA3_PACK_H
+#define SUIKA3_PACK_H
+
+#include <suika3/suika3.h>
+
+/*
+ * Encode RGBA pixels to the QOI format.
+ *  - The returned buffer must be freed by free().
+ */
+bool
+s3i_encode_qoi(
+	const uint8_t *pixels,
+	int width,
+	int height,
+	uint8_t **ret,
+	size_t *ret_size);
+
+/*
+ * Decode QOI data to RGBA pixels.
+ *  - The image size must match.
+ */
+bool
+s3i_decode_qoi(
+	const uint8_t *data,
+	size_t size,
+	uint8_t *pixels,
+	int width,
+	int height);
+
+/*
+ * Compress bytes. (LZ77)
+ *  - The returned buffer must be freed by free().
+ */
+bool
+s3i_compress(
+	const uint8_t *src,
+	size_t src_size,
+	uint8_t **ret,
+	size_t *ret_size);
+
+/*
+ * Decompress bytes to a buffer of the original size.
+ */
+bool
+s3i_decompress(
+	const uint8_t *src,
+	size_t src_size,
+	uint8_t *dst,
+	size_t dst_size);
+
+#endif
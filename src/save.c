@@ -31,6 +31,7 @@
 #include "save.h"
 #include "conf.h"
 #include "image.h"
+#include "pack.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -57,7 +58,13 @@
 	} while (0)
 
 /* Save data compatibility version. */
-#define SAVE_VER	(0x00000001)
+#define SAVE_VER	(0x00000002)
+
+/* Older version without compression. (still readable) */
+#define SAVE_VER_1	(0x00000001)
+
+/* Position of the thumbnail size in a packed local save file. */
+#define PACKED_THUMB_OFFSET	(4)
 
 /* False assertion */
 #define CONFIG_TYPE_ERROR	(0)
@@ -84,9 +91,19 @@ static char *save_title[S3_ALL_SAVE_SLOTS];
 /* Last message of the save data. */
 static char *save_message[S3_ALL_SAVE_SLOTS];
 
-/* Thumbnail of the save data. */
+/* Thumbnail of the save data. (loaded on demand) */
 static struct s3_image *save_thumb[S3_ALL_SAVE_SLOTS];
 
+/* Offset of the thumbnail pixels in the save file. */
+static uint32_t save_thumb_offset[S3_ALL_SAVE_SLOTS];
+
+/* Blank thumbnail for empty slots. */
+static struct s3_image *empty_thumb;
+
+/* Last written (or loaded) global save data to skip an unchanged write. */
+static unsigned char *last_global_data;
+static size_t last_global_size;
+
 /*
  * Temporary Buffers
  */
@@ -105,9 +122,16 @@ static bool is_load_in_progress;
 /*
  * Forward declaration.
  */
+static bool load_save_index(void);
+static bool write_save_index(void);
+static void clear_save_slots(void);
 static bool load_basic_save_info_all(void);
 static bool load_basic_save_info(int index);
+static struct s3_image *load_thumb(int index);
 static bool copy_thumb(int index);
+static bool update_basic_save_info(int index);
+static bool is_global_unchanged(void);
+static void remember_global(const unsigned char *data, size_t size);
 static bool open_write_stream(void);
 static bool write_u32(uint32_t val);
 static bool write_u64(uint64_t val);
@@ -115,6 +139,9 @@ static bool write_f32(float val);
 static bool write_string(const char *val);
 static bool write_data(const void *data, size_t size);
 static bool resize_buffer(size_t inc_size);
+static void patch_u32(size_t pos, uint32_t val);
+static bool pack_write_stream(struct s3_image *thumb);
+static bool unpack_read_stream(void);
 static bool close_write_stream(const char *file, ...);
 static bool open_read_stream(const char *file, ...);
 static bool read_u32(uint32_t *ret);
@@ -136,26 +163,18 @@ static void close_read_stream(void);
 bool
 s3i_init_save(void)
 {
-	int i;
-
 	/* Clear the save slots. */
-	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
-		save_time[i] = 0;
-		FREE(save_title[i]);
-		FREE(save_message[i]);
-		if (save_thumb[i] != NULL) {
-			s3_destroy_image(save_thumb[i]);
-			save_thumb[i] = NULL;
-		}
+	clear_save_slots();
+
+	/*
+	 * Load the basic data from the save index.
+	 * If it doesn't exist yet, scan the local save files once and make it.
+	 */
+	if (!load_save_index()) {
+		clear_save_slots();
+		load_basic_save_info_all();
+		write_save_index();
 	}
-	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
-		save_thumb[i] = s3_create_image(conf_save_thumb_width, conf_save_thumb_height);
-		if (save_thumb[i] == NULL)
-			return false;
-	}
-
-	/* Load the basic data from the local save files. */
-	load_basic_save_info_all();
 
 	/* Load the global save file. */
 	s3_execute_load_global();
@@ -169,18 +188,19 @@ s3i_init_save(void)
 void
 s3i_cleanup_save(void)
 {
-	int i;
-
-	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
-		FREE(save_title[i]);
-		FREE(save_message[i]);
-		if (save_thumb[i] != NULL) {
-			s3_destroy_image(save_thumb[i]);
-			save_thumb[i] = NULL;
-		}
+	clear_save_slots();
+	if (empty_thumb != NULL) {
+		s3_destroy_image(empty_thumb);
+		empty_thumb = NULL;
 	}
 
 	s3_execute_save_global();
+
+	/* Wait for the writer thread before exit. */
+	s3_flush_save_data();
+
+	FREE(last_global_data);
+	last_global_size = 0;
 }
 
 /*
@@ -191,36 +211,35 @@ s3_execute_save_global(void)
 {
 	int i;
 	int count;
+	uint32_t written;
+	size_t count_pos;
 	bool success;
 
 	success = false;
 	do {
-		/* Open the stream. */
+		/* Open the stream. (The version is written by pack_write_stream()) */
 		if (!open_write_stream())
 			break;
 
-		/* Write the save data versoin. */
-		if (!write_u32(SAVE_VER))
+		/* Write the global variables. (Local ones are omitted.) */
+		count_pos = stream_buf_pos;
+		if (!write_u32(0))
 			break;
-		
-		/* Write the global variables. */
 		count = s3_get_variable_count();
-		if (!write_u32((uint32_t)count))
-			break;
+		written = 0;
 		for (i = 0; i < count; i++) {
 			const char *name = s3_get_variable_name(i);
-			if (s3_is_global_variable(name)) {
-				if (!write_string(name))
-					break;
-				if (!write_string(s3_get_variable_string(name)))
-					break;
-			} else {
-				if (!write_string("#l"))
-					break;
-			}
+			if (!s3_is_global_variable(name))
+				continue;
+			if (!write_string(name))
+				break;
+			if (!write_string(s3_get_variable_string(name)))
+				break;
+			written++;
 		}
 		if (i != count)
 			break;	/* Error. */
+		patch_u32(count_pos, written);
 
 		/* Write the master volume. */
 		if (!write_f32(s3_get_master_volume()))
@@ -250,23 +269,37 @@ s3_execute_save_global(void)
 		if (!write_f32(s3_get_auto_speed()))
 			break;
 
-		/* Write the global config. */
-		count = s3_get_config_count();
-		if (!write_u32((uint32_t)count))
+		/* Write the global config. (Local ones are omitted.) */
+		count_pos = stream_buf_pos;
+		if (!write_u32(0))
 			break;
+		count = s3_get_config_count();
+		written = 0;
 		for (i = 0; i < count; i++) {
 			const char *key = s3_get_config_key(i);
-			if (s3_is_global_save_config(key)) {
-				const char *val = s3_get_config_as_string(key);
-				if (!write_string(key))
-					break;
-				if (!write_string(val))
-					break;
-			} else {
-				if (!write_string("#l"))
-					break;
-			}
+			if (!s3_is_global_save_config(key))
+				continue;
+			if (!write_string(key))
+				break;
+			if (!write_string(s3_get_config_as_string(key)))
+				break;
+			written++;
 		}
+		if (i != count)
+			break;	/* Error. */
+		patch_u32(count_pos, written);
+
+		/* Skip the write if nothing has changed since the last one. */
+		if (is_global_unchanged()) {
+			close_write_stream(NULL);
+			success = true;
+			break;
+		}
+		remember_global(stream_buf, stream_buf_pos);
+
+		/* Compress the stream. */
+		if (!pack_write_stream(NULL))
+			break;
 
 		/* Close the stream. */
 		if (!close_write_stream(GLOBAL_SAVE_FILE))
@@ -276,7 +309,10 @@ s3_execute_save_global(void)
 	} while (0);
 
 	if (!success) {
-		close_write_stream(GLOBAL_SAVE_FILE);
+		/* Don't write a broken file. */
+		close_write_stream(NULL);
+		FREE(last_global_data);
+		last_global_size = 0;
 		return false;
 	}
 
@@ -305,10 +341,12 @@ s3_execute_load_global(void)
 		/* Read the save format version. */
 		if (!read_u32(&ver))
 			break;
-		if (ver != SAVE_VER) {
+		if (ver != SAVE_VER && ver != SAVE_VER_1) {
 			s3_log_error(S3_TR("Save data version mismatched."));
 			break;
 		}
+		if (ver == SAVE_VER && !unpack_read_stream())
+			break;
 		
 		/* Read the global variables. */
 		if (!read_u32((uint32_t *)&count))
@@ -375,6 +413,9 @@ s3_execute_load_global(void)
 		if (i != count)
 			break;	/* Error. */
 
+		/* The next global save can be skipped if nothing changes. */
+		remember_global(stream_buf, stream_buf_pos);
+
 		/* Close the stream. */
 		close_read_stream();
 
@@ -399,10 +440,10 @@ s3_execute_save_local(
 	int index)
 {
 	uint64_t timestamp;
-	uint32_t ver;
 	int i;
 	int count;
-	uint32_t u;
+	uint32_t u, written;
+	size_t count_pos;
 	bool success;
 
 	success = false;
@@ -413,15 +454,10 @@ s3_execute_save_local(
 		/* Save the global save data. */
 		s3_execute_save_global();
 
-		/* Open a buffer for streaming. */
+		/* Open a buffer for streaming. (The version is written by pack_write_stream()) */
 		if (!open_write_stream())
 			return false;
 
-		/* Write the save format version. */
-		ver = (uint32_t)SAVE_VER;
-		if (!write_u32(ver))
-			break;
-
 		/* Write the timestamp. */
 		timestamp = (uint64_t)time(NULL);
 		if (!write_u64(timestamp))
@@ -463,12 +499,9 @@ s3_execute_save_local(
 		if (!write_u32(s3_is_page_top()? 0 : 1))
 			break;
 
-		/* Write the thumbnail. */
+		/* Make the thumbnail. (Stored by pack_write_stream()) */
 		if (!copy_thumb(index))
 			break;
-		if (!write_data(s3_get_image_pixels(save_thumb[index]),
-				(size_t)(conf_save_thumb_width * conf_save_thumb_height * 4)))
-			break;
 
 		/* Write the tag file name. */
 		if (!write_string(s3_get_tag_file()))
@@ -558,47 +591,53 @@ s3_execute_save_local(
 				break;
 		}
 
-		/* Write the vaiables. */
-		count = s3_get_variable_count();
-		if (!write_u32((uint32_t)count))
+		/* Write the vaiables. (Global ones are omitted.) */
+		count_pos = stream_buf_pos;
+		if (!write_u32(0))
 			break;
+		count = s3_get_variable_count();
+		written = 0;
 		for (i = 0; i < count; i++) {
 			const char *name = s3_get_variable_name(i);
-			if (!s3_is_global_variable(name)) {
-				if (!write_string(name))
-					break;
-				if (!write_string(s3_get_variable_string(name)))
-					break;
-			} else {
-				if (!write_string("#"))
-					break;
-			}
+			if (s3_is_global_variable(name))
+				continue;
+			if (!write_string(name))
+				break;
+			if (!write_string(s3_get_variable_string(name)))
+				break;
+			written++;
 		}
 		if (i != count)
 			break;	/* Error. */
+		patch_u32(count_pos, written);
 
 		/* TODO: Serialize the temporary stage of Ciel. */
 
-		/* Write the config. */
-		count = s3_get_config_count();
-		if (!write_u32((uint32_t)count))
+		/* Write the config. (Global ones are omitted.) */
+		count_pos = stream_buf_pos;
+		if (!write_u32(0))
 			break;
+		count = s3_get_config_count();
+		written = 0;
 		for (i = 0; i < count; i++) {
 			const char *key = s3_get_config_key(i);
-			if (s3_is_local_save_config(key)) {
-				if (!write_string(key))
-					break;
-				if (!write_string(s3_get_config_as_string(key)))
-					break;
-			} else {
-				if (!write_string("#"))
-					break;
-			}
+			if (!s3_is_local_save_config(key))
+				continue;
+			if (!write_string(key))
+				break;
+			if (!write_string(s3_get_config_as_string(key)))
+				break;
+			written++;
 		}
 		if (i != count)
 			break;	/* Error. */
+		patch_u32(count_pos, written);
 
-		/* Close the stream. */
+		/* Compress the stream and the thumbnail. */
+		if (!pack_write_stream(save_thumb[index]))
+			break;
+
+		/* Pass the stream to the writer thread. */
 		if (!close_write_stream("%03d.sav", index)) {
 			s3_log_error(S3_TR("Failed to write save data."));
 			return false;
@@ -610,8 +649,14 @@ s3_execute_save_local(
 		/* Update the latest index. */
 		latest_index = index;
 
-		/* Update the basic information. */
-		load_basic_save_info(index);
+		/* Update the basic information without reading the file back. */
+		if (!update_basic_save_info(index))
+			break;
+		save_thumb_offset[index] = PACKED_THUMB_OFFSET;
+
+		/* Update the save index. */
+		if (!write_save_index())
+			break;
 
 		/* Succeeded. */
 		success = true;
@@ -674,10 +719,12 @@ s3_execute_load_local(
 		/* Read the save format version. */
 		if (!read_u32(&ver))
 			break;
-		if (ver != SAVE_VER) {
+		if (ver != SAVE_VER && ver != SAVE_VER_1) {
 			s3_log_error(S3_TR("Save data version mismatched."));
 			break;
 		}
+		if (ver == SAVE_VER && !unpack_read_stream())
+			break;
 
 		/* Skip the timestamp. */
 		if (!read_u64(&timestamp))
@@ -718,9 +765,11 @@ s3_execute_load_local(
 		if (u == 0)
 			s3_reset_page_line();
 
-		/* Skip the thumbnail. */
-		if (!read_skip((size_t)(conf_save_thumb_width * conf_save_thumb_height * 4)))
-			break;
+		/* Skip the thumbnail. (Only the old format has it here.) */
+		if (ver == SAVE_VER_1) {
+			if (!read_skip((size_t)(conf_save_thumb_width * conf_save_thumb_height * 4)))
+				break;
+		}
 
 		/* Read the tag file name. */
 		if (!read_string(sbuf, sizeof(sbuf)))
@@ -1042,26 +1091,198 @@ s3_get_save_thumbnail(
 	if (index >= S3_ALL_SAVE_SLOTS)
 		return NULL;
 
-	return save_thumb[index];
+	/* Load the thumbnail on the first use. */
+	if (save_thumb[index] == NULL && save_time[index] != 0)
+		save_thumb[index] = load_thumb(index);
+	if (save_thumb[index] != NULL)
+		return save_thumb[index];
+
+	/* Use the blank thumbnail for an empty slot. */
+	if (empty_thumb == NULL)
+		empty_thumb = s3_create_image(conf_save_thumb_width, conf_save_thumb_height);
+
+	return empty_thumb;
 }
 
-/* Load the basic information from all local save files. */
+/*
+ * Release the thumbnails out of a slot range.
+ */
+void
+s3_cache_save_thumbnails(
+	int start,
+	int count)
+{
+	int i;
+
+	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
+		if (i >= start && i < start + count)
+			continue;
+		if (save_thumb[i] != NULL) {
+			s3_destroy_image(save_thumb[i]);
+			save_thumb[i] = NULL;
+		}
+	}
+}
+
+/* Load the basic information of all slots from the save index. */
 static bool
-load_basic_save_info_all(void)
+load_save_index(void)
 {
+	uint32_t ver, count;
 	int i;
+	bool success;
+
+	/* The first run, or saved by an older version. */
+	if (!s3_check_save_data(SAVE_INDEX_FILE))
+		return false;
 
 	latest_index = 0;
 
-	/* For each save slot. */
-	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
-		if (!load_basic_save_info(i))
+	success = false;
+	do {
+		/* Open a buffer for streaming. */
+		if (!open_read_stream(SAVE_INDEX_FILE))
+			break;
+
+		/* Read the save format version and the slot count. */
+		if (!read_u32(&ver))
+			break;
+		if (ver != SAVE_VER)
+			break;
+		if (!read_u32(&count))
+			break;
+		if (count != S3_ALL_SAVE_SLOTS)
+			break;
+
+		/* Read the slots. */
+		for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
+			if (!read_u64(&save_time[i]))
+				break;
+			if (save_time[i] == 0)
+				continue;
+			if (save_time[i] > save_time[latest_index])
+				latest_index = i;
+
+			if (!read_string(sbuf, sizeof(sbuf)))
+				break;
+			save_title[i] = strdup(sbuf);
+			if (save_title[i] == NULL) {
+				s3_log_out_of_memory();
+				break;
+			}
+
+			if (!read_string(sbuf, sizeof(sbuf)))
+				break;
+			save_message[i] = strdup(sbuf);
+			if (save_message[i] == NULL) {
+				s3_log_out_of_memory();
+				break;
+			}
+
+			if (!read_u32(&save_thumb_offset[i]))
+				break;
+		}
+		if (i != S3_ALL_SAVE_SLOTS)
+			break;	/* Error. */
+
+		/* Close the stream. */
+		close_read_stream();
+
+		success = true;
+	} while (0);
+
+	if (!success) {
+		close_read_stream();
+		return false;
+	}
+
+	return true;
+}
+
+/* Write the basic information of all slots to the save index. */
+static bool
+write_save_index(void)
+{
+	int i;
+	bool success;
+
+	success = false;
+	do {
+		/* Open the stream. */
+		if (!open_write_stream())
+			return false;
+
+		/* Write the save format version and the slot count. */
+		if (!write_u32(SAVE_VER))
+			break;
+		if (!write_u32(S3_ALL_SAVE_SLOTS))
+			break;
+
+		/* Write the slots. */
+		for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
+			if (!write_u64(save_time[i]))
+				break;
+			if (save_time[i] == 0)
+				continue;
+			if (!write_string(save_title[i]))
+				break;
+			if (!write_string(save_message[i]))
+				break;
+			if (!write_u32(save_thumb_offset[i]))
+				break;
+		}
+		if (i != S3_ALL_SAVE_SLOTS)
+			break;	/* Error. */
+
+		/* Close the stream. */
+		if (!close_write_stream(SAVE_INDEX_FILE))
 			return false;
+
+		success = true;
+	} while (0);
+
+	if (!success) {
+		close_write_stream(NULL);
+		return false;
 	}
 
 	return true;
 }
 
+/* Clear the basic information of all slots. */
+static void
+clear_save_slots(void)
+{
+	int i;
+
+	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++) {
+		save_time[i] = 0;
+		save_thumb_offset[i] = 0;
+		FREE(save_title[i]);
+		FREE(save_message[i]);
+		if (save_thumb[i] != NULL) {
+			s3_destroy_image(save_thumb[i]);
+			save_thumb[i] = NULL;
+		}
+	}
+	latest_index = 0;
+}
+
+/* Load the basic information from all local save files. */
+static bool
+load_basic_save_info_all(void)
+{
+	int i;
+
+	latest_index = 0;
+
+	/* For each save slot. (An empty slot fails.) */
+	for (i = 0; i < S3_ALL_SAVE_SLOTS; i++)
+		load_basic_save_info(i);
+
+	return true;
+}
+
 /* Load the basic information from all local save files. */
 static bool
 load_basic_save_info(
@@ -1079,8 +1300,10 @@ load_basic_save_info(
 		/* Read the save format version. */
 		if (!read_u32(&ver))
 			continue;
-		if (ver != SAVE_VER)
+		if (ver != SAVE_VER && ver != SAVE_VER_1)
 			continue;
+		if (ver == SAVE_VER && !unpack_read_stream())
+			break;
 
 		/* Skip the timestamp. */
 		if (!read_u64(&save_time[index]))
@@ -1116,11 +1339,14 @@ load_basic_save_info(
 		if (!read_u32(&u))
 			break;
 
-		/* Read the thumbnail. */
-		if (!read_data(s3_get_image_pixels(save_thumb[index]),
-			       (size_t)(conf_save_thumb_width * conf_save_thumb_height * 4)))
-			break;
-		s3_notify_image_update(save_thumb[index]);
+		/* Skip the thumbnail; it is loaded when shown. */
+		if (ver == SAVE_VER_1) {
+			save_thumb_offset[index] = (uint32_t)stream_buf_pos;
+			if (!read_skip((size_t)(conf_save_thumb_width * conf_save_thumb_height * 4)))
+				break;
+		} else {
+			save_thumb_offset[index] = PACKED_THUMB_OFFSET;
+		}
 
 		/* Close the stream. */
 		close_read_stream();
@@ -1136,6 +1362,90 @@ load_basic_save_info(
 	return true;
 }
 
+/* Update the basic information of a slot from the current state. */
+static bool
+update_basic_save_info(
+	int index)
+{
+	const char *title, *msg;
+
+	title = s3_get_chapter_name();
+	msg = s3_get_last_append_message();
+
+	FREE(save_title[index]);
+	FREE(save_message[index]);
+	STRDUP(save_title[index], title != NULL ? title : "");
+	STRDUP(save_message[index], msg != NULL ? msg : "");
+
+	return true;
+}
+
+/* Load a thumbnail from a save file. */
+static struct s3_image *
+load_thumb(
+	int index)
+{
+	struct s3_image *img;
+	uint32_t ver, qoi_size;
+	size_t size;
+	bool success;
+
+	size = (size_t)(conf_save_thumb_width * conf_save_thumb_height * 4);
+
+	img = NULL;
+	success = false;
+	do {
+		/* Open a buffer for streaming. */
+		if (!open_read_stream("%03d.sav", index))
+			break;
+
+		/* Read the save format version. */
+		if (!read_u32(&ver))
+			break;
+
+		img = s3_create_image(conf_save_thumb_width, conf_save_thumb_height);
+		if (img == NULL)
+			break;
+
+		if (ver == SAVE_VER) {
+			/* Decode the QOI data. */
+			stream_buf_pos = save_thumb_offset[index];
+			if (!read_u32(&qoi_size))
+				break;
+			if (qoi_size > stream_buf_alloc_size - stream_buf_pos)
+				break;
+			if (!s3i_decode_qoi(stream_buf + stream_buf_pos,
+					    qoi_size,
+					    (uint8_t *)s3_get_image_pixels(img),
+					    conf_save_thumb_width,
+					    conf_save_thumb_height))
+				break;
+		} else if (ver == SAVE_VER_1) {
+			/* Copy the raw pixels. */
+			if ((size_t)save_thumb_offset[index] + size > stream_buf_alloc_size)
+				break;
+			memcpy(s3_get_image_pixels(img), stream_buf + save_thumb_offset[index], size);
+		} else {
+			break;
+		}
+		s3_notify_image_update(img);
+
+		/* Close the stream. */
+		close_read_stream();
+
+		success = true;
+	} while (0);
+
+	if (!success) {
+		close_read_stream();
+		if (img != NULL)
+			s3_destroy_image(img);
+		return NULL;
+	}
+
+	return img;
+}
+
 static bool
 copy_thumb(
 	int index)
@@ -1308,7 +1618,8 @@ resize_buffer(
 	if (stream_buf_pos + inc_size < stream_buf_alloc_size)
 		return true;
 
-	stream_buf_alloc_size *= 2;
+	while (stream_buf_pos + inc_size >= stream_buf_alloc_size)
+		stream_buf_alloc_size *= 2;
 	stream_buf = realloc(stream_buf, stream_buf_alloc_size);
 	if (stream_buf == NULL)
 		return false;
@@ -1316,7 +1627,152 @@ resize_buffer(
 	return true;
 }
 
-/* Close the write stream */
+/* Overwrite u32 at a position of the write stream. */
+static void
+patch_u32(
+	size_t pos,
+	uint32_t val)
+{
+	assert(pos + 4 <= stream_buf_pos);
+
+	stream_buf[pos + 0] = (uint8_t)(val & 0xff);
+	stream_buf[pos + 1] = (uint8_t)((val >> 8) & 0xff);
+	stream_buf[pos + 2] = (uint8_t)((val >> 16) & 0xff);
+	stream_buf[pos + 3] = (uint8_t)((val >> 24) & 0xff);
+}
+
+/*
+ * Replace the write stream with the packed format:
+ *  u32 SAVE_VER
+ *  u32 thumbnail size (0 for no thumbnail)
+ *  u8  thumbnail[] (QOI)
+ *  u32 body size
+ *  u8  body[] (LZ compressed)
+ */
+static bool
+pack_write_stream(
+	struct s3_image *thumb)
+{
+	uint8_t *qoi, *lz;
+	size_t body_size, qoi_size, lz_size;
+	bool success;
+
+	/* Encode the thumbnail. */
+	qoi = NULL;
+	qoi_size = 0;
+	if (thumb != NULL) {
+		if (!s3i_encode_qoi((const uint8_t *)s3_get_image_pixels(thumb),
+				    s3_get_image_width(thumb),
+				    s3_get_image_height(thumb),
+				    &qoi,
+				    &qoi_size))
+			return false;
+	}
+
+	/* Compress the body. */
+	if (!s3i_compress(stream_buf, stream_buf_pos, &lz, &lz_size)) {
+		free(qoi);
+		return false;
+	}
+
+	/* Drop the body and open a new stream. */
+	body_size = stream_buf_pos;
+	free(stream_buf);
+	stream_buf = NULL;
+
+	success = false;
+	do {
+		if (!open_write_stream())
+			break;
+		if (!write_u32(SAVE_VER))
+			break;
+		if (!write_u32((uint32_t)qoi_size))
+			break;
+		if (qoi_size > 0 && !write_data(qoi, qoi_size))
+			break;
+		if (!write_u32((uint32_t)body_size))
+			break;
+		if (!write_data(lz, lz_size))
+			break;
+		success = true;
+	} while (0);
+
+	free(qoi);
+	free(lz);
+
+	return success;
+}
+
+/* Decompress the body of a packed read stream, after the version. */
+static bool
+unpack_read_stream(void)
+{
+	uint32_t thumb_size, body_size;
+	unsigned char *body;
+
+	/* Skip the thumbnail. */
+	if (!read_u32(&thumb_size))
+		return false;
+	if (!read_skip(thumb_size))
+		return false;
+
+	/* Decompress the rest. */
+	if (!read_u32(&body_size))
+		return false;
+	body = malloc(body_size > 0 ? body_size : 1);
+	if (body == NULL) {
+		s3_log_out_of_memory();
+		return false;
+	}
+	if (!s3i_decompress(stream_buf + stream_buf_pos,
+			    stream_buf_alloc_size - stream_buf_pos,
+			    body,
+			    body_size)) {
+		free(body);
+		return false;
+	}
+
+	/* Replace the stream. */
+	free(stream_buf);
+	stream_buf = body;
+	stream_buf_alloc_size = body_size;
+	stream_buf_pos = 0;
+
+	return true;
+}
+
+/* Check if the global data in the write stream is the same as the last. */
+static bool
+is_global_unchanged(void)
+{
+	if (last_global_data == NULL)
+		return false;
+	if (last_global_size != stream_buf_pos)
+		return false;
+	if (memcmp(last_global_data, stream_buf, stream_buf_pos) != 0)
+		return false;
+
+	return true;
+}
+
+/* Keep a copy of the global data. */
+static void
+remember_global(
+	const unsigned char *data,
+	size_t size)
+{
+	FREE(last_global_data);
+	last_global_size = 0;
+
+	/* On failure, the next save simply writes the file. */
+	last_global_data = malloc(size);
+	if (last_global_data == NULL)
+		return;
+	memcpy(last_global_data, data, size);
+	last_global_size = size;
+}
+
+/* Close the write stream, passing the buffer to the writer thread. */
 static bool
 close_write_stream(
 	const char *file,
@@ -1324,14 +1780,19 @@ close_write_stream(
 {
 	char fname[128];
 	va_list ap;
+	bool ret;
 
 	if (file != NULL) {
 		va_start(ap, file);
 		vsnprintf(fname, sizeof(fname), file, ap);
 		va_end(ap);
 
-		if (!s3_write_save_data(fname, stream_buf, stream_buf_pos))
-			return false;
+		/* The writer frees the buffer. */
+		ret = s3_write_save_data_async(fname, stream_buf, stream_buf_pos);
+		stream_buf = NULL;
+		stream_buf_alloc_size = 0;
+		stream_buf_pos = 0;
+		return ret;
 	}
 
 	if (stream_buf != NULL) {
@@ -37,6 +37,11 @@
  */
 #define GLOBAL_SAVE_FILE	"g000.sav"
 
+/*
+ * File name for the save slot index.
+ */
+#define SAVE_INDEX_FILE		"i000.sav"
+
 /*
  * File name for the quick save data.
  */
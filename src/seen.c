@@ -30,6 +30,7 @@
 #include <suika3/suika3.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -47,6 +48,9 @@ static uint8_t seen_flag[SEEN_COUNT / 8];
 /* Is initialized. */
 static bool is_initialized;
 
+/* Is changed after the last load or save? */
+static bool is_dirty;
+
 /* Forward declarations. */
 static const char *hash(const char *file);
 static char hex(int c);
@@ -58,6 +62,7 @@ bool
 s3i_init_seen(void)
 {
 	is_initialized = false;
+	is_dirty = false;
 	memset(seen_flag, 0, sizeof(seen_flag));
 
 	return true;
@@ -86,6 +91,7 @@ s3_load_seen(void)
 
 	/* Clear all flags. */
 	memset(seen_flag, 0, sizeof(seen_flag));
+	is_dirty = false;
 
 	/* Get the save data key. */
 	snprintf(key, sizeof(key), "s-%s", hash(s3_get_tag_file()));
@@ -104,14 +110,29 @@ bool
 s3_save_seen(void)
 {
 	char key[128];
+	uint8_t *data;
+
+	/* Nothing to write if no flag has changed. */
+	if (!is_dirty)
+		return true;
 
 	/* Get the save data key. */
 	snprintf(key, sizeof(key), "s-%s", hash(s3_get_tag_file()));
 
-	/* Write the save data. */
-	if (!s3_write_save_data(key, &seen_flag, sizeof(seen_flag)))
+	/* Make a snapshot for the writer thread. */
+	data = malloc(sizeof(seen_flag));
+	if (data == NULL) {
+		s3_log_out_of_memory();
+		return false;
+	}
+	memcpy(data, seen_flag, sizeof(seen_flag));
+
+	/* Write the save data in the background. */
+	if (!s3_write_save_data_async(key, data, sizeof(seen_flag)))
 		return false;
 
+	is_dirty = false;
+
 	return true;
 }
 
@@ -138,8 +159,10 @@ s3_set_seen_flags(int flag)
 	int index;
 
 	index = s3_get_tag_index();
-	if (index < SEEN_COUNT)
+	if (index < SEEN_COUNT && seen_flag[index] != (uint8_t)flag) {
 		seen_flag[index] = (uint8_t)flag;
+		is_dirty = true;
+	}
 }
 
 /* Get a hash string from a tag file name. */
@@ -206,6 +206,22 @@ static int kirakira_y;
 /* Start time of the last Kira Kira Effect. */
 static uint64_t sw_kirakira;
 
+/* Whether Kira Kira Effect was rendered in the last frame. */
+static bool is_kirakira_rendered;
+
+/*
+ * Render Skip
+ */
+
+/* Generation of the stage, incremented on every change. */
+static uint64_t stage_generation = 1;
+
+/* Generation of the stage at the last rendering. */
+static uint64_t rendered_generation;
+
+/* Whether a script drew outside the stage in the last rendered frame. */
+static bool is_direct_rendered;
+
 /*
  * Forward Declarations
  */
@@ -255,6 +271,9 @@ s3i_init_stage(void)
 	layer_alpha[S3_LAYER_AUTO] = 0;
 	layer_alpha[S3_LAYER_SKIP] = 0;
 
+	/* Render the first frame. */
+	s3i_update_stage_generation();
+
 	return true;
 }
 
@@ -299,6 +318,8 @@ s3_reload_stage_images(void)
 	/* Restore the text layers. */
 	restore_text_layers();
 
+	s3i_update_stage_generation();
+
 	return true;
 }
 
@@ -322,6 +343,8 @@ s3_reload_stage_positions(void)
 
 	layer_x[S3_LAYER_SKIP] = conf_skipmode_x;
 	layer_y[S3_LAYER_SKIP] = conf_skipmode_y;
+
+	s3i_update_stage_generation();
 }
 
 /*
@@ -805,6 +828,8 @@ destroy_layer(
 	layer_center_y[layer] = 0;
 	layer_rotate[layer] = 0.0f;
 
+	s3i_update_stage_generation();
+
 	if (layer != S3_LAYER_CLICK &&
 	    layer != S3_LAYER_MSGBOX &&
 	    layer != S3_LAYER_NAMEBOX &&
@@ -850,8 +875,12 @@ s3_set_layer_position(
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
 
+	if (layer_x[layer] == x && layer_y[layer] == y)
+		return;
+
 	layer_x[layer] = x;
 	layer_y[layer] = y;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -894,8 +923,12 @@ s3_set_layer_scale(
 	if (scale_y == 0)
 		s3_log_info("warning: scale_y = 0");
 
+	if (layer_scale_x[layer] == scale_x && layer_scale_y[layer] == scale_y)
+		return;
+
 	layer_scale_x[layer] = scale_x;
 	layer_scale_y[layer] = scale_y;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -933,8 +966,13 @@ s3_set_layer_center(
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
 
+	if (layer_center_x[layer] == center_x &&
+	    layer_center_y[layer] == center_y)
+		return;
+
 	layer_center_x[layer] = center_x;
 	layer_center_y[layer] = center_y;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -959,7 +997,11 @@ s3_set_layer_rotate(
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
 
+	if (layer_rotate[layer] == rot)
+		return;
+
 	layer_rotate[layer] = rot;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -984,7 +1026,11 @@ s3_set_layer_dim(
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
 
+	if (layer_dim[layer] == dim)
+		return;
+
 	layer_dim[layer] = dim;
+	s3i_update_stage_generation();
 }
 
 
@@ -1032,7 +1078,12 @@ s3_set_layer_alpha(
 	int alpha)
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
+
+	if (layer_alpha[layer] == alpha)
+		return;
+
 	layer_alpha[layer] = alpha;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -1055,7 +1106,12 @@ s3_set_layer_blend(
 	int blend)
 {
 	assert(layer >= 0 && layer < S3_STAGE_LAYERS);
+
+	if (layer_blend[layer] == blend)
+		return;
+
 	layer_blend[layer] = blend;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -1130,6 +1186,7 @@ s3_set_layer_image(
 	}
 
 	layer_image[layer] = img;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -1150,7 +1207,11 @@ s3_set_layer_frame(
 	int layer,
 	int frame)
 {
+	if (layer_frame[layer] == frame)
+		return;
+
 	layer_frame[layer] = frame;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -1177,6 +1238,8 @@ s3_set_layer_text(
 	assert(layer >= S3_LAYER_TEXT1);
 	assert(layer <= S3_LAYER_TEXT8);
 
+	s3i_update_stage_generation();
+
 	if (layer_text[layer] != NULL) {
 		free(layer_text[layer]);
 		layer_text[layer] = NULL;
@@ -1219,6 +1282,8 @@ s3_clear_stage_basic(void)
 {
 	int i;
 
+	s3i_update_stage_generation();
+
 	for (i = 0; i < S3_STAGE_LAYERS; i++) {
 		if (i == S3_LAYER_MSGBOX ||
 		    i == S3_LAYER_NAMEBOX ||
@@ -1246,6 +1311,8 @@ s3_clear_stage(void)
 {
 	int i;
 
+	s3i_update_stage_generation();
+
 	for (i = 0; i < S3_STAGE_LAYERS; i++) {
 		switch (i) {
 		case S3_LAYER_BG:	/* fall-thru */
@@ -1742,6 +1809,9 @@ s3_render_stage(void)
 	/* SYSBTN - System Button */
 	render_layer(S3_LAYER_SYSBTN_IDLE);
 	render_layer(S3_LAYER_SYSBTN_HOVER);
+
+	/* Remember the stage state on the screen. */
+	rendered_generation = stage_generation;
 }
 
 /* Render a layer. */
@@ -2578,6 +2648,8 @@ s3_start_fade(
 
 	assert(stage_mode == STAGE_MODE_IDLE);
 
+	s3i_update_stage_generation();
+
 	/* Enable the fading mode. */
 	stage_mode = STAGE_MODE_FADE;
 	fade_method = method;
@@ -2707,8 +2779,12 @@ s3_set_shake_offset(
 {
 	assert(stage_mode == STAGE_MODE_FADE);
 
+	if (shake_offset_x == x && shake_offset_y == y)
+		return;
+
 	shake_offset_x = x;
 	shake_offset_y = y;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -2808,6 +2884,8 @@ s3_finish_fade(void)
 
 	/* Reset the stage mode. */
 	stage_mode = STAGE_MODE_IDLE;
+
+	s3i_update_stage_generation();
 }
 
 /*
@@ -2988,6 +3066,8 @@ s3_show_namebox(
 		file = conf_namebox_anime_hide;
 
 	/* Set the flag. */
+	if (is_namebox_visible != show)
+		s3i_update_stage_generation();
 	is_namebox_visible = show;
 
 	/* Run an anime. */
@@ -3063,6 +3143,8 @@ s3_show_msgbox(
 		file = conf_msgbox_anime_hide;
 
 	/* Set the flag. */
+	if (is_msgbox_visible != show)
+		s3i_update_stage_generation();
 	is_msgbox_visible = show;
 
 	/* Run an anime. */
@@ -3123,8 +3205,7 @@ s3_set_click_position(
 	int x,
 	int y)
 {
-	layer_x[S3_LAYER_CLICK] = x;
-	layer_y[S3_LAYER_CLICK] = y;
+	s3_set_layer_position(S3_LAYER_CLICK, x, y);
 }
 
 /*
@@ -3134,7 +3215,11 @@ void
 s3_show_click(
 	bool show)
 {
+	if (is_click_visible == show)
+		return;
+
 	is_click_visible = show;
+	s3i_update_stage_generation();
 }
 
 /*
@@ -3147,7 +3232,11 @@ s3_set_click_index(
 	assert(index >= 0 && index < S3_CLICK_FRAMES);
 	assert(index < conf_click_frames);
 
+	if (layer_image[S3_LAYER_CLICK] == click_image[index])
+		return;
+
 	layer_image[S3_LAYER_CLICK] = click_image[index];
+	s3i_update_stage_generation();
 }
 
 /*
@@ -3233,6 +3322,8 @@ s3_show_choosebox(
 {
 	int i;
 
+	s3i_update_stage_generation();
+
 	if (index == -1) {
 		for (i = 0; i < S3_CHOOSEBOX_COUNT; i++) {
 			is_choosebox_idle_visible[i] = show_idle;
@@ -3283,6 +3374,8 @@ s3_show_automode_banner(
 		file = conf_automode_anime_hide;
 
 	/* Set the flag. */
+	if (is_auto_visible != show)
+		s3i_update_stage_generation();
 	is_auto_visible = show;
 
 	/* Run an anime. */
@@ -3324,6 +3417,8 @@ s3_show_skipmode_banner(
 		file = conf_skipmode_anime_hide;
 
 	/* Set the flag. */
+	if (is_skip_visible != show)
+		s3i_update_stage_generation();
 	is_skip_visible = show;
 
 	/* Run an anime. */
@@ -3498,10 +3593,12 @@ s3i_render_kirakira(void)
 
 	lap = (float)s3_get_lap_timer_millisec(&sw_kirakira) / 1000.0f;
 	index = (int)(lap / frame_time);
+	is_kirakira_rendered = false;
 	if (index < 0 || index >= S3_KIRAKIRA_FRAMES)
 		return;
 	if (kirakira_image[index] == NULL)
 		return;
+	is_kirakira_rendered = true;
 
 	if (!conf_kirakira_add_blend) {
 		pf_render_texture(kirakira_x,
@@ -3529,3 +3626,58 @@ s3i_render_kirakira(void)
 				  PF_BLEND_ADD);
 	}
 }
+
+/*
+ * Render Skip
+ */
+
+/*
+ * Notify a change of the stage.
+ */
+void
+s3i_update_stage_generation(void)
+{
+	stage_generation++;
+}
+
+/*
+ * Notify a draw outside the stage.
+ */
+void
+s3i_notify_direct_render(void)
+{
+	is_direct_rendered = true;
+}
+
+/*
+ * Check if the stage has to be rendered in this frame.
+ */
+bool
+s3i_is_stage_render_needed(void)
+{
+	bool was_direct_rendered;
+
+	/*
+	 * Direct draws are not tracked, so the next frame has to call them
+	 * again. The last frame is already presented here, and the draws in
+	 * this frame set the flag again.
+	 */
+	was_direct_rendered = is_direct_rendered;
+	is_direct_rendered = false;
+	if (was_direct_rendered)
+		return true;
+
+	/* Changed since the last rendering. */
+	if (stage_generation != rendered_generation)
+		return true;
+
+	/* Animes are updated in the rendering. */
+	if (s3_is_anime_running())
+		return true;
+
+	/* Erase or advance Kira Kira Effect. */
+	if (is_kirakira_rendered)
+		return true;
+
+	return false;
+}
@@ -100,4 +100,22 @@ s3i_start_kirakira(
 void
 s3i_render_kirakira(void);
 
+/*
+ * Notify a change of the stage.
+ */
+void
+s3i_update_stage_generation(void);
+
+/*
+ * Notify a draw outside the stage.
+ */
+void
+s3i_notify_direct_render(void);
+
+/*
+ * Check if the stage has to be rendered in this frame.
+ */
+bool
+s3i_is_stage_render_needed(void);
+
 #endif
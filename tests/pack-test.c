@@ -0,0 +1,300 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Suika3
+ * Save Data Packing Tests (QOI and LZ round trips)
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Copyright (c) 1996-2026 Awe Morris / SCHOLA SUIKAE
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+#include <suika3/suika3.h>
+#include "../src/pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Patterns of the test data. */
+enum {
+	PAT_ZERO,	/* all zero (the longest runs) */
+	PAT_NOISE,	/* random bytes (incompressible) */
+	PAT_STEP,	/* short repeats */
+	PAT_GRAD	/* smooth gradient with alpha changes */
+};
+
+static int failures;
+
+/* The engine provides this. */
+void
+s3_log_out_of_memory(void)
+{
+	printf("out of memory\n");
+}
+
+/* A small LCG so that the results don't depend on rand(). */
+static uint32_t
+next_random(
+	uint32_t *seed)
+{
+	*seed = *seed * 1103515245U + 12345U;
+	return *seed >> 16;
+}
+
+/* Fill a buffer with a pattern. */
+static void
+fill(
+	uint8_t *buf,
+	size_t size,
+	int pat)
+{
+	uint32_t seed;
+	size_t i;
+
+	seed = 1;
+	for (i = 0; i < size; i++) {
+		switch (pat) {
+		case PAT_ZERO:
+			buf[i] = 0;
+			break;
+		case PAT_NOISE:
+			buf[i] = (uint8_t)next_random(&seed);
+			break;
+		case PAT_STEP:
+			buf[i] = (uint8_t)((i / 3) % 5);
+			break;
+		case PAT_GRAD:
+			buf[i] = (uint8_t)(i % 4 == 3 ? 255 - (i / 4) / 97 : (i / 4) * (i % 4 + 1));
+			break;
+		}
+	}
+}
+
+static void
+check(
+	bool cond,
+	const char *name,
+	size_t arg)
+{
+	if (!cond) {
+		printf("FAIL: %s (%lu)\n", name, (unsigned long)arg);
+		failures++;
+	}
+}
+
+/*
+ * QOI
+ */
+
+/* Encode, decode and compare. Then check that every truncation fails. */
+static void
+test_qoi_image(
+	const uint8_t *pixels,
+	int width,
+	int height,
+	bool truncate)
+{
+	uint8_t *qoi, *out;
+	size_t qoi_size, len, i;
+
+	len = (size_t)width * (size_t)height * 4;
+	out = malloc(len > 0 ? len : 1);
+	if (out == NULL)
+		exit(1);
+
+	if (!s3i_encode_qoi(pixels, width, height, &qoi, &qoi_size)) {
+		check(false, "qoi encode", len);
+		free(out);
+		return;
+	}
+	check(qoi_size <= 14 + len / 4 * 5 + 8, "qoi worst size", len);
+
+	memset(out, 0xaa, len);
+	check(s3i_decode_qoi(qoi, qoi_size, out, width, height), "qoi decode", len);
+	check(len == 0 || memcmp(out, pixels, len) == 0, "qoi round trip", len);
+
+	/* A different size is an error. */
+	check(!s3i_decode_qoi(qoi, qoi_size, out, width + 1, height), "qoi size mismatch", len);
+
+	/* The truncated data are errors. */
+	if (truncate) {
+		for (i = 0; i < qoi_size; i++)
+			check(!s3i_decode_qoi(qoi, i, out, width, height), "qoi truncated", i);
+	}
+
+	free(qoi);
+	free(out);
+}
+
+static void
+test_qoi(void)
+{
+	uint8_t *px;
+	size_t i;
+	int n;
+
+	px = malloc(256 * 256 * 4);
+	if (px == NULL)
+		exit(1);
+	memset(px, 0, 256 * 256 * 4);
+
+	/* Empty and 1x1 images. */
+	test_qoi_image(px, 0, 0, true);
+	px[0] = 1; px[1] = 2; px[2] = 3; px[3] = 4;
+	test_qoi_image(px, 1, 1, true);
+
+	/* Runs around the maximum run length (62), from the initial pixel. */
+	for (n = 60; n <= 126; n++) {
+		for (i = 0; i < (size_t)n * 4; i++)
+			px[i] = (uint8_t)(i % 4 == 3 ? 255 : 0);
+		test_qoi_image(px, n, 1, n == 62 || n == 63);
+	}
+
+	/* A long run of another color, and a run that ends the image. */
+	for (i = 0; i < 256 * 256; i++) {
+		px[i * 4 + 0] = 200;
+		px[i * 4 + 1] = 100;
+		px[i * 4 + 2] = 50;
+		px[i * 4 + 3] = (uint8_t)(i < 1000 ? 128 : 255);
+	}
+	test_qoi_image(px, 256, 256, false);
+
+	/* Incompressible noise. (QOI_OP_RGBA for most pixels) */
+	fill(px, 256 * 256 * 4, PAT_NOISE);
+	test_qoi_image(px, 256, 256, false);
+	test_qoi_image(px, 17, 9, true);
+
+	/* Small differences, wrap-arounds and index hits. */
+	fill(px, 256 * 256 * 4, PAT_GRAD);
+	test_qoi_image(px, 256, 256, false);
+	test_qoi_image(px, 31, 7, true);
+	fill(px, 256 * 256 * 4, PAT_STEP);
+	test_qoi_image(px, 256, 256, false);
+	test_qoi_image(px, 31, 7, true);
+
+	free(px);
+
+	printf("qoi: done\n");
+}
+
+/*
+ * LZ
+ */
+
+/* Compress, decompress and compare. Then check that every truncation fails. */
+static void
+test_lz_data(
+	const uint8_t *data,
+	size_t size,
+	bool truncate)
+{
+	uint8_t *lz, *out;
+	size_t lz_size, i;
+
+	out = malloc(size + 1);
+	if (out == NULL)
+		exit(1);
+
+	if (!s3i_compress(data, size, &lz, &lz_size)) {
+		check(false, "lz compress", size);
+		free(out);
+		return;
+	}
+	check(lz_size <= size + size / 255 + 16, "lz worst size", size);
+
+	memset(out, 0xaa, size + 1);
+	check(s3i_decompress(lz, lz_size, out, size), "lz decompress", size);
+	check(size == 0 || memcmp(out, data, size) == 0, "lz round trip", size);
+	check(out[size] == 0xaa, "lz overrun", size);
+
+	/* A different size is an error. */
+	check(!s3i_decompress(lz, lz_size, out, size + 1), "lz longer size", size);
+	if (size > 0)
+		check(!s3i_decompress(lz, lz_size, out, size - 1), "lz shorter size", size);
+
+	/* The truncated data are errors. */
+	if (truncate) {
+		for (i = 0; i < lz_size; i++)
+			check(!s3i_decompress(lz, i, out, size), "lz truncated", i);
+	}
+
+	free(lz);
+	free(out);
+}
+
+static void
+test_lz(void)
+{
+	static const size_t sizes[] = {
+		/* Around the minimum match and the extra length bytes. */
+		1, 3, 4, 5, 8, 18, 19, 20, 33, 34, 35, 273, 274, 275, 529, 530,
+		/* Larger. */
+		4096, 65535, 65536, 65537, 300000,
+	};
+	/* "a", a match of "aaaa", and "b". Then the broken offsets. */
+	static const uint8_t good[] = { 0x10, 'a', 0x01, 0x00, 0x10, 'b' };
+	static const uint8_t bad_offset0[] = { 0x10, 'a', 0x00, 0x00, 0x10, 'b' };
+	static const uint8_t bad_offset2[] = { 0x10, 'a', 0x02, 0x00, 0x10, 'b' };
+	uint8_t *buf, out[16];
+	size_t i;
+	int pat;
+
+	buf = malloc(300000);
+	if (buf == NULL)
+		exit(1);
+	memset(buf, 0, 300000);
+
+	/* Empty data. */
+	test_lz_data(buf, 0, true);
+
+	/* The patterns in various sizes. */
+	for (pat = PAT_ZERO; pat <= PAT_GRAD; pat++) {
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			fill(buf, sizes[i], pat);
+			test_lz_data(buf, sizes[i], sizes[i] <= 4096);
+		}
+	}
+
+	/* Hand-made sequences. */
+	check(s3i_decompress(good, sizeof(good), out, 6) && memcmp(out, "aaaaab", 6) == 0, "lz overlap", 0);
+	check(!s3i_decompress(bad_offset0, sizeof(bad_offset0), out, 6), "lz offset 0", 0);
+	check(!s3i_decompress(bad_offset2, sizeof(bad_offset2), out, 6), "lz offset 2", 0);
+
+	free(buf);
+
+	printf("lz: done\n");
+}
+
+int
+main(void)
+{
+	test_qoi();
+	test_lz();
+
+	if (failures > 0) {
+		printf("%d failure(s)\n", failures);
+		return 1;
+	}
+
+	printf("All tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,14 @@
+#!/bin/sh
+
+set -eu
+
+echo 'Suika3 Benchmarks'
+echo
+
+CC=${CC:-cc}
+OUT=${TMPDIR:-/tmp}/suika3-save-bench
+
+echo 'Save data (v1 vs. v2)'
+$CC -O2 -I../include -I../external/PlayfieldEngine/include -o $OUT save-bench.c ../src/pack.c -lpng
+$OUT "$@"
+rm -f $OUT
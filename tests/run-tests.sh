@@ -0,0 +1,14 @@
+#!/bin/sh
+
+set -eu
+
+echo 'Suika3 Tests'
+echo
+
+CC=${CC:-cc}
+OUT=${TMPDIR:-/tmp}/suika3-pack-test
+
+echo 'Running pack tests...'
+$CC -O2 -I../include -I../external/PlayfieldEngine/include -o $OUT pack-test.c ../src/pack.c
+$OUT
+rm -f $OUT
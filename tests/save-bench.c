@@ -0,0 +1,273 @@
+/* -*- coding: utf-8; tab-width: 8; indent-tabs-mode: t; -*- */
+
+/*
+ * Suika3
+ * Save Data Benchmark (v1 raw format vs. v2 packed format)
+ */
+
+/*-
+ * SPDX-License-Identifier: Zlib
+ *
+ * Copyright (c) 1996-2026 Awe Morris / SCHOLA SUIKAE
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/*
+ * Usage: save-bench [image.png]
+ *  - The image is shrunk to a thumbnail of the default size.
+ *  - The body is a typical local save with variables and config.
+ */
+
+#include <suika3/suika3.h>
+#include "../src/pack.h"
+
+#include <png.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Default thumbnail size. */
+#define THUMB_WIDTH	(213)
+#define THUMB_HEIGHT	(120)
+
+/* Iterations. */
+#define LOOP_COUNT	(200)
+
+static uint8_t *body;
+static size_t body_size;
+
+/* The engine provides this. */
+void
+s3_log_out_of_memory(void)
+{
+	printf("out of memory\n");
+}
+
+static double
+get_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static void
+write_str(
+	const char *s)
+{
+	size_t len;
+
+	len = strlen(s) + 1;
+	memcpy(body + body_size, s, len);
+	body_size += len;
+}
+
+static void
+write_u32(
+	uint32_t v)
+{
+	body[body_size + 0] = (uint8_t)(v & 0xff);
+	body[body_size + 1] = (uint8_t)((v >> 8) & 0xff);
+	body[body_size + 2] = (uint8_t)((v >> 16) & 0xff);
+	body[body_size + 3] = (uint8_t)((v >> 24) & 0xff);
+	body_size += 4;
+}
+
+/* Make a body like a local save. */
+static void
+make_body(void)
+{
+	char key[64], val[32];
+	int i;
+
+	body = malloc(1024 * 1024);
+	if (body == NULL)
+		exit(1);
+	body_size = 0;
+
+	/* Header strings. */
+	write_u32(0);
+	write_u32(0);
+	write_str("Chapter 1: After School");
+	write_str("Tomoka");
+	write_str("I wonder if she'll come back tomorrow.");
+	write_str("I wonder if she'll come back tomorrow.");
+	write_str("");
+	write_u32(1);
+
+	/* Script position. */
+	write_str("start.novel");
+	write_u32(123);
+	write_u32(120);
+
+	/* Layers. */
+	for (i = 0; i < 16; i++) {
+		write_str("");
+		write_u32(0);
+	}
+	for (i = 0; i < 21; i++) {
+		write_str(i < 3 ? "images/ch/tomoka-smile.png" : "");
+		write_u32(0);
+		write_u32(0);
+		write_u32(255);
+		write_u32(0x3f800000);
+		write_u32(0x3f800000);
+		write_u32(0);
+		write_u32(0);
+		write_u32(0);
+	}
+
+	/* Sounds. */
+	for (i = 0; i < 4; i++) {
+		write_u32(0x3f800000);
+		write_str(i == 0 ? "sound/bgm/afternoon2.ogg" : "");
+	}
+
+	/* Variables. */
+	write_u32(200);
+	for (i = 0; i < 200; i++) {
+		snprintf(key, sizeof(key), "$%d", i);
+		snprintf(val, sizeof(val), "%d", i % 7 != 0 ? 0 : i);
+		write_str(key);
+		write_str(val);
+	}
+
+	/* Config. */
+	write_u32(300);
+	for (i = 0; i < 300; i++) {
+		snprintf(key, sizeof(key), "config.key.%d.name", i);
+		write_str(key);
+		write_str(i % 3 != 0 ? "0" : "images/sys/button.png");
+	}
+}
+
+/* Load an image and shrink it to a thumbnail. */
+static uint8_t *
+make_thumb(
+	const char *file)
+{
+	png_image image;
+	uint8_t *src, *thumb;
+	int x, y, sx, sy;
+
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+	if (!png_image_begin_read_from_file(&image, file)) {
+		printf("Cannot read %s\n", file);
+		exit(1);
+	}
+	image.format = PNG_FORMAT_RGBA;
+
+	src = malloc(PNG_IMAGE_SIZE(image));
+	thumb = malloc(THUMB_WIDTH * THUMB_HEIGHT * 4);
+	if (src == NULL || thumb == NULL)
+		exit(1);
+	if (!png_image_finish_read(&image, NULL, src, 0, NULL)) {
+		printf("Cannot read %s\n", file);
+		exit(1);
+	}
+
+	for (y = 0; y < THUMB_HEIGHT; y++) {
+		sy = (int)((uint32_t)y * image.height / THUMB_HEIGHT);
+		for (x = 0; x < THUMB_WIDTH; x++) {
+			sx = (int)((uint32_t)x * image.width / THUMB_WIDTH);
+			memcpy(thumb + (y * THUMB_WIDTH + x) * 4,
+			       src + ((size_t)sy * image.width + (size_t)sx) * 4,
+			       4);
+		}
+	}
+
+	free(src);
+
+	return thumb;
+}
+
+int
+main(
+	int argc,
+	char *argv[])
+{
+	uint8_t *thumb, *qoi, *lz, *thumb2, *body2;
+	size_t qoi_size, lz_size, v1_size, v2_size, thumb_size;
+	double t0, pack_ms, unpack_ms;
+	int i;
+
+	thumb = make_thumb(argc > 1 ? argv[1] : "../game/images/bg/school.png");
+	thumb_size = THUMB_WIDTH * THUMB_HEIGHT * 4;
+	make_body();
+
+	/* Pack: the thumbnail and the body, as save.c does per save. */
+	qoi = NULL;
+	lz = NULL;
+	t0 = get_ms();
+	for (i = 0; i < LOOP_COUNT; i++) {
+		free(qoi);
+		free(lz);
+		if (!s3i_encode_qoi(thumb, THUMB_WIDTH, THUMB_HEIGHT, &qoi, &qoi_size) ||
+		    !s3i_compress(body, body_size, &lz, &lz_size)) {
+			printf("Pack failed.\n");
+			return 1;
+		}
+	}
+	pack_ms = (get_ms() - t0) / LOOP_COUNT;
+
+	/* Unpack. */
+	thumb2 = malloc(thumb_size);
+	body2 = malloc(body_size);
+	if (thumb2 == NULL || body2 == NULL)
+		return 1;
+	t0 = get_ms();
+	for (i = 0; i < LOOP_COUNT; i++) {
+		if (!s3i_decode_qoi(qoi, qoi_size, thumb2, THUMB_WIDTH, THUMB_HEIGHT) ||
+		    !s3i_decompress(lz, lz_size, body2, body_size)) {
+			printf("Unpack failed.\n");
+			return 1;
+		}
+	}
+	unpack_ms = (get_ms() - t0) / LOOP_COUNT;
+
+	/* v1: version, body, raw thumbnail. v2: version, sizes, QOI, LZ. */
+	v1_size = 4 + body_size + thumb_size;
+	v2_size = 4 + 4 + qoi_size + 4 + lz_size;
+
+	printf("v1: %lu bytes (body %lu, thumbnail %lu)\n",
+	       (unsigned long)v1_size,
+	       (unsigned long)body_size,
+	       (unsigned long)thumb_size);
+	printf("v2: %lu bytes (body %lu, thumbnail %lu), %.1f%% of v1\n",
+	       (unsigned long)v2_size,
+	       (unsigned long)lz_size,
+	       (unsigned long)qoi_size,
+	       100.0 * (double)v2_size / (double)v1_size);
+	printf("save: %.3f ms, load: %.3f ms\n", pack_ms, unpack_ms);
+	printf("round trip: %s\n",
+	       memcmp(thumb, thumb2, thumb_size) == 0 &&
+	       memcmp(body, body2, body_size) == 0 ? "exact" : "MISMATCH");
+
+	free(thumb);
+	free(thumb2);
+	free(body);
+	free(body2);
+	free(qoi);
+	free(lz);
+
+	return 0;
+}